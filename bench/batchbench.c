@@ -0,0 +1,142 @@
+/***************************************************************************
+* FILE NAME:    BatchBench.C                                               *
+* MODULE NAME:  ISO8583Engine benchmarks                                   *
+* PROGRAMMER:                                                              *
+* DESCRIPTION:  Batch decode and encode of a block of 0200 messages of     *
+*               varying size on 1, 2, 4 ... threads up to the CPU count,   *
+*               messages per second and speedup over one thread.           *
+* REVISION:                                                                *
+****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ISO8583Engine.h"
+#include "ISO8583Batch.h"
+#include "SampleFmt.h"
+
+#define BATCH_MSGS      16384
+#define MSG_STRIDE      512
+
+static double NowNs( void )
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+//0200 number iMsg, the variable fields change size from message to message
+static void BuildMessage( const ISO8583_Spec * pSpec, ISO8583_Rec * pRec, int iMsg )
+{
+    static const int Dense0200[] = { 2, 3, 4, 7, 11, 12, 13, 14, 22, 23, 25, 26, 32, 35, 37, 41, 42, 48, 49, 52, 53, 55, 60, 63, 0 };
+    unsigned char cData[ 1000 ];
+    const int * piFields;
+    int i, iFieldNo, iLength;
+
+    ISO8583Engine_ClearAllFields( pRec );
+    ISO8583Engine_SetField( pSpec, pRec, 0, ( unsigned char * )"0200", 4 );
+
+    for( piFields = Dense0200; *piFields; piFields ++ )
+    {
+        iFieldNo = *piFields;
+        iLength = SampleFldFmt[ iFieldNo - 1 ].iMaxLength;
+
+        if( SampleFldFmt[ iFieldNo - 1 ].bType & ISO8583TYPE_VAR )
+            iLength = 1 + ( iMsg * 7 + iFieldNo ) % ( iLength > 40 ? 40 : iLength - 1 );
+        else if( SampleFldFmt[ iFieldNo - 1 ].bType & ISO8583TYPE_BIN )
+            iLength /= 8;
+
+        for( i = 0; i < iLength; i ++ )
+            cData[ i ] = ( unsigned char )(( SampleFldFmt[ iFieldNo - 1 ].bType & ISO8583TYPE_BCD ) ? '0' + ( i + iMsg ) % 10 : 'A' + ( i + iMsg ) % 26 );
+
+        ISO8583Engine_SetField( pSpec, pRec, iFieldNo, cData, iLength );
+    }
+}
+
+int main( int argc, char ** argv )
+{
+    static ISO8583_Spec Spec;
+    static ISO8583_Rec Recs[ BATCH_MSGS ];
+    static ISO8583_Rec * pRecs[ BATCH_MSGS ];
+    static size_t nOffset[ BATCH_MSGS + 1 ];
+    static int iResults[ BATCH_MSGS ];
+    static byte cBuf[ BATCH_MSGS * MSG_STRIDE ], cOut[ BATCH_MSGS * MSG_STRIDE ];
+    byte * pData;
+    int i, iThreads, iMaxThreads, iRounds = argc > 1 ? atoi( argv[ 1 ] ) : 20;
+    double t0, tDecode, tEncode, tBase = 0;
+    ISO8583_Batch * pBatch;
+    long r;
+
+    iMaxThreads = argc > 2 ? atoi( argv[ 2 ] ) : ( int )sysconf( _SC_NPROCESSORS_ONLN );
+    pData = ( byte * )malloc(( size_t )BATCH_MSGS * MSG_STRIDE );
+
+    if( pData == NULL )
+        return 1;
+
+    ISO8583Engine_InitFieldFormat( &Spec, ISO8583_BITMAP64, SampleFldFmt );
+
+    for( i = 0; i < BATCH_MSGS; i ++ )
+    {
+        pRecs[ i ] = &Recs[ i ];
+        ISO8583Engine_InitRec( pRecs[ i ], pData + ( size_t )i * MSG_STRIDE, MSG_STRIDE );
+        BuildMessage( &Spec, pRecs[ i ], i );
+        nOffset[ i + 1 ] = nOffset[ i ] + ISO8583Engine_Iso8583ToHexbuf( &Spec, pRecs[ i ], cBuf + nOffset[ i ], MSG_STRIDE );
+    }
+
+    printf( "%d messages, %.1f bytes average\n", BATCH_MSGS, ( double )nOffset[ BATCH_MSGS ] / BATCH_MSGS );
+
+    if( iMaxThreads < 1 )
+        iMaxThreads = 1;
+
+    for( iThreads = 1; ; iThreads *= 2 )
+    {
+        if( iThreads > iMaxThreads )
+            iThreads = iMaxThreads;
+
+        if(( pBatch = ISO8583Batch_Create( iThreads ) ) == NULL )
+            return 1;
+
+        if( ISO8583Batch_DecodeOffsets( pBatch, &Spec, cBuf, nOffset, pRecs, iResults, BATCH_MSGS ) != 0
+            || ISO8583Batch_Encode( pBatch, &Spec, pRecs, cOut, MSG_STRIDE, iResults, BATCH_MSGS ) != 0 )
+        {
+            printf( "batch failed\n" );
+            return 1;
+        }
+
+        for( i = 0; i < BATCH_MSGS; i ++ )
+        {
+            if( iResults[ i ] != ( int )( nOffset[ i + 1 ] - nOffset[ i ] ) || memcmp( cOut + ( size_t )i * MSG_STRIDE, cBuf + nOffset[ i ], iResults[ i ] ) != 0 )
+            {
+                printf( "message %d does not round trip\n", i );
+                return 1;
+            }
+        }
+
+        t0 = NowNs();
+        for( r = 0; r < iRounds; r ++ )
+            ISO8583Batch_DecodeOffsets( pBatch, &Spec, cBuf, nOffset, pRecs, iResults, BATCH_MSGS );
+        tDecode = ( NowNs() - t0 ) / iRounds / BATCH_MSGS;
+
+        t0 = NowNs();
+        for( r = 0; r < iRounds; r ++ )
+            ISO8583Batch_Encode( pBatch, &Spec, pRecs, cOut, MSG_STRIDE, iResults, BATCH_MSGS );
+        tEncode = ( NowNs() - t0 ) / iRounds / BATCH_MSGS;
+
+        if( iThreads == 1 )
+            tBase = tDecode;
+
+        printf( "%3d threads   decode %8.2f M msg/s (x%.2f)  encode %8.2f M msg/s\n",
+                iThreads, 1e3 / tDecode, tBase / tDecode, 1e3 / tEncode );
+        ISO8583Batch_Destroy( pBatch );
+
+        if( iThreads == iMaxThreads )
+            break;
+    }
+
+    free( pData );
+    return 0;
+}
@@ -0,0 +1,145 @@
+/***************************************************************************
+* FILE NAME:    BitmapBench.C                                              *
+* MODULE NAME:  ISO8583Engine benchmarks                                   *
+* PROGRAMMER:                                                              *
+* DESCRIPTION:  Bitmap walk cost on a sparse 0800 and a dense 0200         *
+*               message: the per-bit 8x8 scan the engine used to do        *
+*               against word loads visiting set bits only, plus the full   *
+*               HexbufToIso8583 / Iso8583ToHexbuf on the same messages.    *
+* REVISION:                                                                *
+****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ISO8583Engine.h"
+#include "ISO8583Bits.h"
+#include "SampleFmt.h"
+
+static volatile int g_iSink;
+
+static double NowNs( void )
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+//Per-bit scan as in the 8x8 loops, returns the sum of the visited field indexes
+static int ScanBits( const byte * pBitmap )
+{
+    int i, j, iSum = 0;
+    byte cBitmask;
+
+    for( i = 0; i < 8; i ++ )
+    {
+        cBitmask = 0x80;
+
+        for( j = 0; j < 8; j ++, cBitmask >>= 1 )
+        {
+            if( i == 0 && cBitmask == 0x80 )
+                continue;
+
+            if(( pBitmap[ i ] & cBitmask ) == 0 )
+                continue;
+
+            iSum += ( i << 3 ) + j;
+        }
+    }
+
+    return iSum;
+}
+
+//Word load and count-trailing-zeros over the set bits only
+static int ScanWord( const byte * pBitmap )
+{
+    unsigned long long ullBits = ISO8583Bits_LoadWire( pBitmap ) & ~1ULL;
+    int iSum = 0;
+
+    for( ; ullBits; ullBits &= ullBits - 1 )
+        iSum += ISO8583Bits_Ctz64( ullBits );
+
+    return iSum;
+}
+
+static void BuildMessage( const ISO8583_Spec * pSpec, ISO8583_Rec * pRec, const char * pMsgID, const int * piFields )
+{
+    unsigned char cData[ 1000 ];
+    int i, iFieldNo, iLength;
+
+    ISO8583Engine_ClearAllFields( pRec );
+    ISO8583Engine_SetField( pSpec, pRec, 0, ( unsigned char * )pMsgID, 4 );
+
+    for( ; *piFields; piFields ++ )
+    {
+        iFieldNo = *piFields;
+        iLength = SampleFldFmt[ iFieldNo - 1 ].iMaxLength;
+
+        if( SampleFldFmt[ iFieldNo - 1 ].bType & ISO8583TYPE_VAR )
+            iLength = iLength > 12 ? 12 : iLength - 1;
+
+        for( i = 0; i < iLength; i ++ )
+            cData[ i ] = ( unsigned char )(( SampleFldFmt[ iFieldNo - 1 ].bType & ISO8583TYPE_BCD ) ? '0' + i % 10 : 'A' + i % 26 );
+
+        ISO8583Engine_SetField( pSpec, pRec, iFieldNo, cData, iLength );
+    }
+}
+
+static void RunCase( const ISO8583_Spec * pSpec, const char * pName, const int * piFields, long lIters )
+{
+    static ISO8583_FixRec FixRec;
+    ISO8583_Rec * pRec = ISO8583Engine_InitFixRec( &FixRec );
+    unsigned char cWire[ 2048 ];
+    double t0, tBits, tWord, tUnpack, tPack;
+    int iLen;
+    long l;
+
+    BuildMessage( pSpec, pRec, pName, piFields );
+    iLen = ISO8583Engine_Iso8583ToHexbuf( pSpec, pRec, cWire, sizeof( cWire ) );
+
+    if( ScanBits( cWire + 2 ) != ScanWord( cWire + 2 ) )
+    {
+        printf( "%s: bitmap scans disagree\n", pName );
+        exit( 1 );
+    }
+
+    t0 = NowNs();
+    for( l = 0; l < lIters; l ++ )
+        g_iSink = ScanBits(( const byte * )cWire + 2 + ( g_iSink & 0 ) );
+    tBits = ( NowNs() - t0 ) / lIters;
+
+    t0 = NowNs();
+    for( l = 0; l < lIters; l ++ )
+        g_iSink = ScanWord(( const byte * )cWire + 2 + ( g_iSink & 0 ) );
+    tWord = ( NowNs() - t0 ) / lIters;
+
+    t0 = NowNs();
+    for( l = 0; l < lIters; l ++ )
+        g_iSink = ISO8583Engine_HexbufToIso8583( pSpec, pRec, cWire );
+    tUnpack = ( NowNs() - t0 ) / lIters;
+
+    t0 = NowNs();
+    for( l = 0; l < lIters; l ++ )
+        g_iSink = ISO8583Engine_Iso8583ToHexbuf( pSpec, pRec, cWire, sizeof( cWire ) );
+    tPack = ( NowNs() - t0 ) / lIters;
+
+    printf( "%s  %2d fields %4d bytes   bit scan %6.1f ns  word scan %6.1f ns   unpack %7.1f ns  pack %7.1f ns\n",
+            pName, ISO8583Bits_Popcount64( pRec->ulBitmap[ 0 ] ), iLen, tBits, tWord, tUnpack, tPack );
+}
+
+int main( int argc, char ** argv )
+{
+    static const int Sparse0800[] = { 7, 11, 39, 41, 0 };
+    static const int Dense0200[] = { 2, 3, 4, 5, 6, 7, 9, 10, 11, 12, 13, 14, 15, 17, 18, 22, 23, 25, 26, 32, 33, 35,
+                                     37, 38, 39, 41, 42, 43, 44, 48, 49, 52, 53, 54, 55, 60, 61, 62, 63, 64, 0 };
+    static ISO8583_Spec Spec;
+    long lIters = argc > 1 ? atol( argv[ 1 ] ) : 2000000;
+
+    ISO8583Engine_InitFieldFormat( &Spec, ISO8583_BITMAP64, SampleFldFmt );
+    RunCase( &Spec, "0800", Sparse0800, lIters );
+    RunCase( &Spec, "0200", Dense0200, lIters );
+    return 0;
+}
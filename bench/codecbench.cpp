@@ -0,0 +1,117 @@
+/***************************************************************************
+* FILE NAME:    CodecBench.CPP                                             *
+* MODULE NAME:  ISO8583Engine benchmarks                                   *
+* PROGRAMMER:                                                              *
+* DESCRIPTION:  ns per message of the table-driven engine against the      *
+*               compile-time specialized iso8583::Codec on SampleFldFmt.   *
+* REVISION:                                                                *
+****************************************************************************/
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "ISO8583Engine.h"
+#include "ISO8583Codec.hpp"
+#include "SampleFmt.h"
+
+using SampleCodec = iso8583::Codec< SampleFldFmt >;
+
+static volatile int g_iSink;
+
+//Fill every field listed in piFields with data valid for its SampleFldFmt type
+static void BuildMessage( const ISO8583_Spec * pSpec, ISO8583_Rec * pRec, const char * pMsgID, const int * piFields )
+{
+    unsigned char cData[ 1000 ];
+    int i, iFieldNo, iLength;
+
+    ISO8583Engine_ClearAllFields( pRec );
+    ISO8583Engine_SetField( pSpec, pRec, 0, ( unsigned char * )pMsgID, 4 );
+
+    for( ; *piFields; piFields ++ )
+    {
+        iFieldNo = *piFields;
+        iLength = SampleFldFmt[ iFieldNo - 1 ].iMaxLength;
+
+        if( SampleFldFmt[ iFieldNo - 1 ].bType & ISO8583TYPE_VAR )
+            iLength = iLength > 20 ? 20 : iLength - 1;
+
+        for( i = 0; i < iLength; i ++ )
+        {
+            if( SampleFldFmt[ iFieldNo - 1 ].bType & ISO8583TYPE_BCD )
+                cData[ i ] = ( unsigned char )( '0' + ( i + iFieldNo ) % 10 );
+            else
+                cData[ i ] = ( unsigned char )( 'A' + ( i + iFieldNo ) % 26 );
+        }
+
+        ISO8583Engine_SetField( pSpec, pRec, iFieldNo, cData, iLength );
+    }
+}
+
+template < typename Fn >
+static double NsPerCall( long lIters, Fn fn )
+{
+    auto tStart = std::chrono::steady_clock::now();
+
+    for( long l = 0; l < lIters; l ++ )
+        fn();
+
+    auto tEnd = std::chrono::steady_clock::now();
+    return std::chrono::duration< double, std::nano >( tEnd - tStart ).count() / lIters;
+}
+
+static int RunCase( const ISO8583_Spec * pSpec, const char * pName, const char * pMsgID, const int * piFields, long lIters )
+{
+    static ISO8583_FixRec SrcFixRec, DstFixRec;
+    ISO8583_Rec * pSrcRec = ISO8583Engine_InitFixRec( &SrcFixRec );
+    ISO8583_Rec * pDstRec = ISO8583Engine_InitFixRec( &DstFixRec );
+    unsigned char cWire[ 2048 ], cOut[ 2048 ];
+    int iLen, iOutLen;
+
+    BuildMessage( pSpec, pSrcRec, pMsgID, piFields );
+    iLen = ISO8583Engine_Iso8583ToHexbuf( pSpec, pSrcRec, cWire, sizeof( cWire ) );
+    iOutLen = SampleCodec::Iso8583ToHexbuf( pSrcRec, cOut, sizeof( cOut ) );
+
+    if( iLen <= 0 || iOutLen != iLen || memcmp( cWire, cOut, iLen ) != 0 )
+    {
+        printf( "%s: codec pack output differs from engine\n", pName );
+        return -1;
+    }
+
+    ISO8583Engine_ClearAllFields( pDstRec );
+
+    if( SampleCodec::HexbufToIso8583( pDstRec, cWire ) != 0
+        || ISO8583Engine_Iso8583ToHexbuf( pSpec, pDstRec, cOut, sizeof( cOut ) ) != iLen
+        || memcmp( cWire, cOut, iLen ) != 0 )
+    {
+        printf( "%s: codec unpack does not round-trip\n", pName );
+        return -1;
+    }
+
+    printf( "%-8s %4d bytes  unpack engine %8.1f ns  codec %8.1f ns   pack engine %8.1f ns  codec %8.1f ns\n",
+            pName, iLen,
+            NsPerCall( lIters, [&] { g_iSink = ISO8583Engine_HexbufToIso8583( pSpec, pDstRec, cWire ); } ),
+            NsPerCall( lIters, [&] { g_iSink = SampleCodec::HexbufToIso8583( pDstRec, cWire ); } ),
+            NsPerCall( lIters, [&] { g_iSink = ISO8583Engine_Iso8583ToHexbuf( pSpec, pSrcRec, cOut, sizeof( cOut ) ); } ),
+            NsPerCall( lIters, [&] { g_iSink = SampleCodec::Iso8583ToHexbuf( pSrcRec, cOut, sizeof( cOut ) ); } ) );
+    return 0;
+}
+
+int main( int argc, char ** argv )
+{
+    static const int Sparse0800[] = { 7, 11, 37, 39, 41, 0 };
+    static const int Dense0200[] = { 2, 3, 4, 7, 11, 12, 13, 14, 18, 22, 23, 25, 32, 35, 37, 38, 39, 41, 42, 43, 49, 52, 53, 55, 60, 62, 64, 0 };
+    static ISO8583_Spec Spec;
+    long lIters = argc > 1 ? atol( argv[ 1 ] ) : 1000000;
+
+    ISO8583Engine_InitFieldFormat( &Spec, ISO8583_BITMAP64, SampleFldFmt );
+
+    if( RunCase( &Spec, "0800", "0800", Sparse0800, lIters ) != 0 )
+        return 1;
+
+    if( RunCase( &Spec, "0200", "0200", Dense0200, lIters ) != 0 )
+        return 1;
+
+    return 0;
+}
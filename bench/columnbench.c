@@ -0,0 +1,150 @@
+/***************************************************************************
+* FILE NAME:    ColumnBench.C                                              *
+* MODULE NAME:  ISO8583Engine benchmarks                                   *
+* PROGRAMMER:                                                              *
+* DESCRIPTION:  Settlement columns (4, 11, 12, 13, 39, 41, 42) out of a    *
+*               block of 0210 messages: HexbufToIso8583 and GetField per   *
+*               field into scratch buffers with atoll for the numbers,     *
+*               against ISO8583Column_AddMessage.                          *
+* REVISION:                                                                *
+****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ISO8583Engine.h"
+#include "ISO8583Column.h"
+#include "SampleFmt.h"
+
+#define BENCH_MSGS      4096
+
+static const int SettleFields[] = { 4, 11, 12, 13, 39, 41, 42 };
+#define SETTLE_COUNT    ( int )( sizeof( SettleFields ) / sizeof( SettleFields[ 0 ] ) )
+
+static long long g_llAmount[ BENCH_MSGS ], g_llStan[ BENCH_MSGS ], g_llTime[ BENCH_MSGS ], g_llDate[ BENCH_MSGS ];
+static char g_cRc[ BENCH_MSGS ][ 2 ], g_cTid[ BENCH_MSGS ][ 8 ], g_cMid[ BENCH_MSGS ][ 15 ];
+
+static double NowNs( void )
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+//The columns the way they are built without the sink
+static void ScratchColumns( const ISO8583_Spec * pSpec, ISO8583_Rec * pRec, byte * pBuf, const size_t * pnOffset )
+{
+    unsigned char cScratch[ 64 ];
+    int i, iLength;
+
+    for( i = 0; i < BENCH_MSGS; i ++ )
+    {
+        ISO8583Engine_HexbufToIso8583( pSpec, pRec, pBuf + pnOffset[ i ] );
+
+        iLength = ISO8583Engine_GetField( pSpec, pRec, 4, cScratch, sizeof( cScratch ) - 1 );
+        cScratch[ iLength > 0 ? iLength : 0 ] = 0;
+        g_llAmount[ i ] = atoll(( char * )cScratch );
+
+        iLength = ISO8583Engine_GetField( pSpec, pRec, 11, cScratch, sizeof( cScratch ) - 1 );
+        cScratch[ iLength > 0 ? iLength : 0 ] = 0;
+        g_llStan[ i ] = atoll(( char * )cScratch );
+
+        iLength = ISO8583Engine_GetField( pSpec, pRec, 12, cScratch, sizeof( cScratch ) - 1 );
+        cScratch[ iLength > 0 ? iLength : 0 ] = 0;
+        g_llTime[ i ] = atoll(( char * )cScratch );
+
+        iLength = ISO8583Engine_GetField( pSpec, pRec, 13, cScratch, sizeof( cScratch ) - 1 );
+        cScratch[ iLength > 0 ? iLength : 0 ] = 0;
+        g_llDate[ i ] = atoll(( char * )cScratch );
+
+        if( ISO8583Engine_GetField( pSpec, pRec, 39, cScratch, sizeof( cScratch ) ) > 0 )
+            memcpy( g_cRc[ i ], cScratch, 2 );
+
+        if( ISO8583Engine_GetField( pSpec, pRec, 41, cScratch, sizeof( cScratch ) ) > 0 )
+            memcpy( g_cTid[ i ], cScratch, 8 );
+
+        if( ISO8583Engine_GetField( pSpec, pRec, 42, cScratch, sizeof( cScratch ) ) > 0 )
+            memcpy( g_cMid[ i ], cScratch, 15 );
+    }
+}
+
+int main( int argc, char ** argv )
+{
+    static ISO8583_Spec Spec;
+    static ISO8583_FixRec FixRec;
+    static byte cBuf[ BENCH_MSGS * 256 ];
+    static size_t nOffset[ BENCH_MSGS + 1 ];
+    ISO8583_Rec * pRec = ISO8583Engine_InitFixRec( &FixRec );
+    ISO8583_ColumnDef Defs[ SETTLE_COUNT ];
+    ISO8583_ColumnSet Set;
+    char cData[ 64 ];
+    long l, lIters = argc > 1 ? atol( argv[ 1 ] ) : 200;
+    double t0, tScratch, tColumn;
+    int i;
+
+    ISO8583Engine_InitFieldFormat( &Spec, ISO8583_BITMAP64, SampleFldFmt );
+
+    for( i = 0; i < BENCH_MSGS; i ++ )
+    {
+        ISO8583Engine_ClearAllFields( pRec );
+        ISO8583Engine_SetField( &Spec, pRec, 0, ( unsigned char * )"0210", 4 );
+        ISO8583Engine_SetField( &Spec, pRec, 2, ( unsigned char * )"6225880012345678", 16 );
+        ISO8583Engine_SetField( &Spec, pRec, 3, ( unsigned char * )"000000", 6 );
+        sprintf( cData, "%012d", i * 37 );
+        ISO8583Engine_SetField( &Spec, pRec, 4, ( unsigned char * )cData, 12 );
+        sprintf( cData, "%06d", i );
+        ISO8583Engine_SetField( &Spec, pRec, 11, ( unsigned char * )cData, 6 );
+        ISO8583Engine_SetField( &Spec, pRec, 12, ( unsigned char * )"101530", 6 );
+        ISO8583Engine_SetField( &Spec, pRec, 13, ( unsigned char * )"1017", 4 );
+        ISO8583Engine_SetField( &Spec, pRec, 37, ( unsigned char * )"000000123456", 12 );
+        ISO8583Engine_SetField( &Spec, pRec, 39, ( unsigned char * )( i % 10 ? "00" : "51" ), 2 );
+        sprintf( cData, "T%07d", i % 500 );
+        ISO8583Engine_SetField( &Spec, pRec, 41, ( unsigned char * )cData, 8 );
+        ISO8583Engine_SetField( &Spec, pRec, 42, ( unsigned char * )"898440358120001", 15 );
+        ISO8583Engine_SetField( &Spec, pRec, 49, ( unsigned char * )"156", 3 );
+        nOffset[ i + 1 ] = nOffset[ i ] + ISO8583Engine_Iso8583ToHexbuf( &Spec, pRec, cBuf + nOffset[ i ], 256 );
+    }
+
+    for( i = 0; i < SETTLE_COUNT; i ++ )
+        ISO8583Column_DefaultDef( &Spec, SettleFields[ i ], &Defs[ i ] );
+
+    if( ISO8583Column_Init( &Set, &Spec, Defs, SETTLE_COUNT, BENCH_MSGS ) != ISOENGINE_OK )
+        return 1;
+
+    ScratchColumns( &Spec, pRec, cBuf, nOffset );
+
+    for( i = 0; i < BENCH_MSGS; i ++ )
+        ISO8583Column_AddMessage( &Set, cBuf + nOffset[ i ], nOffset[ i + 1 ] - nOffset[ i ] );
+
+    for( i = 0; i < BENCH_MSGS; i ++ )
+    {
+        if((( long long * )Set.Column[ 0 ].pData )[ i ] != g_llAmount[ i ] || (( long long * )Set.Column[ 1 ].pData )[ i ] != g_llStan[ i ]
+            || memcmp( Set.Column[ 5 ].pData + i * 8, g_cTid[ i ], 8 ) != 0 )
+        {
+            printf( "row %d differs\n", i );
+            return 1;
+        }
+    }
+
+    t0 = NowNs();
+    for( l = 0; l < lIters; l ++ )
+        ScratchColumns( &Spec, pRec, cBuf, nOffset );
+    tScratch = ( NowNs() - t0 ) / lIters / BENCH_MSGS;
+
+    t0 = NowNs();
+    for( l = 0; l < lIters; l ++ )
+    {
+        ISO8583Column_Reset( &Set );
+
+        for( i = 0; i < BENCH_MSGS; i ++ )
+            ISO8583Column_AddMessage( &Set, cBuf + nOffset[ i ], nOffset[ i + 1 ] - nOffset[ i ] );
+    }
+    tColumn = ( NowNs() - t0 ) / lIters / BENCH_MSGS;
+
+    printf( "%d columns   unpack + GetField %7.1f ns/msg  column sink %7.1f ns/msg\n", SETTLE_COUNT, tScratch, tColumn );
+    ISO8583Column_Free( &Set );
+    return 0;
+}
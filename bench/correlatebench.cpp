@@ -0,0 +1,158 @@
+/***************************************************************************
+* FILE NAME:    CorrelateBench.CPP                                         *
+* MODULE NAME:  ISO8583Engine benchmarks                                   *
+* PROGRAMMER:                                                              *
+* DESCRIPTION:  ns per transaction of request / response correlation with  *
+*               200000 in flight: a mutex guarded std::map keyed on the    *
+*               field 41 / 11 / 7 strings from GetField and swept for      *
+*               timeouts, against ISO8583Correlate keyed on the wire bytes *
+*               with the timer wheel advanced every 1000 transactions.     *
+*               Every 10th request gets no response and times out.        *
+* REVISION:                                                                *
+****************************************************************************/
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+
+#include "ISO8583Engine.h"
+#include "ISO8583Correlate.h"
+#include "SampleFmt.h"
+
+#define BENCH_INFLIGHT      200000
+#define BENCH_TIMEOUT       300
+
+static volatile int g_iSink;
+
+static double NowNs( void )
+{
+    return ( double )std::chrono::duration_cast< std::chrono::nanoseconds >( std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+//Request i: field 7 and 11 vary, 64 terminals
+static void BuildRequest( const ISO8583_Spec * pSpec, ISO8583_Rec * pRec, long i )
+{
+    char cData[ 16 ];
+
+    snprintf( cData, sizeof( cData ), "1017%06ld", i / 1000000 % 1000000 );
+    ISO8583Engine_SetField( pSpec, pRec, 7, ( unsigned char * )cData, 10 );
+    snprintf( cData, sizeof( cData ), "%06ld", i % 1000000 );
+    ISO8583Engine_SetField( pSpec, pRec, 11, ( unsigned char * )cData, 6 );
+    snprintf( cData, sizeof( cData ), "TERM%04ld", i % 64 );
+    ISO8583Engine_SetField( pSpec, pRec, 41, ( unsigned char * )cData, 8 );
+}
+
+static std::string MapKey( const ISO8583_Spec * pSpec, ISO8583_Rec * pRec )
+{
+    unsigned char cData[ 32 ];
+    std::string Key;
+    int iLength;
+
+    iLength = ISO8583Engine_GetField( pSpec, pRec, 41, cData, sizeof( cData ) );
+    Key.append(( const char * )cData, iLength > 0 ? iLength : 0 );
+    iLength = ISO8583Engine_GetField( pSpec, pRec, 11, cData, sizeof( cData ) );
+    Key.append(( const char * )cData, iLength > 0 ? iLength : 0 );
+    iLength = ISO8583Engine_GetField( pSpec, pRec, 7, cData, sizeof( cData ) );
+    Key.append(( const char * )cData, iLength > 0 ? iLength : 0 );
+    return Key;
+}
+
+static void OnExpired( void * pContext, const ISO8583_CorrKey * pKey, void * pUser )
+{
+    ( void )pKey;
+    ( void )pUser;
+    ( *( long * )pContext ) ++;
+}
+
+int main( int argc, char ** argv )
+{
+    static ISO8583_Spec Spec;
+    static ISO8583_FixRec FixRec;
+    ISO8583_Rec * pRec = ISO8583Engine_InitFixRec( &FixRec );
+    std::map< std::string, long > Map;
+    std::mutex Lock;
+    ISO8583_CorrTable * pTable;
+    ISO8583_CorrKey Key;
+    void * pUser;
+    long i, lTx = argc > 1 ? atol( argv[ 1 ] ) : 500000, lMapExpired = 0, lCorrExpired = 0, lMatched = 0;
+    double t0, tMap, tCorr;
+
+    ISO8583Engine_InitFieldFormat( &Spec, ISO8583_BITMAP64, SampleFldFmt );
+    ISO8583Engine_SetField( &Spec, pRec, 0, ( unsigned char * )"0200", 4 );
+
+    //Request i is sent at tick i / 1000, its response comes with request
+    //i + BENCH_INFLIGHT, the timeout is longer than that
+    t0 = NowNs();
+    for( i = 0; i < lTx + BENCH_INFLIGHT; i ++ )
+    {
+        if( i < lTx )
+        {
+            BuildRequest( &Spec, pRec, i );
+            std::lock_guard< std::mutex > Guard( Lock );
+            Map.emplace( MapKey( &Spec, pRec ), i / 1000 + BENCH_TIMEOUT );
+        }
+
+        if( i >= BENCH_INFLIGHT && ( i - BENCH_INFLIGHT ) % 10 != 0 )
+        {
+            BuildRequest( &Spec, pRec, i - BENCH_INFLIGHT );
+            std::lock_guard< std::mutex > Guard( Lock );
+            auto It = Map.find( MapKey( &Spec, pRec ) );
+            if( It != Map.end() )
+            {
+                Map.erase( It );
+                lMatched ++;
+            }
+        }
+
+        if( i % 1000 == 999 )
+        {
+            std::lock_guard< std::mutex > Guard( Lock );
+            for( auto It = Map.begin(); It != Map.end(); )
+            {
+                if( It->second <= i / 1000 + 1 )
+                {
+                    It = Map.erase( It );
+                    lMapExpired ++;
+                }
+                else
+                    ++ It;
+            }
+        }
+    }
+    tMap = ( NowNs() - t0 ) / lTx;
+
+    if(( pTable = ISO8583Correlate_Create( 2 * BENCH_INFLIGHT, OnExpired, &lCorrExpired ) ) == NULL )
+        return 1;
+
+    t0 = NowNs();
+    for( i = 0; i < lTx + BENCH_INFLIGHT; i ++ )
+    {
+        if( i < lTx )
+        {
+            BuildRequest( &Spec, pRec, i );
+            ISO8583Correlate_KeyRec( &Spec, pRec, &Key );
+            if( ISO8583Correlate_Insert( pTable, &Key, ( void * )pRec, BENCH_TIMEOUT ) != ISOENGINE_OK )
+                return 1;
+        }
+
+        if( i >= BENCH_INFLIGHT && ( i - BENCH_INFLIGHT ) % 10 != 0 )
+        {
+            BuildRequest( &Spec, pRec, i - BENCH_INFLIGHT );
+            ISO8583Correlate_KeyRec( &Spec, pRec, &Key );
+            g_iSink += ISO8583Correlate_Match( pTable, &Key, &pUser );
+        }
+
+        if( i % 1000 == 999 )
+            ISO8583Correlate_Advance( pTable, i / 1000 + 1 );
+    }
+    tCorr = ( NowNs() - t0 ) / lTx;
+
+    ISO8583Correlate_Destroy( pTable );
+    printf( "%ld transactions, %ld / %ld timed out   std::map + mutex %7.1f ns  correlate %7.1f ns\n",
+            lTx, lMapExpired, lCorrExpired, tMap, tCorr );
+    return 0;
+}
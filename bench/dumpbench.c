@@ -0,0 +1,144 @@
+/***************************************************************************
+* FILE NAME:    DumpBench.C                                                *
+* MODULE NAME:  ISO8583Engine benchmarks                                   *
+* PROGRAMMER:                                                              *
+* DESCRIPTION:  Cost of tracing a 0200 on the transaction thread: the hex  *
+*               of the message and every field through GetField and        *
+*               fprintf as in usingsample.c, against ISO8583Dump_Format    *
+*               and ISO8583Dump_Log, which queues the masked line for the  *
+*               drain thread. Traces go to /dev/null unless a file is      *
+*               given.                                                     *
+* REVISION:                                                                *
+****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ISO8583Engine.h"
+#include "ISO8583Dump.h"
+#include "SampleFmt.h"
+
+#define BENCH_MSGS      1024
+
+static volatile int g_iSink;
+
+static double NowNs( void )
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+//Trace as usingsample.c does it, in clear
+static void PrintfTrace( FILE * fp, const ISO8583_Spec * pSpec, ISO8583_Rec * pRec, const byte * pMsg, int iLength )
+{
+    unsigned char cHex[ 1024 ], cData[ 1000 ];
+    int j, iFieldLen;
+
+    ISO8583Utils_BCD2ASC(( unsigned char * )pMsg, cHex, iLength * 2 );
+    cHex[ iLength * 2 ] = 0;
+    fprintf( fp, "ISO8583 Hex Buf:%s\n", cHex );
+
+    for( j = 1; j < pSpec->iMaxField; j ++ )
+    {
+        if( !pRec->Field[ j ].bitf )
+            continue;
+
+        iFieldLen = ISO8583Engine_GetField( pSpec, pRec, j + 1, cData, sizeof( cData ) - 1 );
+        cData[ iFieldLen < 0 ? 0 : iFieldLen ] = 0;
+        fprintf( fp, "Field %d: %s\n", j + 1, cData );
+    }
+}
+
+int main( int argc, char ** argv )
+{
+    static ISO8583_Spec Spec;
+    static ISO8583_FixRec FixRec;
+    static byte cBuf[ BENCH_MSGS * 256 ];
+    static size_t nOffset[ BENCH_MSGS + 1 ];
+    static unsigned char cMask[ ISO8583_MAXFIELD ];
+    ISO8583_Rec * pRec = ISO8583Engine_InitFixRec( &FixRec );
+    ISO8583_DumpLog * pLog;
+    ISO8583_DumpRing * pRing;
+    FILE * fp;
+    char cLine[ ISO8583_DUMP_MAXLINE ];
+    unsigned char cData[ 32 ];
+    long l, lIters = argc > 1 ? atol( argv[ 1 ] ) : 100;
+    double t0, tPrintf, tFormat, tLog;
+    int i, iLength, iSum = 0;
+
+    if(( fp = fopen( argc > 2 ? argv[ 2 ] : "/dev/null", "w" ) ) == NULL )
+        return 1;
+
+    ISO8583Engine_InitFieldFormat( &Spec, ISO8583_BITMAP64, SampleFldFmt );
+    ISO8583Dump_InitMask( &Spec, cMask );
+
+    for( i = 0; i < BENCH_MSGS; i ++ )
+    {
+        ISO8583Engine_ClearAllFields( pRec );
+        ISO8583Engine_SetField( &Spec, pRec, 0, ( unsigned char * )"0200", 4 );
+        ISO8583Engine_SetField( &Spec, pRec, 2, ( unsigned char * )"4111111111111111", 16 );
+        ISO8583Engine_SetField( &Spec, pRec, 3, ( unsigned char * )"000000", 6 );
+        sprintf(( char * )cData, "%012d", i * 37 );
+        ISO8583Engine_SetField( &Spec, pRec, 4, cData, 12 );
+        sprintf(( char * )cData, "%06d", i );
+        ISO8583Engine_SetField( &Spec, pRec, 11, cData, 6 );
+        ISO8583Engine_SetField( &Spec, pRec, 22, ( unsigned char * )"051", 3 );
+        ISO8583Engine_SetField( &Spec, pRec, 35, ( unsigned char * )"4111111111111111=2512101123456", 30 );
+        ISO8583Engine_SetField( &Spec, pRec, 41, ( unsigned char * )"TERM0001", 8 );
+        ISO8583Engine_SetField( &Spec, pRec, 42, ( unsigned char * )"898440358120001", 15 );
+        ISO8583Engine_SetField( &Spec, pRec, 49, ( unsigned char * )"156", 3 );
+        ISO8583Engine_SetField( &Spec, pRec, 52, ( unsigned char * )"\x12\x34\x56\x78\x9A\xBC\xDE\xF0", 8 );
+        nOffset[ i + 1 ] = nOffset[ i ] + ISO8583Engine_Iso8583ToHexbuf( &Spec, pRec, cBuf + nOffset[ i ], 256 );
+    }
+
+    //every loop decodes the message first, as the transaction thread would
+    t0 = NowNs();
+    for( l = 0; l < lIters; l ++ )
+    {
+        for( i = 0; i < BENCH_MSGS; i ++ )
+        {
+            iLength = ( int )( nOffset[ i + 1 ] - nOffset[ i ] );
+            ISO8583Engine_HexbufToIso8583Len( &Spec, pRec, cBuf + nOffset[ i ], iLength );
+            PrintfTrace( fp, &Spec, pRec, cBuf + nOffset[ i ], iLength );
+        }
+    }
+    fflush( fp );
+    tPrintf = ( NowNs() - t0 ) / lIters / BENCH_MSGS;
+
+    t0 = NowNs();
+    for( l = 0; l < lIters; l ++ )
+    {
+        for( i = 0; i < BENCH_MSGS; i ++ )
+        {
+            ISO8583Engine_HexbufToIso8583Len( &Spec, pRec, cBuf + nOffset[ i ], nOffset[ i + 1 ] - nOffset[ i ] );
+            iSum += ISO8583Dump_Format( &Spec, cMask, pRec, cLine, sizeof( cLine ) );
+        }
+    }
+    tFormat = ( NowNs() - t0 ) / lIters / BENCH_MSGS;
+
+    if(( pLog = ISO8583Dump_Create( fp, 1 ) ) == NULL || ( pRing = ISO8583Dump_OpenRing( pLog, 1 << 22 ) ) == NULL )
+        return 1;
+
+    t0 = NowNs();
+    for( l = 0; l < lIters; l ++ )
+    {
+        for( i = 0; i < BENCH_MSGS; i ++ )
+        {
+            ISO8583Engine_HexbufToIso8583Len( &Spec, pRec, cBuf + nOffset[ i ], nOffset[ i + 1 ] - nOffset[ i ] );
+            iSum += ISO8583Dump_Log( pRing, &Spec, cMask, pRec );
+        }
+    }
+    tLog = ( NowNs() - t0 ) / lIters / BENCH_MSGS;
+
+    printf( "per message, decode included: printf trace %7.1f ns   Format %6.1f ns   Log %6.1f ns, %llu of %ld dropped\n",
+            tPrintf, tFormat, tLog, ISO8583Dump_Dropped( pLog ), lIters * BENCH_MSGS );
+
+    ISO8583Dump_Destroy( pLog );
+    fclose( fp );
+    g_iSink = iSum;
+    return 0;
+}
@@ -0,0 +1,546 @@
+/***************************************************************************
+* FILE NAME:    EngineBench.C                                              *
+* MODULE NAME:  ISO8583Engine benchmarks                                   *
+* PROGRAMMER:                                                              *
+* DESCRIPTION:  Reference benchmark of the engine on SampleFldFmt, meant   *
+*               to be run on every commit and compared:                    *
+*               - pack and unpack of three message mixes: a sparse 0800    *
+*                 as in usingsample.c, a dense 0200 with fields 2 - 64     *
+*                 and a 0200 carrying fields 46 - 63 at their longest      *
+*                 (999 where the spec allows it)                           *
+*               - SetField and GetField per field type                     *
+*               - the BCD / ASCII utilities                                *
+*               Every case is calibrated to run -t ms per sample, the      *
+*               median of -r samples is reported as ns per operation,      *
+*               operations and bytes per second. -j writes the results as  *
+*               JSON, one case per line; -b reads such a file back and     *
+*               shows the change against it.                               *
+*               enginebench [-t ms] [-r repeats] [-f filter] [-l label]    *
+*                           [-j out.json] [-b baseline.json]               *
+* REVISION:                                                                *
+****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ISO8583Engine.h"
+#include "ISO8583Pool.h"
+#include "ISO8583Stats.h"
+#include "SampleFmt.h"
+
+#define BENCH_MSGS      64
+#define BENCH_MSGSIZE   ( 20 * 1024 )
+#define BENCH_CASES     64
+#define BENCH_REPEATS   31
+
+//One message mix: records to pack and their wire form to unpack
+typedef struct
+{
+    const char * pName;
+    ISO8583_Rec * pRecs[ BENCH_MSGS ];
+    byte * pWire[ BENCH_MSGS ];
+    int iLength[ BENCH_MSGS ];
+    double dBytes;              // average message length
+} BenchMix;
+
+//SetField / GetField of one field type
+typedef struct
+{
+    const char * pName;
+    int iFieldNo;
+    int iLength;
+} BenchField;
+
+typedef struct BenchCase BenchCase;
+typedef long ( * BenchFn )( BenchCase * pCase, long lIters );
+
+struct BenchCase
+{
+    char cName[ 48 ];
+    BenchFn pfnRun;
+    BenchMix * pMix;
+    const BenchField * pField;
+    double dBytes;              // bytes processed per operation
+    double dNs;                 // median ns per operation
+};
+
+static const BenchField FieldTypes[] =
+{
+    { "n_fixed",    4,  12 },
+    { "n_llvar",    2,  16 },
+    { "n_lllvar",   48, 200 },
+    { "an_fixed",   43, 40 },
+    { "ans_llvar",  44, 25 },
+    { "ans_lllvar", 62, 999 },
+    { "b_fixed",    52, 8 },
+};
+
+static ISO8583_Spec g_Spec;
+static ISO8583_Rec * g_pRec;            // decode target and field record
+static byte g_cOut[ BENCH_MSGSIZE ];
+static unsigned char g_cData[ 1024 ];
+static unsigned char g_cAsc[ 64 ];
+static unsigned char g_cBcd[ 32 ];
+static volatile long g_lSink;
+
+static double NowNs( void )
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+//Field data of iLength characters valid for the type of iFieldNo
+static void FillField( int iFieldNo, int iLength, int iSeed, unsigned char * pData )
+{
+    int i, iType = SampleFldFmt[ iFieldNo - 1 ].bType;
+
+    for( i = 0; i < iLength; i ++ )
+    {
+        if( iType & ISO8583TYPE_BCD )
+            pData[ i ] = ( unsigned char )( '0' + ( i + iSeed ) % 10 );
+        else if( iType & ISO8583TYPE_BIN )
+            pData[ i ] = ( unsigned char )( i * 37 + iSeed );
+        else
+            pData[ i ] = ( unsigned char )( 'A' + ( i + iSeed ) % 26 );
+    }
+}
+
+//Length the mixes set a field to: fixed fields in full, variable ones up to
+//iVarLength
+static int MixLength( int iFieldNo, int iVarLength )
+{
+    const ISO8583_FieldFormat * pFmt = &SampleFldFmt[ iFieldNo - 1 ];
+
+    if( pFmt->bType & ISO8583TYPE_BIN )
+        return pFmt->iMaxLength / 8;
+
+    if( pFmt->bType & ISO8583TYPE_VAR )
+        return pFmt->iMaxLength < iVarLength ? pFmt->iMaxLength : iVarLength;
+
+    return pFmt->iMaxLength;
+}
+
+static void SetMixField( ISO8583_Rec * pRec, int iFieldNo, int iVarLength, int iSeed )
+{
+    int iLength = MixLength( iFieldNo, iVarLength );
+
+    FillField( iFieldNo, iLength, iSeed, g_cData );
+    ISO8583Engine_SetField( &g_Spec, pRec, iFieldNo, g_cData, iLength );
+}
+
+//Build the records and wire form of a mix
+static int BuildMix( ISO8583_Pool * pPool, BenchMix * pMix, const char * pName )
+{
+    static const int Sparse[] = { 4, 11, 41, 42, 60, 63 };
+    static const int Base[] = { 2, 3, 4, 11, 22, 41, 42, 49 };
+    ISO8583_Rec * pRec;
+    double dTotal = 0;
+    int i, j;
+
+    pMix->pName = pName;
+
+    for( i = 0; i < BENCH_MSGS; i ++ )
+    {
+        if(( pRec = pMix->pRecs[ i ] = ISO8583Pool_Acquire( pPool ) ) == NULL
+            || ( pMix->pWire[ i ] = ( byte * )malloc( BENCH_MSGSIZE ) ) == NULL )
+            return -1;
+
+        if( strcmp( pName, "0800_sparse" ) == 0 )
+        {
+            ISO8583Engine_SetField( &g_Spec, pRec, 0, ( unsigned char * )"0800", 4 );
+            for( j = 0; j < ( int )( sizeof( Sparse ) / sizeof( Sparse[ 0 ] ) ); j ++ )
+                SetMixField( pRec, Sparse[ j ], 11, i + j );
+        }
+        else if( strcmp( pName, "0200_dense" ) == 0 )
+        {
+            ISO8583Engine_SetField( &g_Spec, pRec, 0, ( unsigned char * )"0200", 4 );
+            for( j = 2; j <= 64; j ++ )
+                SetMixField( pRec, j, 16, i + j );
+        }
+        else
+        {
+            ISO8583Engine_SetField( &g_Spec, pRec, 0, ( unsigned char * )"0200", 4 );
+            for( j = 0; j < ( int )( sizeof( Base ) / sizeof( Base[ 0 ] ) ); j ++ )
+                SetMixField( pRec, Base[ j ], 16, i + j );
+            for( j = 46; j <= 63; j ++ )
+                SetMixField( pRec, j, 999, i + j );
+        }
+
+        //a case must not time an error path
+        if(( pMix->iLength[ i ] = ISO8583Engine_Iso8583ToHexbuf( &g_Spec, pRec, pMix->pWire[ i ], BENCH_MSGSIZE ) ) <= 0
+            || ISO8583Engine_HexbufToIso8583Len( &g_Spec, g_pRec, pMix->pWire[ i ], pMix->iLength[ i ] ) != 0 )
+            return -1;
+
+        dTotal += pMix->iLength[ i ];
+    }
+
+    pMix->dBytes = dTotal / BENCH_MSGS;
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------
+ * Cases, each runs lIters operations
+ *-----------------------------------------------------------------------------*/
+
+static long RunPack( BenchCase * pCase, long lIters )
+{
+    long l, lSum = 0;
+
+    for( l = 0; l < lIters; l ++ )
+        lSum += ISO8583Engine_Iso8583ToHexbuf( &g_Spec, pCase->pMix->pRecs[ l & ( BENCH_MSGS - 1 ) ], g_cOut, sizeof( g_cOut ) );
+
+    return lSum;
+}
+
+static long RunUnpack( BenchCase * pCase, long lIters )
+{
+    long l, lSum = 0;
+    int i;
+
+    for( l = 0; l < lIters; l ++ )
+    {
+        i = ( int )( l & ( BENCH_MSGS - 1 ) );
+        lSum += ISO8583Engine_HexbufToIso8583Len( &g_Spec, g_pRec, pCase->pMix->pWire[ i ], pCase->pMix->iLength[ i ] );
+    }
+
+    return lSum;
+}
+
+static long RunSetField( BenchCase * pCase, long lIters )
+{
+    long l, lSum = 0;
+
+    for( l = 0; l < lIters; l ++ )
+        lSum += ISO8583Engine_SetField( &g_Spec, g_pRec, pCase->pField->iFieldNo, g_cData, pCase->pField->iLength );
+
+    return lSum;
+}
+
+static long RunGetField( BenchCase * pCase, long lIters )
+{
+    unsigned char cOut[ 1024 ];
+    long l, lSum = 0;
+
+    for( l = 0; l < lIters; l ++ )
+        lSum += ISO8583Engine_GetField( &g_Spec, g_pRec, pCase->pField->iFieldNo, cOut, sizeof( cOut ) );
+
+    return lSum;
+}
+
+static long RunBcd2Asc( BenchCase * pCase, long lIters )
+{
+    long l, lSum = 0;
+
+    ( void )pCase;
+
+    for( l = 0; l < lIters; l ++ )
+        lSum += ISO8583Utils_BCD2ASC( g_cBcd, g_cAsc, 64 ) + g_cAsc[ l & 63 ];
+
+    return lSum;
+}
+
+static long RunAsc2Bcd( BenchCase * pCase, long lIters )
+{
+    long l, lSum = 0;
+
+    ( void )pCase;
+
+    for( l = 0; l < lIters; l ++ )
+        lSum += ISO8583Utils_ASC2BCD( g_cAsc, g_cBcd, 64 ) + g_cBcd[ l & 31 ];
+
+    return lSum;
+}
+
+static long RunBcd2U64( BenchCase * pCase, long lIters )
+{
+    unsigned long long ullValue;
+    long l, lSum = 0;
+
+    ( void )pCase;
+
+    for( l = 0; l < lIters; l ++ )
+    {
+        ISO8583Utils_BCD2U64( g_cBcd + ( l & 7 ), 12, &ullValue );
+        lSum += ( long )ullValue;
+    }
+
+    return lSum;
+}
+
+static long RunU642Bcd( BenchCase * pCase, long lIters )
+{
+    unsigned char cOut[ 8 ];
+    long l, lSum = 0;
+
+    ( void )pCase;
+
+    for( l = 0; l < lIters; l ++ )
+        lSum += ISO8583Utils_U642BCD(( unsigned long long )l * 7919, cOut, 12 ) + cOut[ 5 ];
+
+    return lSum;
+}
+
+static long RunAsc2U64( BenchCase * pCase, long lIters )
+{
+    unsigned long long ullValue;
+    long l, lSum = 0;
+
+    ( void )pCase;
+
+    for( l = 0; l < lIters; l ++ )
+    {
+        ISO8583Utils_ASC2U64( g_cAsc + ( l & 15 ), 12, &ullValue );
+        lSum += ( long )ullValue;
+    }
+
+    return lSum;
+}
+
+static long RunLuhn( BenchCase * pCase, long lIters )
+{
+    long l, lSum = 0;
+
+    ( void )pCase;
+
+    for( l = 0; l < lIters; l ++ )
+        lSum += ISO8583Utils_Luhn( g_cAsc + ( l & 15 ), 16, FALSE );
+
+    return lSum;
+}
+
+static BenchCase * AddCase( BenchCase * pCases, int * piCases, const char * pName, const char * pSub, BenchFn pfnRun, double dBytes )
+{
+    BenchCase * pCase = &pCases[ ( *piCases ) ++ ];
+
+    memset( pCase, 0, sizeof( BenchCase ) );
+    snprintf( pCase->cName, sizeof( pCase->cName ), "%s/%s", pName, pSub );
+    pCase->pfnRun = pfnRun;
+    pCase->dBytes = dBytes;
+    return pCase;
+}
+
+static int CompareDouble( const void * a, const void * b )
+{
+    double dA = *( const double * )a, dB = *( const double * )b;
+
+    return dA < dB ? -1 : dA > dB;
+}
+
+//Median ns per operation of iRepeats samples of about iSampleMs each
+static double Measure( BenchCase * pCase, int iSampleMs, int iRepeats )
+{
+    double dSamples[ BENCH_REPEATS ], t0, dNs;
+    long lIters = 16;
+    int i;
+
+    //warm up and find the iterations of one sample
+    for( ;; )
+    {
+        t0 = NowNs();
+        g_lSink += pCase->pfnRun( pCase, lIters );
+        dNs = NowNs() - t0;
+
+        if( dNs >= iSampleMs * 1e6 / 4 )
+            break;
+
+        lIters *= 2;
+    }
+
+    lIters = ( long )( lIters * ( iSampleMs * 1e6 ) / dNs ) + 1;
+
+    for( i = 0; i < iRepeats; i ++ )
+    {
+        t0 = NowNs();
+        g_lSink += pCase->pfnRun( pCase, lIters );
+        dSamples[ i ] = ( NowNs() - t0 ) / lIters;
+    }
+
+    qsort( dSamples, iRepeats, sizeof( double ), CompareDouble );
+    return dSamples[ iRepeats / 2 ];
+}
+
+//ns per operation of a case in a file written by -j, 0 if not there
+static double BaselineNs( const char * pBaseline, const char * pName )
+{
+    size_t nName = strlen( pName );
+    const char * p;
+
+    if( pBaseline == NULL )
+        return 0;
+
+    //Match the whole name, however long, not a prefix of another case
+    for( p = pBaseline; ( p = strstr( p, "\"name\": \"" ) ) != NULL; p ++ )
+    {
+        p += 9;
+        if( strncmp( p, pName, nName ) == 0 && p[ nName ] == '"' )
+            break;
+    }
+
+    if( p == NULL || ( p = strstr( p, "\"ns_per_op\": " ) ) == NULL )
+        return 0;
+
+    return atof( p + 13 );
+}
+
+static char * ReadFile( const char * pPath )
+{
+    FILE * fp = fopen( pPath, "rb" );
+    char * pText = NULL;
+    long lSize;
+
+    if( fp == NULL )
+        return NULL;
+
+    if( fseek( fp, 0, SEEK_END ) == 0 && ( lSize = ftell( fp ) ) >= 0 && fseek( fp, 0, SEEK_SET ) == 0
+        && ( pText = ( char * )malloc( lSize + 1 ) ) != NULL )
+        pText[ fread( pText, 1, lSize, fp ) ] = 0;
+
+    fclose( fp );
+    return pText;
+}
+
+int main( int argc, char ** argv )
+{
+    static BenchMix Mixes[ 3 ];
+    static BenchCase Cases[ BENCH_CASES ];
+    static const char * MixNames[ 3 ] = { "0800_sparse", "0200_dense", "0200_private" };
+    ISO8583_Pool * pPool;
+    BenchCase * pCase;
+    const char * pFilter = NULL, * pLabel = "", * pJson = NULL, * pBase = NULL;
+    char * pBaseline = NULL, cDate[ 32 ];
+    FILE * fp;
+    time_t tNow = time( NULL );
+    double dBase;
+    int i, iRun, iCases = 0, iSampleMs = 100, iRepeats = 5;
+
+    while(( i = getopt( argc, argv, "t:r:f:l:j:b:" ) ) != -1 )
+    {
+        switch( i )
+        {
+        case 't': iSampleMs = atoi( optarg ); break;
+        case 'r': iRepeats = atoi( optarg ); break;
+        case 'f': pFilter = optarg; break;
+        case 'l': pLabel = optarg; break;
+        case 'j': pJson = optarg; break;
+        case 'b': pBase = optarg; break;
+        default:
+            fprintf( stderr, "usage: %s [-t ms] [-r repeats] [-f filter] [-l label] [-j out.json] [-b baseline.json]\n", argv[ 0 ] );
+            return 2;
+        }
+    }
+
+    if( iSampleMs < 1 )
+        iSampleMs = 1;
+
+    if( iRepeats < 1 || iRepeats > BENCH_REPEATS )
+        iRepeats = iRepeats < 1 ? 1 : BENCH_REPEATS;
+
+    if( pBase && ( pBaseline = ReadFile( pBase ) ) == NULL )
+    {
+        perror( pBase );
+        return 1;
+    }
+
+    ISO8583Engine_InitFieldFormat( &g_Spec, ISO8583_BITMAP64, SampleFldFmt );
+
+    if(( pPool = ISO8583Pool_Create( BENCH_MSGS * 3 + 1, ISO8583_MAXLENTH ) ) == NULL
+        || ( g_pRec = ISO8583Pool_Acquire( pPool ) ) == NULL )
+        return 1;
+
+    for( i = 0; i < 3; i ++ )
+    {
+        if( BuildMix( pPool, &Mixes[ i ], MixNames[ i ] ) != 0 )
+        {
+            fprintf( stderr, "cannot build %s\n", MixNames[ i ] );
+            return 1;
+        }
+    }
+
+    for( i = 0; i < 3; i ++ )
+        AddCase( Cases, &iCases, "pack", MixNames[ i ], RunPack, Mixes[ i ].dBytes )->pMix = &Mixes[ i ];
+
+    for( i = 0; i < 3; i ++ )
+        AddCase( Cases, &iCases, "unpack", MixNames[ i ], RunUnpack, Mixes[ i ].dBytes )->pMix = &Mixes[ i ];
+
+    for( i = 0; i < ( int )( sizeof( FieldTypes ) / sizeof( FieldTypes[ 0 ] ) ); i ++ )
+        AddCase( Cases, &iCases, "setfield", FieldTypes[ i ].pName, RunSetField, FieldTypes[ i ].iLength )->pField = &FieldTypes[ i ];
+
+    for( i = 0; i < ( int )( sizeof( FieldTypes ) / sizeof( FieldTypes[ 0 ] ) ); i ++ )
+        AddCase( Cases, &iCases, "getfield", FieldTypes[ i ].pName, RunGetField, FieldTypes[ i ].iLength )->pField = &FieldTypes[ i ];
+
+    AddCase( Cases, &iCases, "utils", "bcd2asc_64", RunBcd2Asc, 32 );
+    AddCase( Cases, &iCases, "utils", "asc2bcd_64", RunAsc2Bcd, 64 );
+    AddCase( Cases, &iCases, "utils", "bcd2u64_12", RunBcd2U64, 6 );
+    AddCase( Cases, &iCases, "utils", "u642bcd_12", RunU642Bcd, 6 );
+    AddCase( Cases, &iCases, "utils", "asc2u64_12", RunAsc2U64, 12 );
+    AddCase( Cases, &iCases, "utils", "luhn_16", RunLuhn, 16 );
+
+    //utility inputs, a Luhn valid PAN leads the ASCII digits
+    memcpy( g_cAsc, "4111111111111111", 16 );
+    for( i = 16; i < ( int )sizeof( g_cAsc ); i ++ )
+        g_cAsc[ i ] = ( unsigned char )( '0' + i % 10 );
+    ISO8583Utils_ASC2BCD( g_cAsc, g_cBcd, 64 );
+
+    printf( "%-26s %10s %14s %12s %8s\n", "case", "ns/op", "ops/s", "MB/s", pBaseline ? "change" : "" );
+
+    for( i = 0; i < iCases; i ++ )
+    {
+        pCase = &Cases[ i ];
+
+        if( pFilter && strstr( pCase->cName, pFilter ) == NULL )
+            continue;
+
+        //a field case runs on data of its own type, GetField on the field set
+        if( pCase->pField )
+        {
+            FillField( pCase->pField->iFieldNo, pCase->pField->iLength, 0, g_cData );
+            ISO8583Engine_SetField( &g_Spec, g_pRec, pCase->pField->iFieldNo, g_cData, pCase->pField->iLength );
+        }
+
+        pCase->dNs = Measure( pCase, iSampleMs, iRepeats );
+        printf( "%-26s %10.1f %14.0f %12.1f", pCase->cName, pCase->dNs, 1e9 / pCase->dNs, pCase->dBytes * 1e3 / pCase->dNs );
+
+        if(( dBase = BaselineNs( pBaseline, pCase->cName ) ) > 0 )
+            printf( " %+7.1f%%", 100 * ( pCase->dNs - dBase ) / dBase );
+
+        printf( "\n" );
+        fflush( stdout );
+    }
+
+    if( pJson )
+    {
+        if(( fp = fopen( pJson, "w" ) ) == NULL )
+        {
+            perror( pJson );
+            return 1;
+        }
+
+        strftime( cDate, sizeof( cDate ), "%Y-%m-%dT%H:%M:%SZ", gmtime( &tNow ) );
+        fprintf( fp, "{\"suite\": \"iso8583engine\", \"label\": \"%s\", \"date\": \"%s\", \"sample_ms\": %d, \"repeats\": %d, "
+                     "\"simd_level\": %d, \"stats\": %d,\n\"results\": [\n",
+                 pLabel, cDate, iSampleMs, iRepeats, ISO8583Utils_GetSimdLevel(), ISO8583Stats_Enabled() );
+
+        for( i = 0, iRun = 0; i < iCases; i ++ )
+        {
+            pCase = &Cases[ i ];
+
+            if( pCase->dNs <= 0 )
+                continue;
+
+            fprintf( fp, "%s{\"name\": \"%s\", \"ns_per_op\": %.2f, \"ops_per_sec\": %.0f, \"bytes_per_op\": %.1f, \"bytes_per_sec\": %.0f}",
+                     iRun ++ ? ",\n" : "", pCase->cName, pCase->dNs, 1e9 / pCase->dNs, pCase->dBytes, pCase->dBytes * 1e9 / pCase->dNs );
+        }
+
+        fprintf( fp, "\n]}\n" );
+        fclose( fp );
+    }
+
+    free( pBaseline );
+    ISO8583Pool_Destroy( pPool );
+    return 0;
+}
@@ -0,0 +1,132 @@
+/***************************************************************************
+* FILE NAME:    FramerBench.C                                              *
+* MODULE NAME:  ISO8583Engine benchmarks                                   *
+* PROGRAMMER:                                                              *
+* DESCRIPTION:  A stream of 2 byte length + TPDU framed 0200 messages fed  *
+*               to ISO8583Framer in 1460 byte segments, framing alone and  *
+*               framing plus ISO8583Engine_HexbufToIso8583Len of every     *
+*               frame straight out of the framer buffer.                   *
+* REVISION:                                                                *
+****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ISO8583Engine.h"
+#include "ISO8583Framer.h"
+#include "SampleFmt.h"
+
+#define STREAM_MSGS     256
+#define SEGMENT_SIZE    1460
+
+static volatile int g_iSink;
+
+static double NowNs( void )
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+//Feed the whole stream once, returns the number of frames seen
+static int FeedStream( const ISO8583_Spec * pSpec, ISO8583_Rec * pRec, ISO8583_Framer * pFramer, const byte * pStream, int iStreamLen )
+{
+    ISO8583_Frame Frame;
+    int iPos, iRoom, iChunk, iRet, iFrames = 0;
+    byte * pWpt;
+
+    for( iPos = 0; iPos < iStreamLen; iPos += iChunk )
+    {
+        pWpt = ISO8583Framer_WritePtr( pFramer, &iRoom );
+        iChunk = iStreamLen - iPos < SEGMENT_SIZE ? iStreamLen - iPos : SEGMENT_SIZE;
+
+        if( iChunk > iRoom )
+            iChunk = iRoom;
+
+        //Stands in for the read() of one TCP segment
+        memcpy( pWpt, pStream + iPos, iChunk );
+        ISO8583Framer_Commit( pFramer, iChunk );
+
+        while(( iRet = ISO8583Framer_Next( pFramer, &Frame ) ) == 1 )
+        {
+            if( pRec != NULL )
+                g_iSink = ISO8583Engine_HexbufToIso8583Len( pSpec, pRec, Frame.pMsg, Frame.iMsgLength );
+
+            iFrames ++;
+        }
+
+        if( iRet < 0 )
+            return iRet;
+    }
+
+    return iFrames;
+}
+
+int main( int argc, char ** argv )
+{
+    static const int Dense0200[] = { 2, 3, 4, 7, 11, 12, 13, 14, 22, 23, 25, 26, 32, 35, 37, 41, 42, 49, 52, 53, 55, 60, 63, 0 };
+    static const byte Tpdu[ ISO8583_TPDU_LENGTH ] = { 0x60, 0x00, 0x01, 0x00, 0x00 };
+    static const ISO8583_FramerCfg Cfg = { ISO8583_LEN_BINARY, 2, 0, ISO8583_TPDU_LENGTH, ISO8583_MAXLENTH };
+    static ISO8583_Spec Spec;
+    static ISO8583_FixRec FixRec;
+    static byte cStream[ STREAM_MSGS * ( ISO8583_MAXLENTH + 8 ) ], cBuf[ 4 * ISO8583_MAXLENTH ];
+    ISO8583_Rec * pRec = ISO8583Engine_InitFixRec( &FixRec );
+    ISO8583_Framer Framer;
+    unsigned char cData[ 1000 ], cMsg[ 2048 ];
+    long l, lIters = argc > 1 ? atol( argv[ 1 ] ) : 20000;
+    int i, iFieldNo, iLength, iMsgLen, iStreamLen = 0;
+    double t0, tFrame, tDecode;
+    const int * piFields;
+
+    ISO8583Engine_InitFieldFormat( &Spec, ISO8583_BITMAP64, SampleFldFmt );
+    ISO8583Engine_SetField( &Spec, pRec, 0, ( unsigned char * )"0200", 4 );
+
+    for( piFields = Dense0200; *piFields; piFields ++ )
+    {
+        iFieldNo = *piFields;
+        iLength = SampleFldFmt[ iFieldNo - 1 ].iMaxLength;
+
+        if( SampleFldFmt[ iFieldNo - 1 ].bType & ISO8583TYPE_VAR )
+            iLength = iLength > 20 ? 20 : iLength - 1;
+        else if( SampleFldFmt[ iFieldNo - 1 ].bType & ISO8583TYPE_BIN )
+            iLength /= 8;
+
+        for( i = 0; i < iLength; i ++ )
+            cData[ i ] = ( unsigned char )(( SampleFldFmt[ iFieldNo - 1 ].bType & ISO8583TYPE_BCD ) ? '0' + ( i + iFieldNo ) % 10 : 'A' + ( i + iFieldNo ) % 26 );
+
+        ISO8583Engine_SetField( &Spec, pRec, iFieldNo, cData, iLength );
+    }
+
+    iMsgLen = ISO8583Engine_Iso8583ToHexbuf( &Spec, pRec, cMsg, sizeof( cMsg ) );
+
+    for( i = 0; i < STREAM_MSGS; i ++ )
+    {
+        iStreamLen += ISO8583Framer_EncodePrefix( &Cfg, cStream + iStreamLen, Tpdu, iMsgLen );
+        memcpy( cStream + iStreamLen, cMsg, iMsgLen );
+        iStreamLen += iMsgLen;
+    }
+
+    if( ISO8583Framer_Init( &Framer, &Cfg, cBuf, sizeof( cBuf ) ) != ISOENGINE_OK
+        || FeedStream( &Spec, pRec, &Framer, cStream, iStreamLen ) != STREAM_MSGS || g_iSink != 0 )
+    {
+        printf( "framer lost messages\n" );
+        return 1;
+    }
+
+    t0 = NowNs();
+    for( l = 0; l < lIters; l ++ )
+        g_iSink = FeedStream( &Spec, NULL, &Framer, cStream, iStreamLen );
+    tFrame = ( NowNs() - t0 ) / lIters / STREAM_MSGS;
+
+    t0 = NowNs();
+    for( l = 0; l < lIters; l ++ )
+        g_iSink = FeedStream( &Spec, pRec, &Framer, cStream, iStreamLen );
+    tDecode = ( NowNs() - t0 ) / lIters / STREAM_MSGS;
+
+    printf( "0200 %4d bytes in %d byte segments   frame %6.1f ns/msg  frame + decode %7.1f ns/msg\n",
+            iMsgLen, SEGMENT_SIZE, tFrame, tDecode );
+    return 0;
+}
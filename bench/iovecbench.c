@@ -0,0 +1,108 @@
+/***************************************************************************
+* FILE NAME:    IovecBench.C                                               *
+* MODULE NAME:  ISO8583Engine benchmarks                                   *
+* PROGRAMMER:                                                              *
+* DESCRIPTION:  Send of a 0200 message with 999 byte fields 46 and 47 to   *
+*               /dev/null: SetField of the large fields, Iso8583ToHexbuf   *
+*               and write, against Iso8583ToIovec with the large fields    *
+*               left in caller memory and writev. Also timed without the   *
+*               write, the encode alone.                                   *
+* REVISION:                                                                *
+****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "ISO8583Engine.h"
+#include "SampleFmt.h"
+
+#define BENCH_IOV       32
+
+static double NowNs( void )
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int main( int argc, char ** argv )
+{
+    static ISO8583_Spec Spec;
+    static ISO8583_Rec Rec;
+    static unsigned char cData[ 4096 ], cField46[ 999 ], cField47[ 999 ], cBuf[ 4096 ], cArena[ 256 ];
+    ISO8583_Rec * pRec = &Rec;
+    ISO8583_Edit Fields[ 2 ];
+    struct iovec Iov[ BENCH_IOV ];
+    long l, lIters = argc > 1 ? atol( argv[ 1 ] ) : 200000;
+    double t0, tCopy[ 2 ], tIovec[ 2 ];
+    size_t nLength = 0;
+    int i, iLength = 0, iIov = 0, bWrite, fd;
+
+    if(( fd = open( "/dev/null", O_WRONLY ) ) < 0 )
+        return 1;
+
+    for( i = 0; i < 999; i ++ )
+    {
+        cField46[ i ] = ( unsigned char )( 'A' + i % 26 );
+        cField47[ i ] = ( unsigned char )( '0' + i % 10 );
+    }
+
+    ISO8583Engine_InitFieldFormat( &Spec, ISO8583_BITMAP64, SampleFldFmt );
+    ISO8583Engine_InitRec( pRec, cData, sizeof( cData ) );
+    ISO8583Engine_SetField( &Spec, pRec, 0, ( unsigned char * )"0200", 4 );
+    ISO8583Engine_SetField( &Spec, pRec, 2, ( unsigned char * )"4111111111111111", 16 );
+    ISO8583Engine_SetField( &Spec, pRec, 3, ( unsigned char * )"000000", 6 );
+    ISO8583Engine_SetField( &Spec, pRec, 11, ( unsigned char * )"000123", 6 );
+    ISO8583Engine_SetField( &Spec, pRec, 41, ( unsigned char * )"TERM0001", 8 );
+
+    Fields[ 0 ].iFieldNo = 46;
+    Fields[ 0 ].iOp = ISO8583_EDIT_SET;
+    Fields[ 0 ].pData = cField46;
+    Fields[ 0 ].iLength = sizeof( cField46 );
+    Fields[ 1 ].iFieldNo = 47;
+    Fields[ 1 ].iOp = ISO8583_EDIT_SET;
+    Fields[ 1 ].pData = cField47;
+    Fields[ 1 ].iLength = sizeof( cField47 );
+
+    for( bWrite = 0; bWrite < 2; bWrite ++ )
+    {
+        t0 = NowNs();
+        for( l = 0; l < lIters; l ++ )
+        {
+            ISO8583Engine_SetField( &Spec, pRec, 46, cField46, sizeof( cField46 ) );
+            ISO8583Engine_SetField( &Spec, pRec, 47, cField47, sizeof( cField47 ) );
+            iLength = ISO8583Engine_Iso8583ToHexbuf( &Spec, pRec, cBuf, sizeof( cBuf ) );
+            if( bWrite && write( fd, cBuf, iLength ) != iLength )
+                return 1;
+        }
+        tCopy[ bWrite ] = ( NowNs() - t0 ) / lIters;
+
+        ISO8583Engine_ClearOneField( pRec, 46 );
+        ISO8583Engine_ClearOneField( pRec, 47 );
+
+        t0 = NowNs();
+        for( l = 0; l < lIters; l ++ )
+        {
+            iIov = ISO8583Engine_Iso8583ToIovec( &Spec, pRec, Fields, 2, cArena, sizeof( cArena ), Iov, BENCH_IOV, &nLength );
+            if( iIov <= 0 || ( bWrite && writev( fd, Iov, iIov ) != ( ssize_t )nLength ) )
+                return 1;
+        }
+        tIovec[ bWrite ] = ( NowNs() - t0 ) / lIters;
+    }
+
+    if( nLength != ( size_t )iLength )
+    {
+        printf( "lengths differ: %d %d\n", iLength, ( int )nLength );
+        return 1;
+    }
+
+    close( fd );
+    printf( "%d byte message   encode: copy %7.1f ns  iovec (%d entries) %7.1f ns   with write: %7.1f ns  %7.1f ns\n",
+            iLength, tCopy[ 0 ], iIov, tIovec[ 0 ], tCopy[ 1 ], tIovec[ 1 ] );
+    return 0;
+}
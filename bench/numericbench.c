@@ -0,0 +1,137 @@
+/***************************************************************************
+* FILE NAME:    NumericBench.C                                             *
+* MODULE NAME:  ISO8583Engine benchmarks                                   *
+* PROGRAMMER:                                                              *
+* DESCRIPTION:  Numeric fields 3, 4, 11, 12 and 13 of a record: GetField   *
+*               and atoll / sprintf and SetField, against the typed        *
+*               GetFieldU64 / SetFieldU64. Also LEN2BCD of a 2 byte        *
+*               length prefix.                                             *
+* REVISION:                                                                *
+****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ISO8583Engine.h"
+#include "SampleFmt.h"
+
+#define BENCH_VALUES    1024
+
+static const int NumericFields[] = { 3, 4, 11, 12, 13 };
+#define NUMERIC_COUNT   ( int )( sizeof( NumericFields ) / sizeof( NumericFields[ 0 ] ) )
+
+static volatile unsigned long long g_ullSink;
+
+static double NowNs( void )
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+//The fields through ASC, the way it is done without the typed accessors
+static unsigned long long AscRound( const ISO8583_Spec * pSpec, ISO8583_Rec * pRec, const unsigned long long * pullValues )
+{
+    unsigned long long ullSum = 0;
+    unsigned char cData[ 32 ];
+    int i, iLength, iDigits;
+
+    for( i = 0; i < NUMERIC_COUNT; i ++ )
+    {
+        iDigits = pSpec->FldFormat[ NumericFields[ i ] - 1 ].iMaxLength;
+        sprintf(( char * )cData, "%0*llu", iDigits, pullValues[ i ] );
+        ISO8583Engine_SetField( pSpec, pRec, NumericFields[ i ], cData, iDigits );
+    }
+
+    for( i = 0; i < NUMERIC_COUNT; i ++ )
+    {
+        iLength = ISO8583Engine_GetField( pSpec, pRec, NumericFields[ i ], cData, sizeof( cData ) - 1 );
+        cData[ iLength > 0 ? iLength : 0 ] = 0;
+        ullSum += ( unsigned long long )atoll(( char * )cData );
+    }
+
+    return ullSum;
+}
+
+static unsigned long long TypedRound( const ISO8583_Spec * pSpec, ISO8583_Rec * pRec, const unsigned long long * pullValues )
+{
+    unsigned long long ullSum = 0, ullValue;
+    int i;
+
+    for( i = 0; i < NUMERIC_COUNT; i ++ )
+        ISO8583Engine_SetFieldU64( pSpec, pRec, NumericFields[ i ], pullValues[ i ] );
+
+    for( i = 0; i < NUMERIC_COUNT; i ++ )
+    {
+        ISO8583Engine_GetFieldU64( pSpec, pRec, NumericFields[ i ], &ullValue );
+        ullSum += ullValue;
+    }
+
+    return ullSum;
+}
+
+int main( int argc, char ** argv )
+{
+    static ISO8583_Spec Spec;
+    static ISO8583_FixRec FixRec;
+    static unsigned long long ullValues[ BENCH_VALUES ][ NUMERIC_COUNT ];
+    ISO8583_Rec * pRec = ISO8583Engine_InitFixRec( &FixRec );
+    unsigned long long ullAsc = 0, ullTyped = 0;
+    byte cPrefix[ 2 ];
+    long l, lIters = argc > 1 ? atol( argv[ 1 ] ) : 200;
+    double t0, tAsc, tTyped, tLen;
+    int i, j;
+
+    ISO8583Engine_InitFieldFormat( &Spec, ISO8583_BITMAP64, SampleFldFmt );
+    srand( 1 );
+
+    for( i = 0; i < BENCH_VALUES; i ++ )
+    {
+        ullValues[ i ][ 0 ] = rand() % 1000000;
+        ullValues[ i ][ 1 ] = ( unsigned long long )rand() * rand() % 1000000000000ULL;
+        ullValues[ i ][ 2 ] = rand() % 1000000;
+        ullValues[ i ][ 3 ] = rand() % 240000;
+        ullValues[ i ][ 4 ] = rand() % 1232;
+    }
+
+    for( i = 0; i < BENCH_VALUES; i ++ )
+    {
+        ullAsc += AscRound( &Spec, pRec, ullValues[ i ] );
+        ullTyped += TypedRound( &Spec, pRec, ullValues[ i ] );
+    }
+
+    if( ullAsc != ullTyped )
+    {
+        printf( "typed sum %llu differs from %llu\n", ullTyped, ullAsc );
+        return 1;
+    }
+
+    t0 = NowNs();
+    for( l = 0; l < lIters; l ++ )
+        for( i = 0; i < BENCH_VALUES; i ++ )
+            g_ullSink += AscRound( &Spec, pRec, ullValues[ i ] );
+    tAsc = ( NowNs() - t0 ) / lIters / BENCH_VALUES / NUMERIC_COUNT;
+
+    t0 = NowNs();
+    for( l = 0; l < lIters; l ++ )
+        for( i = 0; i < BENCH_VALUES; i ++ )
+            g_ullSink += TypedRound( &Spec, pRec, ullValues[ i ] );
+    tTyped = ( NowNs() - t0 ) / lIters / BENCH_VALUES / NUMERIC_COUNT;
+
+    t0 = NowNs();
+    for( l = 0; l < lIters; l ++ )
+    {
+        for( j = 0; j < BENCH_VALUES; j ++ )
+        {
+            ISO8583Utils_LEN2BCD( j % 1000, cPrefix, 2 );
+            g_ullSink += cPrefix[ 1 ];
+        }
+    }
+    tLen = ( NowNs() - t0 ) / lIters / BENCH_VALUES;
+
+    printf( "set + get per field   ASC %6.1f ns  typed %6.1f ns    LEN2BCD %5.1f ns\n", tAsc, tTyped, tLen );
+    return 0;
+}
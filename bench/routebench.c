@@ -0,0 +1,198 @@
+/***************************************************************************
+* FILE NAME:    RouteBench.C                                               *
+* MODULE NAME:  ISO8583Engine benchmarks                                   *
+* PROGRAMMER:                                                              *
+* DESCRIPTION:  BIN routing of decoded 0200 messages over a million        *
+*               ranges: GetField of fields 2 and 3, conversion of the      *
+*               ASCII and a binary search of the sorted ranges, against    *
+*               ISO8583Route_LookupRec on the packed fields. The build     *
+*               and publish of a new table are timed as well.              *
+* REVISION:                                                                *
+****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ISO8583Engine.h"
+#include "ISO8583Route.h"
+#include "SampleFmt.h"
+
+#define BENCH_MSGS      1024
+
+//A range as a flat table would keep it
+typedef struct
+{
+    unsigned long long ullLow;
+    unsigned long long ullHigh;
+    int iRoute;
+} BenchRange;
+
+static volatile int g_iSink;
+
+static double NowNs( void )
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static unsigned int NextRand( unsigned int * pSeed )
+{
+    *pSeed ^= *pSeed << 13;
+    *pSeed ^= *pSeed >> 17;
+    *pSeed ^= *pSeed << 5;
+    return *pSeed;
+}
+
+//Route of the flat table: field 2 and 3 copied out as ASCII, then searched
+static int FlatLookup( const ISO8583_Spec * pSpec, ISO8583_Rec * pRec, const BenchRange * pRanges, int iRanges )
+{
+    unsigned char cPan[ 20 ], cProc[ 8 ];
+    unsigned long long ullBin = 0;
+    int i, iLow = 0, iHigh = iRanges - 1, iLength;
+
+    iLength = ISO8583Engine_GetField( pSpec, pRec, 2, cPan, sizeof( cPan ) );
+    ISO8583Engine_GetField( pSpec, pRec, 3, cProc, sizeof( cProc ) );
+
+    for( i = 0; i < ISO8583_ROUTE_DIGITS; i ++ )
+        ullBin = ullBin * 10 + ( i < iLength ? cPan[ i ] - '0' : 0 );
+
+    if( memcmp( pRec->cMsgID, "0200", 4 ) != 0 || cProc[ 0 ] != '0' || cProc[ 1 ] != '0' )
+        return ISO8583_ROUTE_NONE;
+
+    while( iLow <= iHigh )
+    {
+        int iMid = ( iLow + iHigh ) >> 1;
+
+        if( ullBin < pRanges[ iMid ].ullLow )
+            iHigh = iMid - 1;
+        else if( ullBin > pRanges[ iMid ].ullHigh )
+            iLow = iMid + 1;
+        else
+            return pRanges[ iMid ].iRoute;
+    }
+
+    return ISO8583_ROUTE_NONE;
+}
+
+int main( int argc, char ** argv )
+{
+    static ISO8583_Spec Spec;
+    static ISO8583_FixRec FixRec;
+    static byte cBuf[ BENCH_MSGS * 128 ];
+    static size_t nOffset[ BENCH_MSGS + 1 ];
+    ISO8583_Rec * pRec = ISO8583Engine_InitFixRec( &FixRec );
+    ISO8583_RouteRule * pRules;
+    ISO8583_RouteTable * pTable;
+    ISO8583_Router * pRouter;
+    BenchRange * pRanges;
+    unsigned long long ullNext = 40000000000ULL;
+    unsigned char cPan[ 20 ];
+    unsigned int uiSeed = 2463534242U;
+    int iRanges = argc > 1 ? atoi( argv[ 1 ] ) : 1000000;
+    long l, lIters = argc > 2 ? atol( argv[ 2 ] ) : 1000;
+    double t0, tBuild, tPublish, tFlat, tIndex;
+    int i, iReader, iBad = 0, iSum = 0;
+
+    pRules = ( ISO8583_RouteRule * )calloc( iRanges, sizeof( ISO8583_RouteRule ) );
+    pRanges = ( BenchRange * )calloc( iRanges, sizeof( BenchRange ) );
+
+    if( pRules == NULL || pRanges == NULL )
+        return 1;
+
+    //disjoint 9 digit ranges from 400000000 up with gaps, all 0200 purchases,
+    //as a flat table needs them
+    for( i = 0; i < iRanges; i ++ )
+    {
+        ullNext += ( 1 + NextRand( &uiSeed ) % 8 ) * 100ULL;
+        pRanges[ i ].ullLow = ullNext;
+        ullNext += ( 1 + NextRand( &uiSeed ) % 4 ) * 100ULL;
+        pRanges[ i ].ullHigh = ullNext - 1;
+        pRanges[ i ].iRoute = NextRand( &uiSeed ) % 64;
+
+        sprintf( pRules[ i ].cLow, "%09llu", pRanges[ i ].ullLow / 100 );
+        sprintf( pRules[ i ].cHigh, "%09llu", pRanges[ i ].ullHigh / 100 );
+        strcpy( pRules[ i ].cMti, "0200" );
+        strcpy( pRules[ i ].cProc, "00" );
+        pRules[ i ].iRoute = pRanges[ i ].iRoute;
+    }
+
+    t0 = NowNs();
+    if( ISO8583Route_Build( pRules, iRanges, &pTable, NULL ) != ISOENGINE_OK )
+        return 1;
+    tBuild = NowNs() - t0;
+
+    pRouter = ISO8583Route_Create( pTable );
+    iReader = ISO8583Route_Register( pRouter );
+
+    ISO8583Engine_InitFieldFormat( &Spec, ISO8583_BITMAP64, SampleFldFmt );
+
+    for( i = 0; i < BENCH_MSGS; i ++ )
+    {
+        sprintf(( char * )cPan, "%011llu%05u", 40000000000ULL + NextRand( &uiSeed ) % ( ullNext - 40000000000ULL ), NextRand( &uiSeed ) % 100000 );
+        ISO8583Engine_ClearAllFields( pRec );
+        ISO8583Engine_SetField( &Spec, pRec, 0, ( unsigned char * )"0200", 4 );
+        ISO8583Engine_SetField( &Spec, pRec, 2, cPan, 16 );
+        ISO8583Engine_SetField( &Spec, pRec, 3, ( unsigned char * )"000000", 6 );
+        ISO8583Engine_SetField( &Spec, pRec, 4, ( unsigned char * )"000000001000", 12 );
+        ISO8583Engine_SetField( &Spec, pRec, 11, ( unsigned char * )"000001", 6 );
+        ISO8583Engine_SetField( &Spec, pRec, 41, ( unsigned char * )"TERM0001", 8 );
+        nOffset[ i + 1 ] = nOffset[ i ] + ISO8583Engine_Iso8583ToHexbuf( &Spec, pRec, cBuf + nOffset[ i ], 128 );
+    }
+
+    //both ways must agree before they are timed
+    for( i = 0; i < BENCH_MSGS; i ++ )
+    {
+        ISO8583Engine_HexbufToIso8583Len( &Spec, pRec, cBuf + nOffset[ i ], nOffset[ i + 1 ] - nOffset[ i ] );
+        iBad += FlatLookup( &Spec, pRec, pRanges, iRanges ) != ISO8583Route_LookupRec( pRouter, iReader, &Spec, pRec );
+    }
+
+    if( iBad != 0 )
+    {
+        printf( "%d messages routed differently\n", iBad );
+        return 1;
+    }
+
+    //both loops decode every message again, the difference is the routing
+    t0 = NowNs();
+    for( l = 0; l < lIters; l ++ )
+    {
+        for( i = 0; i < BENCH_MSGS; i ++ )
+        {
+            ISO8583Engine_HexbufToIso8583Len( &Spec, pRec, cBuf + nOffset[ i ], nOffset[ i + 1 ] - nOffset[ i ] );
+            iSum += FlatLookup( &Spec, pRec, pRanges, iRanges );
+        }
+    }
+    tFlat = ( NowNs() - t0 ) / lIters / BENCH_MSGS;
+
+    t0 = NowNs();
+    for( l = 0; l < lIters; l ++ )
+    {
+        for( i = 0; i < BENCH_MSGS; i ++ )
+        {
+            ISO8583Engine_HexbufToIso8583Len( &Spec, pRec, cBuf + nOffset[ i ], nOffset[ i + 1 ] - nOffset[ i ] );
+            iSum += ISO8583Route_LookupRec( pRouter, iReader, &Spec, pRec );
+        }
+    }
+    tIndex = ( NowNs() - t0 ) / lIters / BENCH_MSGS;
+
+    if( ISO8583Route_Build( pRules, iRanges, &pTable, NULL ) != ISOENGINE_OK )
+        return 1;
+
+    t0 = NowNs();
+    ISO8583Route_Publish( pRouter, pTable );
+    tPublish = NowNs() - t0;
+
+    g_iSink = iSum;
+    printf( "%d ranges: build %.0f ms  publish %.1f us\n", iRanges, tBuild / 1e6, tPublish / 1e3 );
+    printf( "decode + GetField + search %6.1f ns/msg   decode + LookupRec %6.1f ns/msg\n", tFlat, tIndex );
+
+    ISO8583Route_Unregister( pRouter, iReader );
+    ISO8583Route_Destroy( pRouter );
+    free( pRules );
+    free( pRanges );
+    return 0;
+}
@@ -0,0 +1,36 @@
+# Run enginebench and keep its results as bench-results/<commit>.json, run by
+# the "bench" target:
+#   cmake -DBENCH=<enginebench> -DSOURCE_DIR=<repo> -DOUTPUT_DIR=<dir>
+#         [-DBASELINE=<earlier json>] -P runbench.cmake
+# Without BASELINE the previous run, bench-results/last.json, is compared.
+
+set( _revision "unknown" )
+
+find_package( Git QUIET )
+if( GIT_FOUND )
+    execute_process( COMMAND ${GIT_EXECUTABLE} describe --always --dirty
+                     WORKING_DIRECTORY ${SOURCE_DIR}
+                     OUTPUT_VARIABLE _revision OUTPUT_STRIP_TRAILING_WHITESPACE
+                     ERROR_QUIET )
+    if( NOT _revision )
+        set( _revision "unknown" )
+    endif()
+endif()
+
+file( MAKE_DIRECTORY ${OUTPUT_DIR} )
+set( _args -l ${_revision} -j ${OUTPUT_DIR}/${_revision}.json )
+
+if( BASELINE )
+    list( APPEND _args -b ${BASELINE} )
+elseif( EXISTS ${OUTPUT_DIR}/last.json )
+    list( APPEND _args -b ${OUTPUT_DIR}/last.json )
+endif()
+
+execute_process( COMMAND ${BENCH} ${_args} RESULT_VARIABLE _result )
+
+if( NOT _result EQUAL 0 )
+    message( FATAL_ERROR "enginebench failed: ${_result}" )
+endif()
+
+configure_file( ${OUTPUT_DIR}/${_revision}.json ${OUTPUT_DIR}/last.json COPYONLY )
+message( STATUS "Results: ${OUTPUT_DIR}/${_revision}.json" )
@@ -0,0 +1,119 @@
+/***************************************************************************
+* FILE NAME:    SpecBench.C                                                *
+* MODULE NAME:  ISO8583Engine benchmarks                                   *
+* PROGRAMMER:                                                              *
+* DESCRIPTION:  Start up of 32 dialects: ISO8583SpecFile_Load of every     *
+*               definition file, against ISO8583SpecFile_LoadAll from a    *
+*               current spec cache. The definition files are written to a *
+*               temporary directory from SampleFldFmt, each dialect with   *
+*               one field made ASCII.                                      *
+* REVISION:                                                                *
+****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ISO8583Engine.h"
+#include "ISO8583SpecFile.h"
+#include "SampleFmt.h"
+
+#define BENCH_DIALECTS  32
+
+static double NowNs( void )
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+//Definition file of SampleFldFmt with field iAscii as ascii digits
+static int WriteDialect( const char * pPath, int iAscii )
+{
+    FILE * fp = fopen( pPath, "w" );
+    const ISO8583_FieldFormat * pFmt;
+    int i, iMax;
+
+    if( fp == NULL )
+        return -1;
+
+    fputs( "# SampleFldFmt\nbitmap 64\n", fp );
+    for( i = 1; i < 64; i ++ )
+    {
+        pFmt = &SampleFldFmt[ i ];
+        iMax = pFmt->iMaxLength;
+
+        if( pFmt->bType & ISO8583TYPE_BIN )
+            fprintf( fp, "%d b fixed %d\n", i + 1, iMax );
+        else if( pFmt->bType & ISO8583TYPE_BCD )
+            fprintf( fp, "%d n %s %d%s%s\n", i + 1, !( pFmt->bType & ISO8583TYPE_VAR ) ? "fixed" : iMax > 99 ? "LLL" : "LL", iMax,
+                     pFmt->bType & ISO8583TYPE_DIGIT ? " pad=zero" : "", i + 1 == iAscii ? " ascii" : "" );
+        else
+            fprintf( fp, "%d ans %s %d\n", i + 1, !( pFmt->bType & ISO8583TYPE_VAR ) ? "fixed" : iMax > 99 ? "LLL" : "LL", iMax );
+    }
+
+    return fclose( fp ) == 0 ? 0 : -1;
+}
+
+int main( int argc, char ** argv )
+{
+    static ISO8583_Spec Spec;
+    static char cPaths[ BENCH_DIALECTS ][ 64 ];
+    const char * pPaths[ BENCH_DIALECTS ];
+    const ISO8583_Spec * pSpecs[ BENCH_DIALECTS ];
+    ISO8583_SpecCache Cache;
+    char cDir[] = "/tmp/specbenchXXXXXX", cCache[ 64 ];
+    long l, lIters = argc > 1 ? atol( argv[ 1 ] ) : 200;
+    double t0, tParse, tCache;
+    int i, iFailed, iLine, iRet = 1;
+
+    if( mkdtemp( cDir ) == NULL )
+        return 1;
+
+    for( i = 0; i < BENCH_DIALECTS; i ++ )
+    {
+        sprintf( cPaths[ i ], "%s/dialect%02d.spec", cDir, i );
+        pPaths[ i ] = cPaths[ i ];
+        if( WriteDialect( cPaths[ i ], 3 + i ) != 0 )
+            goto done;
+    }
+    sprintf( cCache, "%s/specs.cache", cDir );
+
+    //first start writes the cache
+    if( ISO8583SpecFile_LoadAll( &Cache, cCache, pPaths, BENCH_DIALECTS, pSpecs, &iFailed, &iLine ) != ISOENGINE_OK )
+    {
+        printf( "dialect %d line %d\n", iFailed, iLine );
+        goto done;
+    }
+    ISO8583SpecFile_CloseCache( &Cache );
+
+    t0 = NowNs();
+    for( l = 0; l < lIters; l ++ )
+    {
+        for( i = 0; i < BENCH_DIALECTS; i ++ )
+            ISO8583SpecFile_Load( pPaths[ i ], &Spec, &iLine );
+    }
+    tParse = ( NowNs() - t0 ) / lIters;
+
+    t0 = NowNs();
+    for( l = 0; l < lIters; l ++ )
+    {
+        if( ISO8583SpecFile_LoadAll( &Cache, cCache, pPaths, BENCH_DIALECTS, pSpecs, &iFailed, &iLine ) != ISOENGINE_OK )
+            goto done;
+        ISO8583SpecFile_CloseCache( &Cache );
+    }
+    tCache = ( NowNs() - t0 ) / lIters;
+
+    printf( "%d dialects   parse %8.1f us  spec cache %8.1f us\n", BENCH_DIALECTS, tParse / 1000, tCache / 1000 );
+    iRet = 0;
+
+done:
+    for( i = 0; i < BENCH_DIALECTS; i ++ )
+        unlink( cPaths[ i ] );
+    unlink( cCache );
+    rmdir( cDir );
+    return iRet;
+}
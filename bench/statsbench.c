@@ -0,0 +1,89 @@
+/***************************************************************************
+* FILE NAME:    StatsBench.C                                               *
+* MODULE NAME:  ISO8583Engine benchmarks                                   *
+* PROGRAMMER:                                                              *
+* DESCRIPTION:  SetField, pack, unpack and GetField of a 0200 message, the *
+*               cost of the instrumentation: built once against a library  *
+*               without ISO8583_STATS and once with, compare the times.    *
+*               With the counters built in their export is printed.        *
+* REVISION:                                                                *
+****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ISO8583Engine.h"
+#include "ISO8583Stats.h"
+#include "SampleFmt.h"
+
+static volatile int g_iSink;
+
+static double NowNs( void )
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int main( int argc, char ** argv )
+{
+    static ISO8583_Spec Spec;
+    static ISO8583_FixRec FixRec, FixOut;
+    static ISO8583_Stats Stats;
+    static char cJson[ 65536 ];
+    ISO8583_Rec * pRec = ISO8583Engine_InitFixRec( &FixRec );
+    ISO8583_Rec * pOut = ISO8583Engine_InitFixRec( &FixOut );
+    byte cBuf[ 512 ];
+    unsigned char cData[ 128 ];
+    long l, lIters = argc > 1 ? atol( argv[ 1 ] ) : 1000000;
+    double t0, tSet, tPack, tUnpack, tGet;
+    int iLength = 0, iSink = 0;
+
+    ISO8583Engine_InitFieldFormat( &Spec, ISO8583_BITMAP64, SampleFldFmt );
+    ISO8583Engine_SetField( &Spec, pRec, 0, ( unsigned char * )"0200", 4 );
+    ISO8583Engine_SetField( &Spec, pRec, 2, ( unsigned char * )"4111111111111111", 16 );
+    ISO8583Engine_SetField( &Spec, pRec, 3, ( unsigned char * )"000000", 6 );
+    ISO8583Engine_SetField( &Spec, pRec, 4, ( unsigned char * )"000000001000", 12 );
+    ISO8583Engine_SetField( &Spec, pRec, 22, ( unsigned char * )"051", 3 );
+    ISO8583Engine_SetField( &Spec, pRec, 35, ( unsigned char * )"4111111111111111=2512101123456", 30 );
+    ISO8583Engine_SetField( &Spec, pRec, 41, ( unsigned char * )"TERM0001", 8 );
+    ISO8583Engine_SetField( &Spec, pRec, 42, ( unsigned char * )"898440358120001", 15 );
+    ISO8583Engine_SetField( &Spec, pRec, 49, ( unsigned char * )"156", 3 );
+    ISO8583Stats_Reset();
+
+    t0 = NowNs();
+    for( l = 0; l < lIters; l ++ )
+        iSink += ISO8583Engine_SetField( &Spec, pRec, 11, ( unsigned char * )"000123", 6 );
+    tSet = ( NowNs() - t0 ) / lIters;
+
+    t0 = NowNs();
+    for( l = 0; l < lIters; l ++ )
+        iLength = ISO8583Engine_Iso8583ToHexbuf( &Spec, pRec, cBuf, sizeof( cBuf ) );
+    tPack = ( NowNs() - t0 ) / lIters;
+
+    t0 = NowNs();
+    for( l = 0; l < lIters; l ++ )
+        iSink += ISO8583Engine_HexbufToIso8583Len( &Spec, pOut, cBuf, iLength );
+    tUnpack = ( NowNs() - t0 ) / lIters;
+
+    t0 = NowNs();
+    for( l = 0; l < lIters; l ++ )
+        iSink += ISO8583Engine_GetField( &Spec, pOut, 2, cData, sizeof( cData ) );
+    tGet = ( NowNs() - t0 ) / lIters;
+
+    g_iSink = iSink;
+    printf( "stats %s   SetField %6.1f ns  pack %6.1f ns  unpack %6.1f ns  GetField %6.1f ns\n",
+            ISO8583Stats_Enabled() ? "on " : "off", tSet, tPack, tUnpack, tGet );
+
+    if( ISO8583Stats_Enabled() )
+    {
+        ISO8583Stats_Snapshot( &Stats );
+        if( ISO8583Stats_Export( &Stats, cJson, sizeof( cJson ) ) > 0 )
+            printf( "%s\n", cJson );
+    }
+
+    return 0;
+}
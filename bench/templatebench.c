@@ -0,0 +1,116 @@
+/***************************************************************************
+* FILE NAME:    TemplateBench.C                                            *
+* MODULE NAME:  ISO8583Engine benchmarks                                   *
+* PROGRAMMER:                                                              *
+* DESCRIPTION:  Terminal 0200 with static fields 25, 41, 42, 49, 60 and    *
+*               dynamic fields 2, 4, 11, 12, 13, 64: SetField of every     *
+*               field and Iso8583ToHexbuf per message, against one         *
+*               ISO8583_Template and TemplateToHexbuf of the dynamic ones. *
+* REVISION:                                                                *
+****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ISO8583Engine.h"
+#include "SampleFmt.h"
+
+#define EDIT_COUNT( a ) (( int )( sizeof( a ) / sizeof( a[ 0 ] ) ))
+
+static volatile int g_iSink;
+
+static double NowNs( void )
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+//Every field of the message through the record API
+static int PackRecord( const ISO8583_Spec * pSpec, ISO8583_Rec * pRec, const ISO8583_Edit * pStatic, int iStatic,
+                       const ISO8583_Edit * pDynamic, int iDynamic, byte * pRetBuf, int iSize )
+{
+    int i;
+
+    ISO8583Engine_ClearAllFields( pRec );
+
+    for( i = 0; i < iStatic; i ++ )
+        ISO8583Engine_SetField( pSpec, pRec, pStatic[ i ].iFieldNo, ( unsigned char * )pStatic[ i ].pData, pStatic[ i ].iLength );
+
+    for( i = 0; i < iDynamic; i ++ )
+        ISO8583Engine_SetField( pSpec, pRec, pDynamic[ i ].iFieldNo, ( unsigned char * )pDynamic[ i ].pData, pDynamic[ i ].iLength );
+
+    return ISO8583Engine_Iso8583ToHexbuf( pSpec, pRec, pRetBuf, iSize );
+}
+
+int main( int argc, char ** argv )
+{
+    static const ISO8583_Edit Static[] =
+    {
+        { 0, ISO8583_EDIT_SET, ( const unsigned char * )"0200", 4 },
+        { 25, ISO8583_EDIT_SET, ( const unsigned char * )"00", 2 },
+        { 41, ISO8583_EDIT_SET, ( const unsigned char * )"TERM0001", 8 },
+        { 42, ISO8583_EDIT_SET, ( const unsigned char * )"998877665508642", 15 },
+        { 49, ISO8583_EDIT_SET, ( const unsigned char * )"156", 3 },
+        { 60, ISO8583_EDIT_SET, ( const unsigned char * )"22000123000", 11 },
+    };
+    static ISO8583_Edit Dynamic[] =
+    {
+        { 2, ISO8583_EDIT_SET, ( const unsigned char * )"6222021234567890123", 19 },
+        { 4, ISO8583_EDIT_SET, ( const unsigned char * )"000000012345", 12 },
+        { 11, ISO8583_EDIT_SET, NULL, 6 },
+        { 12, ISO8583_EDIT_SET, ( const unsigned char * )"235959", 6 },
+        { 13, ISO8583_EDIT_SET, ( const unsigned char * )"1017", 4 },
+        { 64, ISO8583_EDIT_SET, ( const unsigned char * )"\x12\x34\x56\x78\x9A\xBC\xDE\xF0", 8 },
+    };
+    static ISO8583_Spec Spec;
+    static ISO8583_Template Template;
+    static ISO8583_FixRec FixRec;
+    ISO8583_Rec * pRec = ISO8583Engine_InitFixRec( &FixRec );
+    unsigned char cTrace[ 7 ], cRec[ 2048 ], cOut[ 2048 ];
+    long l, lIters = argc > 1 ? atol( argv[ 1 ] ) : 1000000;
+    double t0, tRecord, tTemplate;
+    int iLen;
+
+    ISO8583Engine_InitFieldFormat( &Spec, ISO8583_BITMAP64, SampleFldFmt );
+
+    if( ISO8583Engine_InitTemplate( &Spec, &Template, Static, EDIT_COUNT( Static ) ) != ISOENGINE_OK )
+    {
+        printf( "template init failed\n" );
+        return 1;
+    }
+
+    memcpy( cTrace, "000001", 7 );
+    Dynamic[ 2 ].pData = cTrace;
+
+    iLen = PackRecord( &Spec, pRec, Static, EDIT_COUNT( Static ), Dynamic, EDIT_COUNT( Dynamic ), cRec, sizeof( cRec ) );
+
+    if( iLen <= 0 || ISO8583Engine_TemplateToHexbuf( &Spec, &Template, Dynamic, EDIT_COUNT( Dynamic ), cOut, sizeof( cOut ) ) != iLen
+        || memcmp( cRec, cOut, iLen ) != 0 )
+    {
+        printf( "template output differs from the record API\n" );
+        return 1;
+    }
+
+    t0 = NowNs();
+    for( l = 0; l < lIters; l ++ )
+    {
+        cTrace[ 5 ] = ( unsigned char )( '0' + l % 10 );
+        g_iSink = PackRecord( &Spec, pRec, Static, EDIT_COUNT( Static ), Dynamic, EDIT_COUNT( Dynamic ), cRec, sizeof( cRec ) );
+    }
+    tRecord = ( NowNs() - t0 ) / lIters;
+
+    t0 = NowNs();
+    for( l = 0; l < lIters; l ++ )
+    {
+        cTrace[ 5 ] = ( unsigned char )( '0' + l % 10 );
+        g_iSink = ISO8583Engine_TemplateToHexbuf( &Spec, &Template, Dynamic, EDIT_COUNT( Dynamic ), cOut, sizeof( cOut ) );
+    }
+    tTemplate = ( NowNs() - t0 ) / lIters;
+
+    printf( "0200 %4d bytes   SetField + pack %7.1f ns  template %7.1f ns\n", iLen, tRecord, tTemplate );
+    return 0;
+}
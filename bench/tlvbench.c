@@ -0,0 +1,184 @@
+/***************************************************************************
+* FILE NAME:    TlvBench.C                                                 *
+* MODULE NAME:  ISO8583Engine benchmarks                                   *
+* PROGRAMMER:                                                              *
+* DESCRIPTION:  Tags 9F26, 9F27, 95 and 9A out of field 55 of a block of   *
+*               0200 messages with 20 EMV tags each: GetField and a scan   *
+*               of the copy per tag, the way it is done without the TLV    *
+*               layer, against ISO8583Tlv_ParseRec and ISO8583Tlv_Value.   *
+*               Both are shown next to HexbufToIso8583 of the message.     *
+* REVISION:                                                                *
+****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ISO8583Engine.h"
+#include "ISO8583Tlv.h"
+#include "SampleFmt.h"
+
+#define BENCH_MSGS      1024
+
+static const unsigned int LookupTags[] = { ISO8583_TAG_AC, ISO8583_TAG_CID, ISO8583_TAG_TVR, ISO8583_TAG_TXNDATE };
+#define LOOKUP_COUNT    ( int )( sizeof( LookupTags ) / sizeof( LookupTags[ 0 ] ) )
+
+static volatile unsigned long g_ulSink;
+
+static double NowNs( void )
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+//Field 55 of an ARQC, built in place in the record
+static int BuildIcc( const ISO8583_Spec * pSpec, ISO8583_Rec * pRec, int iSeq )
+{
+    static const byte cIad[ 32 ] = { 0x06, 0x01, 0x0A, 0x03, 0xA0, 0x00, 0x00 };
+    ISO8583_TlvBuilder Builder;
+    byte * pValue;
+
+    ISO8583Tlv_BuildField( &Builder, pSpec, pRec, 55, 255 );
+    ISO8583Tlv_Put( &Builder, 0x5F2A, ( const byte * )"\x01\x56", 2 );
+    ISO8583Tlv_Put( &Builder, 0x82, ( const byte * )"\x7C\x00", 2 );
+    ISO8583Tlv_Put( &Builder, 0x84, ( const byte * )"\xA0\x00\x00\x03\x33\x01\x01\x01", 8 );
+    ISO8583Tlv_Put( &Builder, 0x9F1A, ( const byte * )"\x01\x56", 2 );
+    ISO8583Tlv_Put( &Builder, 0x9F33, ( const byte * )"\xE0\xF1\xC8", 3 );
+    ISO8583Tlv_Put( &Builder, 0x9F34, ( const byte * )"\x42\x03\x00", 3 );
+    ISO8583Tlv_Put( &Builder, 0x9F35, ( const byte * )"\x22", 1 );
+    ISO8583Tlv_Put( &Builder, 0x9F1E, ( const byte * )"12345678", 8 );
+    ISO8583Tlv_Put( &Builder, 0x9F10, cIad, sizeof( cIad ) );
+    ISO8583Tlv_Put( &Builder, 0x9F09, ( const byte * )"\x00\x30", 2 );
+    ISO8583Tlv_PutBcd( &Builder, 0x9F41, iSeq, 4 );
+    ISO8583Tlv_PutBcd( &Builder, 0x9F02, iSeq * 37, 6 );
+    ISO8583Tlv_PutBcd( &Builder, 0x9F03, 0, 6 );
+    ISO8583Tlv_Put( &Builder, 0x9F36, ( const byte * )"\x00\x2A", 2 );
+    ISO8583Tlv_Put( &Builder, 0x9C, ( const byte * )"\x00", 1 );
+    pValue = ISO8583Tlv_Place( &Builder, 0x9F37, 4 );
+    if( pValue != NULL )
+        memcpy( pValue, &iSeq, 4 );
+    ISO8583Tlv_PutBcd( &Builder, 0x9A, 251017, 3 );
+    ISO8583Tlv_Put( &Builder, 0x95, ( const byte * )"\x00\x00\x04\x80\x00", 5 );
+    ISO8583Tlv_Put( &Builder, 0x9F27, ( const byte * )"\x80", 1 );
+    ISO8583Tlv_Put( &Builder, 0x9F26, ( const byte * )"\x1A\x2B\x3C\x4D\x5E\x6F\x70\x81", 8 );
+
+    return ISO8583Tlv_CommitField( &Builder, pSpec, pRec, 55 );
+}
+
+//Value of uiTag in a copy of field 55, scanning from the start every time
+static int ScanTag( const byte * pData, int iLength, unsigned int uiTag, const byte ** ppValue )
+{
+    unsigned int uiCur;
+    int i = 0, iLen;
+
+    while( i < iLength )
+    {
+        uiCur = pData[ i ++ ];
+        if(( uiCur & 0x1F ) == 0x1F )
+        {
+            do
+                uiCur = ( uiCur << 8 ) | pData[ i ];
+            while( pData[ i ++ ] & 0x80 );
+        }
+
+        iLen = pData[ i ++ ];
+        if( iLen == 0x81 )
+            iLen = pData[ i ++ ];
+
+        if( uiCur == uiTag )
+        {
+            *ppValue = pData + i;
+            return iLen;
+        }
+        i += iLen;
+    }
+
+    return -1;
+}
+
+int main( int argc, char ** argv )
+{
+    static ISO8583_Spec Spec;
+    static ISO8583_FixRec FixRec;
+    static byte cBuf[ BENCH_MSGS * 512 ];
+    static size_t nOffset[ BENCH_MSGS + 1 ];
+    ISO8583_Rec * pRec = ISO8583Engine_InitFixRec( &FixRec );
+    ISO8583_TlvIndex Index;
+    const byte * pValue;
+    byte cIcc[ 1000 ];
+    char cData[ 32 ];
+    long l, lIters = argc > 1 ? atol( argv[ 1 ] ) : 200;
+    unsigned long ulScan = 0, ulTlv = 0;
+    double t0, tDecode, tScan, tTlv;
+    int i, j, iLength;
+
+    ISO8583Engine_InitFieldFormat( &Spec, ISO8583_BITMAP64, SampleFldFmt );
+
+    for( i = 0; i < BENCH_MSGS; i ++ )
+    {
+        ISO8583Engine_ClearAllFields( pRec );
+        ISO8583Engine_SetField( &Spec, pRec, 0, ( unsigned char * )"0200", 4 );
+        ISO8583Engine_SetField( &Spec, pRec, 2, ( unsigned char * )"6225880012345678", 16 );
+        ISO8583Engine_SetField( &Spec, pRec, 3, ( unsigned char * )"000000", 6 );
+        sprintf( cData, "%012d", i * 37 );
+        ISO8583Engine_SetField( &Spec, pRec, 4, ( unsigned char * )cData, 12 );
+        sprintf( cData, "%06d", i );
+        ISO8583Engine_SetField( &Spec, pRec, 11, ( unsigned char * )cData, 6 );
+        ISO8583Engine_SetField( &Spec, pRec, 22, ( unsigned char * )"051", 3 );
+        ISO8583Engine_SetField( &Spec, pRec, 41, ( unsigned char * )"TERM0001", 8 );
+        ISO8583Engine_SetField( &Spec, pRec, 42, ( unsigned char * )"898440358120001", 15 );
+        ISO8583Engine_SetField( &Spec, pRec, 49, ( unsigned char * )"156", 3 );
+        if( BuildIcc( &Spec, pRec, i ) <= 0 )
+        {
+            printf( "field 55 not built\n" );
+            return 1;
+        }
+        nOffset[ i + 1 ] = nOffset[ i ] + ISO8583Engine_Iso8583ToHexbuf( &Spec, pRec, cBuf + nOffset[ i ], 512 );
+    }
+
+    t0 = NowNs();
+    for( l = 0; l < lIters; l ++ )
+        for( i = 0; i < BENCH_MSGS; i ++ )
+            ISO8583Engine_HexbufToIso8583( &Spec, pRec, cBuf + nOffset[ i ] );
+    tDecode = ( NowNs() - t0 ) / lIters / BENCH_MSGS;
+
+    t0 = NowNs();
+    for( l = 0; l < lIters; l ++ )
+    {
+        for( i = 0; i < BENCH_MSGS; i ++ )
+        {
+            ISO8583Engine_HexbufToIso8583( &Spec, pRec, cBuf + nOffset[ i ] );
+            iLength = ISO8583Engine_GetField( &Spec, pRec, 55, cIcc, sizeof( cIcc ) );
+            for( j = 0; j < LOOKUP_COUNT; j ++ )
+                ulScan += ScanTag( cIcc, iLength, LookupTags[ j ], &pValue ) + pValue[ 0 ];
+        }
+    }
+    tScan = ( NowNs() - t0 ) / lIters / BENCH_MSGS - tDecode;
+
+    t0 = NowNs();
+    for( l = 0; l < lIters; l ++ )
+    {
+        for( i = 0; i < BENCH_MSGS; i ++ )
+        {
+            ISO8583Engine_HexbufToIso8583( &Spec, pRec, cBuf + nOffset[ i ] );
+            ISO8583Tlv_ParseRec( &Index, &Spec, pRec, 55 );
+            for( j = 0; j < LOOKUP_COUNT; j ++ )
+                ulTlv += ISO8583Tlv_Value( &Index, LookupTags[ j ], &pValue ) + pValue[ 0 ];
+        }
+    }
+    tTlv = ( NowNs() - t0 ) / lIters / BENCH_MSGS - tDecode;
+
+    if( ulScan != ulTlv )
+    {
+        printf( "tag values differ\n" );
+        return 1;
+    }
+
+    g_ulSink = ulTlv;
+    printf( "decode %6.1f ns/msg   field 55, %d tags: copy + scan %6.1f ns  TLV index %6.1f ns (%.0f%% of decode)\n",
+            tDecode, LOOKUP_COUNT, tScan, tTlv, 100 * tTlv / tDecode );
+    return 0;
+}
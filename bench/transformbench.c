@@ -0,0 +1,123 @@
+/***************************************************************************
+* FILE NAME:    TransformBench.C                                           *
+* MODULE NAME:  ISO8583Engine benchmarks                                   *
+* PROGRAMMER:                                                              *
+* DESCRIPTION:  0200 request to 0210 response: unpack, copy every kept     *
+*               field with GetField / SetField and pack again, against     *
+*               ISO8583Engine_Transform on the RAW request.                *
+* REVISION:                                                                *
+****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ISO8583Engine.h"
+#include "SampleFmt.h"
+
+static volatile int g_iSink;
+
+static double NowNs( void )
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int IsDropped( int iFieldNo )
+{
+    return iFieldNo == 35 || iFieldNo == 52 || iFieldNo == 55;
+}
+
+//Response through the record API, the way it is built without Transform
+static int BuildResponse( const ISO8583_Spec * pSpec, ISO8583_Rec * pReq, ISO8583_Rec * pRsp, byte * pReqBuf, byte * pRetBuf, int iSize )
+{
+    unsigned char cData[ 1000 ];
+    int iFieldNo, iLength;
+
+    ISO8583Engine_HexbufToIso8583( pSpec, pReq, pReqBuf );
+    ISO8583Engine_ClearAllFields( pRsp );
+    ISO8583Engine_SetField( pSpec, pRsp, 0, ( unsigned char * )"0210", 4 );
+
+    for( iFieldNo = 2; iFieldNo <= ISO8583_PRIMARYFIELD; iFieldNo ++ )
+    {
+        if( IsDropped( iFieldNo ) || !pReq->Field[ iFieldNo - 1 ].bitf )
+            continue;
+
+        iLength = ISO8583Engine_GetField( pSpec, pReq, iFieldNo, cData, sizeof( cData ) );
+
+        if( iLength > 0 )
+            ISO8583Engine_SetField( pSpec, pRsp, iFieldNo, cData, iLength );
+    }
+
+    ISO8583Engine_SetField( pSpec, pRsp, 38, ( unsigned char * )"A1B2C3", 6 );
+    ISO8583Engine_SetField( pSpec, pRsp, 39, ( unsigned char * )"00", 2 );
+    return ISO8583Engine_Iso8583ToHexbuf( pSpec, pRsp, pRetBuf, iSize );
+}
+
+int main( int argc, char ** argv )
+{
+    static const int Dense0200[] = { 2, 3, 4, 7, 11, 12, 13, 14, 22, 23, 25, 26, 32, 35, 37, 41, 42, 49, 52, 53, 55, 60, 63, 0 };
+    static const ISO8583_Edit Edits[] =
+    {
+        { 0, ISO8583_EDIT_SET, ( const unsigned char * )"0210", 4 },
+        { 35, ISO8583_EDIT_REMOVE, NULL, 0 },
+        { 38, ISO8583_EDIT_SET, ( const unsigned char * )"A1B2C3", 6 },
+        { 39, ISO8583_EDIT_SET, ( const unsigned char * )"00", 2 },
+        { 52, ISO8583_EDIT_REMOVE, NULL, 0 },
+        { 55, ISO8583_EDIT_REMOVE, NULL, 0 },
+    };
+    static ISO8583_Spec Spec;
+    static ISO8583_FixRec ReqFixRec, RspFixRec;
+    ISO8583_Rec * pReq = ISO8583Engine_InitFixRec( &ReqFixRec );
+    ISO8583_Rec * pRsp = ISO8583Engine_InitFixRec( &RspFixRec );
+    unsigned char cData[ 1000 ], cReq[ 2048 ], cRsp[ 2048 ], cOut[ 2048 ];
+    long l, lIters = argc > 1 ? atol( argv[ 1 ] ) : 1000000;
+    int i, iFieldNo, iLength, iReqLen, iRspLen;
+    double t0, tRecord, tTransform;
+    const int * piFields;
+
+    ISO8583Engine_InitFieldFormat( &Spec, ISO8583_BITMAP64, SampleFldFmt );
+    ISO8583Engine_SetField( &Spec, pReq, 0, ( unsigned char * )"0200", 4 );
+
+    for( piFields = Dense0200; *piFields; piFields ++ )
+    {
+        iFieldNo = *piFields;
+        iLength = SampleFldFmt[ iFieldNo - 1 ].iMaxLength;
+
+        if( SampleFldFmt[ iFieldNo - 1 ].bType & ISO8583TYPE_VAR )
+            iLength = iLength > 20 ? 20 : iLength - 1;
+        else if( SampleFldFmt[ iFieldNo - 1 ].bType & ISO8583TYPE_BIN )
+            iLength /= 8;
+
+        for( i = 0; i < iLength; i ++ )
+            cData[ i ] = ( unsigned char )(( SampleFldFmt[ iFieldNo - 1 ].bType & ISO8583TYPE_BCD ) ? '0' + ( i + iFieldNo ) % 10 : 'A' + ( i + iFieldNo ) % 26 );
+
+        ISO8583Engine_SetField( &Spec, pReq, iFieldNo, cData, iLength );
+    }
+
+    iReqLen = ISO8583Engine_Iso8583ToHexbuf( &Spec, pReq, cReq, sizeof( cReq ) );
+    iRspLen = BuildResponse( &Spec, pReq, pRsp, cReq, cRsp, sizeof( cRsp ) );
+
+    if( iRspLen <= 0 || ISO8583Engine_Transform( &Spec, cReq, iReqLen, Edits, sizeof( Edits ) / sizeof( Edits[ 0 ] ), cOut, sizeof( cOut ) ) != iRspLen
+        || memcmp( cRsp, cOut, iRspLen ) != 0 )
+    {
+        printf( "transform output differs from the record API\n" );
+        return 1;
+    }
+
+    t0 = NowNs();
+    for( l = 0; l < lIters; l ++ )
+        g_iSink = BuildResponse( &Spec, pReq, pRsp, cReq, cRsp, sizeof( cRsp ) );
+    tRecord = ( NowNs() - t0 ) / lIters;
+
+    t0 = NowNs();
+    for( l = 0; l < lIters; l ++ )
+        g_iSink = ISO8583Engine_Transform( &Spec, cReq, iReqLen, Edits, sizeof( Edits ) / sizeof( Edits[ 0 ] ), cOut, sizeof( cOut ) );
+    tTransform = ( NowNs() - t0 ) / lIters;
+
+    printf( "0200 %4d bytes -> 0210 %4d bytes   record API %7.1f ns  transform %7.1f ns\n", iReqLen, iRspLen, tRecord, tTransform );
+    return 0;
+}
@@ -0,0 +1,129 @@
+/***************************************************************************
+* FILE NAME:    ValidateBench.C                                            *
+* MODULE NAME:  ISO8583Engine benchmarks                                   *
+* PROGRAMMER:                                                              *
+* DESCRIPTION:  Checked decode of a block of 0200 messages: HexbufToIso8583 *
+*               followed by GetField and a byte by byte check of every     *
+*               field, against HexbufToIso8583Strict checking the fields   *
+*               as they are copied. HexbufToIso8583Len is shown for the    *
+*               cost of the decode alone.                                  *
+* REVISION:                                                                *
+****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ISO8583Engine.h"
+#include "SampleFmt.h"
+
+#define BENCH_MSGS      1024
+
+static volatile int g_iSink;
+
+static double NowNs( void )
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+//The check of a second pass over the ASC copy of a field
+static int CheckCopy( const ISO8583_Spec * pSpec, int iFieldNum, const unsigned char * pData, int iLength )
+{
+    const ISO8583_FieldOp * pOp = &pSpec->Op[ iFieldNum ];
+    int i;
+
+    for( i = 0; i < iLength; i ++ )
+    {
+        if( pOp->bClass == ISO8583_CLASS_N && ( pData[ i ] < '0' || pData[ i ] > '9' ) )
+            return -1;
+        if( pOp->bClass == ISO8583_CLASS_Z && !( pData[ i ] >= '0' && pData[ i ] <= '9' ) && pData[ i ] != 'D' )
+            return -1;
+        if( pOp->bClass == ISO8583_CLASS_ANS && ( pData[ i ] < 0x20 || pData[ i ] > 0x7E ) )
+            return -1;
+    }
+
+    if( pOp->bLuhn )
+        return ISO8583Utils_Luhn( pData, iLength, FALSE );
+
+    return 0;
+}
+
+int main( int argc, char ** argv )
+{
+    static ISO8583_Spec Spec;
+    static ISO8583_FixRec FixRec;
+    static byte cBuf[ BENCH_MSGS * 256 ];
+    static size_t nOffset[ BENCH_MSGS + 1 ];
+    ISO8583_Rec * pRec = ISO8583Engine_InitFixRec( &FixRec );
+    ISO8583_CheckError Error;
+    unsigned char cData[ 128 ];
+    long l, lIters = argc > 1 ? atol( argv[ 1 ] ) : 200;
+    double t0, tDecode, tTwoPass, tStrict;
+    int i, j, iLength, iBad = 0;
+
+    ISO8583Engine_InitFieldFormat( &Spec, ISO8583_BITMAP64, SampleFldFmt );
+
+    for( i = 0; i < BENCH_MSGS; i ++ )
+    {
+        ISO8583Engine_ClearAllFields( pRec );
+        ISO8583Engine_SetField( &Spec, pRec, 0, ( unsigned char * )"0200", 4 );
+        ISO8583Engine_SetField( &Spec, pRec, 2, ( unsigned char * )"4111111111111111", 16 );
+        ISO8583Engine_SetField( &Spec, pRec, 3, ( unsigned char * )"000000", 6 );
+        sprintf(( char * )cData, "%012d", i * 37 );
+        ISO8583Engine_SetField( &Spec, pRec, 4, cData, 12 );
+        sprintf(( char * )cData, "%06d", i );
+        ISO8583Engine_SetField( &Spec, pRec, 11, cData, 6 );
+        ISO8583Engine_SetField( &Spec, pRec, 22, ( unsigned char * )"051", 3 );
+        ISO8583Engine_SetField( &Spec, pRec, 35, ( unsigned char * )"4111111111111111=2512101123456", 30 );
+        ISO8583Engine_SetField( &Spec, pRec, 41, ( unsigned char * )"TERM0001", 8 );
+        ISO8583Engine_SetField( &Spec, pRec, 42, ( unsigned char * )"898440358120001", 15 );
+        ISO8583Engine_SetField( &Spec, pRec, 43, ( unsigned char * )"ACME STORES 0042        SHANGHAI      CN", 40 );
+        ISO8583Engine_SetField( &Spec, pRec, 49, ( unsigned char * )"156", 3 );
+        nOffset[ i + 1 ] = nOffset[ i ] + ISO8583Engine_Iso8583ToHexbuf( &Spec, pRec, cBuf + nOffset[ i ], 256 );
+    }
+
+    t0 = NowNs();
+    for( l = 0; l < lIters; l ++ )
+        for( i = 0; i < BENCH_MSGS; i ++ )
+            ISO8583Engine_HexbufToIso8583Len( &Spec, pRec, cBuf + nOffset[ i ], nOffset[ i + 1 ] - nOffset[ i ] );
+    tDecode = ( NowNs() - t0 ) / lIters / BENCH_MSGS;
+
+    t0 = NowNs();
+    for( l = 0; l < lIters; l ++ )
+    {
+        for( i = 0; i < BENCH_MSGS; i ++ )
+        {
+            ISO8583Engine_HexbufToIso8583Len( &Spec, pRec, cBuf + nOffset[ i ], nOffset[ i + 1 ] - nOffset[ i ] );
+            for( j = 1; j < Spec.iMaxField; j ++ )
+            {
+                if( !pRec->Field[ j ].bitf )
+                    continue;
+
+                iLength = ISO8583Engine_GetField( &Spec, pRec, j + 1, cData, sizeof( cData ) );
+                iBad += CheckCopy( &Spec, j, cData, iLength ) != 0;
+            }
+        }
+    }
+    tTwoPass = ( NowNs() - t0 ) / lIters / BENCH_MSGS;
+
+    t0 = NowNs();
+    for( l = 0; l < lIters; l ++ )
+        for( i = 0; i < BENCH_MSGS; i ++ )
+            iBad += ISO8583Engine_HexbufToIso8583Strict( &Spec, pRec, cBuf + nOffset[ i ], nOffset[ i + 1 ] - nOffset[ i ], &Error ) != 0;
+    tStrict = ( NowNs() - t0 ) / lIters / BENCH_MSGS;
+
+    if( iBad != 0 )
+    {
+        printf( "%d messages failed the check\n", iBad );
+        return 1;
+    }
+
+    g_iSink = iBad;
+    printf( "decode %6.1f ns/msg   decode + check pass %6.1f ns  strict decode %6.1f ns (%.0f%% of decode)\n",
+            tDecode, tTwoPass, tStrict, 100 * tStrict / tDecode );
+    return 0;
+}
@@ -0,0 +1,449 @@
+/***************************************************************************
+* FILE NAME:    ISO8583Batch.C                                             *
+* MODULE NAME:  ISO8583Engine                                              *
+* PROGRAMMER:                                                              *
+* DESCRIPTION:  Work stealing batch pool, see ISO8583Batch.h               *
+* REVISION:                                                                *
+****************************************************************************/
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "ISO8583Engine.h"
+#include "ISO8583Batch.h"
+
+#define ISO8583_BATCH_ALIGN     64
+
+//Messages an owner takes from its own range at once, at most
+#define ISO8583_BATCH_MAXCHUNK  64
+
+typedef enum
+{
+    BATCH_DECODE = 0,
+    BATCH_DECODE_OFFSETS,
+    BATCH_ENCODE,
+} BatchOp;
+
+//One batch call
+typedef struct
+{
+    int iOp;
+    const ISO8583_Spec * pSpec;
+    const byte * const * ppMsg;
+    const size_t * pnLength;
+    const byte * pBuf;
+    const size_t * pnOffset;
+    ISO8583_Rec * const * ppRecs;
+    byte * pOut;
+    int iStride;
+    int * piResults;
+    int iChunk;
+} BatchJob;
+
+//Range of messages left to a thread, next in the low and end in the high 32
+//bits, so owner and thieves both move it with one compare and swap. Each
+//range has a cache line of its own.
+typedef struct
+{
+    _Alignas( ISO8583_BATCH_ALIGN ) _Atomic unsigned long long ullRange;
+    int iFailed;
+    pthread_t Thread;
+} BatchWorker;
+
+struct ISO8583_Batch
+{
+    BatchWorker Worker[ ISO8583_BATCH_MAXTHREADS ];
+    void * pMem;
+    int iThreads;
+    BatchJob Job;                   // job of the batch running, under Busy
+    pthread_mutex_t Busy;           // held by the caller for a whole batch
+    pthread_mutex_t Lock;
+    pthread_cond_t Start;
+    pthread_cond_t Done;
+    unsigned int uiGeneration;
+    int iActive;
+    int iStarted;
+    int bStop;
+};
+
+//Argument of a worker thread
+typedef struct
+{
+    ISO8583_Batch * pBatch;
+    int iWorker;
+} BatchArg;
+
+/*-----------------------------------------------------------------------------
+ * Internal functions
+ *-----------------------------------------------------------------------------*/
+
+#define RANGE( lo, hi )     (((( unsigned long long )( hi )) << 32 ) | ( unsigned int )( lo ))
+#define RANGE_LO( r )       (( int )( unsigned int )( r ))
+#define RANGE_HI( r )       (( int )(( r ) >> 32 ))
+
+//Take up to iChunk messages from the front of a thread's own range
+static int TakeOwn( BatchWorker * pWorker, int iChunk, int * piLo, int * piHi )
+{
+    unsigned long long ullRange = atomic_load( &pWorker->ullRange );
+    int iLo, iHi, n;
+
+    do
+    {
+        iLo = RANGE_LO( ullRange );
+        iHi = RANGE_HI( ullRange );
+
+        if( iLo >= iHi )
+            return 0;
+
+        n = iHi - iLo < iChunk ? iHi - iLo : iChunk;
+    } while( !atomic_compare_exchange_weak( &pWorker->ullRange, &ullRange, RANGE( iLo + n, iHi ) ) );
+
+    *piLo = iLo;
+    *piHi = iLo + n;
+    return 1;
+}
+
+//Take the back half of another thread's range
+static int Steal( BatchWorker * pVictim, int * piLo, int * piHi )
+{
+    unsigned long long ullRange = atomic_load( &pVictim->ullRange );
+    int iLo, iHi, n;
+
+    do
+    {
+        iLo = RANGE_LO( ullRange );
+        iHi = RANGE_HI( ullRange );
+
+        if( iLo >= iHi )
+            return 0;
+
+        n = ( iHi - iLo + 1 ) >> 1;
+    } while( !atomic_compare_exchange_weak( &pVictim->ullRange, &ullRange, RANGE( iLo, iHi - n ) ) );
+
+    *piLo = iHi - n;
+    *piHi = iHi;
+    return 1;
+}
+
+//Run messages iLo up to iHi of the job, returns the number of failures
+static int RunRange( const BatchJob * pJob, int iLo, int iHi )
+{
+    int i, iRet, iFailed = 0;
+
+    for( i = iLo; i < iHi; i ++ )
+    {
+        switch( pJob->iOp )
+        {
+        case BATCH_DECODE:
+            iRet = ISO8583Engine_HexbufToIso8583Len( pJob->pSpec, pJob->ppRecs[ i ], pJob->ppMsg[ i ], pJob->pnLength[ i ] );
+            iFailed += iRet != 0;
+            break;
+        case BATCH_DECODE_OFFSETS:
+            iRet = ISO8583Engine_HexbufToIso8583Len( pJob->pSpec, pJob->ppRecs[ i ], pJob->pBuf + pJob->pnOffset[ i ],
+                                                     pJob->pnOffset[ i + 1 ] - pJob->pnOffset[ i ] );
+            iFailed += iRet != 0;
+            break;
+        default:
+            iRet = ISO8583Engine_Iso8583ToHexbuf( pJob->pSpec, pJob->ppRecs[ i ], pJob->pOut + ( size_t )i * pJob->iStride, pJob->iStride );
+            iFailed += iRet <= 0;
+            break;
+        }
+
+        pJob->piResults[ i ] = iRet;
+    }
+
+    return iFailed;
+}
+
+//Work on the current job until no range has anything left
+static void RunJob( ISO8583_Batch * pBatch, int iWorker )
+{
+    BatchWorker * pSelf = &pBatch->Worker[ iWorker ];
+    int i, iLo = 0, iHi = 0, iFailed = 0;
+
+    for( ;; )
+    {
+        while( TakeOwn( pSelf, pBatch->Job.iChunk, &iLo, &iHi ) )
+            iFailed += RunRange( &pBatch->Job, iLo, iHi );
+
+        for( i = 1; i < pBatch->iThreads; i ++ )
+        {
+            if( Steal( &pBatch->Worker[ ( iWorker + i ) % pBatch->iThreads ], &iLo, &iHi ) )
+                break;
+        }
+
+        if( i == pBatch->iThreads )
+            break;
+
+        //Own range is empty, nobody can change it until the stolen part is stored
+        atomic_store( &pSelf->ullRange, RANGE( iLo, iHi ) );
+    }
+
+    pSelf->iFailed = iFailed;
+}
+
+static void * WorkerMain( void * pArg )
+{
+    ISO8583_Batch * pBatch = (( BatchArg * )pArg )->pBatch;
+    int iWorker = (( BatchArg * )pArg )->iWorker;
+    unsigned int uiSeen = 0;
+
+    free( pArg );
+    pthread_mutex_lock( &pBatch->Lock );
+
+    for( ;; )
+    {
+        while( !pBatch->bStop && pBatch->uiGeneration == uiSeen )
+            pthread_cond_wait( &pBatch->Start, &pBatch->Lock );
+
+        if( pBatch->bStop )
+            break;
+
+        uiSeen = pBatch->uiGeneration;
+        pthread_mutex_unlock( &pBatch->Lock );
+
+        RunJob( pBatch, iWorker );
+
+        pthread_mutex_lock( &pBatch->Lock );
+
+        if( -- pBatch->iActive == 0 )
+            pthread_cond_signal( &pBatch->Done );
+    }
+
+    pthread_mutex_unlock( &pBatch->Lock );
+    return NULL;
+}
+
+//Split iCount messages over the threads, run the job and wait for all of them.
+//Batches on one pool run one after the other, Job and the ranges are shared.
+static int Dispatch( ISO8583_Batch * pBatch, const BatchJob * pJob, int iCount )
+{
+    int i, iFailed = 0;
+
+    if( iCount <= 0 )
+        return 0;
+
+    pthread_mutex_lock( &pBatch->Busy );
+    pBatch->Job = *pJob;
+
+    //Small chunks balance better, large ones touch the shared range less
+    pBatch->Job.iChunk = iCount / ( pBatch->iThreads * 16 );
+
+    if( pBatch->Job.iChunk < 1 )
+        pBatch->Job.iChunk = 1;
+    else if( pBatch->Job.iChunk > ISO8583_BATCH_MAXCHUNK )
+        pBatch->Job.iChunk = ISO8583_BATCH_MAXCHUNK;
+
+    for( i = 0; i < pBatch->iThreads; i ++ )
+        atomic_store( &pBatch->Worker[ i ].ullRange, RANGE(( long long )iCount * i / pBatch->iThreads, ( long long )iCount * ( i + 1 ) / pBatch->iThreads ) );
+
+    if( pBatch->iThreads > 1 )
+    {
+        pthread_mutex_lock( &pBatch->Lock );
+        pBatch->uiGeneration ++;
+        pBatch->iActive = pBatch->iThreads - 1;
+        pthread_cond_broadcast( &pBatch->Start );
+        pthread_mutex_unlock( &pBatch->Lock );
+    }
+
+    RunJob( pBatch, 0 );
+
+    if( pBatch->iThreads > 1 )
+    {
+        pthread_mutex_lock( &pBatch->Lock );
+
+        while( pBatch->iActive > 0 )
+            pthread_cond_wait( &pBatch->Done, &pBatch->Lock );
+
+        pthread_mutex_unlock( &pBatch->Lock );
+    }
+
+    for( i = 0; i < pBatch->iThreads; i ++ )
+        iFailed += pBatch->Worker[ i ].iFailed;
+
+    pthread_mutex_unlock( &pBatch->Busy );
+    return iFailed;
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Batch_Create
+ * DESCRIPTION:     Start a batch pool
+ * PARAMETERS:      iThreads: threads including the caller, <=0 for one per CPU
+ * RETURN:          The pool, NULL when out of memory or threads
+ ---------------------------------------------------------------------------- */
+ISO8583_Batch * ISO8583Batch_Create( int iThreads )
+{
+    ISO8583_Batch * pBatch;
+    BatchArg * pArg;
+    void * pMem;
+
+    if( iThreads <= 0 )
+        iThreads = ( int )sysconf( _SC_NPROCESSORS_ONLN );
+
+    if( iThreads <= 0 )
+        iThreads = 1;
+    else if( iThreads > ISO8583_BATCH_MAXTHREADS )
+        iThreads = ISO8583_BATCH_MAXTHREADS;
+
+    pMem = malloc( sizeof( ISO8583_Batch ) + ISO8583_BATCH_ALIGN );
+
+    if( pMem == NULL )
+        return NULL;
+
+    pBatch = ( ISO8583_Batch * )((( size_t )pMem + ISO8583_BATCH_ALIGN - 1 ) & ~( size_t )( ISO8583_BATCH_ALIGN - 1 ));
+    memset( pBatch, 0, sizeof( ISO8583_Batch ) );
+    pBatch->pMem = pMem;
+    pBatch->iThreads = iThreads;
+    pthread_mutex_init( &pBatch->Busy, NULL );
+    pthread_mutex_init( &pBatch->Lock, NULL );
+    pthread_cond_init( &pBatch->Start, NULL );
+    pthread_cond_init( &pBatch->Done, NULL );
+
+    for( pBatch->iStarted = 1; pBatch->iStarted < iThreads; pBatch->iStarted ++ )
+    {
+        pArg = ( BatchArg * )malloc( sizeof( BatchArg ) );
+
+        if( pArg == NULL )
+            break;
+
+        pArg->pBatch = pBatch;
+        pArg->iWorker = pBatch->iStarted;
+
+        if( pthread_create( &pBatch->Worker[ pBatch->iStarted ].Thread, NULL, WorkerMain, pArg ) != 0 )
+        {
+            free( pArg );
+            break;
+        }
+    }
+
+    if( pBatch->iStarted < iThreads )
+    {
+        ISO8583Batch_Destroy( pBatch );
+        return NULL;
+    }
+
+    return pBatch;
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Batch_Destroy
+ * DESCRIPTION:     Stop and join the worker threads, free the pool
+ * PARAMETERS:      pBatch: pool, may be NULL
+ * RETURN:          None.
+ ---------------------------------------------------------------------------- */
+void ISO8583Batch_Destroy( ISO8583_Batch * pBatch )
+{
+    int i;
+
+    if( pBatch == NULL )
+        return;
+
+    pthread_mutex_lock( &pBatch->Lock );
+    pBatch->bStop = 1;
+    pthread_cond_broadcast( &pBatch->Start );
+    pthread_mutex_unlock( &pBatch->Lock );
+
+    for( i = 1; i < pBatch->iStarted; i ++ )
+        pthread_join( pBatch->Worker[ i ].Thread, NULL );
+
+    pthread_cond_destroy( &pBatch->Done );
+    pthread_cond_destroy( &pBatch->Start );
+    pthread_mutex_destroy( &pBatch->Lock );
+    pthread_mutex_destroy( &pBatch->Busy );
+    free( pBatch->pMem );
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Batch_Threads
+ * DESCRIPTION:     Number of threads working on a batch
+ * PARAMETERS:      pBatch: pool
+ * RETURN:          Thread count including the caller
+ ---------------------------------------------------------------------------- */
+int ISO8583Batch_Threads( const ISO8583_Batch * pBatch )
+{
+    return pBatch->iThreads;
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Batch_Decode
+ * DESCRIPTION:     Decode iCount messages given as pointer and length
+ * PARAMETERS:      pBatch: pool
+ *                  pSpec: spec context
+ *                  ppMsg: RAW messages
+ *                  pnLength: message lengths
+ *                  ppRecs(out): records
+ *                  piResults(out): return values
+ *                  iCount: messages in the batch
+ * RETURN:          Number of messages with a result other than 0
+ ---------------------------------------------------------------------------- */
+int ISO8583Batch_Decode( ISO8583_Batch * pBatch, const ISO8583_Spec * pSpec, const byte * const * ppMsg, const size_t * pnLength,
+                         ISO8583_Rec * const * ppRecs, int * piResults, int iCount )
+{
+    BatchJob Job;
+
+    memset( &Job, 0, sizeof( BatchJob ) );
+    Job.iOp = BATCH_DECODE;
+    Job.pSpec = pSpec;
+    Job.ppMsg = ppMsg;
+    Job.pnLength = pnLength;
+    Job.ppRecs = ppRecs;
+    Job.piResults = piResults;
+    return Dispatch( pBatch, &Job, iCount );
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Batch_DecodeOffsets
+ * DESCRIPTION:     Decode iCount messages stored back to back in pBuf
+ * PARAMETERS:      pBatch: pool
+ *                  pSpec: spec context
+ *                  pBuf: messages
+ *                  pnOffset: iCount + 1 offsets into pBuf
+ *                  ppRecs(out): records
+ *                  piResults(out): return values
+ *                  iCount: messages in the batch
+ * RETURN:          Number of messages with a result other than 0
+ ---------------------------------------------------------------------------- */
+int ISO8583Batch_DecodeOffsets( ISO8583_Batch * pBatch, const ISO8583_Spec * pSpec, const byte * pBuf, const size_t * pnOffset,
+                                ISO8583_Rec * const * ppRecs, int * piResults, int iCount )
+{
+    BatchJob Job;
+
+    memset( &Job, 0, sizeof( BatchJob ) );
+    Job.iOp = BATCH_DECODE_OFFSETS;
+    Job.pSpec = pSpec;
+    Job.pBuf = pBuf;
+    Job.pnOffset = pnOffset;
+    Job.ppRecs = ppRecs;
+    Job.piResults = piResults;
+    return Dispatch( pBatch, &Job, iCount );
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Batch_Encode
+ * DESCRIPTION:     Encode iCount records, message i goes to pOut + i * iStride
+ * PARAMETERS:      pBatch: pool
+ *                  pSpec: spec context
+ *                  ppRecs: records
+ *                  pOut(out): iCount * iStride bytes
+ *                  iStride: room for one message
+ *                  piResults(out): return values, >0 length
+ *                  iCount: messages in the batch
+ * RETURN:          Number of messages with a result <=0
+ ---------------------------------------------------------------------------- */
+int ISO8583Batch_Encode( ISO8583_Batch * pBatch, const ISO8583_Spec * pSpec, ISO8583_Rec * const * ppRecs,
+                         byte * pOut, int iStride, int * piResults, int iCount )
+{
+    BatchJob Job;
+
+    memset( &Job, 0, sizeof( BatchJob ) );
+    Job.iOp = BATCH_ENCODE;
+    Job.pSpec = pSpec;
+    Job.ppRecs = ppRecs;
+    Job.pOut = pOut;
+    Job.iStride = iStride;
+    Job.piResults = piResults;
+    return Dispatch( pBatch, &Job, iCount );
+}
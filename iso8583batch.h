@@ -0,0 +1,115 @@
+/***************************************************************************
+* FILE NAME:    ISO8583Batch.H                                             *
+* MODULE NAME:  ISO8583Engine                                              *
+* PROGRAMMER:                                                              *
+* DESCRIPTION:  Batch decode / encode of many messages on a pool of        *
+*               worker threads. The messages of a batch are split in one   *
+*               range per thread, a thread that runs out of work steals    *
+*               half of the rest of another range, so uneven message       *
+*               sizes do not leave threads idle. Results go to caller      *
+*               allocated arrays, one entry per message. The calling       *
+*               thread works on the batch too. Needs POSIX threads.        *
+* REVISION:                                                                *
+****************************************************************************/
+
+#ifndef _ISO8583BATCH_H
+#define _ISO8583BATCH_H
+
+#include "ISO8583Engine.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//Most threads of one batch pool
+#define ISO8583_BATCH_MAXTHREADS    256
+
+//A pool runs one batch at a time: a batch called from another thread while
+//one is running waits until it is done. Batches that should run side by side
+//need a pool each.
+typedef struct ISO8583_Batch ISO8583_Batch;
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Batch_Create
+ * DESCRIPTION:     Start a batch pool
+ * PARAMETERS:      iThreads: threads working on a batch including the caller,
+ *                            <=0 for one per online CPU
+ * RETURN:          The pool, NULL when out of memory or threads
+ ---------------------------------------------------------------------------- */
+ISO8583_Batch * ISO8583Batch_Create( int iThreads );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Batch_Destroy
+ * DESCRIPTION:     Stop and join the worker threads, free the pool
+ * PARAMETERS:      pBatch: pool, may be NULL
+ * RETURN:          None.
+ ---------------------------------------------------------------------------- */
+void ISO8583Batch_Destroy( ISO8583_Batch * pBatch );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Batch_Threads
+ * DESCRIPTION:     Number of threads working on a batch
+ * PARAMETERS:      pBatch: pool
+ * RETURN:          Thread count including the caller
+ ---------------------------------------------------------------------------- */
+int ISO8583Batch_Threads( const ISO8583_Batch * pBatch );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Batch_Decode
+ * DESCRIPTION:     ISO8583Engine_HexbufToIso8583Len of iCount messages given
+ *                  as pointer and length. Records are written by different
+ *                  threads, so they must not grow through a shared
+ *                  ISO8583_Pool: use ISO8583_FixRec or ISO8583Engine_InitRec
+ *                  records.
+ * PARAMETERS:      pBatch: pool
+ *                  pSpec: spec context
+ *                  ppMsg: iCount RAW messages
+ *                  pnLength: iCount message lengths
+ *                  ppRecs(out): iCount records
+ *                  piResults(out): iCount return values of
+ *                                  ISO8583Engine_HexbufToIso8583Len
+ *                  iCount: messages in the batch
+ * RETURN:          Number of messages with a result other than 0
+ ---------------------------------------------------------------------------- */
+int ISO8583Batch_Decode( ISO8583_Batch * pBatch, const ISO8583_Spec * pSpec, const byte * const * ppMsg, const size_t * pnLength,
+                         ISO8583_Rec * const * ppRecs, int * piResults, int iCount );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Batch_DecodeOffsets
+ * DESCRIPTION:     ISO8583Batch_Decode of iCount messages stored back to back
+ *                  in one buffer, message i is pBuf[ pnOffset[ i ] ] up to
+ *                  pBuf[ pnOffset[ i + 1 ] ]
+ * PARAMETERS:      pBatch: pool
+ *                  pSpec: spec context
+ *                  pBuf: messages
+ *                  pnOffset: iCount + 1 offsets into pBuf
+ *                  ppRecs(out): iCount records
+ *                  piResults(out): iCount return values
+ *                  iCount: messages in the batch
+ * RETURN:          Number of messages with a result other than 0
+ ---------------------------------------------------------------------------- */
+int ISO8583Batch_DecodeOffsets( ISO8583_Batch * pBatch, const ISO8583_Spec * pSpec, const byte * pBuf, const size_t * pnOffset,
+                                ISO8583_Rec * const * ppRecs, int * piResults, int iCount );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Batch_Encode
+ * DESCRIPTION:     ISO8583Engine_Iso8583ToHexbuf of iCount records, message i
+ *                  goes to pOut + i * iStride
+ * PARAMETERS:      pBatch: pool
+ *                  pSpec: spec context
+ *                  ppRecs: iCount records
+ *                  pOut(out): iCount * iStride bytes
+ *                  iStride: room for one message
+ *                  piResults(out): iCount return values of
+ *                                  ISO8583Engine_Iso8583ToHexbuf, >0 length
+ *                  iCount: messages in the batch
+ * RETURN:          Number of messages with a result <=0
+ ---------------------------------------------------------------------------- */
+int ISO8583Batch_Encode( ISO8583_Batch * pBatch, const ISO8583_Spec * pSpec, ISO8583_Rec * const * ppRecs,
+                         byte * pOut, int iStride, int * piResults, int iCount );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,93 @@
+/***************************************************************************
+* FILE NAME:    ISO8583Bits.H                                              *
+* MODULE NAME:  ISO8583Engine                                              *
+* PROGRAMMER:                                                              *
+* DESCRIPTION:  Internal bitmap word helpers. Bit i of bitmap word w is    *
+*               field w * 64 + i + 1, so set fields are visited in         *
+*               ascending order with count-trailing-zeros. The wire bitmap *
+*               is most significant bit first, LoadWire / StoreWire        *
+*               reverse the bit order once per word.                       *
+* REVISION:                                                                *
+****************************************************************************/
+
+#ifndef _ISO8583BITS_H
+#define _ISO8583BITS_H
+
+#if defined( _MSC_VER )
+#include <intrin.h>
+#endif
+
+//Bit of field index iIdx (0 based) inside its bitmap word
+#define ISO8583_BITWORD_MASK( iIdx )    ( 1ULL << (( iIdx ) & 63 ) )
+
+//Test / set / clear field index iIdx (0 based) in an array of bitmap words
+#define ISO8583_BITMAP_TEST( pWords, iIdx )     (( ( pWords )[ ( iIdx ) >> 6 ] & ISO8583_BITWORD_MASK( iIdx ) ) != 0 )
+#define ISO8583_BITMAP_SET( pWords, iIdx )      (( pWords )[ ( iIdx ) >> 6 ] |= ISO8583_BITWORD_MASK( iIdx ))
+#define ISO8583_BITMAP_CLEAR( pWords, iIdx )    (( pWords )[ ( iIdx ) >> 6 ] &= ~ISO8583_BITWORD_MASK( iIdx ))
+
+//Number of trailing zero bits, ullWord must not be 0
+static inline int ISO8583Bits_Ctz64( unsigned long long ullWord )
+{
+#if defined( __GNUC__ )
+    return __builtin_ctzll( ullWord );
+#elif defined( _MSC_VER ) && defined( _M_X64 )
+    unsigned long ulIdx;
+    _BitScanForward64( &ulIdx, ullWord );
+    return ( int )ulIdx;
+#else
+    int n = 0;
+
+    while(( ullWord & 1 ) == 0 )
+    {
+        ullWord >>= 1;
+        n ++;
+    }
+
+    return n;
+#endif
+}
+
+//Number of set bits
+static inline int ISO8583Bits_Popcount64( unsigned long long ullWord )
+{
+#if defined( __GNUC__ )
+    return __builtin_popcountll( ullWord );
+#else
+    int n = 0;
+
+    for( ; ullWord; n ++ )
+        ullWord &= ullWord - 1;
+
+    return n;
+#endif
+}
+
+//Reverse the bit order inside each byte
+static inline unsigned long long ISO8583Bits_ReverseBytes( unsigned long long x )
+{
+    x = (( x >> 1 ) & 0x5555555555555555ULL ) | (( x & 0x5555555555555555ULL ) << 1 );
+    x = (( x >> 2 ) & 0x3333333333333333ULL ) | (( x & 0x3333333333333333ULL ) << 2 );
+    return (( x >> 4 ) & 0x0F0F0F0F0F0F0F0FULL ) | (( x & 0x0F0F0F0F0F0F0F0FULL ) << 4 );
+}
+
+//8 wire bitmap bytes to one bitmap word
+static inline unsigned long long ISO8583Bits_LoadWire( const unsigned char * p )
+{
+    return ISO8583Bits_ReverseBytes(( unsigned long long )p[ 0 ] | (( unsigned long long )p[ 1 ] << 8 )
+                                    | (( unsigned long long )p[ 2 ] << 16 ) | (( unsigned long long )p[ 3 ] << 24 )
+                                    | (( unsigned long long )p[ 4 ] << 32 ) | (( unsigned long long )p[ 5 ] << 40 )
+                                    | (( unsigned long long )p[ 6 ] << 48 ) | (( unsigned long long )p[ 7 ] << 56 ) );
+}
+
+//One bitmap word to 8 wire bitmap bytes
+static inline void ISO8583Bits_StoreWire( unsigned char * p, unsigned long long ullWord )
+{
+    int i;
+
+    ullWord = ISO8583Bits_ReverseBytes( ullWord );
+
+    for( i = 0; i < 8; i ++, ullWord >>= 8 )
+        p[ i ] = ( unsigned char )ullWord;
+}
+
+#endif
@@ -0,0 +1,356 @@
+/***************************************************************************
+* FILE NAME:    ISO8583Codec.HPP                                           *
+* MODULE NAME:  ISO8583Engine                                              *
+* PROGRAMMER:                                                              *
+* DESCRIPTION:  Header-only C++17 codec specialized at compile time from a *
+*               constexpr ISO8583_FieldFormat table. Produces and accepts  *
+*               the same wire format as ISO8583Engine_Iso8583ToHexbuf /   *
+*               ISO8583Engine_HexbufToIso8583 on the same ISO8583_Rec.     *
+* REVISION:                                                                *
+****************************************************************************/
+
+#ifndef _ISO8583CODEC_HPP
+#define _ISO8583CODEC_HPP
+
+#include <cstring>
+#include <type_traits>
+#include <utility>
+
+#include "ISO8583Engine.h"
+#include "ISO8583Bits.h"
+
+namespace iso8583
+{
+
+/* -----------------------------------------------------------------------------
+ * CLASS NAME:      FieldCodec
+ * DESCRIPTION:     Pack/unpack of one field, every format decision (type,
+ *                  length prefix width, fixed length) is resolved from
+ *                  Fmt[ Idx ] when the template is instantiated
+ ---------------------------------------------------------------------------- */
+template < const auto & Fmt, int Idx >
+struct FieldCodec
+{
+    static constexpr unsigned char bType = Fmt[ Idx ].bType;
+    static constexpr int iMaxLength = Fmt[ Idx ].iMaxLength;
+    static constexpr bool bVar = ( bType & ISO8583TYPE_VAR ) != 0;
+    static constexpr bool bPacked = ( bType & ( ISO8583TYPE_BCD | ISO8583TYPE_DIGIT ) ) != 0;
+    static constexpr int iPrefix = bVar ? ( iMaxLength > 99 ? 2 : 1 ) : 0;
+    static constexpr int iFixLen = ( bType & ISO8583TYPE_BIN ) ? iMaxLength / 8 : iMaxLength;
+    static constexpr int iFixWire = bPacked ? ( iFixLen + 1 ) >> 1 : iFixLen;
+
+    //Field data copy. GCC expands a memcpy of bounded or mid-sized constant
+    //length to rep movs and a memcpy of any other length to a libc call, both
+    //cost more than the whole field at the usual lengths. Only a short fixed
+    //field at its full length keeps the plain memcpy.
+    static void CopyData( byte * pDst, const byte * pSrc, int iWire )
+    {
+        if constexpr( !bVar && iFixWire <= 16 )
+        {
+            if( iWire == iFixWire )
+            {
+                memcpy( pDst, pSrc, iFixWire );
+                return;
+            }
+        }
+
+        for( ; iWire >= 8; iWire -= 8, pDst += 8, pSrc += 8 )
+            memcpy( pDst, pSrc, 8 );
+
+        if( iWire & 4 )
+        {
+            memcpy( pDst, pSrc, 4 );
+            pDst += 4;
+            pSrc += 4;
+        }
+
+        if( iWire & 2 )
+        {
+            memcpy( pDst, pSrc, 2 );
+            pDst += 2;
+            pSrc += 2;
+        }
+
+        if( iWire & 1 )
+            *pDst = *pSrc;
+    }
+
+    static int Unpack( ISO8583_Rec * pIso8583Data, const byte *& pRpt, int & iOffSize )
+    {
+        int iLength, iWire;
+
+        if constexpr( bVar )
+        {
+            iLength = ( pRpt[ 0 ] >> 4 ) * 10 + ( pRpt[ 0 ] & 0x0F );
+
+            if constexpr( iPrefix == 2 )
+                iLength = iLength * 100 + ( pRpt[ 1 ] >> 4 ) * 10 + ( pRpt[ 1 ] & 0x0F );
+
+            pRpt += iPrefix;
+
+            if( iLength > iMaxLength )
+                return( -1 );
+
+            iWire = bPacked ? ( iLength + 1 ) >> 1 : iLength;
+        }
+        else
+        {
+            iLength = iFixLen;
+            iWire = iFixWire;
+        }
+
+        //Slow path only: a pooled record grows to a larger block, which
+        //copies the iOffset bytes decoded so far
+        if( iOffSize + iWire >= pIso8583Data->iCapacity )
+        {
+            pIso8583Data->iOffset = iOffSize;
+
+            if( ISO8583Engine_Reserve( pIso8583Data, iOffSize + iWire + 1 ) != ISOENGINE_OK )
+                return( -3 );
+        }
+
+        pIso8583Data->Field[ Idx ].len = ( short )iLength;
+        pIso8583Data->Field[ Idx ].addr = iOffSize;
+        pIso8583Data->Field[ Idx ].bitf = 1;
+        CopyData( &pIso8583Data->cData[ iOffSize ], pRpt, iWire );
+        pRpt += iWire;
+        iOffSize += iWire;
+        return( 0 );
+    }
+
+    static int Pack( const ISO8583_Rec * pIso8583Data, byte *& cpWpt, const byte * pEnd )
+    {
+        int iLength = pIso8583Data->Field[ Idx ].len;
+        int iAddr = pIso8583Data->Field[ Idx ].addr;
+        int iWire = bPacked ? ( iLength + 1 ) >> 1 : iLength;
+
+        if( cpWpt + iPrefix + iWire > pEnd )
+            return( -3 );
+
+        if( iAddr < 0 || iWire < 0 || iAddr + iWire > pIso8583Data->iCapacity )
+            return( -4 );
+
+        if constexpr( iPrefix == 1 )
+        {
+            *cpWpt ++ = ( byte )((( iLength / 10 % 10 ) << 4 ) | ( iLength % 10 ));
+        }
+        else if constexpr( iPrefix == 2 )
+        {
+            *cpWpt ++ = ( byte )((( iLength / 1000 % 10 ) << 4 ) | ( iLength / 100 % 10 ));
+            *cpWpt ++ = ( byte )((( iLength / 10 % 10 ) << 4 ) | ( iLength % 10 ));
+        }
+
+        CopyData( cpWpt, &pIso8583Data->cData[ iAddr ], iWire );
+        cpWpt += iWire;
+        return( 0 );
+    }
+};
+
+/* -----------------------------------------------------------------------------
+ * CLASS NAME:      Codec
+ * DESCRIPTION:     Packer / unpacker for the table Fmt (an array of 64 or 128
+ *                  ISO8583_FieldFormat declared constexpr). The bitmap walk is
+ *                  unrolled into one FieldCodec step per field, so there is
+ *                  no runtime lookup of bType / iMaxLength at all. Mode is the
+ *                  ISO8583_BitMode of the matching ISO8583_Spec, BITMAP64 for
+ *                  64 entries and BITMAP128 or BITMAPAUTO for 128 entries.
+ * USAGE:           static constexpr ISO8583_FieldFormat MyFmt[ 64 ] = {...};
+ *                  using MyCodec = iso8583::Codec< MyFmt >;
+ *                  iLen = MyCodec::Iso8583ToHexbuf( &Rec, Buf, sizeof( Buf ) );
+ ---------------------------------------------------------------------------- */
+template < const auto & Fmt,
+           int Mode = std::extent< std::remove_reference_t< decltype( Fmt ) > >::value == 64 ? ISO8583_BITMAP64 : ISO8583_BITMAP128 >
+class Codec
+{
+    static constexpr int iMaxField = ( int )std::extent< std::remove_reference_t< decltype( Fmt ) > >::value;
+
+    static_assert( iMaxField == 64 || iMaxField == 128, "field format table must have 64 or 128 entries" );
+    static_assert( iMaxField <= ISO8583_MAXFIELD, "field format table larger than ISO8583_Rec.Field" );
+    static_assert(( Mode == ISO8583_BITMAP64 ) == ( iMaxField == 64 ), "bitmap mode does not match the field format table" );
+
+    template < int Idx >
+    static int UnpackStep( ISO8583_Rec * pIso8583Data, const unsigned long long * pullBits, const byte *& pRpt, int & iOffSize )
+    {
+        if( !(( pullBits[ Idx >> 6 ] >> ( Idx & 63 ) ) & 1 ) )
+            return( 0 );
+
+        return FieldCodec< Fmt, Idx >::Unpack( pIso8583Data, pRpt, iOffSize );
+    }
+
+    template < int Idx >
+    static int PackStep( const ISO8583_Rec * pIso8583Data, const unsigned long long * pullBits, byte *& cpWpt, const byte * pEnd )
+    {
+        if( !(( pullBits[ Idx >> 6 ] >> ( Idx & 63 ) ) & 1 ) )
+            return( 0 );
+
+        return FieldCodec< Fmt, Idx >::Pack( pIso8583Data, cpWpt, pEnd );
+    }
+
+    //Bits of the 8 fields from Idx on
+    static unsigned int GroupBits( const unsigned long long * pullBits, int Idx )
+    {
+        return ( unsigned int )( pullBits[ Idx >> 6 ] >> ( Idx & 63 ) ) & 0xFF;
+    }
+
+    template < int iGroup, int... Bit >
+    static int UnpackGroup( ISO8583_Rec * pIso8583Data, const unsigned long long * pullBits, const byte *& pRpt, int & iOffSize, std::integer_sequence< int, Bit... > )
+    {
+        int iRet = 0;
+
+        if( GroupBits( pullBits, iGroup * 8 ) == 0 )
+            return( 0 );
+
+        ( void )(( ( iRet = UnpackStep< iGroup * 8 + Bit >( pIso8583Data, pullBits, pRpt, iOffSize ) ) == 0 ) && ... );
+        return iRet;
+    }
+
+    template < int iGroup, int... Bit >
+    static int PackGroup( const ISO8583_Rec * pIso8583Data, const unsigned long long * pullBits, byte *& cpWpt, const byte * pEnd, std::integer_sequence< int, Bit... > )
+    {
+        int iRet = 0;
+
+        if( GroupBits( pullBits, iGroup * 8 ) == 0 )
+            return( 0 );
+
+        ( void )(( ( iRet = PackStep< iGroup * 8 + Bit >( pIso8583Data, pullBits, cpWpt, pEnd ) ) == 0 ) && ... );
+        return iRet;
+    }
+
+    //The walks go by groups of 8 fields, an empty group costs one test. They
+    //work on local copies of the bitmap, read / write pointer and offset:
+    //the field copy may alias anything reachable through pointers, locals
+    //stay in registers across it. Bit 0 (field 1) is the secondary bitmap
+    //flag, never a data field, and is cleared in the copy.
+    template < int... iGroup >
+    static int UnpackAll( ISO8583_Rec * pIso8583Data, const byte *& pRpt, int & iOffSize, std::integer_sequence< int, iGroup... > )
+    {
+        unsigned long long ulBits[ ISO8583_MAXFIELD / 64 ];
+        const byte * pWalk = pRpt;
+        int iOff = iOffSize, iRet = 0;
+
+        for( int i = 0; i < ISO8583_MAXFIELD / 64; i ++ )
+            ulBits[ i ] = pIso8583Data->ulBitmap[ i ];
+
+        ulBits[ 0 ] &= ~1ULL;
+        ( void )(( ( iRet = UnpackGroup< iGroup >( pIso8583Data, ulBits, pWalk, iOff, std::make_integer_sequence< int, 8 >() ) ) == 0 ) && ... );
+        pRpt = pWalk;
+        iOffSize = iOff;
+        return iRet;
+    }
+
+    template < int... iGroup >
+    static int PackAll( const ISO8583_Rec * pIso8583Data, byte *& cpWpt, const byte * pEnd, std::integer_sequence< int, iGroup... > )
+    {
+        unsigned long long ulBits[ ISO8583_MAXFIELD / 64 ];
+        byte * pWalk = cpWpt;
+        int iRet = 0;
+
+        for( int i = 0; i < ISO8583_MAXFIELD / 64; i ++ )
+            ulBits[ i ] = pIso8583Data->ulBitmap[ i ];
+
+        ulBits[ 0 ] &= ~1ULL;
+        ( void )(( ( iRet = PackGroup< iGroup >( pIso8583Data, ulBits, pWalk, pEnd, std::make_integer_sequence< int, 8 >() ) ) == 0 ) && ... );
+        cpWpt = pWalk;
+        return iRet;
+    }
+
+    //Unpack of a message with iWords bitmap words, the MTI is done
+    template < int iWords >
+    static int UnpackWords( ISO8583_Rec * pIso8583Data, const byte * pBuf )
+    {
+        const byte * pRpt = pBuf + 2 + iWords * 8;
+        int iOffSize = 0, iRet;
+
+        //a secondary bitmap that is not empty needs all 128 Field entries
+        if constexpr( iWords == 2 )
+        {
+            if( ISO8583Bits_LoadWire( pBuf + 10 ) != 0 && pIso8583Data->iMaxField < ISO8583_MAXFIELD
+                && ISO8583Engine_ReserveFields( pIso8583Data, ISO8583_MAXFIELD ) != ISOENGINE_OK )
+                return( -3 );
+        }
+
+        for( int i = 0; i < ISO8583_MAXFIELD / 64; i ++ )
+            pIso8583Data->ulBitmap[ i ] = i < iWords ? ISO8583Bits_LoadWire( pBuf + 2 + i * 8 ) : 0;
+
+        pIso8583Data->ulBitmap[ 0 ] &= ~1ULL;
+
+        iRet = UnpackAll( pIso8583Data, pRpt, iOffSize, std::make_integer_sequence< int, iWords * 8 >() );
+        pIso8583Data->iOffset = iOffSize;
+        return iRet;
+    }
+
+    //Pack of a message with iWords bitmap words
+    template < int iWords >
+    static int PackWords( const ISO8583_Rec * pIso8583Data, byte * pRetBuf, int iSizeRetBuf )
+    {
+        byte * cpWpt = pRetBuf + 2 + iWords * 8;
+        int iRet;
+
+        if( iSizeRetBuf < 2 + iWords * 8 )
+            return( -3 );
+
+        ISO8583Utils_ASC2BCD(( unsigned char * )pIso8583Data->cMsgID, pRetBuf, 4 );
+
+        for( int i = 0; i < iWords; i ++ )
+            ISO8583Bits_StoreWire( pRetBuf + 2 + i * 8, pIso8583Data->ulBitmap[ i ] & ( i ? ~0ULL : ~1ULL ) );
+
+        iRet = PackAll( pIso8583Data, cpWpt, pRetBuf + iSizeRetBuf, std::make_integer_sequence< int, iWords * 8 >() );
+
+        if( iRet != 0 )
+            return iRet;
+
+        if constexpr( iWords == 2 )
+            pRetBuf[ 2 ] |= 0x80;
+
+        return ( int )( cpWpt - pRetBuf );
+    }
+
+public:
+    /* -------------------------------------------------------------------------
+     * FUNCTION NAME:   Codec::HexbufToIso8583
+     * DESCRIPTION:     Same contract as ISO8583Engine_HexbufToIso8583. The
+     *                  BITMAP64 codec never looks at bit 1, the 128 field
+     *                  modes read the secondary bitmap when bit 1 is set.
+     * RETURN:          =0: success,
+     *                  -1: variable field length error
+     *                  -3: iso8583 string total length already > capacity of the record
+     ------------------------------------------------------------------------ */
+    static int HexbufToIso8583( ISO8583_Rec * pIso8583Data, const byte * pBuf )
+    {
+        for( int i = 0; i < ISO8583_MAXFIELD / 64; i ++ )
+        {
+            for( unsigned long long ullBits = pIso8583Data->ulBitmap[ i ]; ullBits; ullBits &= ullBits - 1 )
+                pIso8583Data->Field[ ( i << 6 ) + ISO8583Bits_Ctz64( ullBits ) ].bitf = 0;
+        }
+
+        ISO8583Utils_BCD2ASC(( unsigned char * )pBuf, pIso8583Data->cMsgID, 4 );
+        pIso8583Data->cMsgID[ 4 ] = 0;
+
+        if constexpr( Mode == ISO8583_BITMAP64 )
+            return UnpackWords< 1 >( pIso8583Data, pBuf );
+        else
+            return ( pBuf[ 2 ] & 0x80 ) ? UnpackWords< 2 >( pIso8583Data, pBuf ) : UnpackWords< 1 >( pIso8583Data, pBuf );
+    }
+
+    /* -------------------------------------------------------------------------
+     * FUNCTION NAME:   Codec::Iso8583ToHexbuf
+     * DESCRIPTION:     Same contract as ISO8583Engine_Iso8583ToHexbuf. Only
+     *                  BITMAPAUTO decides on the secondary bitmap at run time.
+     * RETURN:          >0: success, length of pRetBuf used
+     *                  -3: iso8583 string total length already > iSizeRetBuf
+     *                  -4: field data outside of ISO8583_Rec.cData
+     ------------------------------------------------------------------------ */
+    static int Iso8583ToHexbuf( const ISO8583_Rec * pIso8583Data, byte * pRetBuf, int iSizeRetBuf )
+    {
+        if constexpr( Mode == ISO8583_BITMAP64 )
+            return PackWords< 1 >( pIso8583Data, pRetBuf, iSizeRetBuf );
+        else if constexpr( Mode == ISO8583_BITMAP128 )
+            return PackWords< 2 >( pIso8583Data, pRetBuf, iSizeRetBuf );
+        else
+            return pIso8583Data->ulBitmap[ 1 ] != 0 ? PackWords< 2 >( pIso8583Data, pRetBuf, iSizeRetBuf ) : PackWords< 1 >( pIso8583Data, pRetBuf, iSizeRetBuf );
+    }
+};
+
+}
+
+#endif
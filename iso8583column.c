@@ -0,0 +1,571 @@
+/***************************************************************************
+* FILE NAME:    ISO8583Column.C                                            *
+* MODULE NAME:  ISO8583Engine                                              *
+* PROGRAMMER:                                                              *
+* DESCRIPTION:  Columnar sink and column file format, see ISO8583Column.h  *
+* REVISION:                                                                *
+****************************************************************************/
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "ISO8583Engine.h"
+#include "ISO8583Column.h"
+
+//Column sections are written and mapped in host order
+#if defined( __BYTE_ORDER__ ) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#error "the column file format is little endian"
+#endif
+
+#define ISO8583_COLUMN_HEADSIZE     16
+#define ISO8583_COLUMN_DESCSIZE     8
+
+#define ALIGN8( n )     ((( n ) + 7 ) & ~( size_t )7 )
+
+/*-----------------------------------------------------------------------------
+ * Internal functions
+ *-----------------------------------------------------------------------------*/
+
+//Bytes of the validity bitmap of iRows rows
+static size_t ValidSize( int iRows )
+{
+    return ( size_t )(( iRows + 63 ) / 64 ) * 8;
+}
+
+//Bytes of the offset section of a VAR column with iRows rows
+static size_t OffsetSize( int iRows )
+{
+    return ALIGN8(( size_t )( iRows + 1 ) * 4 );
+}
+
+//Bytes of the data section of a column with iRows rows
+static size_t DataSize( const ISO8583_ColumnDef * pDef, int iRows, const unsigned int * pOffset )
+{
+    switch( pDef->iType )
+    {
+    case ISO8583_COL_INT64:
+        return ( size_t )iRows * 8;
+    case ISO8583_COL_FIXED:
+        return ALIGN8(( size_t )iRows * pDef->iWidth );
+    default:
+        return ALIGN8( pOffset[ iRows ] );
+    }
+}
+
+//Numeric value of a field as found in the RAW message, digits packed for
+//BCD fields, ASCII otherwise. Returns 0 for a non digit.
+static int DecodeNumber( const ISO8583_Spec * pSpec, int iFieldNum, const byte * pRpt, int iLength, long long * pllValue )
+{
+    unsigned long long ullValue;
+    int iRet;
+
+    if( iLength <= 0 || iLength > ISO8583_COLUMN_MAXDIGITS )
+        return 0;
+
+    if( pSpec->FldFormat[ iFieldNum ].bType & ( ISO8583TYPE_BCD | ISO8583TYPE_DIGIT ) )
+        iRet = ISO8583Utils_BCD2U64( pRpt, iLength, &ullValue );
+    else
+        iRet = ISO8583Utils_ASC2U64( pRpt, iLength, &ullValue );
+
+    if( iRet != 0 )
+        return 0;
+
+    *pllValue = ( long long )ullValue;
+    return 1;
+}
+
+static void PutLE( byte * p, unsigned long long ullValue, int iBytes )
+{
+    int i;
+
+    for( i = 0; i < iBytes; i ++, ullValue >>= 8 )
+        p[ i ] = ( byte )ullValue;
+}
+
+static unsigned long long GetLE( const byte * p, int iBytes )
+{
+    unsigned long long ullValue = 0;
+
+    while( iBytes -- > 0 )
+        ullValue = ( ullValue << 8 ) | p[ iBytes ];
+
+    return ullValue;
+}
+
+//Write n bytes and zeros up to the next multiple of 8
+static int WritePadded( FILE * fp, const void * p, size_t n )
+{
+    static const byte cZero[ 8 ];
+
+    if( n > 0 && fwrite( p, 1, n, fp ) != n )
+        return -1;
+
+    if(( n & 7 ) != 0 && fwrite( cZero, 1, 8 - ( n & 7 ), fp ) != 8 - ( n & 7 ) )
+        return -1;
+
+    return 0;
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Column_DefaultDef
+ * DESCRIPTION:     Column for a field as its format suggests
+ * PARAMETERS:      pSpec: spec context
+ *                  iFieldNo: field number
+ *                  pDef(out): column definition
+ * RETURN:          ISOENGINE_OK
+ *                  ISOENGINE_INVALID_FIELD_NO: iFieldNo beyond the spec
+ ---------------------------------------------------------------------------- */
+int ISO8583Column_DefaultDef( const ISO8583_Spec * pSpec, int iFieldNo, ISO8583_ColumnDef * pDef )
+{
+    const ISO8583_FieldFormat * pFmt;
+
+    if( iFieldNo < 2 || iFieldNo > pSpec->iMaxField )
+        return ISOENGINE_INVALID_FIELD_NO;
+
+    pFmt = &pSpec->FldFormat[ iFieldNo - 1 ];
+    pDef->iFieldNo = iFieldNo;
+    pDef->iWidth = 0;
+
+    if( pFmt->bType & ISO8583TYPE_VAR )
+        pDef->iType = ISO8583_COL_VAR;
+    else if(( pFmt->bType & ( ISO8583TYPE_BCD | ISO8583TYPE_DIGIT ) ) && pFmt->iMaxLength <= ISO8583_COLUMN_MAXDIGITS )
+        pDef->iType = ISO8583_COL_INT64;
+    else
+        pDef->iType = ISO8583_COL_FIXED;
+
+    return ISOENGINE_OK;
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Column_Init
+ * DESCRIPTION:     Allocate the columns of a column set
+ * PARAMETERS:      pSet(out): column set
+ *                  pSpec: spec context
+ *                  pDefs: column definitions
+ *                  iColumns: number of columns
+ *                  iBlockRows: rows per block
+ * RETURN:          ISOENGINE_OK or <0 error
+ ---------------------------------------------------------------------------- */
+int ISO8583Column_Init( ISO8583_ColumnSet * pSet, const ISO8583_Spec * pSpec, const ISO8583_ColumnDef * pDefs, int iColumns, int iBlockRows )
+{
+    const ISO8583_FieldFormat * pFmt;
+    ISO8583_Column * pCol;
+    size_t nData;
+    int i;
+
+    memset( pSet, 0, sizeof( ISO8583_ColumnSet ) );
+
+    if( iColumns < 1 || iColumns > ISO8583_MAXFIELD || iBlockRows < 1 || iBlockRows > 0x7FFFFFFF / 64 )
+        return ISOENGINE_INVALID_FIELD_LENGTH;
+
+    pSet->pSpec = pSpec;
+    pSet->iBlockRows = iBlockRows;
+
+    for( i = 0; i < iColumns; i ++ )
+    {
+        pCol = &pSet->Column[ i ];
+        pCol->Def = pDefs[ i ];
+
+        if( pCol->Def.iFieldNo < 2 || pCol->Def.iFieldNo > pSpec->iMaxField )
+        {
+            ISO8583Column_Free( pSet );
+            return ISOENGINE_INVALID_FIELD_NO;
+        }
+
+        pFmt = &pSpec->FldFormat[ pCol->Def.iFieldNo - 1 ];
+
+        switch( pCol->Def.iType )
+        {
+        case ISO8583_COL_INT64:
+            pCol->Def.iWidth = 8;
+            nData = ( size_t )iBlockRows * 8;
+            break;
+        case ISO8583_COL_FIXED:
+            if( pCol->Def.iWidth <= 0 )
+                pCol->Def.iWidth = ( pFmt->bType & ISO8583TYPE_BIN ) ? pFmt->iMaxLength / 8 : pFmt->iMaxLength;
+
+            nData = ( size_t )iBlockRows * pCol->Def.iWidth;
+            break;
+        case ISO8583_COL_VAR:
+            pCol->Def.iWidth = 0;
+            pCol->nDataCap = ( size_t )iBlockRows * 16;
+            nData = pCol->nDataCap;
+            pCol->pOffset = ( unsigned int * )calloc(( size_t )iBlockRows + 1, sizeof( unsigned int ) );
+            break;
+        default:
+            ISO8583Column_Free( pSet );
+            return ISOENGINE_INVALID_FIELD_LENGTH;
+        }
+
+        pCol->pValid = ( unsigned long long * )calloc( 1, ValidSize( iBlockRows ) );
+        pCol->pData = ( byte * )malloc( nData > 0 ? nData : 1 );
+        pSet->iColumns = i + 1;
+
+        if( pCol->pValid == NULL || pCol->pData == NULL || ( pCol->Def.iType == ISO8583_COL_VAR && pCol->pOffset == NULL ) )
+        {
+            ISO8583Column_Free( pSet );
+            return ISOENGINE_OVER_MAXLENGTH;
+        }
+
+        if( pCol->Def.iFieldNo > pSet->iMaxFieldNo )
+            pSet->iMaxFieldNo = pCol->Def.iFieldNo;
+    }
+
+    return ISOENGINE_OK;
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Column_Free
+ * DESCRIPTION:     Free the columns of a column set
+ * PARAMETERS:      pSet: column set
+ * RETURN:          None.
+ ---------------------------------------------------------------------------- */
+void ISO8583Column_Free( ISO8583_ColumnSet * pSet )
+{
+    int i;
+
+    for( i = 0; i < pSet->iColumns; i ++ )
+    {
+        free( pSet->Column[ i ].pValid );
+        free( pSet->Column[ i ].pData );
+        free( pSet->Column[ i ].pOffset );
+    }
+
+    memset( pSet, 0, sizeof( ISO8583_ColumnSet ) );
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Column_Reset
+ * DESCRIPTION:     Drop the rows of the current block
+ * PARAMETERS:      pSet: column set
+ * RETURN:          None.
+ ---------------------------------------------------------------------------- */
+void ISO8583Column_Reset( ISO8583_ColumnSet * pSet )
+{
+    pSet->iRows = 0;
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Column_AddView
+ * DESCRIPTION:     Add one message as a row
+ * PARAMETERS:      pSet: column set
+ *                  pView: view of the message
+ * RETURN:          >0: rows in the block
+ *                  <0: error, no row added
+ ---------------------------------------------------------------------------- */
+int ISO8583Column_AddView( ISO8583_ColumnSet * pSet, ISO8583_View * pView )
+{
+    const ISO8583_Spec * pSpec = pSet->pSpec;
+    int iRow = pSet->iRows;
+    unsigned long long ullBit = 1ULL << ( iRow & 63 );
+    ISO8583_Column * pCol;
+    const byte * pRpt;
+    long long llValue;
+    int i, iLength, iCopy, bValid;
+    byte * pNew;
+    size_t nCap;
+
+    if( iRow >= pSet->iBlockRows )
+        return ISOENGINE_OVER_MAXLENGTH;
+
+    //Resolve every column field first, so a bad message fails before any
+    //column is touched. The highest column field alone is not enough: when
+    //it is absent nothing below it is resolved.
+    for( i = 0; i < pSet->iColumns; i ++ )
+    {
+        if(( iLength = ISO8583Engine_ViewFieldPtr( pSpec, pView, pSet->Column[ i ].Def.iFieldNo, &pRpt ) ) < 0 )
+            return iLength;
+    }
+
+    for( i = 0; i < pSet->iColumns; i ++ )
+    {
+        pCol = &pSet->Column[ i ];
+        iLength = ISO8583Engine_ViewFieldPtr( pSpec, pView, pCol->Def.iFieldNo, &pRpt );
+        bValid = iLength > 0;
+
+        switch( pCol->Def.iType )
+        {
+        case ISO8583_COL_INT64:
+            llValue = 0;
+
+            if( bValid && !DecodeNumber( pSpec, pCol->Def.iFieldNo - 1, pRpt, iLength, &llValue ) )
+            {
+                pCol->iInvalid ++;
+                bValid = 0;
+            }
+
+            (( long long * )pCol->pData )[ iRow ] = llValue;
+            break;
+
+        case ISO8583_COL_FIXED:
+            iCopy = bValid ? ( iLength < pCol->Def.iWidth ? iLength : pCol->Def.iWidth ) : 0;
+
+            if( iCopy > 0 && ( pSpec->FldFormat[ pCol->Def.iFieldNo - 1 ].bType & ( ISO8583TYPE_BCD | ISO8583TYPE_DIGIT ) ) )
+                ISO8583Utils_BCD2ASC(( byte * )pRpt, pCol->pData + ( size_t )iRow * pCol->Def.iWidth, iCopy );
+            else if( iCopy > 0 )
+                memcpy( pCol->pData + ( size_t )iRow * pCol->Def.iWidth, pRpt, iCopy );
+
+            memset( pCol->pData + ( size_t )iRow * pCol->Def.iWidth + iCopy, 0, pCol->Def.iWidth - iCopy );
+            break;
+
+        default:
+            iCopy = bValid ? iLength : 0;
+
+            if( pCol->pOffset[ iRow ] + ( size_t )iCopy > pCol->nDataCap )
+            {
+                for( nCap = pCol->nDataCap * 2; nCap < pCol->pOffset[ iRow ] + ( size_t )iCopy; nCap *= 2 )
+                    ;
+
+                if( nCap > 0xFFFFFFFFU || ( pNew = ( byte * )realloc( pCol->pData, nCap ) ) == NULL )
+                    return ISOENGINE_OVER_MAXLENGTH;
+
+                pCol->pData = pNew;
+                pCol->nDataCap = nCap;
+            }
+
+            if( iCopy > 0 && ( pSpec->FldFormat[ pCol->Def.iFieldNo - 1 ].bType & ( ISO8583TYPE_BCD | ISO8583TYPE_DIGIT ) ) )
+                ISO8583Utils_BCD2ASC(( byte * )pRpt, pCol->pData + pCol->pOffset[ iRow ], iCopy );
+            else if( iCopy > 0 )
+                memcpy( pCol->pData + pCol->pOffset[ iRow ], pRpt, iCopy );
+
+            pCol->pOffset[ iRow + 1 ] = pCol->pOffset[ iRow ] + iCopy;
+            break;
+        }
+
+        if( bValid )
+            pCol->pValid[ iRow >> 6 ] |= ullBit;
+        else
+            pCol->pValid[ iRow >> 6 ] &= ~ullBit;
+    }
+
+    return ++ pSet->iRows;
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Column_AddMessage
+ * DESCRIPTION:     ISO8583Column_AddView of a RAW message
+ * PARAMETERS:      pSet: column set
+ *                  pBuf: RAW iso8583 message
+ *                  nLength: bytes in pBuf
+ * RETURN:          As for ISO8583Column_AddView
+ ---------------------------------------------------------------------------- */
+int ISO8583Column_AddMessage( ISO8583_ColumnSet * pSet, const byte * pBuf, size_t nLength )
+{
+    ISO8583_View View;
+    int iRet;
+
+    iRet = ISO8583Engine_OpenView( pSet->pSpec, &View, pBuf, nLength );
+
+    if( iRet != ISOENGINE_OK )
+        return iRet;
+
+    return ISO8583Column_AddView( pSet, &View );
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Column_WriteHeader
+ * DESCRIPTION:     Write the file header of a column file
+ * PARAMETERS:      pSet: column set
+ *                  fp: output file
+ * RETURN:          ISOENGINE_OK, -1: write error
+ ---------------------------------------------------------------------------- */
+int ISO8583Column_WriteHeader( const ISO8583_ColumnSet * pSet, FILE * fp )
+{
+    byte cHead[ ISO8583_COLUMN_HEADSIZE + ISO8583_MAXFIELD * ISO8583_COLUMN_DESCSIZE ];
+    byte * pDesc;
+    int i;
+
+    memset( cHead, 0, sizeof( cHead ) );
+    memcpy( cHead, ISO8583_COLUMN_MAGIC, 8 );
+    PutLE( cHead + 8, ISO8583_COLUMN_VERSION, 4 );
+    PutLE( cHead + 12, pSet->iColumns, 4 );
+
+    for( i = 0; i < pSet->iColumns; i ++ )
+    {
+        pDesc = cHead + ISO8583_COLUMN_HEADSIZE + i * ISO8583_COLUMN_DESCSIZE;
+        PutLE( pDesc, pSet->Column[ i ].Def.iFieldNo, 2 );
+        pDesc[ 2 ] = ( byte )pSet->Column[ i ].Def.iType;
+        PutLE( pDesc + 4, pSet->Column[ i ].Def.iWidth, 4 );
+    }
+
+    return WritePadded( fp, cHead, ISO8583_COLUMN_HEADSIZE + pSet->iColumns * ISO8583_COLUMN_DESCSIZE );
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Column_WriteBlock
+ * DESCRIPTION:     Write the rows added so far as one block
+ * PARAMETERS:      pSet: column set
+ *                  fp: output file
+ * RETURN:          ISOENGINE_OK, -1: write error
+ ---------------------------------------------------------------------------- */
+int ISO8583Column_WriteBlock( ISO8583_ColumnSet * pSet, FILE * fp )
+{
+    const ISO8583_Column * pCol;
+    byte cHead[ ISO8583_COLUMN_HEADSIZE ];
+    int i, iRows = pSet->iRows;
+    size_t nBody = 0;
+
+    if( iRows == 0 )
+        return ISOENGINE_OK;
+
+    for( i = 0; i < pSet->iColumns; i ++ )
+    {
+        pCol = &pSet->Column[ i ];
+        nBody += ValidSize( iRows ) + DataSize( &pCol->Def, iRows, pCol->pOffset );
+
+        if( pCol->Def.iType == ISO8583_COL_VAR )
+            nBody += OffsetSize( iRows );
+    }
+
+    memset( cHead, 0, sizeof( cHead ) );
+    PutLE( cHead, iRows, 4 );
+    PutLE( cHead + 8, nBody, 8 );
+
+    if( WritePadded( fp, cHead, sizeof( cHead ) ) != 0 )
+        return -1;
+
+    for( i = 0; i < pSet->iColumns; i ++ )
+    {
+        pCol = &pSet->Column[ i ];
+
+        //Bits past the last row of the last word are not defined
+        if( iRows & 63 )
+            pCol->pValid[ iRows >> 6 ] &= ( 1ULL << ( iRows & 63 ) ) - 1;
+
+        if( WritePadded( fp, pCol->pValid, ValidSize( iRows ) ) != 0 )
+            return -1;
+
+        switch( pCol->Def.iType )
+        {
+        case ISO8583_COL_INT64:
+            if( WritePadded( fp, pCol->pData, ( size_t )iRows * 8 ) != 0 )
+                return -1;
+            break;
+        case ISO8583_COL_FIXED:
+            if( WritePadded( fp, pCol->pData, ( size_t )iRows * pCol->Def.iWidth ) != 0 )
+                return -1;
+            break;
+        default:
+            if( WritePadded( fp, pCol->pOffset, ( size_t )( iRows + 1 ) * 4 ) != 0
+                || WritePadded( fp, pCol->pData, pCol->pOffset[ iRows ] ) != 0 )
+                return -1;
+            break;
+        }
+    }
+
+    ISO8583Column_Reset( pSet );
+    return ISOENGINE_OK;
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Column_ReadHeader
+ * DESCRIPTION:     Read the file header of a mapped column file
+ * PARAMETERS:      pFile: start of the file
+ *                  nLength: bytes of the file
+ *                  pDefs(out): column definitions
+ *                  iMaxDefs: entries of pDefs
+ *                  pnPos(out): offset of the first block
+ * RETURN:          >0: number of columns, <0 error
+ ---------------------------------------------------------------------------- */
+int ISO8583Column_ReadHeader( const byte * pFile, size_t nLength, ISO8583_ColumnDef * pDefs, int iMaxDefs, size_t * pnPos )
+{
+    const byte * pDesc;
+    int i, iColumns;
+
+    if( nLength < ISO8583_COLUMN_HEADSIZE || memcmp( pFile, ISO8583_COLUMN_MAGIC, 8 ) != 0
+        || GetLE( pFile + 8, 4 ) != ISO8583_COLUMN_VERSION )
+        return ISOENGINE_INVALID_FIELD_DATA;
+
+    iColumns = ( int )GetLE( pFile + 12, 4 );
+
+    if( iColumns < 1 || iColumns > ISO8583_MAXFIELD
+        || nLength < ISO8583_COLUMN_HEADSIZE + ( size_t )iColumns * ISO8583_COLUMN_DESCSIZE )
+        return ISOENGINE_INVALID_FIELD_DATA;
+
+    if( iColumns > iMaxDefs )
+        return ISOENGINE_TOO_SMALL_FIELD_BUF_SIZE;
+
+    for( i = 0; i < iColumns; i ++ )
+    {
+        pDesc = pFile + ISO8583_COLUMN_HEADSIZE + i * ISO8583_COLUMN_DESCSIZE;
+        pDefs[ i ].iFieldNo = ( int )GetLE( pDesc, 2 );
+        pDefs[ i ].iType = pDesc[ 2 ];
+        pDefs[ i ].iWidth = ( int )GetLE( pDesc + 4, 4 );
+
+        if( pDefs[ i ].iType < ISO8583_COL_INT64 || pDefs[ i ].iType > ISO8583_COL_VAR || pDefs[ i ].iWidth < 0 )
+            return ISOENGINE_INVALID_FIELD_DATA;
+    }
+
+    *pnPos = ISO8583_COLUMN_HEADSIZE + ( size_t )iColumns * ISO8583_COLUMN_DESCSIZE;
+    return iColumns;
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Column_MapBlock
+ * DESCRIPTION:     Locate the columns of the block at *pnPos in place
+ * PARAMETERS:      pFile: start of the file
+ *                  nLength: bytes of the file
+ *                  pnPos(in/out): block offset
+ *                  pDefs: column definitions
+ *                  iColumns: number of columns
+ *                  pMaps(out): columns
+ * RETURN:          >0: rows in the block, 0: end of the file, <0 error
+ ---------------------------------------------------------------------------- */
+int ISO8583Column_MapBlock( const byte * pFile, size_t nLength, size_t * pnPos, const ISO8583_ColumnDef * pDefs, int iColumns, ISO8583_ColumnMap * pMaps )
+{
+    const byte * pRpt;
+    const byte * pEnd;
+    unsigned long long ullBody;
+    int i, iRows;
+
+    if( *pnPos >= nLength )
+        return 0;
+
+    if( nLength - *pnPos < ISO8583_COLUMN_HEADSIZE )
+        return ISOENGINE_TRUNCATED_MSG;
+
+    pRpt = pFile + *pnPos;
+    iRows = ( int )GetLE( pRpt, 4 );
+    ullBody = GetLE( pRpt + 8, 8 );
+
+    if( ullBody > nLength - *pnPos - ISO8583_COLUMN_HEADSIZE )
+        return ISOENGINE_TRUNCATED_MSG;
+
+    if( iRows <= 0 )
+        return ISOENGINE_INVALID_FIELD_DATA;
+
+    pRpt += ISO8583_COLUMN_HEADSIZE;
+    pEnd = pRpt + ullBody;
+
+    for( i = 0; i < iColumns; i ++ )
+    {
+        if(( size_t )( pEnd - pRpt ) < ValidSize( iRows ) )
+            return ISOENGINE_INVALID_FIELD_DATA;
+
+        pMaps[ i ].pValid = ( const unsigned long long * )pRpt;
+        pRpt += ValidSize( iRows );
+        pMaps[ i ].pOffset = NULL;
+
+        if( pDefs[ i ].iType == ISO8583_COL_VAR )
+        {
+            if(( size_t )( pEnd - pRpt ) < OffsetSize( iRows ) )
+                return ISOENGINE_INVALID_FIELD_DATA;
+
+            pMaps[ i ].pOffset = ( const unsigned int * )pRpt;
+            pRpt += OffsetSize( iRows );
+        }
+
+        if(( size_t )( pEnd - pRpt ) < DataSize( &pDefs[ i ], iRows, pMaps[ i ].pOffset ) )
+            return ISOENGINE_INVALID_FIELD_DATA;
+
+        pMaps[ i ].pData = pRpt;
+        pRpt += DataSize( &pDefs[ i ], iRows, pMaps[ i ].pOffset );
+    }
+
+    if( pRpt != pEnd )
+        return ISOENGINE_INVALID_FIELD_DATA;
+
+    *pnPos = ( size_t )( pEnd - pFile );
+    return iRows;
+}
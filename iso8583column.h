@@ -0,0 +1,227 @@
+/***************************************************************************
+* FILE NAME:    ISO8583Column.H                                            *
+* MODULE NAME:  ISO8583Engine                                              *
+* PROGRAMMER:                                                              *
+* DESCRIPTION:  Columnar sink for decoded messages. Each chosen field gets *
+*               one column, messages are added as rows: the field data is  *
+*               read from the RAW message through an ISO8583_View and      *
+*               written straight to its column, numeric BCD fields as      *
+*               64 bit integers. A validity bitmap per column follows the  *
+*               message bitmap. Full blocks of rows are written to a file  *
+*               in the format below and can be mapped back without         *
+*               decoding anything.                                         *
+*                                                                          *
+*               FILE FORMAT (integers little endian, every section starts  *
+*               on an 8 byte boundary of the file)                         *
+*               File header, 16 + 8 * C bytes:                             *
+*                 0   char[8]   "ISO8583C"                                 *
+*                 8   uint32    version, ISO8583_COLUMN_VERSION            *
+*                 12  uint32    C, number of columns                       *
+*                 16  C column descriptors of 8 bytes:                     *
+*                     uint16 field number, uint8 ISO8583_ColType,          *
+*                     uint8 0, uint32 width (FIXED bytes, INT64 8, VAR 0)  *
+*               Blocks until the end of the file, 16 bytes of header:      *
+*                 0   uint32    R, rows in the block                       *
+*                 4   uint32    0                                          *
+*                 8   uint64    bytes of block body that follow            *
+*               Block body, for each column in descriptor order:           *
+*                 validity: ( R + 63 ) / 64 uint64 words, row r is valid   *
+*                           when bit r % 64 of word r / 64 is set          *
+*                 INT64:    R int64, 0 for rows not valid                  *
+*                 FIXED:    R * width bytes, BCD fields as ASCII digits,   *
+*                           shorter values padded with 0 bytes, the        *
+*                           section padded with 0 bytes to 8               *
+*                 VAR:      R + 1 uint32 offsets into the data, padded     *
+*                           with 0 bytes to 8, then offset[ R ] bytes of   *
+*                           data padded with 0 bytes to 8                  *
+* REVISION:                                                                *
+****************************************************************************/
+
+#ifndef _ISO8583COLUMN_H
+#define _ISO8583COLUMN_H
+
+#include <stdio.h>
+
+#include "ISO8583Engine.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ISO8583_COLUMN_MAGIC        "ISO8583C"
+#define ISO8583_COLUMN_VERSION      1
+
+//Most digits of a field kept in an ISO8583_COL_INT64 column
+#define ISO8583_COLUMN_MAXDIGITS    18
+
+//Column types
+//ISO8583_COL_INT64:    numeric field as int64, rows with a non digit are not valid
+//ISO8583_COL_FIXED:    iWidth bytes per row, BCD fields as ASCII digits
+//ISO8583_COL_VAR:      variable length bytes with an offset per row
+typedef enum
+{
+    ISO8583_COL_INT64 = 1,
+    ISO8583_COL_FIXED,
+    ISO8583_COL_VAR,
+} ISO8583_ColType;
+
+//One column to fill
+typedef struct
+{
+    int iFieldNo;           //field 2 - 128
+    int iType;              //ISO8583_ColType
+    int iWidth;             //ISO8583_COL_FIXED bytes per row, 0 for the field length
+} ISO8583_ColumnDef;
+
+//Column data of the rows added since the last block was written
+typedef struct
+{
+    ISO8583_ColumnDef Def;
+    unsigned long long * pValid;    //validity bitmap
+    byte * pData;                   //INT64 long long[ rows ], FIXED rows * iWidth, VAR bytes
+    unsigned int * pOffset;         //VAR: rows + 1 offsets into pData
+    size_t nDataCap;                //VAR: bytes allocated at pData
+    int iInvalid;                   //rows with the field present but not numeric (INT64)
+} ISO8583_Column;
+
+//Column set, filled by ISO8583Column_AddView
+typedef struct
+{
+    const ISO8583_Spec * pSpec;
+    int iColumns;
+    int iBlockRows;         //rows per block
+    int iRows;              //rows added to the current block
+    int iMaxFieldNo;        //highest field of any column
+    ISO8583_Column Column[ ISO8583_MAXFIELD ];
+} ISO8583_ColumnSet;
+
+//Column of a block mapped from a column file
+typedef struct
+{
+    const unsigned long long * pValid;
+    const void * pData;
+    const unsigned int * pOffset;
+} ISO8583_ColumnMap;
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Column_DefaultDef
+ * DESCRIPTION:     Column for a field as its format suggests: VAR fields as
+ *                  ISO8583_COL_VAR, fixed numeric fields of at most
+ *                  ISO8583_COLUMN_MAXDIGITS digits as ISO8583_COL_INT64,
+ *                  others as ISO8583_COL_FIXED of the field length
+ * PARAMETERS:      pSpec: spec context
+ *                  iFieldNo: field 2 - iMaxField
+ *                  pDef(out): column definition
+ * RETURN:          ISOENGINE_OK
+ *                  ISOENGINE_INVALID_FIELD_NO: iFieldNo beyond the spec
+ ---------------------------------------------------------------------------- */
+int ISO8583Column_DefaultDef( const ISO8583_Spec * pSpec, int iFieldNo, ISO8583_ColumnDef * pDef );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Column_Init
+ * DESCRIPTION:     Allocate the columns of a column set
+ * PARAMETERS:      pSet(out): column set, ISO8583Column_Free when done
+ *                  pSpec: spec context, must outlive pSet
+ *                  pDefs: iColumns column definitions
+ *                  iColumns: 1 - ISO8583_MAXFIELD
+ *                  iBlockRows: rows per block
+ * RETURN:          ISOENGINE_OK
+ *                  ISOENGINE_INVALID_FIELD_NO: column of a field beyond the spec
+ *                  ISOENGINE_INVALID_FIELD_LENGTH: bad type, width or counts
+ *                  ISOENGINE_OVER_MAXLENGTH: out of memory
+ ---------------------------------------------------------------------------- */
+int ISO8583Column_Init( ISO8583_ColumnSet * pSet, const ISO8583_Spec * pSpec, const ISO8583_ColumnDef * pDefs, int iColumns, int iBlockRows );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Column_Free
+ * DESCRIPTION:     Free the columns of a column set
+ * PARAMETERS:      pSet: column set
+ * RETURN:          None.
+ ---------------------------------------------------------------------------- */
+void ISO8583Column_Free( ISO8583_ColumnSet * pSet );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Column_Reset
+ * DESCRIPTION:     Drop the rows of the current block without writing them
+ * PARAMETERS:      pSet: column set
+ * RETURN:          None.
+ ---------------------------------------------------------------------------- */
+void ISO8583Column_Reset( ISO8583_ColumnSet * pSet );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Column_AddView
+ * DESCRIPTION:     Add one message as a row, fields are read from the viewed
+ *                  buffer straight into their columns
+ * PARAMETERS:      pSet: column set
+ *                  pView: view opened with the spec of pSet
+ * RETURN:          >0: rows in the block, iBlockRows when it is full
+ *                  ISOENGINE_OVER_MAXLENGTH: block already full or out of memory
+ *                  other <0: message error, see ISO8583Engine_ParseView,
+ *                  no row is added
+ ---------------------------------------------------------------------------- */
+int ISO8583Column_AddView( ISO8583_ColumnSet * pSet, ISO8583_View * pView );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Column_AddMessage
+ * DESCRIPTION:     ISO8583Column_AddView of a RAW message
+ * PARAMETERS:      pSet: column set
+ *                  pBuf: RAW iso8583 message
+ *                  nLength: bytes in pBuf
+ * RETURN:          As for ISO8583Column_AddView
+ ---------------------------------------------------------------------------- */
+int ISO8583Column_AddMessage( ISO8583_ColumnSet * pSet, const byte * pBuf, size_t nLength );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Column_WriteHeader
+ * DESCRIPTION:     Write the file header of a column file
+ * PARAMETERS:      pSet: column set
+ *                  fp: output file, at offset 0
+ * RETURN:          ISOENGINE_OK, -1: write error
+ ---------------------------------------------------------------------------- */
+int ISO8583Column_WriteHeader( const ISO8583_ColumnSet * pSet, FILE * fp );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Column_WriteBlock
+ * DESCRIPTION:     Write the rows added so far as one block and start a new
+ *                  block, nothing is written when there are no rows
+ * PARAMETERS:      pSet: column set
+ *                  fp: output file after the header or the previous block
+ * RETURN:          ISOENGINE_OK, -1: write error
+ ---------------------------------------------------------------------------- */
+int ISO8583Column_WriteBlock( ISO8583_ColumnSet * pSet, FILE * fp );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Column_ReadHeader
+ * DESCRIPTION:     Read the file header of a mapped column file
+ * PARAMETERS:      pFile: start of the file, 8 byte aligned
+ *                  nLength: bytes of the file
+ *                  pDefs(out): column definitions
+ *                  iMaxDefs: entries of pDefs
+ *                  pnPos(out): offset of the first block
+ * RETURN:          >0: number of columns
+ *                  ISOENGINE_INVALID_FIELD_DATA: not a column file
+ *                  ISOENGINE_TOO_SMALL_FIELD_BUF_SIZE: more columns than iMaxDefs
+ ---------------------------------------------------------------------------- */
+int ISO8583Column_ReadHeader( const byte * pFile, size_t nLength, ISO8583_ColumnDef * pDefs, int iMaxDefs, size_t * pnPos );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Column_MapBlock
+ * DESCRIPTION:     Locate the columns of the block at *pnPos in place
+ * PARAMETERS:      pFile: start of the file, 8 byte aligned
+ *                  nLength: bytes of the file
+ *                  pnPos(in/out): block offset, moved to the next block
+ *                  pDefs: iColumns column definitions from the header
+ *                  iColumns: number of columns
+ *                  pMaps(out): iColumns columns
+ * RETURN:          >0: rows in the block
+ *                  0: end of the file
+ *                  ISOENGINE_TRUNCATED_MSG: file ends inside the block
+ *                  ISOENGINE_INVALID_FIELD_DATA: block does not match the header
+ ---------------------------------------------------------------------------- */
+int ISO8583Column_MapBlock( const byte * pFile, size_t nLength, size_t * pnPos, const ISO8583_ColumnDef * pDefs, int iColumns, ISO8583_ColumnMap * pMaps );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,637 @@
+/***************************************************************************
+* FILE NAME:    ISO8583Correlate.C                                         *
+* MODULE NAME:  ISO8583Engine                                              *
+* PROGRAMMER:                                                              *
+* DESCRIPTION:  Request / response correlation, see ISO8583Correlate.h     *
+* REVISION:                                                                *
+****************************************************************************/
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+
+#include "ISO8583Engine.h"
+#include "ISO8583Bits.h"
+#include "ISO8583Correlate.h"
+
+//Slot state, low bits of Entry.ullState, the rest is a generation bumped on
+//every reuse so a stale compare-and-swap on a reused slot fails
+enum
+{
+    CORR_EMPTY = 0,         // never used, ends a probe
+    CORR_BUSY,              // taken by an insert, key being written
+    CORR_LIVE,              // in flight
+    CORR_MATCHED,           // matched, slot released by the next Advance
+    CORR_EXPIRED,           // timed out, being called back
+    CORR_FREE,              // released, reused by inserts, does not end a probe
+};
+
+#define CORR_STATEBITS      3
+#define CORR_STATEMASK      (( 1ULL << CORR_STATEBITS ) - 1 )
+#define CORR_GENERATION     ( 1ULL << CORR_STATEBITS )
+#define CORR_NIL            0xFFFFFFFFU
+
+//Where an entry stands with the wheel, owned by the Advance thread
+enum
+{
+    CORR_UNSEEN = 0,        // still on the intake stack
+    CORR_WHEEL,             // in a wheel bucket
+    CORR_POPPED,            // taken from its bucket at expiry, found matched
+    CORR_RETIRED,           // matched before the intake stack was drained
+};
+
+//One slot. The key and ullState are read by any thread, the other members
+//are written by the inserting thread while the slot is CORR_BUSY or by the
+//Advance thread.
+typedef struct
+{
+    atomic_ullong ullState;
+    atomic_ullong ullKey[ 2 ];
+    void * pUser;
+    unsigned long long ullDeadline;
+    unsigned int uiIntakeNext;      // intake stack, pushed by Insert
+    unsigned int uiRetireNext;      // retire stack, pushed by Match
+    unsigned int uiPrev;            // wheel bucket list
+    unsigned int uiNext;
+    unsigned short usBucket;
+    unsigned char cWheel;
+} CorrEntry;
+
+struct ISO8583_CorrTable
+{
+    CorrEntry * pEntries;
+    unsigned int uiMask;
+    int iMaxEntries;
+    ISO8583_CorrExpired pfnExpired;
+    void * pContext;
+    ISO8583_CACHELINE atomic_int iUsed;             // slots neither empty nor free
+    atomic_int iMaxProbe;                           // longest probe of any insert
+    ISO8583_CACHELINE atomic_uint uiIntake;         // stacks of entry indexes
+    ISO8583_CACHELINE atomic_uint uiRetire;
+    ISO8583_CACHELINE atomic_ullong ullNow;         // wheel time, read by inserts
+    int iInWheel;
+    unsigned int uiBuckets[ ISO8583_CORR_LEVELS * ISO8583_CORR_SLOTS ];
+};
+
+/*-----------------------------------------------------------------------------
+ * Internal functions
+ *-----------------------------------------------------------------------------*/
+
+//Wire bytes of a field from its ISO8583_ElementFlag.len
+static int WireBytes( const ISO8583_Spec * pSpec, int iFieldNum, int iLength )
+{
+    const ISO8583_FieldOp * pOp = &pSpec->Op[ iFieldNum ];
+
+    if( pOp->bPrefix == 0 )
+        return pOp->usWire;
+
+    return pOp->bPacked ? ( iLength + 1 ) >> 1 : iLength;
+}
+
+//Key of the wire bytes of fields 41, 11 and 7: the bytes themselves when they
+//fit, else two 64 bit FNV-1a lanes over bytes and lengths
+static void BuildKey( const byte * const * ppData, const int * piBytes, ISO8583_CorrKey * pKey )
+{
+    unsigned char cKey[ sizeof( ISO8583_CorrKey ) ];
+    unsigned long long ullLo = 0xCBF29CE484222325ULL, ullHi = 0x84222325CBF29CE4ULL;
+    int i, j, iTotal = piBytes[ 0 ] + piBytes[ 1 ] + piBytes[ 2 ];
+
+    if( iTotal <= ( int )sizeof( cKey ) )
+    {
+        memset( cKey, 0, sizeof( cKey ) );
+
+        for( iTotal = 0, i = 0; i < 3; i ++ )
+        {
+            memcpy( cKey + iTotal, ppData[ i ], piBytes[ i ] );
+            iTotal += piBytes[ i ];
+        }
+
+        memcpy( pKey->ullKey, cKey, sizeof( cKey ) );
+        return;
+    }
+
+    for( i = 0; i < 3; i ++ )
+    {
+        for( j = 0; j < piBytes[ i ]; j ++ )
+        {
+            ullLo = ( ullLo ^ ppData[ i ][ j ] ) * 0x100000001B3ULL;
+            ullHi = ( ullHi ^ ppData[ i ][ j ] ^ ( ullLo >> 56 ) ) * 0x9E3779B97F4A7C15ULL;
+        }
+
+        ullLo = ( ullLo ^ ( unsigned int )piBytes[ i ] ) * 0x100000001B3ULL;
+    }
+
+    pKey->ullKey[ 0 ] = ullLo;
+    pKey->ullKey[ 1 ] = ullHi;
+}
+
+//Home slot of a key
+static unsigned int HashKey( const ISO8583_CorrKey * pKey, unsigned int uiMask )
+{
+    unsigned long long h = ( pKey->ullKey[ 0 ] ^ ( pKey->ullKey[ 1 ] * 0x9E3779B97F4A7C15ULL ) ) * 0xFF51AFD7ED558CCDULL;
+
+    return ( unsigned int )( h ^ ( h >> 32 ) ) & uiMask;
+}
+
+static int KeyEquals( CorrEntry * pEntry, const ISO8583_CorrKey * pKey )
+{
+    return atomic_load_explicit( &pEntry->ullKey[ 0 ], memory_order_relaxed ) == pKey->ullKey[ 0 ]
+        && atomic_load_explicit( &pEntry->ullKey[ 1 ], memory_order_relaxed ) == pKey->ullKey[ 1 ];
+}
+
+//Treiber stack push, the Advance thread takes the whole stack at once so
+//there is no ABA
+static void Push( atomic_uint * puiHead, unsigned int * puiNext, unsigned int uiIndex )
+{
+    unsigned int uiHead = atomic_load_explicit( puiHead, memory_order_relaxed );
+
+    do
+        *puiNext = uiHead;
+    while( !atomic_compare_exchange_weak_explicit( puiHead, &uiHead, uiIndex, memory_order_release, memory_order_relaxed ) );
+}
+
+//Give a slot back to the inserts
+static void Release( ISO8583_CorrTable * pTable, CorrEntry * pEntry )
+{
+    unsigned long long ullState = atomic_load_explicit( &pEntry->ullState, memory_order_relaxed );
+
+    pEntry->cWheel = CORR_UNSEEN;
+    atomic_store_explicit( &pEntry->ullState, ( ullState & ~CORR_STATEMASK ) | CORR_FREE, memory_order_release );
+    atomic_fetch_sub_explicit( &pTable->iUsed, 1, memory_order_relaxed );
+}
+
+//Put an entry in the bucket of its deadline, not before tick ullMin
+static void WheelAdd( ISO8583_CorrTable * pTable, unsigned int uiIndex, unsigned long long ullMin )
+{
+    CorrEntry * pEntry = &pTable->pEntries[ uiIndex ];
+    unsigned long long ullNow = atomic_load_explicit( &pTable->ullNow, memory_order_relaxed );
+    unsigned long long ullDue = pEntry->ullDeadline < ullMin ? ullMin : pEntry->ullDeadline;
+    unsigned long long ullDelta = ullDue - ullNow;
+    int iLevel = 0, iBucket;
+
+    while( iLevel < ISO8583_CORR_LEVELS - 1 && ullDelta >= ( 1ULL << ( ISO8583_CORR_SLOTBITS * ( iLevel + 1 ) ) ) )
+        iLevel ++;
+
+    iBucket = iLevel * ISO8583_CORR_SLOTS + ( int )(( ullDue >> ( ISO8583_CORR_SLOTBITS * iLevel ) ) & ( ISO8583_CORR_SLOTS - 1 ) );
+
+    pEntry->usBucket = ( unsigned short )iBucket;
+    pEntry->uiPrev = CORR_NIL;
+    pEntry->uiNext = pTable->uiBuckets[ iBucket ];
+
+    if( pEntry->uiNext != CORR_NIL )
+        pTable->pEntries[ pEntry->uiNext ].uiPrev = uiIndex;
+
+    pTable->uiBuckets[ iBucket ] = uiIndex;
+    pEntry->cWheel = CORR_WHEEL;
+    pTable->iInWheel ++;
+}
+
+static void WheelRemove( ISO8583_CorrTable * pTable, unsigned int uiIndex )
+{
+    CorrEntry * pEntry = &pTable->pEntries[ uiIndex ];
+
+    if( pEntry->uiPrev != CORR_NIL )
+        pTable->pEntries[ pEntry->uiPrev ].uiNext = pEntry->uiNext;
+    else
+        pTable->uiBuckets[ pEntry->usBucket ] = pEntry->uiNext;
+
+    if( pEntry->uiNext != CORR_NIL )
+        pTable->pEntries[ pEntry->uiNext ].uiPrev = pEntry->uiPrev;
+
+    pTable->iInWheel --;
+}
+
+//Take the list of a bucket, its entries leave the wheel
+static unsigned int WheelTake( ISO8583_CorrTable * pTable, int iBucket )
+{
+    unsigned int uiIndex, uiList = pTable->uiBuckets[ iBucket ];
+
+    pTable->uiBuckets[ iBucket ] = CORR_NIL;
+
+    for( uiIndex = uiList; uiIndex != CORR_NIL; uiIndex = pTable->pEntries[ uiIndex ].uiNext )
+        pTable->iInWheel --;
+
+    return uiList;
+}
+
+//Entries added since the last Advance go in the wheel, the ones matched
+//meanwhile are released
+static void DrainIntake( ISO8583_CorrTable * pTable )
+{
+    unsigned long long ullNow = atomic_load_explicit( &pTable->ullNow, memory_order_relaxed );
+    unsigned int uiIndex, uiNext;
+    CorrEntry * pEntry;
+
+    uiIndex = atomic_exchange_explicit( &pTable->uiIntake, CORR_NIL, memory_order_acquire );
+
+    for( ; uiIndex != CORR_NIL; uiIndex = uiNext )
+    {
+        pEntry = &pTable->pEntries[ uiIndex ];
+        uiNext = pEntry->uiIntakeNext;
+
+        if( pEntry->cWheel == CORR_RETIRED )
+            Release( pTable, pEntry );
+        else
+            WheelAdd( pTable, uiIndex, ullNow + 1 );
+    }
+}
+
+static void DrainRetire( ISO8583_CorrTable * pTable )
+{
+    unsigned int uiIndex, uiNext;
+    CorrEntry * pEntry;
+
+    uiIndex = atomic_exchange_explicit( &pTable->uiRetire, CORR_NIL, memory_order_acquire );
+
+    for( ; uiIndex != CORR_NIL; uiIndex = uiNext )
+    {
+        pEntry = &pTable->pEntries[ uiIndex ];
+        uiNext = pEntry->uiRetireNext;
+
+        if( pEntry->cWheel == CORR_UNSEEN )
+        {
+            //Inserted after the intake stack was taken, released when it is
+            pEntry->cWheel = CORR_RETIRED;
+            continue;
+        }
+
+        if( pEntry->cWheel == CORR_WHEEL )
+            WheelRemove( pTable, uiIndex );
+
+        Release( pTable, pEntry );
+    }
+}
+
+//Time out the entries of the level 0 bucket of ullTick, entries matched
+//meanwhile wait for their retire
+static int Expire( ISO8583_CorrTable * pTable, unsigned int uiIndex, unsigned long long ullTick )
+{
+    unsigned long long ullState;
+    ISO8583_CorrKey Key;
+    CorrEntry * pEntry;
+    unsigned int uiNext;
+    int iExpired = 0;
+
+    for( ; uiIndex != CORR_NIL; uiIndex = uiNext )
+    {
+        pEntry = &pTable->pEntries[ uiIndex ];
+        uiNext = pEntry->uiNext;
+        ullState = atomic_load_explicit( &pEntry->ullState, memory_order_relaxed );
+
+        //The insert has not published it yet, try again next tick
+        if(( ullState & CORR_STATEMASK ) == CORR_BUSY )
+        {
+            WheelAdd( pTable, uiIndex, ullTick + 1 );
+            continue;
+        }
+
+        if(( ullState & CORR_STATEMASK ) != CORR_LIVE
+            || !atomic_compare_exchange_strong_explicit( &pEntry->ullState, &ullState, ( ullState & ~CORR_STATEMASK ) | CORR_EXPIRED,
+                                                         memory_order_acquire, memory_order_relaxed ) )
+        {
+            pEntry->cWheel = CORR_POPPED;
+            continue;
+        }
+
+        if( pTable->pfnExpired != NULL )
+        {
+            Key.ullKey[ 0 ] = atomic_load_explicit( &pEntry->ullKey[ 0 ], memory_order_relaxed );
+            Key.ullKey[ 1 ] = atomic_load_explicit( &pEntry->ullKey[ 1 ], memory_order_relaxed );
+            pTable->pfnExpired( pTable->pContext, &Key, pEntry->pUser );
+        }
+
+        Release( pTable, pEntry );
+        iExpired ++;
+    }
+
+    return iExpired;
+}
+
+/*-----------------------------------------------------------------------------
+ * External functions
+ *-----------------------------------------------------------------------------*/
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Correlate_KeyRec
+ * DESCRIPTION:     Key of a decoded or built message
+ * PARAMETERS:      pSpec: spec context
+ *                  pIso8583Data: Iso8583 data structure
+ *                  pKey(out): key
+ * RETURN:          ISOENGINE_OK
+ *                  ISOENGINE_INVALID_FIELD_DATA: field data outside of
+ *                                                ISO8583_Rec.cData
+ ---------------------------------------------------------------------------- */
+int ISO8583Correlate_KeyRec( const ISO8583_Spec * pSpec, const ISO8583_Rec * pIso8583Data, ISO8583_CorrKey * pKey )
+{
+    static const int KeyFields[ 3 ] = { 41, 11, 7 };
+    const byte * pData[ 3 ];
+    int i, iFieldNum, iBytes[ 3 ];
+
+    for( i = 0; i < 3; i ++ )
+    {
+        iFieldNum = KeyFields[ i ] - 1;
+        pData[ i ] = NULL;
+        iBytes[ i ] = 0;
+
+        if( !ISO8583_BITMAP_TEST( pIso8583Data->ulBitmap, iFieldNum ) )
+            continue;
+
+        iBytes[ i ] = WireBytes( pSpec, iFieldNum, pIso8583Data->Field[ iFieldNum ].len );
+        pData[ i ] = &pIso8583Data->cData[ pIso8583Data->Field[ iFieldNum ].addr ];
+
+        if( pIso8583Data->Field[ iFieldNum ].addr < 0 || iBytes[ i ] < 0
+            || pIso8583Data->Field[ iFieldNum ].addr + iBytes[ i ] > pIso8583Data->iCapacity )
+            return ISOENGINE_INVALID_FIELD_DATA;
+    }
+
+    BuildKey( pData, iBytes, pKey );
+    return ISOENGINE_OK;
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Correlate_KeyView
+ * DESCRIPTION:     ISO8583Correlate_KeyRec on a view of a RAW message
+ * PARAMETERS:      pSpec: spec context
+ *                  pView: view
+ *                  pKey(out): key
+ * RETURN:          ISOENGINE_OK or an error of ISO8583Engine_ViewFieldPtr
+ ---------------------------------------------------------------------------- */
+int ISO8583Correlate_KeyView( const ISO8583_Spec * pSpec, ISO8583_View * pView, ISO8583_CorrKey * pKey )
+{
+    static const int KeyFields[ 3 ] = { 41, 11, 7 };
+    const byte * pData[ 3 ];
+    int i, iLength, iBytes[ 3 ];
+
+    for( i = 0; i < 3; i ++ )
+    {
+        pData[ i ] = NULL;
+        iBytes[ i ] = 0;
+
+        if(( iLength = ISO8583Engine_ViewFieldPtr( pSpec, pView, KeyFields[ i ], &pData[ i ] ) ) < 0 )
+            return iLength;
+
+        if( iLength > 0 )
+            iBytes[ i ] = WireBytes( pSpec, KeyFields[ i ] - 1, iLength );
+    }
+
+    BuildKey( pData, iBytes, pKey );
+    return ISOENGINE_OK;
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Correlate_Create
+ * DESCRIPTION:     Create a table for up to iMaxEntries transactions
+ * PARAMETERS:      iMaxEntries: in flight transactions
+ *                  pfnExpired: timeout callback, may be NULL
+ *                  pContext: first argument of pfnExpired
+ * RETURN:          The table, NULL when out of memory
+ ---------------------------------------------------------------------------- */
+ISO8583_CorrTable * ISO8583Correlate_Create( int iMaxEntries, ISO8583_CorrExpired pfnExpired, void * pContext )
+{
+    ISO8583_CorrTable * pTable;
+    unsigned int uiSlots = 16;
+    int i;
+
+    if( iMaxEntries <= 0 || iMaxEntries > ( 1 << 29 ) )
+        return NULL;
+
+    while( uiSlots < 2U * ( unsigned int )iMaxEntries )
+        uiSlots <<= 1;
+
+    if(( pTable = ( ISO8583_CorrTable * )calloc( 1, sizeof( ISO8583_CorrTable ) ) ) == NULL )
+        return NULL;
+
+    //All slots CORR_EMPTY with generation 0
+    if(( pTable->pEntries = ( CorrEntry * )calloc( uiSlots, sizeof( CorrEntry ) ) ) == NULL )
+    {
+        free( pTable );
+        return NULL;
+    }
+
+    pTable->uiMask = uiSlots - 1;
+    pTable->iMaxEntries = iMaxEntries;
+    pTable->pfnExpired = pfnExpired;
+    pTable->pContext = pContext;
+    atomic_init( &pTable->iUsed, 0 );
+    atomic_init( &pTable->iMaxProbe, 0 );
+    atomic_init( &pTable->uiIntake, CORR_NIL );
+    atomic_init( &pTable->uiRetire, CORR_NIL );
+    atomic_init( &pTable->ullNow, 0 );
+
+    for( i = 0; i < ISO8583_CORR_LEVELS * ISO8583_CORR_SLOTS; i ++ )
+        pTable->uiBuckets[ i ] = CORR_NIL;
+
+    return pTable;
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Correlate_Destroy
+ * DESCRIPTION:     Free a table
+ * PARAMETERS:      pTable: table, may be NULL
+ * RETURN:          None.
+ ---------------------------------------------------------------------------- */
+void ISO8583Correlate_Destroy( ISO8583_CorrTable * pTable )
+{
+    if( pTable == NULL )
+        return;
+
+    free( pTable->pEntries );
+    free( pTable );
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Correlate_Insert
+ * DESCRIPTION:     Add a request sent. The probe looks for the key up to the
+ *                  longest probe of any insert, and takes the first empty or
+ *                  free slot on its way.
+ * PARAMETERS:      pTable: table
+ *                  pKey: key of the request
+ *                  pUser: caller data
+ *                  uiTimeout: ticks from the current wheel time
+ * RETURN:          ISOENGINE_OK
+ *                  ISOENGINE_OVER_MAXLENGTH: iMaxEntries in flight
+ *                  ISOENGINE_INVALID_FIELD_DATA: key already in flight
+ *                  ISOENGINE_INVALID_FIELD_LENGTH: uiTimeout 0
+ ---------------------------------------------------------------------------- */
+int ISO8583Correlate_Insert( ISO8583_CorrTable * pTable, const ISO8583_CorrKey * pKey, void * pUser, unsigned int uiTimeout )
+{
+    unsigned long long ullState, ullClaim = 0;
+    unsigned int uiHome, uiIndex, uiClaim;
+    CorrEntry * pEntry;
+    int iProbe, iMaxProbe, iClaim;
+
+    if( uiTimeout == 0 )
+        return ISOENGINE_INVALID_FIELD_LENGTH;
+
+    if( atomic_fetch_add_explicit( &pTable->iUsed, 1, memory_order_relaxed ) >= pTable->iMaxEntries )
+    {
+        atomic_fetch_sub_explicit( &pTable->iUsed, 1, memory_order_relaxed );
+        return ISOENGINE_OVER_MAXLENGTH;
+    }
+
+    uiHome = HashKey( pKey, pTable->uiMask );
+
+    for( ;; )
+    {
+        iMaxProbe = atomic_load_explicit( &pTable->iMaxProbe, memory_order_acquire );
+        iClaim = -1;
+        uiClaim = 0;
+
+        //At most half the slots are used, an empty or free slot is always found
+        for( iProbe = 0; ; iProbe ++ )
+        {
+            uiIndex = ( uiHome + iProbe ) & pTable->uiMask;
+            pEntry = &pTable->pEntries[ uiIndex ];
+            ullState = atomic_load_explicit( &pEntry->ullState, memory_order_acquire );
+
+            if(( ullState & CORR_STATEMASK ) == CORR_LIVE && KeyEquals( pEntry, pKey ) )
+            {
+                atomic_fetch_sub_explicit( &pTable->iUsed, 1, memory_order_relaxed );
+                return ISOENGINE_INVALID_FIELD_DATA;
+            }
+
+            if( iClaim < 0 && (( ullState & CORR_STATEMASK ) == CORR_EMPTY || ( ullState & CORR_STATEMASK ) == CORR_FREE ) )
+            {
+                iClaim = iProbe;
+                uiClaim = uiIndex;
+                ullClaim = ullState;
+            }
+
+            if(( ullState & CORR_STATEMASK ) == CORR_EMPTY || ( iClaim >= 0 && iProbe >= iMaxProbe ) )
+                break;
+        }
+
+        pEntry = &pTable->pEntries[ uiClaim ];
+
+        if( atomic_compare_exchange_strong_explicit( &pEntry->ullState, &ullClaim,
+                                                     ( ullClaim & ~CORR_STATEMASK ) + CORR_GENERATION + CORR_BUSY,
+                                                     memory_order_acquire, memory_order_relaxed ) )
+            break;
+    }
+
+    //Lookups must probe at least this far from now on
+    while( iClaim > iMaxProbe && !atomic_compare_exchange_weak_explicit( &pTable->iMaxProbe, &iMaxProbe, iClaim,
+                                                                         memory_order_release, memory_order_relaxed ) )
+        ;
+
+    atomic_store_explicit( &pEntry->ullKey[ 0 ], pKey->ullKey[ 0 ], memory_order_relaxed );
+    atomic_store_explicit( &pEntry->ullKey[ 1 ], pKey->ullKey[ 1 ], memory_order_relaxed );
+    pEntry->pUser = pUser;
+    pEntry->ullDeadline = atomic_load_explicit( &pTable->ullNow, memory_order_relaxed ) + uiTimeout;
+
+    //On the intake stack before it can be matched, so the retire of a match
+    //never comes before the intake
+    Push( &pTable->uiIntake, &pEntry->uiIntakeNext, uiClaim );
+    atomic_store_explicit( &pEntry->ullState, ( ullClaim & ~CORR_STATEMASK ) + CORR_GENERATION + CORR_LIVE, memory_order_release );
+    return ISOENGINE_OK;
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Correlate_Match
+ * DESCRIPTION:     Take the request of a response out of the table
+ * PARAMETERS:      pTable: table
+ *                  pKey: key of the response
+ *                  ppUser(out): pUser of the request, may be NULL
+ * RETURN:          1: matched
+ *                  0: no such request in flight
+ ---------------------------------------------------------------------------- */
+int ISO8583Correlate_Match( ISO8583_CorrTable * pTable, const ISO8583_CorrKey * pKey, void ** ppUser )
+{
+    unsigned long long ullState;
+    unsigned int uiHome, uiIndex;
+    CorrEntry * pEntry;
+    int iProbe, iMaxProbe = atomic_load_explicit( &pTable->iMaxProbe, memory_order_acquire );
+
+    uiHome = HashKey( pKey, pTable->uiMask );
+
+    for( iProbe = 0; iProbe <= iMaxProbe; iProbe ++ )
+    {
+        uiIndex = ( uiHome + iProbe ) & pTable->uiMask;
+        pEntry = &pTable->pEntries[ uiIndex ];
+        ullState = atomic_load_explicit( &pEntry->ullState, memory_order_acquire );
+
+        if(( ullState & CORR_STATEMASK ) == CORR_EMPTY )
+            return 0;
+
+        //A failed swap means the slot was matched, expired or reused since
+        //the key was read
+        if(( ullState & CORR_STATEMASK ) != CORR_LIVE || !KeyEquals( pEntry, pKey )
+            || !atomic_compare_exchange_strong_explicit( &pEntry->ullState, &ullState, ( ullState & ~CORR_STATEMASK ) | CORR_MATCHED,
+                                                         memory_order_acquire, memory_order_relaxed ) )
+            continue;
+
+        if( ppUser != NULL )
+            *ppUser = pEntry->pUser;
+
+        Push( &pTable->uiRetire, &pEntry->uiRetireNext, uiIndex );
+        return 1;
+    }
+
+    return 0;
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Correlate_Advance
+ * DESCRIPTION:     Move the wheel to tick ullNow. A level is cascaded into
+ *                  the one below when the lower one wraps, an entry moves at
+ *                  most ISO8583_CORR_LEVELS - 1 times.
+ * PARAMETERS:      pTable: table
+ *                  ullNow: current tick
+ * RETURN:          Requests timed out by this call
+ ---------------------------------------------------------------------------- */
+int ISO8583Correlate_Advance( ISO8583_CorrTable * pTable, unsigned long long ullNow )
+{
+    unsigned long long ullTick = atomic_load_explicit( &pTable->ullNow, memory_order_relaxed );
+    unsigned int uiIndex, uiNext;
+    int iLevel, iExpired = 0;
+
+    DrainIntake( pTable );
+    DrainRetire( pTable );
+
+    while( ullTick < ullNow )
+    {
+        //Nothing to time out, jump
+        if( pTable->iInWheel == 0 )
+        {
+            ullTick = ullNow;
+            atomic_store_explicit( &pTable->ullNow, ullTick, memory_order_relaxed );
+            break;
+        }
+
+        atomic_store_explicit( &pTable->ullNow, ++ ullTick, memory_order_relaxed );
+
+        //Highest level first, so entries cascade all the way down this tick
+        for( iLevel = 1; iLevel < ISO8583_CORR_LEVELS; iLevel ++ )
+        {
+            if(( ullTick & (( 1ULL << ( ISO8583_CORR_SLOTBITS * iLevel ) ) - 1 ) ) != 0 )
+                break;
+        }
+
+        while( -- iLevel > 0 )
+        {
+            uiIndex = WheelTake( pTable, iLevel * ISO8583_CORR_SLOTS
+                                 + ( int )(( ullTick >> ( ISO8583_CORR_SLOTBITS * iLevel ) ) & ( ISO8583_CORR_SLOTS - 1 ) ) );
+
+            for( ; uiIndex != CORR_NIL; uiIndex = uiNext )
+            {
+                uiNext = pTable->pEntries[ uiIndex ].uiNext;
+                WheelAdd( pTable, uiIndex, ullTick );
+            }
+        }
+
+        iExpired += Expire( pTable, WheelTake( pTable, ( int )( ullTick & ( ISO8583_CORR_SLOTS - 1 ) ) ), ullTick );
+    }
+
+    return iExpired;
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Correlate_Count
+ * DESCRIPTION:     Requests in flight
+ * PARAMETERS:      pTable: table
+ * RETURN:          Count
+ ---------------------------------------------------------------------------- */
+int ISO8583Correlate_Count( const ISO8583_CorrTable * pTable )
+{
+    return atomic_load_explicit(( atomic_int * )&pTable->iUsed, memory_order_relaxed );
+}
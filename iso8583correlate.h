@@ -0,0 +1,145 @@
+/***************************************************************************
+* FILE NAME:    ISO8583Correlate.H                                         *
+* MODULE NAME:  ISO8583Engine                                              *
+* PROGRAMMER:                                                              *
+* DESCRIPTION:  Request / response correlation for pipelined links.        *
+*               A transaction is keyed on the wire bytes of its field 41   *
+*               (terminal ID), 11 (STAN) and 7 (transmission date and      *
+*               time), taken straight from ISO8583_Rec.cData or a view.    *
+*               In flight transactions are kept in a fixed size open       *
+*               addressing hash table: any number of threads may insert    *
+*               and match concurrently without locks. Timeouts run on a    *
+*               hierarchical timer wheel advanced by one thread, which     *
+*               calls back for every transaction that got no response,     *
+*               e.g. to send its reversal. Insert, match and expiry are    *
+*               O(1).                                                      *
+* REVISION:                                                                *
+****************************************************************************/
+
+#ifndef _ISO8583CORRELATE_H
+#define _ISO8583CORRELATE_H
+
+#include "ISO8583Engine.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//Timer wheel: ISO8583_CORR_LEVELS levels of ISO8583_CORR_SLOTS buckets, any
+//unsigned int timeout fits
+#define ISO8583_CORR_SLOTBITS   8
+#define ISO8583_CORR_SLOTS      ( 1 << ISO8583_CORR_SLOTBITS )
+#define ISO8583_CORR_LEVELS     4
+
+//Correlation key: the wire bytes of fields 41, 11 and 7 when they fit in 16
+//bytes (8 ASC + 3 BCD + 5 BCD with the sample formats), else a 128 bit hash
+//of them
+typedef struct
+{
+    unsigned long long ullKey[ 2 ];
+} ISO8583_CorrKey;
+
+typedef struct ISO8583_CorrTable ISO8583_CorrTable;
+
+//Called by ISO8583Correlate_Advance for a transaction that timed out, on the
+//thread advancing the wheel. The entry is gone once the call returns.
+typedef void ( * ISO8583_CorrExpired )( void * pContext, const ISO8583_CorrKey * pKey, void * pUser );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Correlate_KeyRec
+ * DESCRIPTION:     Key of a decoded or built message, read from the field
+ *                  data in wire form, nothing is converted
+ * PARAMETERS:      pSpec: spec context
+ *                  pIso8583Data: Iso8583 data structure
+ *                  pKey(out): key, an absent field counts as empty
+ * RETURN:          ISOENGINE_OK
+ *                  ISOENGINE_INVALID_FIELD_DATA: field data outside of
+ *                                                ISO8583_Rec.cData
+ ---------------------------------------------------------------------------- */
+int ISO8583Correlate_KeyRec( const ISO8583_Spec * pSpec, const ISO8583_Rec * pIso8583Data, ISO8583_CorrKey * pKey );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Correlate_KeyView
+ * DESCRIPTION:     ISO8583Correlate_KeyRec on a view of a RAW message, the
+ *                  same message gives the same key either way
+ * PARAMETERS:      pSpec: spec context
+ *                  pView: view, see ISO8583Engine_OpenView
+ *                  pKey(out): key
+ * RETURN:          ISOENGINE_OK or an error of ISO8583Engine_ViewFieldPtr
+ ---------------------------------------------------------------------------- */
+int ISO8583Correlate_KeyView( const ISO8583_Spec * pSpec, ISO8583_View * pView, ISO8583_CorrKey * pKey );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Correlate_Create
+ * DESCRIPTION:     Create a table for up to iMaxEntries transactions. Slots
+ *                  are allocated once, for twice iMaxEntries rounded up to a
+ *                  power of two. A matched entry keeps its slot until the
+ *                  next ISO8583Correlate_Advance.
+ * PARAMETERS:      iMaxEntries: in flight transactions
+ *                  pfnExpired: timeout callback, may be NULL
+ *                  pContext: first argument of pfnExpired
+ * RETURN:          The table, NULL when out of memory
+ ---------------------------------------------------------------------------- */
+ISO8583_CorrTable * ISO8583Correlate_Create( int iMaxEntries, ISO8583_CorrExpired pfnExpired, void * pContext );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Correlate_Destroy
+ * DESCRIPTION:     Free a table, pending transactions are not called back
+ * PARAMETERS:      pTable: table, may be NULL
+ * RETURN:          None.
+ ---------------------------------------------------------------------------- */
+void ISO8583Correlate_Destroy( ISO8583_CorrTable * pTable );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Correlate_Insert
+ * DESCRIPTION:     Add a request sent, thread safe. The same key inserted
+ *                  twice by racing threads is not detected.
+ * PARAMETERS:      pTable: table
+ *                  pKey: key of the request
+ *                  pUser: caller data returned by the match or the timeout
+ *                  uiTimeout: ticks from the current wheel time, at least 1
+ * RETURN:          ISOENGINE_OK
+ *                  ISOENGINE_OVER_MAXLENGTH: iMaxEntries in flight
+ *                  ISOENGINE_INVALID_FIELD_DATA: key already in flight
+ *                  ISOENGINE_INVALID_FIELD_LENGTH: uiTimeout 0
+ ---------------------------------------------------------------------------- */
+int ISO8583Correlate_Insert( ISO8583_CorrTable * pTable, const ISO8583_CorrKey * pKey, void * pUser, unsigned int uiTimeout );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Correlate_Match
+ * DESCRIPTION:     Take the request of a response out of the table, thread
+ *                  safe. A transaction is either matched once or expires.
+ * PARAMETERS:      pTable: table
+ *                  pKey: key of the response
+ *                  ppUser(out): pUser of the request, may be NULL
+ * RETURN:          1: matched
+ *                  0: no such request in flight, late or unsolicited
+ ---------------------------------------------------------------------------- */
+int ISO8583Correlate_Match( ISO8583_CorrTable * pTable, const ISO8583_CorrKey * pKey, void ** ppUser );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Correlate_Advance
+ * DESCRIPTION:     Move the wheel to tick ullNow, calling back the requests
+ *                  timed out meanwhile and releasing the slots of matched
+ *                  ones. Called periodically by one thread at a time; the
+ *                  tick length is up to the caller, e.g. 1 ms. The wheel
+ *                  starts at tick 0.
+ * PARAMETERS:      pTable: table
+ *                  ullNow: current tick, not below the previous call
+ * RETURN:          Requests timed out by this call
+ ---------------------------------------------------------------------------- */
+int ISO8583Correlate_Advance( ISO8583_CorrTable * pTable, unsigned long long ullNow );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Correlate_Count
+ * DESCRIPTION:     Requests in flight, matched ones not yet released included
+ * PARAMETERS:      pTable: table
+ * RETURN:          Count
+ ---------------------------------------------------------------------------- */
+int ISO8583Correlate_Count( const ISO8583_CorrTable * pTable );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,528 @@
+/***************************************************************************
+* FILE NAME:    ISO8583Dump.C                                              *
+* MODULE NAME:  ISO8583Engine                                              *
+* PROGRAMMER:                                                              *
+* DESCRIPTION:  PCI safe trace of messages, see ISO8583Dump.h              *
+* REVISION:                                                                *
+****************************************************************************/
+
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "ISO8583Engine.h"
+#include "ISO8583Bits.h"
+#include "ISO8583Dump.h"
+
+//Output of one field: " 128[999]:" at most, then the value and ".."
+#define DUMP_FIELDHEAD      10
+
+//MTI, space and a 128 bit bitmap in hex
+#define DUMP_HEADWIDTH      ( 4 + 1 + 32 )
+
+//"seconds.microseconds " in front of a logged line
+#define DUMP_STAMPWIDTH     24
+
+#define DUMP_REDACTED       "<redacted>"
+
+//Ring of one producer thread and the drain thread. uiHead and uiTail run
+//freely and are masked on use; each is written by one side only.
+struct ISO8583_DumpRing
+{
+    char * pBuf;
+    unsigned int uiSize;
+    unsigned int uiMask;
+    ISO8583_CACHELINE atomic_uint uiHead;           // written by the producer
+    unsigned int uiTailSeen;                        // producer's copy of uiTail
+    atomic_ullong ullDropped;
+    ISO8583_CACHELINE atomic_uint uiTail;           // written by the drain thread
+};
+
+struct ISO8583_DumpLog
+{
+    FILE * fp;
+    int iIdleMs;
+    pthread_t Thread;
+    atomic_int bStop;
+    atomic_int iRings;                              // slots handed out
+    _Atomic( ISO8583_DumpRing * ) pRings[ ISO8583_DUMP_RINGS ];
+};
+
+static const char HexDigit[ 16 ] = "0123456789ABCDEF";
+
+/*-----------------------------------------------------------------------------
+ * Internal functions
+ *-----------------------------------------------------------------------------*/
+
+//Default masking of field iFieldNum (0 based)
+static unsigned char DefaultMask( const ISO8583_Spec * pSpec, int iFieldNum )
+{
+    const ISO8583_FieldOp * pOp = &pSpec->Op[ iFieldNum ];
+
+    if( iFieldNum == 34 || iFieldNum == 35 || iFieldNum == 44 || iFieldNum == 51 || iFieldNum == 54
+        || pOp->bClass == ISO8583_CLASS_Z )
+        return ISO8583_DUMP_REDACT;
+
+    if( iFieldNum == 1 || iFieldNum == 33 || pOp->bLuhn )
+        return ISO8583_DUMP_PAN;
+
+    return ISO8583_DUMP_CLEAR;
+}
+
+//Decimal digits of a positive value, returns the end
+static char * PutNumber( char * p, unsigned long long ullValue, int iMinDigits )
+{
+    char cDigits[ 20 ];
+    int i = 0;
+
+    do
+    {
+        cDigits[ i ++ ] = ( char )( '0' + ullValue % 10 );
+        ullValue /= 10;
+    } while( ullValue || i < iMinDigits );
+
+    while( i )
+        *p ++ = cDigits[ -- i ];
+
+    return p;
+}
+
+//Character iIdx of a field as shown: a digit of packed data, or the byte
+static char FieldChar( const byte * pData, int bPacked, int iIdx )
+{
+    unsigned char c;
+
+    if( bPacked )
+        return HexDigit[ iIdx & 1 ? pData[ iIdx >> 1 ] & 0x0F : pData[ iIdx >> 1 ] >> 4 ];
+
+    c = pData[ iIdx ];
+    return c >= 0x20 && c <= 0x7E ? ( char )c : '.';
+}
+
+//Characters PutValue writes at most
+static int ValueWidth( const ISO8583_Spec * pSpec, int iFieldNum, int iLength, unsigned char cMask )
+{
+    if( cMask != ISO8583_DUMP_CLEAR && ( cMask == ISO8583_DUMP_REDACT || ( pSpec->FldFormat[ iFieldNum ].bType & ISO8583TYPE_BIN ) ) )
+        return sizeof( DUMP_REDACTED ) - 1;
+
+    if( pSpec->FldFormat[ iFieldNum ].bType & ISO8583TYPE_BIN )
+        iLength *= 2;
+
+    return iLength > ISO8583_DUMP_FIELDMAX ? ISO8583_DUMP_FIELDMAX + 2 : iLength;
+}
+
+//Value of a field, at most ISO8583_DUMP_FIELDMAX characters then ".."
+static char * PutValue( char * p, const ISO8583_Spec * pSpec, int iFieldNum, const byte * pData, int iLength, unsigned char cMask )
+{
+    const ISO8583_FieldOp * pOp = &pSpec->Op[ iFieldNum ];
+    int i, iShown, bBinary = ( pSpec->FldFormat[ iFieldNum ].bType & ISO8583TYPE_BIN ) != 0;
+
+    //a PAN in binary form has no digits to keep
+    if( cMask == ISO8583_DUMP_REDACT || ( cMask == ISO8583_DUMP_PAN && bBinary ) )
+    {
+        memcpy( p, DUMP_REDACTED, sizeof( DUMP_REDACTED ) - 1 );
+        return p + sizeof( DUMP_REDACTED ) - 1;
+    }
+
+    if( bBinary )
+    {
+        iShown = iLength * 2 > ISO8583_DUMP_FIELDMAX ? ISO8583_DUMP_FIELDMAX / 2 : iLength;
+
+        for( i = 0; i < iShown; i ++ )
+        {
+            *p ++ = HexDigit[ pData[ i ] >> 4 ];
+            *p ++ = HexDigit[ pData[ i ] & 0x0F ];
+        }
+    }
+    else
+    {
+        iShown = iLength > ISO8583_DUMP_FIELDMAX ? ISO8583_DUMP_FIELDMAX : iLength;
+
+        for( i = 0; i < iShown; i ++ )
+        {
+            if( cMask == ISO8583_DUMP_PAN && ( iLength < 13 || ( i >= 6 && i < iLength - 4 ) ) )
+                *p ++ = '*';
+            else
+                *p ++ = FieldChar( pData, pOp->bPacked, i );
+        }
+    }
+
+    if( iShown < iLength )
+    {
+        *p ++ = '.';
+        *p ++ = '.';
+    }
+
+    return p;
+}
+
+//Seconds and microseconds of the wall clock
+static char * PutStamp( char * p )
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_REALTIME, &ts );
+    p = PutNumber( p, ( unsigned long long )ts.tv_sec, 1 );
+    *p ++ = '.';
+    p = PutNumber( p, ( unsigned long long )ts.tv_nsec / 1000, 6 );
+    *p ++ = ' ';
+    return p;
+}
+
+//Copy iLength bytes into the ring at free running offset uiAt
+static void RingCopy( ISO8583_DumpRing * pRing, unsigned int uiAt, const char * pData, int iLength )
+{
+    unsigned int uiPos = uiAt & pRing->uiMask;
+    unsigned int uiFirst = pRing->uiSize - uiPos;
+
+    if( uiFirst >= ( unsigned int )iLength )
+    {
+        memcpy( pRing->pBuf + uiPos, pData, iLength );
+        return;
+    }
+
+    memcpy( pRing->pBuf + uiPos, pData, uiFirst );
+    memcpy( pRing->pBuf, pData + uiFirst, iLength - uiFirst );
+}
+
+//Write what a ring holds, returns the bytes written
+static unsigned int RingDrain( ISO8583_DumpLog * pLog, ISO8583_DumpRing * pRing )
+{
+    unsigned int uiTail = atomic_load_explicit( &pRing->uiTail, memory_order_relaxed );
+    unsigned int uiHead = atomic_load_explicit( &pRing->uiHead, memory_order_acquire );
+    unsigned int uiPos = uiTail & pRing->uiMask, uiBytes = uiHead - uiTail;
+
+    if( uiBytes == 0 )
+        return 0;
+
+    if( uiPos + uiBytes <= pRing->uiSize )
+        fwrite( pRing->pBuf + uiPos, 1, uiBytes, pLog->fp );
+    else
+    {
+        fwrite( pRing->pBuf + uiPos, 1, pRing->uiSize - uiPos, pLog->fp );
+        fwrite( pRing->pBuf, 1, uiBytes - ( pRing->uiSize - uiPos ), pLog->fp );
+    }
+
+    atomic_store_explicit( &pRing->uiTail, uiHead, memory_order_release );
+    return uiBytes;
+}
+
+//Drain thread: write all rings, sleep when none had anything
+static void * DrainThread( void * pArg )
+{
+    ISO8583_DumpLog * pLog = ( ISO8583_DumpLog * )pArg;
+    ISO8583_DumpRing * pRing;
+    struct timespec ts;
+    unsigned int uiWritten;
+    int i, iRings, bStop;
+
+    ts.tv_sec = pLog->iIdleMs / 1000;
+    ts.tv_nsec = ( pLog->iIdleMs % 1000 ) * 1000000L;
+
+    for( ;; )
+    {
+        //read before the pass, so lines queued before the stop are written
+        bStop = atomic_load( &pLog->bStop );
+        iRings = atomic_load( &pLog->iRings );
+        uiWritten = 0;
+
+        for( i = 0; i < iRings && i < ISO8583_DUMP_RINGS; i ++ )
+        {
+            if(( pRing = atomic_load_explicit( &pLog->pRings[ i ], memory_order_acquire ) ) != NULL )
+                uiWritten += RingDrain( pLog, pRing );
+        }
+
+        if( uiWritten )
+            fflush( pLog->fp );
+        else if( bStop )
+            break;
+        else
+            nanosleep( &ts, NULL );
+    }
+
+    return NULL;
+}
+
+/*-----------------------------------------------------------------------------
+ * External functions
+ *-----------------------------------------------------------------------------*/
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Dump_InitMask
+ * DESCRIPTION:     Default masking of a spec
+ * PARAMETERS:      pSpec: spec context
+ *                  pMask(out): ISO8583_MAXFIELD entries
+ * RETURN:          None.
+ ---------------------------------------------------------------------------- */
+void ISO8583Dump_InitMask( const ISO8583_Spec * pSpec, unsigned char * pMask )
+{
+    int i;
+
+    for( i = 0; i < ISO8583_MAXFIELD; i ++ )
+        pMask[ i ] = DefaultMask( pSpec, i );
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Dump_Format
+ * DESCRIPTION:     One line of a record
+ * PARAMETERS:      pSpec: spec context
+ *                  pMask: masking, NULL for the default of pSpec
+ *                  pIso8583Data: Iso8583 data structure
+ *                  pOut(out): the line
+ *                  iSize: size of pOut
+ * RETURN:          Length of the line, -1
+ ---------------------------------------------------------------------------- */
+int ISO8583Dump_Format( const ISO8583_Spec * pSpec, const unsigned char * pMask, const ISO8583_Rec * pIso8583Data, char * pOut, int iSize )
+{
+    char * p = pOut, * pEnd = pOut + iSize - 1;     // room for '\n' kept
+    unsigned char cBitmap[ 16 ];
+    unsigned long long ullBits;
+    unsigned char cMask;
+    int i, iWords, iFieldNum, iLength;
+
+    if( iSize < 2 )
+        return -1;
+
+    if( pSpec->bBitMapMode == ISO8583_BITMAP128
+        || ( pSpec->bBitMapMode == ISO8583_BITMAPAUTO && pIso8583Data->ulBitmap[ 1 ] != 0 ) )
+        iWords = 2;
+    else
+        iWords = 1;
+
+    if( pEnd - p < DUMP_HEADWIDTH )
+    {
+        *p ++ = '\n';
+        return ( int )( p - pOut );
+    }
+
+    //the bitmap as on the wire, bit 1 flags the secondary one
+    for( i = 0; i < iWords; i ++ )
+        ISO8583Bits_StoreWire( cBitmap + i * 8, i == 0 ? pIso8583Data->ulBitmap[ 0 ] & ~1ULL : pIso8583Data->ulBitmap[ 1 ] );
+
+    if( iWords == 2 )
+        cBitmap[ 0 ] |= 0x80;
+
+    memcpy( p, pIso8583Data->cMsgID, 4 );
+    p += 4;
+    *p ++ = ' ';
+
+    for( i = 0; i < iWords * 8; i ++ )
+    {
+        *p ++ = HexDigit[ cBitmap[ i ] >> 4 ];
+        *p ++ = HexDigit[ cBitmap[ i ] & 0x0F ];
+    }
+
+    for( i = 0; i < iWords; i ++ )
+    {
+        ullBits = pIso8583Data->ulBitmap[ i ];
+
+        if( i == 0 )
+            ullBits &= ~1ULL;
+
+        while( ullBits )
+        {
+            iFieldNum = ( i << 6 ) + ISO8583Bits_Ctz64( ullBits );
+            ullBits &= ullBits - 1;
+
+            iLength = pIso8583Data->Field[ iFieldNum ].len;
+            cMask = pMask ? pMask[ iFieldNum ] : DefaultMask( pSpec, iFieldNum );
+
+            if( pEnd - p < DUMP_FIELDHEAD + ValueWidth( pSpec, iFieldNum, iLength, cMask ) )
+            {
+                if( pEnd - p >= 3 )
+                {
+                    memcpy( p, " ..", 3 );
+                    p += 3;
+                }
+
+                goto Done;
+            }
+
+            *p ++ = ' ';
+            p = PutNumber( p, iFieldNum + 1, 1 );
+
+            if( pSpec->Op[ iFieldNum ].bPrefix )
+            {
+                *p ++ = '[';
+                p = PutNumber( p, iLength, 1 );
+                *p ++ = ']';
+            }
+
+            *p ++ = ':';
+            p = PutValue( p, pSpec, iFieldNum, &pIso8583Data->cData[ pIso8583Data->Field[ iFieldNum ].addr ], iLength, cMask );
+        }
+    }
+
+Done:
+    *p ++ = '\n';
+    return ( int )( p - pOut );
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Dump_Create
+ * DESCRIPTION:     Start a log draining its rings to a file
+ * PARAMETERS:      fp: file
+ *                  iIdleMs: sleep of the drain thread when idle
+ * RETURN:          The log, NULL
+ ---------------------------------------------------------------------------- */
+ISO8583_DumpLog * ISO8583Dump_Create( FILE * fp, int iIdleMs )
+{
+    ISO8583_DumpLog * pLog;
+
+    if(( pLog = ( ISO8583_DumpLog * )calloc( 1, sizeof( ISO8583_DumpLog ) ) ) == NULL )
+        return NULL;
+
+    pLog->fp = fp;
+    pLog->iIdleMs = iIdleMs < 1 ? 1 : iIdleMs;
+
+    if( pthread_create( &pLog->Thread, NULL, DrainThread, pLog ) != 0 )
+    {
+        free( pLog );
+        return NULL;
+    }
+
+    return pLog;
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Dump_Destroy
+ * DESCRIPTION:     Drain, stop and free a log
+ * PARAMETERS:      pLog: log, may be NULL
+ * RETURN:          None.
+ ---------------------------------------------------------------------------- */
+void ISO8583Dump_Destroy( ISO8583_DumpLog * pLog )
+{
+    ISO8583_DumpRing * pRing;
+    int i;
+
+    if( pLog == NULL )
+        return;
+
+    atomic_store( &pLog->bStop, 1 );
+    pthread_join( pLog->Thread, NULL );
+
+    for( i = 0; i < ISO8583_DUMP_RINGS; i ++ )
+    {
+        if(( pRing = atomic_load( &pLog->pRings[ i ] ) ) != NULL )
+        {
+            free( pRing->pBuf );
+            free( pRing );
+        }
+    }
+
+    free( pLog );
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Dump_OpenRing
+ * DESCRIPTION:     Ring of one thread
+ * PARAMETERS:      pLog: log
+ *                  iBytes: size
+ * RETURN:          The ring, NULL
+ ---------------------------------------------------------------------------- */
+ISO8583_DumpRing * ISO8583Dump_OpenRing( ISO8583_DumpLog * pLog, int iBytes )
+{
+    ISO8583_DumpRing * pRing;
+    unsigned int uiSize = 2 * ISO8583_DUMP_MAXLINE;
+    int iSlot;
+
+    while( uiSize < ( unsigned int )iBytes && uiSize < 0x40000000U )
+        uiSize <<= 1;
+
+    if(( pRing = ( ISO8583_DumpRing * )calloc( 1, sizeof( ISO8583_DumpRing ) ) ) == NULL )
+        return NULL;
+
+    if(( pRing->pBuf = ( char * )malloc( uiSize ) ) == NULL )
+    {
+        free( pRing );
+        return NULL;
+    }
+
+    pRing->uiSize = uiSize;
+    pRing->uiMask = uiSize - 1;
+
+    if(( iSlot = atomic_fetch_add( &pLog->iRings, 1 ) ) >= ISO8583_DUMP_RINGS )
+    {
+        atomic_fetch_sub( &pLog->iRings, 1 );
+        free( pRing->pBuf );
+        free( pRing );
+        return NULL;
+    }
+
+    atomic_store_explicit( &pLog->pRings[ iSlot ], pRing, memory_order_release );
+    return pRing;
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Dump_Log
+ * DESCRIPTION:     Queue the line of a record on the ring of the thread
+ * PARAMETERS:      pRing: ring of the calling thread
+ *                  pSpec: spec context
+ *                  pMask: masking, NULL for the default
+ *                  pIso8583Data: Iso8583 data structure
+ * RETURN:          ISOENGINE_OK, ISOENGINE_OVER_MAXLENGTH
+ ---------------------------------------------------------------------------- */
+int ISO8583Dump_Log( ISO8583_DumpRing * pRing, const ISO8583_Spec * pSpec, const unsigned char * pMask, const ISO8583_Rec * pIso8583Data )
+{
+    char cLine[ DUMP_STAMPWIDTH + ISO8583_DUMP_MAXLINE ], * p;
+    unsigned int uiHead = atomic_load_explicit( &pRing->uiHead, memory_order_relaxed );
+    unsigned int uiFree = pRing->uiSize - ( uiHead - pRing->uiTailSeen );
+    unsigned int uiPos = uiHead & pRing->uiMask;
+    int iLength;
+
+    if( uiFree < sizeof( cLine ) )
+    {
+        pRing->uiTailSeen = atomic_load_explicit( &pRing->uiTail, memory_order_acquire );
+        uiFree = pRing->uiSize - ( uiHead - pRing->uiTailSeen );
+    }
+
+    //the common case formats in place, near the end of the buffer or when
+    //almost full the line is built aside and copied
+    if( uiFree >= sizeof( cLine ) && pRing->uiSize - uiPos >= sizeof( cLine ) )
+    {
+        p = PutStamp( pRing->pBuf + uiPos );
+        iLength = ( int )( p - ( pRing->pBuf + uiPos ) );
+        iLength += ISO8583Dump_Format( pSpec, pMask, pIso8583Data, p, ISO8583_DUMP_MAXLINE );
+    }
+    else
+    {
+        p = PutStamp( cLine );
+        iLength = ( int )( p - cLine );
+        iLength += ISO8583Dump_Format( pSpec, pMask, pIso8583Data, p, ISO8583_DUMP_MAXLINE );
+
+        if(( unsigned int )iLength > uiFree )
+        {
+            atomic_store_explicit( &pRing->ullDropped, atomic_load_explicit( &pRing->ullDropped, memory_order_relaxed ) + 1,
+                                   memory_order_relaxed );
+            return ISOENGINE_OVER_MAXLENGTH;
+        }
+
+        RingCopy( pRing, uiHead, cLine, iLength );
+    }
+
+    atomic_store_explicit( &pRing->uiHead, uiHead + iLength, memory_order_release );
+    return ISOENGINE_OK;
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Dump_Dropped
+ * DESCRIPTION:     Lines dropped on full rings
+ * PARAMETERS:      pLog: log
+ * RETURN:          Count
+ ---------------------------------------------------------------------------- */
+unsigned long long ISO8583Dump_Dropped( ISO8583_DumpLog * pLog )
+{
+    ISO8583_DumpRing * pRing;
+    unsigned long long ullDropped = 0;
+    int i;
+
+    for( i = 0; i < ISO8583_DUMP_RINGS; i ++ )
+    {
+        if(( pRing = atomic_load_explicit( &pLog->pRings[ i ], memory_order_acquire ) ) != NULL )
+            ullDropped += atomic_load_explicit( &pRing->ullDropped, memory_order_relaxed );
+    }
+
+    return ullDropped;
+}
@@ -0,0 +1,137 @@
+/***************************************************************************
+* FILE NAME:    ISO8583Dump.H                                              *
+* MODULE NAME:  ISO8583Engine                                              *
+* PROGRAMMER:                                                              *
+* DESCRIPTION:  PCI safe trace of messages.                                *
+*               ISO8583Dump_Format renders MTI, bitmap and every field of  *
+*               a record in one line, straight from the wire form in       *
+*               cData, with cardholder data masked per field: the PAN      *
+*               keeps its first 6 and last 4 digits, track data, PIN       *
+*               block and chip data are never written.                     *
+*               ISO8583Dump_Log formats into a ring of the calling thread, *
+*               one producer and one consumer, no lock and no system call; *
+*               a background thread drains all rings to a file. A line    *
+*               that does not fit a full ring is dropped and counted, the  *
+*               transaction never waits for the disk.                      *
+* REVISION:                                                                *
+****************************************************************************/
+
+#ifndef _ISO8583DUMP_H
+#define _ISO8583DUMP_H
+
+#include <stdio.h>
+
+#include "ISO8583Engine.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//Longest line of ISO8583Dump_Log, longer ones are cut
+#define ISO8583_DUMP_MAXLINE    4096
+
+//Characters shown of one field, the rest is cut to ".."
+#define ISO8583_DUMP_FIELDMAX   128
+
+//Rings one log can drain
+#define ISO8583_DUMP_RINGS      64
+
+//Masking of a field
+enum
+{
+    ISO8583_DUMP_CLEAR = 0,     // as is
+    ISO8583_DUMP_PAN,           // first 6 and last 4 digits, all masked below 13 digits
+    ISO8583_DUMP_REDACT,        // length only
+};
+
+typedef struct ISO8583_DumpLog ISO8583_DumpLog;
+typedef struct ISO8583_DumpRing ISO8583_DumpRing;
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Dump_InitMask
+ * DESCRIPTION:     Default masking of a spec: PAN masking for fields 2 and
+ *                  34 and any field with a Luhn check, redaction of track
+ *                  data (35, 36, 45 and any class Z field), the PIN block
+ *                  (52) and chip data (55), which carries PAN and track 2
+ *                  equivalents. Callers may mask more fields afterwards.
+ * PARAMETERS:      pSpec: spec context
+ *                  pMask(out): ISO8583_MAXFIELD entries, index field - 1
+ * RETURN:          None.
+ ---------------------------------------------------------------------------- */
+void ISO8583Dump_InitMask( const ISO8583_Spec * pSpec, unsigned char * pMask );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Dump_Format
+ * DESCRIPTION:     One line of a record:
+ *                  0200 7234054128C28805 2[16]:411111******1111 3:000000 ...
+ *                  Variable fields show their length in brackets, packed
+ *                  fields as digits, binary fields as hex, characters out
+ *                  of 0x20 - 0x7E of ASCII fields as '.'.
+ * PARAMETERS:      pSpec: spec context
+ *                  pMask: masking, see ISO8583Dump_InitMask, NULL for the
+ *                         default of pSpec
+ *                  pIso8583Data: Iso8583 data structure
+ *                  pOut(out): the line, '\n' terminated, not NUL terminated
+ *                  iSize: size of pOut, a longer line is cut and still ends
+ *                         with '\n'
+ * RETURN:          Length of the line, -1: iSize below 2
+ ---------------------------------------------------------------------------- */
+int ISO8583Dump_Format( const ISO8583_Spec * pSpec, const unsigned char * pMask, const ISO8583_Rec * pIso8583Data, char * pOut, int iSize );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Dump_Create
+ * DESCRIPTION:     Start a log draining its rings to a file
+ * PARAMETERS:      fp: file written by the drain thread only, not closed
+ *                  iIdleMs: sleep of the drain thread when all rings are
+ *                           empty, 1 if below
+ * RETURN:          The log, NULL when out of memory or no thread
+ ---------------------------------------------------------------------------- */
+ISO8583_DumpLog * ISO8583Dump_Create( FILE * fp, int iIdleMs );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Dump_Destroy
+ * DESCRIPTION:     Drain every ring, stop the drain thread and free the log
+ *                  and its rings. No thread may log any more.
+ * PARAMETERS:      pLog: log, may be NULL
+ * RETURN:          None.
+ ---------------------------------------------------------------------------- */
+void ISO8583Dump_Destroy( ISO8583_DumpLog * pLog );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Dump_OpenRing
+ * DESCRIPTION:     Ring of one thread, kept until ISO8583Dump_Destroy
+ * PARAMETERS:      pLog: log
+ *                  iBytes: size, rounded up to a power of two, at least
+ *                          2 * ISO8583_DUMP_MAXLINE
+ * RETURN:          The ring, NULL when out of memory or all
+ *                  ISO8583_DUMP_RINGS rings are open
+ ---------------------------------------------------------------------------- */
+ISO8583_DumpRing * ISO8583Dump_OpenRing( ISO8583_DumpLog * pLog, int iBytes );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Dump_Log
+ * DESCRIPTION:     Queue the line of a record, prefixed with the time of
+ *                  the call (seconds.microseconds), on the ring of the
+ *                  calling thread
+ * PARAMETERS:      pRing: ring of the calling thread
+ *                  pSpec: spec context
+ *                  pMask: masking, NULL for the default of pSpec
+ *                  pIso8583Data: Iso8583 data structure
+ * RETURN:          ISOENGINE_OK
+ *                  ISOENGINE_OVER_MAXLENGTH: ring full, line dropped
+ ---------------------------------------------------------------------------- */
+int ISO8583Dump_Log( ISO8583_DumpRing * pRing, const ISO8583_Spec * pSpec, const unsigned char * pMask, const ISO8583_Rec * pIso8583Data );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Dump_Dropped
+ * DESCRIPTION:     Lines dropped on full rings since the log was created
+ * PARAMETERS:      pLog: log
+ * RETURN:          Count
+ ---------------------------------------------------------------------------- */
+unsigned long long ISO8583Dump_Dropped( ISO8583_DumpLog * pLog );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,563 +1,1905 @@
-/***************************************************************************
-* FILE NAME:    ISO8583Engine.C                                            *
-* MODULE NAME:  ISO8583Engine                                              *
-* PROGRAMMER:                                                              *
-* DESCRIPTION:                                                             *
-* REVISION:                                                                *
-****************************************************************************/
-
-#include <conio.h>
-#include <string.h>
-#include <stdarg.h>
-#include <stdio.h>
-#include <stdlib.h>
-
-#include "ISO8583Engine.h"
-
-/*-----------------------------------------------------------------------------
- * Internal variables / constants
- *-----------------------------------------------------------------------------*/
-static unsigned char BitMapMode = ISO8583_BITMAP64;
-static unsigned char FldFormatSetFlag = FALSE;
-
-//ISO8583 field format definitions, should initiated by ISO8583Engine_InitFieldFormat()
-static ISO8583_FieldFormat ISO8583FldFormat[ ISO8583_MAXFIELD ];
-
-/* -----------------------------------------------------------------------------
- * FUNCTION NAME:   ISO8583Engine_InitFieldFormat
- * DESCRIPTION:     Set ISO8583 field type and format, should be called
- *                  before the using of ISO8583 engine module
- * PARAMETERS:      bBitMode: Iso8583 bitmap mode, see enum ISO8583_BitMode in ISO8583Engine.h
- *                  pFieldFormat: poFieldFormat definitions
- * RETURN:          None
- ---------------------------------------------------------------------------- */
-int ISO8583Engine_InitFieldFormat( ISO8583_BitMode bBitMode, ISO8583_FieldFormat *pIso8583FieldFormat )
-{
-    FldFormatSetFlag = TRUE;
-    BitMapMode = bBitMode;
-
-    if( ISO8583_MAXFIELD == 64 )
-        BitMapMode = ISO8583_BITMAP64;
-    else
-        BitMapMode = ISO8583_BITMAP128;
-
-    memcpy(( unsigned char * ) &ISO8583FldFormat, ( unsigned char * )pIso8583FieldFormat, sizeof( ISO8583FldFormat ) );
-    return ISOENGINE_OK;
-}
-
-
-/* -----------------------------------------------------------------------------
- * FUNCTION NAME:   ISO8583Engine_ClearAllFields
- * DESCRIPTION:     Clear all field data in ISO8583_Rec structure
- * PARAMETERS:      ptIso8583Data: ISO8583 data structure
- * RETURN:          None.
- ---------------------------------------------------------------------------- */
-int ISO8583Engine_ClearAllFields( ISO8583_Rec * ptIso8583Data )
-{
-    int i;
-    memset(( char * ) ptIso8583Data, 0, sizeof( ISO8583_Rec ) );
-    ptIso8583Data->iOffset = 0;
-
-    for( i = 0; i < ISO8583_MAXFIELD; i ++ )
-        ptIso8583Data->Field[ i ].bitf = 0;
-
-    return ISOENGINE_OK;
-}
-
-
-/* -----------------------------------------------------------------------------
- * FUNCTION NAME:   ISO8583Engine_ClearOneField
- * DESCRIPTION:     Clear one field data
- * PARAMETERS:      ptIso8583Data: pointer to ISO8583 data structure
- *                  iFieldNo: Field No
- * RETURN:          None
- ---------------------------------------------------------------------------- */
-int ISO8583Engine_ClearOneField( ISO8583_Rec * ptIso8583Data, int iFieldNo )
-{
-    if( iFieldNo >= 1 && iFieldNo < ISO8583_MAXFIELD )
-        ptIso8583Data->Field[ iFieldNo - 1 ].bitf = 0;
-    else
-        return ISOENGINE_INVALID_FIELD_NO;
-
-    return ISOENGINE_OK;
-}
-
-
-/* -----------------------------------------------------------------------------
- * FUNCTION NAME:   ISO8583Engine_SetField
- * DESCRIPTION:     Set ISO8583 field data
- * PARAMETERS:      pIso8583Data: ISO8583 data struct
- *                  iFieldNo: Field No
- *                  pFieldData: Field data
- *                  iDataLength: Length of field data
- * RETURN:          ISOENGINE_OK: Suceess
- *                  ISOENGINE_NOT_SET_FIELD_FMT: not set iso8583 field format
- *                  ISOENGINE_INVALID_FIELD_NO: iFieldNo > ISO8583_MAXFIELD or iFieldNo <= 1
- *                  ISOENGINE_TOO_LONG_FILED_LENGTH: iDataLength > 999
- *                  -4: iso8583 string total length already > ISO8583_MAXLENTH
- ---------------------------------------------------------------------------- */
-int ISO8583Engine_SetField( ISO8583_Rec * pIso8583Data, int iFieldNo, unsigned char * pFieldData, int iDataLength )
-{
-    int i, len;
-    int iFieldNum, iLength;
-    byte cTemp[ 1000 ];
-    byte * pRpt;
-
-    if( FldFormatSetFlag != TRUE )
-        return ISOENGINE_NOT_SET_FIELD_FMT;
-
-    iFieldNum = iFieldNo;
-    iLength = iDataLength;
-
-    if( iLength <= 0 )
-        return ISOENGINE_INVALID_FIELD_LENGTH;
-
-    if( iFieldNum == 0 )
-    {
-        memcpy( pIso8583Data->cMsgID, pFieldData, 4 );
-        pIso8583Data->cMsgID[ 4 ] = 0;
-        return ISOENGINE_OK;
-    }
-
-    if( iFieldNum <= 1 || iFieldNum > ISO8583_MAXFIELD )
-    {
-        return ISOENGINE_INVALID_FIELD_NO;
-    }
-
-    iFieldNum --;
-
-    if( iLength > ISO8583FldFormat[ iFieldNum ].iMaxLength )
-        iLength = ISO8583FldFormat[ iFieldNum ].iMaxLength;
-
-    pIso8583Data->Field[ iFieldNum ].bitf = 1;
-    len = iLength;
-
-    if( ISO8583FldFormat[ iFieldNum ].bType & ISO8583TYPE_FIX )
-        iLength = ISO8583FldFormat[ iFieldNum ].iMaxLength;
-    else if( ISO8583FldFormat[ iFieldNum ].bType & ISO8583TYPE_BIN )
-        iLength = ISO8583FldFormat[ iFieldNum ].iMaxLength / 8;
-
-    if( iLength > 999 )
-        return ISOENGINE_TOO_LONG_FILED_LENGTH;
-
-    pIso8583Data->Field[ iFieldNum ].len = iLength;
-    pRpt = & ( pIso8583Data->cData[ pIso8583Data->iOffset ] );
-    pIso8583Data->Field[ iFieldNum ].addr = pIso8583Data->iOffset;
-
-    if( iLength + pIso8583Data->iOffset >= ISO8583_MAXLENTH )
-        return ISOENGINE_OVER_MAXLENGTH;
-
-    pIso8583Data->iOffset += iLength;
-    i = 0;
-    memset( cTemp, 0, sizeof( cTemp ) );
-
-    if( ISO8583FldFormat[ iFieldNum ].bType & ISO8583TYPE_DIGIT )
-    {
-        for( ; i < iLength - len; i ++ )
-            cTemp[ i ] = '0';
-    }
-
-    memcpy( cTemp + i, pFieldData, len ) ;
-    i += len;
-
-    if( ISO8583FldFormat[ iFieldNum ].bType & ISO8583TYPE_BIN )
-    {
-        for( ; i < iLength; i ++ )
-            cTemp[ i ] = 0;
-    }
-    else if( iFieldNum == 1 )
-    {
-        cTemp[ i ] = 'F';
-        iLength ++;
-    }
-    else
-    {
-        for( ; i < iLength; i ++ )
-            cTemp[ i ] = ' ';
-    }
-
-    if( ISO8583FldFormat[ iFieldNum ].bType & ISO8583TYPE_BCD )
-        ISO8583Utils_ASC2BCD( cTemp, pRpt, iLength );
-    else
-        memcpy( pRpt, pFieldData, iLength );
-
-    return ISOENGINE_OK;
-}
-
-
-/* -----------------------------------------------------------------------------
- * FUNCTION NAME:   ISO8583Engine_GetField
- * DESCRIPTION:     Get ISO8583 field data, pRetFieldData must be ASC format
- * PARAMETERS:      pIso8583Data: ISO8583 data struct
- *                  iFieldNo: Field No
- *                  pRetFieldData: Return field data buffer
- *                  iSizeofRetFieldData: Length of pRetFieldData field data buffer
- * RETURN:          >=0: suceess, return data length
- *                  ISOENGINE_NOT_SET_FIELD_FMT: not set iso8583 field format
- *                  -2: iFieldNo > ISO8583_MAXFIELD or iFieldNo <= 1
- *                  -3: iDataLength > 999
- *                  -4: iso8583 string total length already > ISO8583_MAXLENTH
- ---------------------------------------------------------------------------- */
-int ISO8583Engine_GetField( ISO8583_Rec * pIso8583Data, int iFieldNo, unsigned char * pRetFieldData, int iSizeofRetFieldData )
-{
-    int iLength;
-    int iFieldNum;
-    byte * pRpt;
-
-    if( FldFormatSetFlag != TRUE )
-        return ISOENGINE_NOT_SET_FIELD_FMT;
-
-    iFieldNum = iFieldNo;
-
-    if( iFieldNum == 0 )
-    {
-        if(iSizeofRetFieldData < 5)
-        {
-            return ISOENGINE_TOO_SMALL_FIELD_BUF_SIZE;
-        }
-
-        memcpy( pRetFieldData, pIso8583Data->cMsgID, 4 );
-        pRetFieldData[ 4 ] = 0;
-        return (4);
-    }
-
-    if( iFieldNum <= 1 || iFieldNum > ISO8583_MAXFIELD )
-        return (-2);
-
-    iFieldNum --;
-
-    if( pIso8583Data->Field[ iFieldNum ].bitf == 0 )
-    {
-        pRetFieldData[ 0 ] = 0;
-        return ISOENGINE_OK;
-    }
-
-    if( pIso8583Data->Field[ iFieldNum ].addr < 0 || pIso8583Data->Field[ iFieldNum ].addr >= ISO8583_MAXLENTH )
-        return (-4);
-
-    pRpt = &pIso8583Data->cData[ pIso8583Data->Field[ iFieldNum ].addr ];
-    iLength = pIso8583Data->Field[ iFieldNum ].len;
-
-    if( iLength < 0 || iLength > 999 )
-        return (-3);
-
-    if( iLength > iSizeofRetFieldData )
-        iLength = iSizeofRetFieldData;
-
-    if( ISO8583FldFormat[ iFieldNum ].bType & ( ISO8583TYPE_BCD | ISO8583TYPE_DIGIT ) )
-        ISO8583Utils_BCD2ASC( pRpt, pRetFieldData, iLength );
-    else
-        memcpy( pRetFieldData, pRpt, iLength );
-
-    return (iLength);
-}
-
-
-/* -----------------------------------------------------------------------------
- * FUNCTION NAME:   ISO8583Engine_HexbufToIso8583
- * DESCRIPTION:     Convert ISO8583 RAW hex buffer data to ISO8583_Rec struct
- * PARAMETERS:      pIso8583Data(out): Converted Iso8583 data structure
- *                  pBuf(in): RAW iso8583 hex buf data
- * RETURN:          =0: success,
- *                  -1: variable field length error
- *                  -2: iFieldNo >= ISO8583_MAXFIELD or iFieldNo < 1
- *                  -3: iso8583 string total length already > ISO8583_MAXLENTH
- *                  -4: iso8583 string total length already > ISO8583_MAXLENTH
- ---------------------------------------------------------------------------- */
-int ISO8583Engine_HexbufToIso8583( ISO8583_Rec * pIso8583Data, byte * pBuf )
-{
-    int iOffSize, iLength, iBitnum;
-    int i, j, k, iFieldNum;
-    byte cBitmask, cVarLen[ 3 ];
-    byte * pRpt;
-
-    for( i = 0; i < ISO8583_MAXFIELD; i ++ )
-        pIso8583Data->Field[ i ].bitf = 0;
-
-    iOffSize = 0;
-    ISO8583Utils_BCD2ASC( pBuf, pIso8583Data->cMsgID, 4 );
-    pIso8583Data->cMsgID[ 4 ] = 0;
-    BitMapMode = ISO8583_BITMAP64;
-
-    if(( pBuf[ 2 ] & 0x80 ) && ( ISO8583_MAXFIELD == 128 ) )
-    {
-        iBitnum = 16;
-        BitMapMode = ISO8583_BITMAP64;
-    }
-    else
-        iBitnum = 8;
-
-    pRpt = pBuf + 2 + iBitnum;
-
-    for( i = 0; i < iBitnum; i ++ )
-    {
-        cBitmask = 0x80;
-
-        for( j = 0; j < 8; j ++, cBitmask >>= 1 )
-        {
-            if( i == 0 && cBitmask == 0x80 )
-                continue;
-
-            if(( pBuf[ i + 2 ] & cBitmask ) == 0 )
-                continue;
-
-            iFieldNum = ( i << 3 ) + j;
-
-            if( iFieldNum < 1 || iFieldNum >= ISO8583_MAXFIELD )
-                return( -2 );
-
-            if( ISO8583FldFormat[ iFieldNum ].bType & ISO8583TYPE_VAR )
-            {
-                memset( cVarLen, 0, sizeof( cVarLen ) );
-                cVarLen[ 0 ] = *pRpt;
-                pRpt ++;
-                ISO8583Utils_BCD2LEN( cVarLen, &iLength, 1 );
-
-                if( ISO8583FldFormat[ iFieldNum ].iMaxLength > 99 )
-                {
-                    cVarLen[ 1 ] = *pRpt;
-                    pRpt ++;
-                    ISO8583Utils_BCD2LEN( cVarLen, &iLength, 2 );
-                }
-
-                if( iLength > ISO8583FldFormat[ iFieldNum ].iMaxLength )
-                    return( -1 );
-            }
-            else if( ISO8583FldFormat[ iFieldNum ].bType & ISO8583TYPE_BIN )
-                iLength = ISO8583FldFormat[ iFieldNum ].iMaxLength / 8;
-            else
-                iLength = ISO8583FldFormat[ iFieldNum ].iMaxLength;
-
-            pIso8583Data->Field[ iFieldNum ].len = iLength;
-            pIso8583Data->Field[ iFieldNum ].addr = iOffSize;
-
-            if( ISO8583FldFormat[ iFieldNum ].bType & ( ISO8583TYPE_BCD | ISO8583TYPE_DIGIT ) )
-            {
-                iLength ++;
-                iLength >>= 1;
-            }
-
-            if( iLength + iOffSize >= ISO8583_MAXLENTH )
-                return( -3 );
-
-            for( k = 0; k < iLength; k ++ )
-                pIso8583Data->cData[ iOffSize ++ ] = *pRpt ++;
-
-            pIso8583Data->Field[ iFieldNum ].bitf = 1;
-        }
-    }
-
-    pIso8583Data->iOffset = iOffSize;
-    return( 0 );
-}
-
-/* -----------------------------------------------------------------------------
- * FUNCTION NAME:   ISO8583Engine_Iso8583ToHexbuf
- * DESCRIPTION:     Convert ISO8583_Rec struct to Hex buffer - RAW ISO8583 data
- * PARAMETERS:      pIso8583Data: Iso8583 data structure
- *                  pRetBuf: RAW iso8583 hex buf data
- *                  iSizeRetBuf: size of pRetBuf
- * RETURN:          >0: success,
- *                  -1: variable field length error
- *                  -2: iFieldNo >= ISO8583_MAXFIELD or iFieldNo < 1
- *                  -3: iso8583 string total length already > iSizeRetBuf
- *                  -4: iso8583 string total length already > ISO8583_MAXLENTH
- ---------------------------------------------------------------------------- */
-int ISO8583Engine_Iso8583ToHexbuf( ISO8583_Rec * pIso8583Data, byte * pRetBuf, int iSizeRetBuf )
-{
-    byte * cpWpt, cBitmask, cBitmap;
-    int iFieldNum, iBitnum;
-    int i, j, k, iLength;
-    ISO8583Utils_ASC2BCD( pIso8583Data->cMsgID, pRetBuf, 4 );
-
-    if(( BitMapMode == ISO8583_BITMAP128 ) && ( ISO8583_MAXFIELD == 128 ) )
-        iBitnum = 16;
-    else
-        iBitnum = 8;
-
-    cpWpt = pRetBuf + 2 + iBitnum;
-
-    for( i = 0; i < iBitnum; i ++ )
-    {
-        cBitmap = 0;
-        cBitmask = 0x80;
-
-        for( j = 0; j < 8; j ++, cBitmask >>= 1 )
-        {
-            iFieldNum = ( i << 3 ) + j ;
-
-            if( pIso8583Data->Field[ iFieldNum ].bitf == 0 )
-                continue;
-
-            if( iFieldNum < 1 || iFieldNum >= ISO8583_MAXFIELD )
-                return( -2 );
-
-            if(( cpWpt - pRetBuf ) > iSizeRetBuf )
-                return ( -3 );
-
-            cBitmap |= cBitmask;
-            iLength = pIso8583Data->Field[ iFieldNum ].len;
-
-            if( ISO8583FldFormat[ iFieldNum ].bType & ISO8583TYPE_VAR )
-            {
-                if( ISO8583FldFormat[ iFieldNum ].iMaxLength <= 99 )
-                {
-                    ISO8583Utils_LEN2BCD( iLength, cpWpt, 1 );
-                    cpWpt ++;
-                }
-                else
-                {
-                    ISO8583Utils_LEN2BCD( iLength, cpWpt, 2 );
-                    cpWpt += 2;
-                }
-            }
-
-            k = 0 ;
-
-            if( ISO8583FldFormat[ iFieldNum ].bType & ( ISO8583TYPE_BCD | ISO8583TYPE_DIGIT ) )
-            {
-                iLength ++ ;
-                iLength >>= 1;
-            }
-
-            for( ; k < iLength; k ++ )
-            {
-                if(( pIso8583Data->Field[ iFieldNum ].addr + k < 0 ) || ( pIso8583Data->Field[ iFieldNum ].addr + k >= ISO8583_MAXLENTH ) )
-                    return( -4 );
-
-                ( *cpWpt ++ ) = pIso8583Data->cData[ pIso8583Data->Field[ iFieldNum ].addr + k ];
-            }
-        }
-
-        pRetBuf[ i + 2 ] = cBitmap;
-    }
-
-    if( iBitnum == 16 )
-        pRetBuf[ 2 ] |= 0x80;
-
-    return( cpWpt - pRetBuf );
-}
-
-
-
-/* --------------------------------------------------------------------------
-* FUNCTION NAME: ISO8583Utils_BCD2ASC
-* DESCRIPTION:   Convert BCD code to ASCII code.
-* PARAMETERS:    BcdBuf - BCD input buffer, Len - double length of Bcdbuf bytes
-*                AscBuf - converted result
-* RETURN:        0
-* NOTES:
-* ------------------------------------------------------------------------ */
-int ISO8583Utils_BCD2ASC(unsigned char * BcdBuf, unsigned char * AscBuf, int Len)
-{
-    int i;
-
-    for (i = 0; i < Len; i++)
-    {
-        AscBuf[i] = (i % 2) ? (BcdBuf[i / 2] & 0x0f) : ((BcdBuf[i / 2] >> 4) & 0x0f);
-        AscBuf[i] += ((AscBuf[i] > 9) ? ('A' - 10) : '0');
-    }
-
-    return 0;
-}
-
-
-/* --------------------------------------------------------------------------
-* FUNCTION NAME: ISO8583Utils_ASC2BCD
-* DESCRIPTION:   Convert ASCII code to BCD code.
-* PARAMETERS:    AscBuf - Ascii input buffer, must ended by '\0'
-*                Len - double length of BCD code, should be even.
-*                BcdBuf - converted BCD code result
-* RETURN:        0
-* NOTES:         support 'A'-'F' convertion(extend BCD code)
-* ------------------------------------------------------------------------ */
-int ISO8583Utils_ASC2BCD(unsigned char * AscBuf, unsigned char * BcdBuf, int Len)
-{
-    int  i;
-    unsigned char str[2] = {0};
-
-    for (i = 0; i < Len; i += 2)
-    {
-        if ((AscBuf[i] >= 'a') && (AscBuf[i] <= 'f'))
-        {
-            str[0] = AscBuf[i] - 'a' + 0x0A;
-        }
-        else if ((AscBuf[i] >= 'A') && (AscBuf[i] <= 'F'))
-        {
-            str[0] = AscBuf[i] - 'A' + 0x0A;
-        }
-        else if (AscBuf[i] >= '0')
-        {
-            str[0] = AscBuf[i] - '0';
-        }
-        else
-        {
-            str[0] = 0;
-        }
-
-        if ((AscBuf[i + 1] >= 'a') && (AscBuf[i + 1] <= 'f'))
-        {
-            str[1] = AscBuf[i + 1] - 'a' + 0x0A;
-        }
-        else if ((AscBuf[i + 1] >= 'A') && (AscBuf[i + 1] <= 'F'))
-        {
-            str[1] = AscBuf[i + 1] - 'A' + 0x0A;
-        }
-        else if (AscBuf[1] >= '0')
-        {
-            str[1] = AscBuf[i + 1] - '0';
-        }
-        else
-        {
-            str[1] = 0;
-        }
-
-        BcdBuf[i / 2] = (str[0] << 4) | (str[1] & 0x0F);
-    }
-
-    return 0;
-}
-
-/* -----------------------------------------------------------------------------
- * FUNCTION NAME:   ISO8583Utils_BCD2LEN
- * DESCRIPTION:     Convert BcdLen bytes BCD length to int
- * RETURN:          None
- ---------------------------------------------------------------------------- */
-int ISO8583Utils_BCD2LEN( unsigned char * BcdBuf, int * Len, int BcdLen )
-{
-    int i;
-    unsigned short usLen = 0;
-
-    if(BcdLen <= 0 || BcdLen > 10)
-        return -1;
-
-    for (i = 0; i < BcdLen; i++)
-    {
-        usLen = usLen * 100 + (((*(BcdBuf + i)) & 0xF0) >> 4) * 10 + ((*(BcdBuf + i)) & 0x0F);
-    }
-
-    *Len = (int)usLen;
-    return 0;
-}
-
-/* -----------------------------------------------------------------------------
- * FUNCTION NAME:   ISO8583Utils_LEN2BCD
- * DESCRIPTION:     Convert BcdLen bytes BCD length to int
- * PARAMETERS:
- * RETURN:          None
- ---------------------------------------------------------------------------- */
-int ISO8583Utils_LEN2BCD( int Len, byte * BcdBuf, int BcdLen)
-{
-    char  format[10], str[20];
-
-    if (BcdLen > 10)
-    {
-        return -1;
-    }
-
-    memset(format, 0, sizeof(format));
-    sprintf(format, "%c0%lulu", '%', (unsigned long)(BcdLen * 2));
-    sprintf((char *)str, (char *)format, Len);
-    ISO8583Utils_ASC2BCD((byte *)str, BcdBuf, BcdLen * 2);
-    return 0;
-}
+/***************************************************************************
+* FILE NAME:    ISO8583Engine.C                                            *
+* MODULE NAME:  ISO8583Engine                                              *
+* PROGRAMMER:                                                              *
+* DESCRIPTION:                                                             *
+* REVISION:                                                                *
+****************************************************************************/
+
+#if defined( _WIN32 )
+#include <conio.h>
+#endif
+#include <string.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ISO8583Engine.h"
+#include "ISO8583Bits.h"
+#include "ISO8583Pool.h"
+#include "ISO8583Stats.h"
+
+/*-----------------------------------------------------------------------------
+ * Internal functions
+ *-----------------------------------------------------------------------------*/
+
+//Read the length of field iFieldNum (0 based) at *ppRpt and step over its length
+//prefix. *piLength gets the field length as kept in ISO8583_ElementFlag.len
+//(digits for BCD fields), the return value is the number of data bytes on the
+//wire or <0 on error. pEnd bounds the read, NULL trusts the buffer.
+static int DecodeFieldLength( const ISO8583_Spec * pSpec, int iFieldNum, const byte ** ppRpt, const byte * pEnd, int * piLength )
+{
+    const ISO8583_FieldOp * pOp = &pSpec->Op[ iFieldNum ];
+    const byte * pRpt = *ppRpt;
+    int iLength, iWire;
+
+    if( pOp->bPrefix == 0 )
+    {
+        iLength = pOp->usLength;
+        iWire = pOp->usWire;
+    }
+    else
+    {
+        if( pEnd != NULL && pEnd - pRpt < pOp->bPrefix )
+            return ISOENGINE_TRUNCATED_MSG;
+
+        //Same sum as ISO8583Utils_BCD2LEN, bad nibbles included
+        iLength = ( pRpt[ 0 ] >> 4 ) * 10 + ( pRpt[ 0 ] & 0x0F );
+
+        if( pOp->bPrefix == 2 )
+            iLength = iLength * 100 + ( pRpt[ 1 ] >> 4 ) * 10 + ( pRpt[ 1 ] & 0x0F );
+
+        pRpt += pOp->bPrefix;
+
+        if( iLength > pOp->usMaxLength )
+            return( -1 );
+
+        iWire = pOp->bPacked ? ( iLength + 1 ) >> 1 : iLength;
+    }
+
+    *ppRpt = pRpt;
+    *piLength = iLength;
+
+    if( pEnd != NULL && pEnd - pRpt < iWire )
+        return ISOENGINE_TRUNCATED_MSG;
+
+    return iWire;
+}
+
+//Bytes of field iFieldNum (0 based) on the wire, and in ISO8583_Rec.cData,
+//for a field length iLength as kept in ISO8583_ElementFlag.len
+static int FieldWireSize( const ISO8583_Spec * pSpec, int iFieldNum, int iLength )
+{
+    if( pSpec->Op[ iFieldNum ].bPacked )
+        return ( iLength + 1 ) >> 1;
+
+    return iLength;
+}
+
+//Bytes of the length prefix of field iFieldNum (0 based)
+static int FieldPrefixSize( const ISO8583_Spec * pSpec, int iFieldNum )
+{
+    return pSpec->Op[ iFieldNum ].bPrefix;
+}
+
+//Field length kept in ISO8583_ElementFlag.len when *piDataLength bytes of ASC
+//data are set to field iFieldNum (0 based). *piDataLength is cut to the
+//maximum length of the field.
+static int StoreFieldLength( const ISO8583_Spec * pSpec, int iFieldNum, int * piDataLength )
+{
+    const ISO8583_FieldFormat * pFmt = &pSpec->FldFormat[ iFieldNum ];
+
+    if( *piDataLength > pFmt->iMaxLength )
+        *piDataLength = pFmt->iMaxLength;
+
+    if( pFmt->bType & ISO8583TYPE_FIX )
+        return pFmt->iMaxLength;
+    else if( pFmt->bType & ISO8583TYPE_BIN )
+        return pFmt->iMaxLength / 8;
+
+    return *piDataLength;
+}
+
+//Bytes StoreFieldData writes for field length iLength
+static int StoreFieldSize( const ISO8583_Spec * pSpec, int iFieldNum, int iLength )
+{
+    if( pSpec->FldFormat[ iFieldNum ].bType & ISO8583TYPE_BCD )
+        return ( iLength + ( iFieldNum == 1 ) + 1 ) >> 1;
+
+    return iLength;
+}
+
+//Pad iDataLength bytes of ASC data to field length iLength and store them at
+//pRpt in the field's own format. Field 2 gets a trailing 'F'. Only
+//iDataLength bytes of pFieldData are read.
+static void StoreFieldData( const ISO8583_Spec * pSpec, int iFieldNum, const unsigned char * pFieldData, int iDataLength, int iLength, byte * pRpt )
+{
+    byte cTemp[ 1000 + 2 ];
+    int i = 0;
+
+    //Other than packed BCD the data is stored as is, short fixed ASC data is
+    //padded with spaces and binary data with zeros
+    if( !( pSpec->FldFormat[ iFieldNum ].bType & ISO8583TYPE_BCD ) )
+    {
+        if( iDataLength > iLength )
+            iDataLength = iLength;
+
+        memcpy( pRpt, pFieldData, iDataLength );
+        memset( pRpt + iDataLength, ( pSpec->FldFormat[ iFieldNum ].bType & ISO8583TYPE_BIN ) ? 0 : ' ', iLength - iDataLength );
+        return;
+    }
+
+    if( pSpec->FldFormat[ iFieldNum ].bType & ISO8583TYPE_DIGIT )
+    {
+        for( ; i < iLength - iDataLength; i ++ )
+            cTemp[ i ] = '0';
+    }
+
+    memcpy( cTemp + i, pFieldData, iDataLength ) ;
+    i += iDataLength;
+
+    if( pSpec->FldFormat[ iFieldNum ].bType & ISO8583TYPE_BIN )
+    {
+        for( ; i < iLength; i ++ )
+            cTemp[ i ] = 0;
+    }
+    else if( iFieldNum == 1 )
+    {
+        for( cTemp[ i ++ ] = 'F'; i <= iLength; i ++ )
+            cTemp[ i ] = 0;
+
+        iLength ++;
+    }
+    else
+    {
+        for( ; i < iLength; i ++ )
+            cTemp[ i ] = ' ';
+    }
+
+    //ASC2BCD reads one char past an odd length
+    cTemp[ iLength ] = 0;
+    ISO8583Utils_ASC2BCD( cTemp, pRpt, iLength );
+}
+
+//Bytes of cData held by field iFieldNum (0 based): up to the data of the next
+//field stored after it, or to iOffset. 0 when the field is not in cData.
+static int StoredFieldSize( const ISO8583_Rec * pIso8583Data, int iFieldNum )
+{
+    int i, iIdx, iAddr = pIso8583Data->Field[ iFieldNum ].addr, iNext = pIso8583Data->iOffset;
+    unsigned long long ullBits;
+
+    if( iAddr < 0 || iAddr >= iNext )
+        return 0;
+
+    for( i = 0; i < ISO8583_MAXFIELD / 64; i ++ )
+    {
+        for( ullBits = pIso8583Data->ulBitmap[ i ]; ullBits; ullBits &= ullBits - 1 )
+        {
+            iIdx = ( i << 6 ) + ISO8583Bits_Ctz64( ullBits );
+
+            if( pIso8583Data->Field[ iIdx ].addr > iAddr && pIso8583Data->Field[ iIdx ].addr < iNext )
+                iNext = pIso8583Data->Field[ iIdx ].addr;
+        }
+    }
+
+    return iNext - iAddr;
+}
+
+//Drop the iSize bytes of field iFieldNum (0 based) from cData, the data of
+//fields stored after it moves down
+static void CompactField( ISO8583_Rec * pIso8583Data, int iFieldNum, int iSize )
+{
+    int i, iIdx, iAddr = pIso8583Data->Field[ iFieldNum ].addr;
+    unsigned long long ullBits;
+
+    if( iAddr < 0 || iSize <= 0 || iAddr + iSize > pIso8583Data->iOffset )
+        return;
+
+    memmove( &pIso8583Data->cData[ iAddr ], &pIso8583Data->cData[ iAddr + iSize ], pIso8583Data->iOffset - iAddr - iSize );
+    pIso8583Data->iOffset -= iSize;
+
+    for( i = 0; i < ISO8583_MAXFIELD / 64; i ++ )
+    {
+        for( ullBits = pIso8583Data->ulBitmap[ i ]; ullBits; ullBits &= ullBits - 1 )
+        {
+            iIdx = ( i << 6 ) + ISO8583Bits_Ctz64( ullBits );
+
+            if( pIso8583Data->Field[ iIdx ].addr > iAddr )
+                pIso8583Data->Field[ iIdx ].addr -= iSize;
+        }
+    }
+}
+
+//Field data at pRpt to ASC format, the common tail of the GetField functions
+static int CopyFieldData( const ISO8583_Spec * pSpec, int iFieldNum, const byte * pRpt, int iLength, unsigned char * pRetFieldData, int iSizeofRetFieldData )
+{
+    if( iLength > iSizeofRetFieldData )
+        iLength = iSizeofRetFieldData;
+
+    if( pSpec->FldFormat[ iFieldNum ].bType & ( ISO8583TYPE_BCD | ISO8583TYPE_DIGIT ) )
+        ISO8583Utils_BCD2ASC(( byte * )pRpt, pRetFieldData, iLength );
+    else
+        memcpy( pRetFieldData, pRpt, iLength );
+
+    return (iLength);
+}
+
+//Make room in cData for field iFieldNum (0 based) of length iLength and mark
+//it set, *ppRpt gets where its data goes. A field set before is overwritten
+//in place when the new data fits, otherwise its old bytes are dropped from
+//cData and the field is appended.
+static int PlaceField( const ISO8583_Spec * pSpec, ISO8583_Rec * pIso8583Data, int iFieldNum, int iLength, byte ** ppRpt )
+{
+    int iSize, iOldSize;
+    byte * pRpt = NULL;
+
+    if( ISO8583Engine_ReserveFields( pIso8583Data, iFieldNum + 1 ) != ISOENGINE_OK )
+        return ISOENGINE_INVALID_FIELD_NO;
+
+    if( iLength > 999 )
+        return ISOENGINE_TOO_LONG_FILED_LENGTH;
+
+    iSize = StoreFieldSize( pSpec, iFieldNum, iLength );
+
+    if( ISO8583_BITMAP_TEST( pIso8583Data->ulBitmap, iFieldNum ) )
+    {
+        iOldSize = StoredFieldSize( pIso8583Data, iFieldNum );
+
+        if( iSize <= iOldSize )
+            pRpt = &pIso8583Data->cData[ pIso8583Data->Field[ iFieldNum ].addr ];
+        else
+            CompactField( pIso8583Data, iFieldNum, iOldSize );
+    }
+
+    if( pRpt == NULL )
+    {
+        if( ISO8583Engine_Reserve( pIso8583Data, pIso8583Data->iOffset + iSize + 1 ) != ISOENGINE_OK )
+            return ISOENGINE_OVER_MAXLENGTH;
+
+        pIso8583Data->Field[ iFieldNum ].addr = pIso8583Data->iOffset;
+        pRpt = &pIso8583Data->cData[ pIso8583Data->iOffset ];
+        pIso8583Data->iOffset += iSize;
+    }
+
+    pIso8583Data->Field[ iFieldNum ].bitf = 1;
+    pIso8583Data->Field[ iFieldNum ].len = iLength;
+    ISO8583_BITMAP_SET( pIso8583Data->ulBitmap, iFieldNum );
+
+    *ppRpt = pRpt;
+    return ISOENGINE_OK;
+}
+
+//Integer value of field iFieldNum (0 based) at pRpt, the common tail of the
+//numeric GetField functions
+static int FieldValue( const ISO8583_Spec * pSpec, int iFieldNum, const byte * pRpt, int iLength, unsigned long long * pullValue )
+{
+    int iRet;
+
+    if(( pSpec->FldFormat[ iFieldNum ].bType & ISO8583TYPE_BIN ) || iLength <= 0 )
+        return ISOENGINE_INVALID_FIELD_DATA;
+
+    if( pSpec->FldFormat[ iFieldNum ].bType & ( ISO8583TYPE_BCD | ISO8583TYPE_DIGIT ) )
+        iRet = ISO8583Utils_BCD2U64( pRpt, iLength, pullValue );
+    else
+        iRet = ISO8583Utils_ASC2U64( pRpt, iLength, pullValue );
+
+    if( iRet == -1 )
+        return ISOENGINE_INVALID_FIELD_DATA;
+    else if( iRet < 0 )
+        return ISOENGINE_OVER_MAXLENGTH;
+
+    return iLength;
+}
+
+//Amount in units of 10^-iScale, only exact conversions are done
+static int ScaleAmount( const ISO8583_Amount * pAmount, int iScale, unsigned long long * pullValue )
+{
+    unsigned long long ullValue;
+    int i;
+
+    if( pAmount->llValue < 0 || pAmount->iScale < 0 || pAmount->iScale > 18 || iScale < 0 || iScale > 18 )
+        return ISOENGINE_INVALID_FIELD_DATA;
+
+    ullValue = ( unsigned long long )pAmount->llValue;
+
+    for( i = pAmount->iScale; i < iScale; i ++ )
+    {
+        if( ullValue > ~0ULL / 10 )
+            return ISOENGINE_TOO_LONG_FILED_LENGTH;
+
+        ullValue *= 10;
+    }
+
+    for( i = iScale; i < pAmount->iScale; i ++ )
+    {
+        if( ullValue % 10 != 0 )
+            return ISOENGINE_INVALID_FIELD_DATA;
+
+        ullValue /= 10;
+    }
+
+    *pullValue = ullValue;
+    return ISOENGINE_OK;
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Engine_InitFieldFormat
+ * DESCRIPTION:     Set ISO8583 field type and format, should be called
+ *                  before the using of ISO8583 engine module
+ * PARAMETERS:      pSpec(out): spec context to initiate
+ *                  bBitMode: Iso8583 bitmap mode, see enum ISO8583_BitMode in ISO8583Engine.h
+ *                  pFieldFormat: poFieldFormat definitions
+ * RETURN:          ISOENGINE_OK
+ ---------------------------------------------------------------------------- */
+int ISO8583Engine_InitFieldFormat( ISO8583_Spec * pSpec, ISO8583_BitMode bBitMode, const ISO8583_FieldFormat *pIso8583FieldFormat )
+{
+    const ISO8583_FieldFormat * pFmt;
+    int i;
+
+    pSpec->bFldFormatSetFlag = TRUE;
+    pSpec->bBitMapMode = bBitMode;
+    pSpec->iMaxField = bBitMode == ISO8583_BITMAP64 ? ISO8583_PRIMARYFIELD : ISO8583_MAXFIELD;
+
+    memset(( unsigned char * ) pSpec->FldFormat, 0, sizeof( pSpec->FldFormat ) );
+    memcpy(( unsigned char * ) pSpec->FldFormat, ( const unsigned char * )pIso8583FieldFormat, pSpec->iMaxField * sizeof( ISO8583_FieldFormat ) );
+    memset( pSpec->Op, 0, sizeof( pSpec->Op ) );
+
+    //Compile the bType bits once, the way DecodeFieldLength used to test them
+    for( i = 0; i < pSpec->iMaxField; i ++ )
+    {
+        pFmt = &pSpec->FldFormat[ i ];
+        pSpec->Op[ i ].bPacked = ( pFmt->bType & ( ISO8583TYPE_BCD | ISO8583TYPE_DIGIT ) ) != 0;
+        pSpec->Op[ i ].usMaxLength = ( unsigned short )pFmt->iMaxLength;
+
+        if( pSpec->Op[ i ].bPacked )
+            pSpec->Op[ i ].bClass = i == 34 || i == 35 ? ISO8583_CLASS_Z : ISO8583_CLASS_N;
+        else if( pFmt->bType != 0 && !( pFmt->bType & ISO8583TYPE_BIN ) )
+            pSpec->Op[ i ].bClass = ISO8583_CLASS_ANS;
+
+        pSpec->Op[ i ].bLuhn = i == 1 && pSpec->Op[ i ].bPacked;
+
+        if( pFmt->bType & ISO8583TYPE_VAR )
+            pSpec->Op[ i ].bPrefix = pFmt->iMaxLength > 99 ? 2 : 1;
+        else
+        {
+            pSpec->Op[ i ].usLength = ( unsigned short )(( pFmt->bType & ISO8583TYPE_BIN ) ? pFmt->iMaxLength / 8 : pFmt->iMaxLength );
+            pSpec->Op[ i ].usWire = ( unsigned short )( pSpec->Op[ i ].bPacked ? ( pSpec->Op[ i ].usLength + 1 ) >> 1 : pSpec->Op[ i ].usLength );
+        }
+    }
+
+    return ISOENGINE_OK;
+}
+
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Engine_InitRec
+ * DESCRIPTION:     Initiate an ISO8583_Rec on caller-owned field data storage
+ * PARAMETERS:      ptIso8583Data: ISO8583 data structure
+ *                  pBuf: field data area
+ *                  iSize: size of pBuf
+ * RETURN:          ISOENGINE_OK
+ ---------------------------------------------------------------------------- */
+int ISO8583Engine_InitRec( ISO8583_Rec * ptIso8583Data, unsigned char * pBuf, int iSize )
+{
+    memset(( char * ) ptIso8583Data, 0, sizeof( ISO8583_Rec ) );
+    ptIso8583Data->cData = pBuf;
+    ptIso8583Data->iCapacity = iSize;
+    ptIso8583Data->Field = ptIso8583Data->PrimaryField;
+    ptIso8583Data->iMaxField = ISO8583_PRIMARYFIELD;
+    return ISOENGINE_OK;
+}
+
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Engine_InitFixRec
+ * DESCRIPTION:     Initiate an ISO8583_FixRec on its own buffer
+ * PARAMETERS:      ptFixRec: record with inline storage
+ * RETURN:          The record inside ptFixRec
+ ---------------------------------------------------------------------------- */
+ISO8583_Rec * ISO8583Engine_InitFixRec( ISO8583_FixRec * ptFixRec )
+{
+    ISO8583Engine_InitRec( &ptFixRec->Rec, ptFixRec->cBuf, sizeof( ptFixRec->cBuf ) );
+    memset(( char * ) ptFixRec->Field, 0, sizeof( ptFixRec->Field ) );
+    ptFixRec->Rec.Field = ptFixRec->Field;
+    ptFixRec->Rec.iMaxField = ISO8583_MAXFIELD;
+    return &ptFixRec->Rec;
+}
+
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Engine_Reserve
+ * DESCRIPTION:     Make sure the field data area holds at least iSize bytes
+ * PARAMETERS:      ptIso8583Data: ISO8583 data structure
+ *                  iSize: bytes needed
+ * RETURN:          ISOENGINE_OK or ISOENGINE_OVER_MAXLENGTH
+ ---------------------------------------------------------------------------- */
+int ISO8583Engine_Reserve( ISO8583_Rec * ptIso8583Data, int iSize )
+{
+    if( iSize <= ptIso8583Data->iCapacity )
+        return ISOENGINE_OK;
+
+    if( ptIso8583Data->pPool == NULL )
+        return ISOENGINE_OVER_MAXLENGTH;
+
+    return ISO8583Pool_Grow( ptIso8583Data, iSize );
+}
+
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Engine_ReserveFields
+ * DESCRIPTION:     Make sure Field holds at least iMaxField entries
+ * PARAMETERS:      ptIso8583Data: ISO8583 data structure
+ *                  iMaxField: entries needed, at most ISO8583_MAXFIELD
+ * RETURN:          ISOENGINE_OK or ISOENGINE_INVALID_FIELD_NO
+ ---------------------------------------------------------------------------- */
+int ISO8583Engine_ReserveFields( ISO8583_Rec * ptIso8583Data, int iMaxField )
+{
+    if( iMaxField <= ptIso8583Data->iMaxField )
+        return ISOENGINE_OK;
+
+    if( ptIso8583Data->pPool == NULL || iMaxField > ISO8583_MAXFIELD )
+        return ISOENGINE_INVALID_FIELD_NO;
+
+    //Grow in one step to the secondary bitmap range
+    return ISO8583Pool_GrowFields( ptIso8583Data, ISO8583_MAXFIELD );
+}
+
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Engine_ClearAllFields
+ * DESCRIPTION:     Clear all field data in ISO8583_Rec structure, only the
+ *                  fields set are visited. The field data area is kept.
+ * PARAMETERS:      ptIso8583Data: ISO8583 data structure
+ * RETURN:          None.
+ ---------------------------------------------------------------------------- */
+int ISO8583Engine_ClearAllFields( ISO8583_Rec * ptIso8583Data )
+{
+    unsigned long long ullBits;
+    int i;
+
+    for( i = 0; i < ISO8583_MAXFIELD / 64; i ++ )
+    {
+        for( ullBits = ptIso8583Data->ulBitmap[ i ]; ullBits; ullBits &= ullBits - 1 )
+            ptIso8583Data->Field[ ( i << 6 ) + ISO8583Bits_Ctz64( ullBits ) ].bitf = 0;
+
+        ptIso8583Data->ulBitmap[ i ] = 0;
+    }
+
+    ptIso8583Data->iOffset = 0;
+    ptIso8583Data->cMsgID[ 0 ] = 0;
+    return ISOENGINE_OK;
+}
+
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Engine_ClearOneField
+ * DESCRIPTION:     Clear one field data
+ * PARAMETERS:      ptIso8583Data: pointer to ISO8583 data structure
+ *                  iFieldNo: Field No
+ * RETURN:          None
+ ---------------------------------------------------------------------------- */
+int ISO8583Engine_ClearOneField( ISO8583_Rec * ptIso8583Data, int iFieldNo )
+{
+    if( iFieldNo >= 1 && iFieldNo <= ISO8583_MAXFIELD )
+    {
+        if( iFieldNo <= ptIso8583Data->iMaxField )
+            ptIso8583Data->Field[ iFieldNo - 1 ].bitf = 0;
+
+        ISO8583_BITMAP_CLEAR( ptIso8583Data->ulBitmap, iFieldNo - 1 );
+    }
+    else
+        return ISOENGINE_INVALID_FIELD_NO;
+
+    return ISOENGINE_OK;
+}
+
+
+//ISO8583Engine_SetField without the instrumentation
+static int SetField( const ISO8583_Spec * pSpec, ISO8583_Rec * pIso8583Data, int iFieldNo, unsigned char * pFieldData, int iDataLength )
+{
+    int len, iFieldNum, iLength, iRet;
+    byte * pRpt;
+
+    if( pSpec->bFldFormatSetFlag != TRUE )
+        return ISOENGINE_NOT_SET_FIELD_FMT;
+
+    iFieldNum = iFieldNo;
+    len = iDataLength;
+
+    if( len <= 0 )
+        return ISOENGINE_INVALID_FIELD_LENGTH;
+
+    if( iFieldNum == 0 )
+    {
+        memcpy( pIso8583Data->cMsgID, pFieldData, 4 );
+        pIso8583Data->cMsgID[ 4 ] = 0;
+        return ISOENGINE_OK;
+    }
+
+    if( iFieldNum <= 1 || iFieldNum > pSpec->iMaxField )
+    {
+        return ISOENGINE_INVALID_FIELD_NO;
+    }
+
+    iFieldNum --;
+    iLength = StoreFieldLength( pSpec, iFieldNum, &len );
+    iRet = PlaceField( pSpec, pIso8583Data, iFieldNum, iLength, &pRpt );
+
+    if( iRet != ISOENGINE_OK )
+        return iRet;
+
+    StoreFieldData( pSpec, iFieldNum, pFieldData, len, iLength, pRpt );
+    return ISOENGINE_OK;
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Engine_SetField
+ * DESCRIPTION:     Set ISO8583 field data. Setting a field again replaces it,
+ *                  in place when the new data is not longer.
+ * PARAMETERS:      pSpec: spec context
+ *                  pIso8583Data: ISO8583 data struct
+ *                  iFieldNo: Field No
+ *                  pFieldData: Field data
+ *                  iDataLength: Length of field data
+ * RETURN:          ISOENGINE_OK: Suceess
+ *                  ISOENGINE_NOT_SET_FIELD_FMT: not set iso8583 field format
+ *                  ISOENGINE_INVALID_FIELD_NO: iFieldNo beyond the spec or the
+ *                                              record, or iFieldNo <= 1
+ *                  ISOENGINE_TOO_LONG_FILED_LENGTH: iDataLength > 999
+ *                  -4: iso8583 string total length already > capacity of the record
+ ---------------------------------------------------------------------------- */
+int ISO8583Engine_SetField( const ISO8583_Spec * pSpec, ISO8583_Rec * pIso8583Data, int iFieldNo, unsigned char * pFieldData, int iDataLength )
+{
+    int iRet;
+    ISO8583_STATS_BEGIN( ISO8583_STATS_OP_SETFIELD );
+
+    iRet = SetField( pSpec, pIso8583Data, iFieldNo, pFieldData, iDataLength );
+    ISO8583_STATS_END( ISO8583_STATS_OP_SETFIELD );
+
+    if( iRet < 0 )
+        ISO8583_STATS_ERROR( iRet, iFieldNo );
+
+    return iRet;
+}
+
+
+//ISO8583Engine_GetField without the instrumentation
+static int GetField( const ISO8583_Spec * pSpec, ISO8583_Rec * pIso8583Data, int iFieldNo, unsigned char * pRetFieldData, int iSizeofRetFieldData )
+{
+    int iLength;
+    int iFieldNum;
+    byte * pRpt;
+
+    if( pSpec->bFldFormatSetFlag != TRUE )
+        return ISOENGINE_NOT_SET_FIELD_FMT;
+
+    iFieldNum = iFieldNo;
+
+    if( iFieldNum == 0 )
+    {
+        if(iSizeofRetFieldData < 5)
+        {
+            return ISOENGINE_TOO_SMALL_FIELD_BUF_SIZE;
+        }
+
+        memcpy( pRetFieldData, pIso8583Data->cMsgID, 4 );
+        pRetFieldData[ 4 ] = 0;
+        return (4);
+    }
+
+    if( iFieldNum <= 1 || iFieldNum > pSpec->iMaxField )
+        return (-2);
+
+    iFieldNum --;
+
+    if( !ISO8583_BITMAP_TEST( pIso8583Data->ulBitmap, iFieldNum ) )
+    {
+        pRetFieldData[ 0 ] = 0;
+        return ISOENGINE_OK;
+    }
+
+    if( pIso8583Data->Field[ iFieldNum ].addr < 0 || pIso8583Data->Field[ iFieldNum ].addr >= pIso8583Data->iCapacity )
+        return (-4);
+
+    pRpt = &pIso8583Data->cData[ pIso8583Data->Field[ iFieldNum ].addr ];
+    iLength = pIso8583Data->Field[ iFieldNum ].len;
+
+    if( iLength < 0 || iLength > 999 )
+        return (-3);
+
+    return CopyFieldData( pSpec, iFieldNum, pRpt, iLength, pRetFieldData, iSizeofRetFieldData );
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Engine_GetField
+ * DESCRIPTION:     Get ISO8583 field data, pRetFieldData must be ASC format
+ * PARAMETERS:      pSpec: spec context
+ *                  pIso8583Data: ISO8583 data struct
+ *                  iFieldNo: Field No
+ *                  pRetFieldData: Return field data buffer
+ *                  iSizeofRetFieldData: Length of pRetFieldData field data buffer
+ * RETURN:          >=0: suceess, return data length
+ *                  ISOENGINE_NOT_SET_FIELD_FMT: not set iso8583 field format
+ *                  -2: iFieldNo beyond the spec or iFieldNo <= 1
+ *                  -3: iDataLength > 999
+ *                  -4: field data outside of ISO8583_Rec.cData
+ ---------------------------------------------------------------------------- */
+int ISO8583Engine_GetField( const ISO8583_Spec * pSpec, ISO8583_Rec * pIso8583Data, int iFieldNo, unsigned char * pRetFieldData, int iSizeofRetFieldData )
+{
+    int iRet;
+    ISO8583_STATS_BEGIN( ISO8583_STATS_OP_GETFIELD );
+
+    iRet = GetField( pSpec, pIso8583Data, iFieldNo, pRetFieldData, iSizeofRetFieldData );
+    ISO8583_STATS_END( ISO8583_STATS_OP_GETFIELD );
+
+    if( iRet < 0 )
+        ISO8583_STATS_ERROR( iRet, iFieldNo );
+
+    return iRet;
+}
+
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Engine_GetFieldU64
+ * DESCRIPTION:     Get a numeric field as an integer, packed BCD is converted
+ *                  straight from the record with no ASC copy
+ * PARAMETERS:      pSpec: spec context
+ *                  pIso8583Data: ISO8583 data struct
+ *                  iFieldNo: Field No
+ *                  pullValue(out): field value, 0 when not present
+ * RETURN:          >0: success, digits of the field
+ *                  0: field not present
+ *                  <0: error
+ ---------------------------------------------------------------------------- */
+int ISO8583Engine_GetFieldU64( const ISO8583_Spec * pSpec, ISO8583_Rec * pIso8583Data, int iFieldNo, unsigned long long * pullValue )
+{
+    int iFieldNum = iFieldNo - 1;
+
+    if( pSpec->bFldFormatSetFlag != TRUE )
+        return ISOENGINE_NOT_SET_FIELD_FMT;
+
+    if( iFieldNo <= 1 || iFieldNo > pSpec->iMaxField )
+        return ISOENGINE_INVALID_FIELD_NO;
+
+    *pullValue = 0;
+
+    if( !ISO8583_BITMAP_TEST( pIso8583Data->ulBitmap, iFieldNum ) )
+        return ISOENGINE_OK;
+
+    if( pIso8583Data->Field[ iFieldNum ].addr < 0 || pIso8583Data->Field[ iFieldNum ].addr >= pIso8583Data->iCapacity )
+        return ISOENGINE_OVER_MAXLENGTH;
+
+    return FieldValue( pSpec, iFieldNum, &pIso8583Data->cData[ pIso8583Data->Field[ iFieldNum ].addr ],
+                       pIso8583Data->Field[ iFieldNum ].len, pullValue );
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Engine_GetFieldU32
+ * DESCRIPTION:     ISO8583Engine_GetFieldU64 of a field that fits 32 bits
+ * PARAMETERS:      puiValue(out): field value, 0 when not present
+ * RETURN:          As for ISO8583Engine_GetFieldU64
+ ---------------------------------------------------------------------------- */
+int ISO8583Engine_GetFieldU32( const ISO8583_Spec * pSpec, ISO8583_Rec * pIso8583Data, int iFieldNo, unsigned int * puiValue )
+{
+    unsigned long long ullValue;
+    int iRet;
+
+    iRet = ISO8583Engine_GetFieldU64( pSpec, pIso8583Data, iFieldNo, &ullValue );
+
+    if( iRet < 0 )
+        return iRet;
+
+    if( ullValue > 0xFFFFFFFFULL )
+        return ISOENGINE_OVER_MAXLENGTH;
+
+    *puiValue = ( unsigned int )ullValue;
+    return iRet;
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Engine_SetFieldU64
+ * DESCRIPTION:     Set a numeric field from an integer, packed BCD fields are
+ *                  written straight to the record with no ASC copy
+ * PARAMETERS:      pSpec: spec context
+ *                  pIso8583Data: ISO8583 data struct
+ *                  iFieldNo: Field No
+ *                  ullValue: field value
+ * RETURN:          ISOENGINE_OK or <0 error
+ ---------------------------------------------------------------------------- */
+int ISO8583Engine_SetFieldU64( const ISO8583_Spec * pSpec, ISO8583_Rec * pIso8583Data, int iFieldNo, unsigned long long ullValue )
+{
+    const ISO8583_FieldFormat * pFmt;
+    unsigned long long ullRest;
+    byte cPacked[ 500 ], cDigits[ 1000 + 1 ];
+    byte * pRpt;
+    int iDigits, iRet;
+
+    if( pSpec->bFldFormatSetFlag != TRUE )
+        return ISOENGINE_NOT_SET_FIELD_FMT;
+
+    if( iFieldNo <= 1 || iFieldNo > pSpec->iMaxField )
+        return ISOENGINE_INVALID_FIELD_NO;
+
+    pFmt = &pSpec->FldFormat[ iFieldNo - 1 ];
+
+    if( pFmt->bType & ISO8583TYPE_BIN )
+        return ISOENGINE_INVALID_FIELD_DATA;
+
+    for( iDigits = 1, ullRest = ullValue / 10; ullRest != 0; ullRest /= 10 )
+        iDigits ++;
+
+    //Fixed fields get leading zeros, variable ones the digits of the value
+    if( iDigits > pFmt->iMaxLength || pFmt->iMaxLength > 999 )
+        return ISOENGINE_TOO_LONG_FILED_LENGTH;
+
+    if( !( pFmt->bType & ISO8583TYPE_VAR ) )
+        iDigits = pFmt->iMaxLength;
+
+    //Field 2 takes the 'F' pad of SetField, other packed fields are written here
+    if(( pFmt->bType & ISO8583TYPE_BCD ) && iFieldNo != 2 )
+    {
+        iRet = PlaceField( pSpec, pIso8583Data, iFieldNo - 1, iDigits, &pRpt );
+
+        if( iRet == ISOENGINE_OK )
+            ISO8583Utils_U642BCD( ullValue, pRpt, iDigits );
+
+        return iRet;
+    }
+
+    ISO8583Utils_U642BCD( ullValue, cPacked, iDigits );
+    ISO8583Utils_BCD2ASC( cPacked, cDigits, iDigits );
+    return ISO8583Engine_SetField( pSpec, pIso8583Data, iFieldNo, cDigits, iDigits );
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Engine_GetFieldAmount
+ * DESCRIPTION:     Get an amount field as a fixed point amount
+ * PARAMETERS:      pSpec: spec context
+ *                  pIso8583Data: ISO8583 data struct
+ *                  iFieldNo: Field No
+ *                  iScale: decimal places of the field, e.g. the exponent of
+ *                          the currency in field 49
+ *                  pAmount(out): amount, 0 when not present
+ * RETURN:          As for ISO8583Engine_GetFieldU64
+ ---------------------------------------------------------------------------- */
+int ISO8583Engine_GetFieldAmount( const ISO8583_Spec * pSpec, ISO8583_Rec * pIso8583Data, int iFieldNo, int iScale, ISO8583_Amount * pAmount )
+{
+    unsigned long long ullValue;
+    int iRet;
+
+    iRet = ISO8583Engine_GetFieldU64( pSpec, pIso8583Data, iFieldNo, &ullValue );
+
+    if( iRet < 0 )
+        return iRet;
+
+    if( ullValue > 0x7FFFFFFFFFFFFFFFULL )
+        return ISOENGINE_OVER_MAXLENGTH;
+
+    pAmount->llValue = ( long long )ullValue;
+    pAmount->iScale = iScale;
+    return iRet;
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Engine_SetFieldAmount
+ * DESCRIPTION:     Set an amount field from a fixed point amount
+ * PARAMETERS:      pSpec: spec context
+ *                  pIso8583Data: ISO8583 data struct
+ *                  iFieldNo: Field No
+ *                  iScale: decimal places of the field
+ *                  pAmount: amount, rescaled to iScale
+ * RETURN:          ISOENGINE_OK or <0 error
+ ---------------------------------------------------------------------------- */
+int ISO8583Engine_SetFieldAmount( const ISO8583_Spec * pSpec, ISO8583_Rec * pIso8583Data, int iFieldNo, int iScale, const ISO8583_Amount * pAmount )
+{
+    unsigned long long ullValue;
+    int iRet;
+
+    iRet = ScaleAmount( pAmount, iScale, &ullValue );
+
+    if( iRet != ISOENGINE_OK )
+        return iRet;
+
+    return ISO8583Engine_SetFieldU64( pSpec, pIso8583Data, iFieldNo, ullValue );
+}
+
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Engine_ReserveField
+ * DESCRIPTION:     Make room for the data of a field to be written in place
+ * PARAMETERS:      pSpec: spec context
+ *                  pIso8583Data: ISO8583 data struct
+ *                  iFieldNo: Field No
+ *                  iSize: bytes to reserve, ignored for fixed fields
+ *                  ppData(out): where the field data goes
+ * RETURN:          >0: bytes reserved at *ppData
+ *                  ISOENGINE_INVALID_FIELD_DATA: packed BCD field
+ *                  ISOENGINE_INVALID_FIELD_LENGTH: iSize out of range
+ *                  other <0: as for ISO8583Engine_SetField
+ ---------------------------------------------------------------------------- */
+int ISO8583Engine_ReserveField( const ISO8583_Spec * pSpec, ISO8583_Rec * pIso8583Data, int iFieldNo, int iSize, byte ** ppData )
+{
+    const ISO8583_FieldOp * pOp;
+    int iRet;
+
+    if( pSpec->bFldFormatSetFlag != TRUE )
+        return ISOENGINE_NOT_SET_FIELD_FMT;
+
+    if( iFieldNo <= 1 || iFieldNo > pSpec->iMaxField )
+        return ISOENGINE_INVALID_FIELD_NO;
+
+    pOp = &pSpec->Op[ iFieldNo - 1 ];
+
+    if( pOp->bPacked )
+        return ISOENGINE_INVALID_FIELD_DATA;
+
+    if( pOp->bPrefix == 0 )
+        iSize = pOp->usLength;
+
+    if( iSize <= 0 || iSize > pOp->usMaxLength )
+        return ISOENGINE_INVALID_FIELD_LENGTH;
+
+    iRet = PlaceField( pSpec, pIso8583Data, iFieldNo - 1, iSize, ppData );
+
+    if( iRet != ISOENGINE_OK )
+        return iRet;
+
+    return iSize;
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Engine_CommitField
+ * DESCRIPTION:     Set the length of a field written in place
+ * PARAMETERS:      pSpec: spec context
+ *                  pIso8583Data: ISO8583 data struct
+ *                  iFieldNo: Field No
+ *                  iLength: bytes written
+ * RETURN:          ISOENGINE_OK
+ *                  ISOENGINE_INVALID_FIELD_NO: field not reserved
+ *                  ISOENGINE_INVALID_FIELD_LENGTH: iLength out of range
+ ---------------------------------------------------------------------------- */
+int ISO8583Engine_CommitField( const ISO8583_Spec * pSpec, ISO8583_Rec * pIso8583Data, int iFieldNo, int iLength )
+{
+    ISO8583_ElementFlag * pField;
+
+    if( iFieldNo <= 1 || iFieldNo > pSpec->iMaxField || iFieldNo > pIso8583Data->iMaxField
+        || !ISO8583_BITMAP_TEST( pIso8583Data->ulBitmap, iFieldNo - 1 ) || pSpec->Op[ iFieldNo - 1 ].bPacked )
+        return ISOENGINE_INVALID_FIELD_NO;
+
+    pField = &pIso8583Data->Field[ iFieldNo - 1 ];
+
+    if( iLength <= 0 || iLength > pField->len || ( pSpec->Op[ iFieldNo - 1 ].bPrefix == 0 && iLength != pField->len ) )
+        return ISOENGINE_INVALID_FIELD_LENGTH;
+
+    //The tail of the last field stored goes back to the record
+    if( pField->addr + pField->len == pIso8583Data->iOffset )
+        pIso8583Data->iOffset = pField->addr + iLength;
+
+    pField->len = iLength;
+    return ISOENGINE_OK;
+}
+
+
+//Check the content of field iFieldNum (0 based), iLength as kept in
+//ISO8583_ElementFlag.len, against its ISO8583_FieldOp. Returns the
+//ISO8583_CheckReason, *piBad the byte of pData in error.
+static int CheckFieldData( const ISO8583_Spec * pSpec, int iFieldNum, const byte * pData, int iLength, int * piBad )
+{
+    const ISO8583_FieldOp * pOp = &pSpec->Op[ iFieldNum ];
+    int iBad;
+
+    if( pOp->bPacked )
+    {
+        iBad = ISO8583Utils_CheckBCD( pData, iLength, pOp->bClass == ISO8583_CLASS_Z );
+
+        if( iBad >= 0 )
+        {
+            *piBad = iBad >> 1;
+            return ISO8583_CHECK_DIGIT;
+        }
+    }
+    else
+    {
+        iBad = ISO8583Utils_CheckChars( pData, iLength, pOp->bClass );
+
+        if( iBad >= 0 )
+        {
+            *piBad = iBad;
+            return pOp->bClass == ISO8583_CLASS_N || pOp->bClass == ISO8583_CLASS_Z ? ISO8583_CHECK_DIGIT : ISO8583_CHECK_CHARSET;
+        }
+    }
+
+    if( pOp->bLuhn && ISO8583Utils_Luhn( pData, iLength, pOp->bPacked ) != 0 )
+    {
+        *piBad = pOp->bPacked ? ( iLength - 1 ) >> 1 : iLength - 1;
+        return ISO8583_CHECK_LUHN;
+    }
+
+    return ISO8583_CHECK_OK;
+}
+
+//Record an error of the strict decode and return iRet
+static int CheckFailed( ISO8583_CheckError * pCheck, int iFieldNum, int iReason, size_t nOffset, int iRet )
+{
+    pCheck->iFieldNo = iFieldNum + 1;
+    pCheck->iReason = iReason;
+    pCheck->iOffset = ( int )nOffset;
+    return iRet;
+}
+
+//Decode a RAW message into a record, pEnd bounds the read (NULL trusts the
+//buffer), see ISO8583Engine_HexbufToIso8583. pCheck not NULL checks every
+//field as it is copied, see ISO8583Engine_HexbufToIso8583Strict. Returns the
+//bytes read, *piFieldNo gets the field of an error.
+static int DecodeFields( const ISO8583_Spec * pSpec, ISO8583_Rec * pIso8583Data, const byte * pBuf, const byte * pEnd, ISO8583_CheckError * pCheck, int * piFieldNo )
+{
+    int iReason, iBad;
+    int iOffSize, iLength, iWire, iWords;
+    int i, iFieldNum;
+    unsigned long long ullBits;
+    const byte * pRpt;
+
+    //Field[].bitf only mirrors ulBitmap, drop the flags of the previous content
+    for( i = 0; i < ISO8583_MAXFIELD / 64; i ++ )
+    {
+        for( ullBits = pIso8583Data->ulBitmap[ i ]; ullBits; ullBits &= ullBits - 1 )
+            pIso8583Data->Field[ ( i << 6 ) + ISO8583Bits_Ctz64( ullBits ) ].bitf = 0;
+
+        pIso8583Data->ulBitmap[ i ] = 0;
+    }
+
+    pIso8583Data->iOffset = 0;
+
+    if( pCheck != NULL )
+        CheckFailed( pCheck, -1, ISO8583_CHECK_OK, 0, 0 );
+
+    if( pEnd != NULL && pEnd - pBuf < 2 + 8 )
+    {
+        if( pCheck != NULL )
+            CheckFailed( pCheck, -1, ISO8583_CHECK_TRUNCATED, 0, 0 );
+        return ISOENGINE_TRUNCATED_MSG;
+    }
+
+    if( pCheck != NULL && ( ISO8583Utils_CheckBCD( pBuf, 4, FALSE ) >= 0 ) )
+        return CheckFailed( pCheck, -1, ISO8583_CHECK_MTI, 0, ISOENGINE_INVALID_FIELD_DATA );
+
+    iOffSize = 0;
+    ISO8583Utils_BCD2ASC(( byte * )pBuf, pIso8583Data->cMsgID, 4 );
+    pIso8583Data->cMsgID[ 4 ] = 0;
+
+    if(( pBuf[ 2 ] & 0x80 ) && ( pSpec->iMaxField == ISO8583_MAXFIELD ) )
+        iWords = 2;
+    else
+        iWords = 1;
+
+    if( pEnd != NULL && pEnd - pBuf < 2 + iWords * 8 )
+    {
+        if( pCheck != NULL )
+            CheckFailed( pCheck, 0, ISO8583_CHECK_TRUNCATED, 10, 0 );
+        return ISOENGINE_TRUNCATED_MSG;
+    }
+
+    //Secondary bitmap present and not empty, the record needs all 128 entries
+    if( iWords == 2 && ISO8583Bits_LoadWire( pBuf + 10 ) != 0
+        && ISO8583Engine_ReserveFields( pIso8583Data, ISO8583_MAXFIELD ) != ISOENGINE_OK )
+        return( -3 );
+
+    pRpt = pBuf + 2 + iWords * 8;
+
+    for( i = 0; i < iWords; i ++ )
+    {
+        ullBits = ISO8583Bits_LoadWire( pBuf + 2 + i * 8 );
+
+        if( i == 0 )
+            ullBits &= ~1ULL;
+
+        pIso8583Data->ulBitmap[ i ] = ullBits;
+
+        while( ullBits )
+        {
+            iFieldNum = ( i << 6 ) + ISO8583Bits_Ctz64( ullBits );
+            ullBits &= ullBits - 1;
+            *piFieldNo = iFieldNum + 1;
+
+            if( pCheck != NULL )
+            {
+                if( pSpec->FldFormat[ iFieldNum ].bType == 0 )
+                    return CheckFailed( pCheck, iFieldNum, ISO8583_CHECK_FORMAT, pRpt - pBuf, ISOENGINE_INVALID_FIELD_DATA );
+
+                if( pSpec->Op[ iFieldNum ].bPrefix != 0 && pEnd - pRpt >= pSpec->Op[ iFieldNum ].bPrefix
+                    && ( iBad = ISO8583Utils_CheckBCD( pRpt, pSpec->Op[ iFieldNum ].bPrefix * 2, FALSE ) ) >= 0 )
+                    return CheckFailed( pCheck, iFieldNum, ISO8583_CHECK_PREFIX, pRpt - pBuf + ( iBad >> 1 ), ISOENGINE_INVALID_FIELD_DATA );
+            }
+
+            iWire = DecodeFieldLength( pSpec, iFieldNum, &pRpt, pEnd, &iLength );
+
+            if( iWire < 0 )
+            {
+                if( pCheck == NULL )
+                    return iWire;
+                else if( iWire == ISOENGINE_TRUNCATED_MSG )
+                    return CheckFailed( pCheck, iFieldNum, ISO8583_CHECK_TRUNCATED, pRpt - pBuf, iWire );
+
+                return CheckFailed( pCheck, iFieldNum, ISO8583_CHECK_LENGTH, pRpt - pBuf, ISOENGINE_INVALID_FIELD_LENGTH );
+            }
+
+            if( pCheck != NULL && ( iReason = CheckFieldData( pSpec, iFieldNum, pRpt, iLength, &iBad ) ) != ISO8583_CHECK_OK )
+                return CheckFailed( pCheck, iFieldNum, iReason, pRpt - pBuf + iBad, ISOENGINE_INVALID_FIELD_DATA );
+
+            pIso8583Data->Field[ iFieldNum ].len = iLength;
+            pIso8583Data->Field[ iFieldNum ].addr = iOffSize;
+
+            pIso8583Data->iOffset = iOffSize;
+
+            if( ISO8583Engine_Reserve( pIso8583Data, iOffSize + iWire + 1 ) != ISOENGINE_OK )
+                return( -3 );
+
+            memcpy( &pIso8583Data->cData[ iOffSize ], pRpt, iWire );
+            pRpt += iWire;
+            iOffSize += iWire;
+            pIso8583Data->Field[ iFieldNum ].bitf = 1;
+        }
+    }
+
+    pIso8583Data->iOffset = iOffSize;
+    return( int )( pRpt - pBuf );
+}
+
+//DecodeFields with the instrumentation, 0 on success
+static int DecodeRec( const ISO8583_Spec * pSpec, ISO8583_Rec * pIso8583Data, const byte * pBuf, const byte * pEnd, ISO8583_CheckError * pCheck )
+{
+    int iRet, iFieldNo = 0;
+    ISO8583_STATS_BEGIN( ISO8583_STATS_OP_UNPACK );
+
+    iRet = DecodeFields( pSpec, pIso8583Data, pBuf, pEnd, pCheck, &iFieldNo );
+    ISO8583_STATS_END( ISO8583_STATS_OP_UNPACK );
+
+    if( iRet < 0 )
+    {
+        ISO8583_STATS_ERROR( iRet, iFieldNo );
+        return iRet;
+    }
+
+    ISO8583_STATS_UNPACKED( pIso8583Data->cMsgID, iRet, pIso8583Data->ulBitmap );
+    return( 0 );
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Engine_HexbufToIso8583
+ * DESCRIPTION:     Convert ISO8583 RAW hex buffer data to ISO8583_Rec struct
+ * PARAMETERS:      pSpec: spec context
+ *                  pIso8583Data(out): Converted Iso8583 data structure
+ *                  pBuf(in): RAW iso8583 hex buf data
+ * RETURN:          =0: success,
+ *                  -1: variable field length error
+ *                  -2: iFieldNo >= ISO8583_MAXFIELD or iFieldNo < 1
+ *                  -3: iso8583 string total length already > capacity of the record
+ ---------------------------------------------------------------------------- */
+int ISO8583Engine_HexbufToIso8583( const ISO8583_Spec * pSpec, ISO8583_Rec * pIso8583Data, byte * pBuf )
+{
+    return DecodeRec( pSpec, pIso8583Data, pBuf, NULL, NULL );
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Engine_HexbufToIso8583Len
+ * DESCRIPTION:     ISO8583Engine_HexbufToIso8583 on a buffer of known length,
+ *                  reads never go past pBuf + nLength
+ * PARAMETERS:      pSpec: spec context
+ *                  pIso8583Data(out): Converted Iso8583 data structure
+ *                  pBuf(in): RAW iso8583 hex buf data
+ *                  nLength: number of bytes in pBuf
+ * RETURN:          =0: success,
+ *                  ISOENGINE_TRUNCATED_MSG: message ends before a field does
+ *                  -1: variable field length error
+ *                  -3: iso8583 string total length already > capacity of the record
+ ---------------------------------------------------------------------------- */
+int ISO8583Engine_HexbufToIso8583Len( const ISO8583_Spec * pSpec, ISO8583_Rec * pIso8583Data, const byte * pBuf, size_t nLength )
+{
+    return DecodeRec( pSpec, pIso8583Data, pBuf, pBuf + nLength, NULL );
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Engine_HexbufToIso8583Strict
+ * DESCRIPTION:     ISO8583Engine_HexbufToIso8583Len that checks every field
+ *                  against its ISO8583_FieldOp while the field is in cache
+ * PARAMETERS:      pSpec: spec context
+ *                  pIso8583Data(out): Converted Iso8583 data structure
+ *                  pBuf(in): RAW iso8583 hex buf data
+ *                  nLength: number of bytes in pBuf
+ *                  pError(out): where the decode stopped
+ * RETURN:          =0: success,
+ *                  ISOENGINE_INVALID_FIELD_DATA: content error
+ *                  ISOENGINE_INVALID_FIELD_LENGTH: field longer than its maximum
+ *                  ISOENGINE_TRUNCATED_MSG: message ends before a field does
+ *                  -3: iso8583 string total length already > capacity of the record
+ ---------------------------------------------------------------------------- */
+int ISO8583Engine_HexbufToIso8583Strict( const ISO8583_Spec * pSpec, ISO8583_Rec * pIso8583Data, const byte * pBuf, size_t nLength, ISO8583_CheckError * pError )
+{
+    return DecodeRec( pSpec, pIso8583Data, pBuf, pBuf + nLength, pError );
+}
+
+//ISO8583Engine_Iso8583ToHexbuf without the instrumentation, *piFieldNo gets
+//the field of an error
+static int EncodeRec( const ISO8583_Spec * pSpec, ISO8583_Rec * pIso8583Data, byte * pRetBuf, int iSizeRetBuf, int * piFieldNo )
+{
+    byte * cpWpt;
+    int iFieldNum, iWords, iPrefix;
+    int i, iLength, iAddr;
+    unsigned long long ullBits;
+
+    if( pSpec->bBitMapMode == ISO8583_BITMAP128
+        || ( pSpec->bBitMapMode == ISO8583_BITMAPAUTO && pIso8583Data->ulBitmap[ 1 ] != 0 ) )
+        iWords = 2;
+    else
+        iWords = 1;
+
+    if( iSizeRetBuf < 2 + iWords * 8 )
+        return ( -3 );
+
+    ISO8583Utils_ASC2BCD( pIso8583Data->cMsgID, pRetBuf, 4 );
+    cpWpt = pRetBuf + 2 + iWords * 8;
+
+    for( i = 0; i < iWords; i ++ )
+    {
+        ullBits = pIso8583Data->ulBitmap[ i ];
+
+        if( i == 0 )
+            ullBits &= ~1ULL;
+
+        ISO8583Bits_StoreWire( pRetBuf + 2 + i * 8, ullBits );
+
+        while( ullBits )
+        {
+            iFieldNum = ( i << 6 ) + ISO8583Bits_Ctz64( ullBits );
+            ullBits &= ullBits - 1;
+
+            iAddr = pIso8583Data->Field[ iFieldNum ].addr;
+            iPrefix = FieldPrefixSize( pSpec, iFieldNum );
+            iLength = FieldWireSize( pSpec, iFieldNum, pIso8583Data->Field[ iFieldNum ].len );
+
+            *piFieldNo = iFieldNum + 1;
+
+            if(( cpWpt - pRetBuf ) + iPrefix + iLength > iSizeRetBuf )
+                return ( -3 );
+
+            if( iAddr < 0 || iLength < 0 || iAddr + iLength > pIso8583Data->iCapacity )
+                return( -4 );
+
+            if( iPrefix )
+            {
+                ISO8583Utils_LEN2BCD( pIso8583Data->Field[ iFieldNum ].len, cpWpt, iPrefix );
+                cpWpt += iPrefix;
+            }
+
+            memcpy( cpWpt, &pIso8583Data->cData[ iAddr ], iLength );
+            cpWpt += iLength;
+        }
+    }
+
+    if( iWords == 2 )
+        pRetBuf[ 2 ] |= 0x80;
+
+    return( cpWpt - pRetBuf );
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Engine_Iso8583ToHexbuf
+ * DESCRIPTION:     Convert ISO8583_Rec struct to Hex buffer - RAW ISO8583 data
+ * PARAMETERS:      pSpec: spec context
+ *                  pIso8583Data: Iso8583 data structure
+ *                  pRetBuf: RAW iso8583 hex buf data
+ *                  iSizeRetBuf: size of pRetBuf
+ * RETURN:          >0: success,
+ *                  -1: variable field length error
+ *                  -2: iFieldNo >= ISO8583_MAXFIELD or iFieldNo < 1
+ *                  -3: iso8583 string total length already > iSizeRetBuf
+ *                  -4: field data outside of ISO8583_Rec.cData
+ ---------------------------------------------------------------------------- */
+int ISO8583Engine_Iso8583ToHexbuf( const ISO8583_Spec * pSpec, ISO8583_Rec * pIso8583Data, byte * pRetBuf, int iSizeRetBuf )
+{
+    int iRet, iFieldNo = 0;
+    ISO8583_STATS_BEGIN( ISO8583_STATS_OP_PACK );
+
+    iRet = EncodeRec( pSpec, pIso8583Data, pRetBuf, iSizeRetBuf, &iFieldNo );
+    ISO8583_STATS_END( ISO8583_STATS_OP_PACK );
+
+    if( iRet < 0 )
+        ISO8583_STATS_ERROR( iRet, iFieldNo );
+    else
+        ISO8583_STATS_PACKED( pIso8583Data->cMsgID, iRet, pIso8583Data->ulBitmap );
+
+    return iRet;
+}
+
+
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Engine_OpenView
+ * DESCRIPTION:     Lazy zero-copy decode: check the message ID and bitmap of a
+ *                  RAW iso8583 buffer and note which fields are present. Field
+ *                  offsets are resolved later, only as far as the highest
+ *                  field asked for, and cached in the view.
+ * PARAMETERS:      pSpec: spec context
+ *                  pView(out): field index into pBuf
+ *                  pBuf(in): RAW iso8583 hex buf data, must outlive pView
+ *                  nLength: number of bytes in pBuf
+ * RETURN:          ISOENGINE_OK: success
+ *                  ISOENGINE_TRUNCATED_MSG: message shorter than its bitmap
+ *                  ISOENGINE_INVALID_FIELD_NO: field bit set beyond the spec
+ *                  ISOENGINE_OVER_MAXLENGTH: nLength > ISO8583_MAXVIEWLEN
+ ---------------------------------------------------------------------------- */
+int ISO8583Engine_OpenView( const ISO8583_Spec * pSpec, ISO8583_View * pView, const byte * pBuf, size_t nLength )
+{
+    int i, iWords;
+
+    pView->pBuf = pBuf;
+    pView->iLength = nLength > ISO8583_MAXVIEWLEN ? ISO8583_MAXVIEWLEN : ( int )nLength;
+    pView->iResolved = ISO8583_MAXFIELD;
+    pView->iError = ISOENGINE_OK;
+
+    for( i = 0; i < ISO8583_MAXFIELD / 64; i ++ )
+        pView->ulBitmap[ i ] = 0;
+
+    if( nLength > ISO8583_MAXVIEWLEN )
+        pView->iError = ISOENGINE_OVER_MAXLENGTH;
+    else if( nLength < 2 + 8 )
+        pView->iError = ISOENGINE_TRUNCATED_MSG;
+
+    if( pView->iError != ISOENGINE_OK )
+        return pView->iError;
+
+    if(( pBuf[ 2 ] & 0x80 ) && ( pSpec->iMaxField == ISO8583_MAXFIELD ) )
+        iWords = 2;
+    else
+        iWords = 1;
+
+    if( nLength < ( size_t )( 2 + iWords * 8 ) )
+        return pView->iError = ISOENGINE_TRUNCATED_MSG;
+
+    for( i = 0; i < iWords; i ++ )
+        pView->ulBitmap[ i ] = ISO8583Bits_LoadWire( pBuf + 2 + i * 8 );
+
+    pView->ulBitmap[ 0 ] &= ~1ULL;
+    pView->iResolved = 1;
+    pView->iCursor = 2 + iWords * 8;
+    return ISOENGINE_OK;
+}
+
+//Resolve offsets of fields up to and including iFieldNum (0 based). Resolution
+//errors are sticky, a view that failed once keeps returning the same error.
+static int ResolveView( const ISO8583_Spec * pSpec, ISO8583_View * pView, int iFieldNum )
+{
+    const byte * pRpt, * pEnd;
+    int i, iIdx, iLength, iWire;
+    unsigned long long ullBits;
+
+    if( pView->iError != ISOENGINE_OK )
+        return pView->iError;
+
+    if( iFieldNum < pView->iResolved )
+        return ISOENGINE_OK;
+
+    pRpt = pView->pBuf + pView->iCursor;
+    pEnd = pView->pBuf + pView->iLength;
+
+    for( i = pView->iResolved >> 6; i <= iFieldNum >> 6; i ++ )
+    {
+        ullBits = pView->ulBitmap[ i ];
+
+        if( i == pView->iResolved >> 6 )
+            ullBits &= ~0ULL << ( pView->iResolved & 63 );
+
+        if( i == iFieldNum >> 6 )
+            ullBits &= ~0ULL >> ( 63 - ( iFieldNum & 63 ) );
+
+        while( ullBits )
+        {
+            iIdx = ( i << 6 ) + ISO8583Bits_Ctz64( ullBits );
+            ullBits &= ullBits - 1;
+
+            iWire = DecodeFieldLength( pSpec, iIdx, &pRpt, pEnd, &iLength );
+
+            if( iWire < 0 )
+                return pView->iError = iWire;
+
+            pView->Field[ iIdx ].len = ( short )iLength;
+            pView->Field[ iIdx ].addr = ( int )( pRpt - pView->pBuf );
+            pRpt += iWire;
+        }
+    }
+
+    pView->iResolved = iFieldNum + 1;
+    pView->iCursor = ( int )( pRpt - pView->pBuf );
+    return ISOENGINE_OK;
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Engine_ParseView
+ * DESCRIPTION:     Index a RAW iso8583 buffer in place: record the offset and
+ *                  length of every field present, copy nothing. Reads never
+ *                  go past pBuf + nLength.
+ * PARAMETERS:      pSpec: spec context
+ *                  pView(out): field index into pBuf
+ *                  pBuf(in): RAW iso8583 hex buf data, must outlive pView
+ *                  nLength: number of bytes in pBuf
+ * RETURN:          ISOENGINE_OK: success
+ *                  ISOENGINE_TRUNCATED_MSG: message ends before a field does
+ *                  ISOENGINE_INVALID_FIELD_NO: field bit set beyond the spec
+ *                  -1: variable field length error
+ ---------------------------------------------------------------------------- */
+int ISO8583Engine_ParseView( const ISO8583_Spec * pSpec, ISO8583_View * pView, const byte * pBuf, size_t nLength )
+{
+    int iRet = ISO8583Engine_OpenView( pSpec, pView, pBuf, nLength );
+
+    if( iRet != ISOENGINE_OK )
+        return iRet;
+
+    return ResolveView( pSpec, pView, ISO8583_MAXFIELD - 1 );
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Engine_ViewGetField
+ * DESCRIPTION:     ISO8583Engine_GetField on a view, the data is read straight
+ *                  from the viewed buffer
+ * PARAMETERS:      pSpec: spec context the view was opened with
+ *                  pView: opened or parsed view
+ *                  iFieldNo: Field No, 0 for the message ID
+ *                  pRetFieldData: Return field data buffer, ASC format
+ *                  iSizeofRetFieldData: Length of pRetFieldData field data buffer
+ * RETURN:          >=0: suceess, return data length (0: field not present)
+ *                  ISOENGINE_INVALID_FIELD_NO: iFieldNo beyond the spec or iFieldNo <= 1
+ *                  ISOENGINE_TOO_SMALL_FIELD_BUF_SIZE: buffer too small for message ID
+ *                  other <0: error resolving the field offset, see ISO8583Engine_ParseView
+ ---------------------------------------------------------------------------- */
+int ISO8583Engine_ViewGetField( const ISO8583_Spec * pSpec, ISO8583_View * pView, int iFieldNo, unsigned char * pRetFieldData, int iSizeofRetFieldData )
+{
+    const byte * pRpt = NULL;
+    int iLength;
+
+    if( iFieldNo == 0 )
+    {
+        if( iSizeofRetFieldData < 5 )
+            return ISOENGINE_TOO_SMALL_FIELD_BUF_SIZE;
+
+        if( pView->iLength < 2 )
+            return ISOENGINE_TRUNCATED_MSG;
+
+        ISO8583Utils_BCD2ASC(( byte * )pView->pBuf, pRetFieldData, 4 );
+        pRetFieldData[ 4 ] = 0;
+        return (4);
+    }
+
+    iLength = ISO8583Engine_ViewFieldPtr( pSpec, pView, iFieldNo, &pRpt );
+
+    if( iLength <= 0 )
+    {
+        if( iLength == 0 && iSizeofRetFieldData > 0 )
+            pRetFieldData[ 0 ] = 0;
+
+        return iLength;
+    }
+
+    return CopyFieldData( pSpec, iFieldNo - 1, pRpt, iLength, pRetFieldData, iSizeofRetFieldData );
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Engine_ViewGetFieldU64
+ * DESCRIPTION:     ISO8583Engine_GetFieldU64 on a view, the value is converted
+ *                  straight from the viewed buffer
+ * PARAMETERS:      pSpec: spec context the view was opened with
+ *                  pView: opened or parsed view
+ *                  iFieldNo: Field No
+ *                  pullValue(out): field value, 0 when not present
+ * RETURN:          >0: success, digits of the field
+ *                  0: field not present
+ *                  <0: error
+ ---------------------------------------------------------------------------- */
+int ISO8583Engine_ViewGetFieldU64( const ISO8583_Spec * pSpec, ISO8583_View * pView, int iFieldNo, unsigned long long * pullValue )
+{
+    const byte * pRpt = NULL;
+    int iLength;
+
+    *pullValue = 0;
+    iLength = ISO8583Engine_ViewFieldPtr( pSpec, pView, iFieldNo, &pRpt );
+
+    if( iLength <= 0 )
+        return iLength;
+
+    return FieldValue( pSpec, iFieldNo - 1, pRpt, iLength, pullValue );
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Engine_ViewFieldPtr
+ * DESCRIPTION:     Locate the RAW field data inside the viewed buffer, packed
+ *                  BCD fields are returned packed
+ * PARAMETERS:      pSpec: spec context the view was opened with
+ *                  pView: opened or parsed view
+ *                  iFieldNo: Field No
+ *                  ppData(out): start of field data, after any length prefix
+ * RETURN:          >0: field length, in digits for BCD fields, bytes otherwise
+ *                  0: field not present
+ *                  ISOENGINE_INVALID_FIELD_NO: iFieldNo beyond the spec or iFieldNo <= 1
+ *                  other <0: error resolving the field offset, see ISO8583Engine_ParseView
+ ---------------------------------------------------------------------------- */
+int ISO8583Engine_ViewFieldPtr( const ISO8583_Spec * pSpec, ISO8583_View * pView, int iFieldNo, const byte ** ppData )
+{
+    int iRet;
+
+    if( iFieldNo <= 1 || iFieldNo > pSpec->iMaxField )
+        return ISOENGINE_INVALID_FIELD_NO;
+
+    if( !ISO8583_BITMAP_TEST( pView->ulBitmap, iFieldNo - 1 ) )
+        return pView->iError;
+
+    if( iFieldNo > pView->iResolved )
+    {
+        iRet = ResolveView( pSpec, pView, iFieldNo - 1 );
+
+        if( iRet != ISOENGINE_OK )
+            return iRet;
+    }
+
+    *ppData = pView->pBuf + pView->Field[ iFieldNo - 1 ].addr;
+    return pView->Field[ iFieldNo - 1 ].len;
+}
+
+//Copy the source bytes [pStart, pStop) to *ppWpt, bounded by pEnd
+static int CopyRun( byte ** ppWpt, const byte * pEnd, const byte * pStart, const byte * pStop )
+{
+    if( pStart == pStop )
+        return( 0 );
+
+    if( pStop - pStart > pEnd - *ppWpt )
+        return( -3 );
+
+    memcpy( *ppWpt, pStart, pStop - pStart );
+    *ppWpt += pStop - pStart;
+    return( 0 );
+}
+
+//Apply pEdits to the bitmap pulPresent of a source: ulBitmap(out) gets the
+//fields of the result, ulEdited(out) the ones taken from pEdit(out) and
+//*ppMsgID the message ID edit, NULL if none.
+static int CollectEdits( const ISO8583_Spec * pSpec, const unsigned long long * pulPresent, const ISO8583_Edit * pEdits, int iEdits,
+                         unsigned long long * ulBitmap, unsigned long long * ulEdited, const ISO8583_Edit ** pEdit, const ISO8583_Edit ** ppMsgID )
+{
+    int i, iFieldNum;
+
+    *ppMsgID = NULL;
+
+    for( i = 0; i < ISO8583_MAXFIELD / 64; i ++ )
+    {
+        ulBitmap[ i ] = pulPresent[ i ];
+        ulEdited[ i ] = 0;
+    }
+
+    for( i = 0; i < iEdits; i ++ )
+    {
+        iFieldNum = pEdits[ i ].iFieldNo;
+
+        if( iFieldNum == 0 )
+        {
+            if( pEdits[ i ].iOp != ISO8583_EDIT_SET || pEdits[ i ].iLength < 4 )
+                return ISOENGINE_INVALID_FIELD_LENGTH;
+
+            *ppMsgID = &pEdits[ i ];
+            continue;
+        }
+
+        if( iFieldNum <= 1 || iFieldNum > pSpec->iMaxField )
+            return ISOENGINE_INVALID_FIELD_NO;
+
+        iFieldNum --;
+
+        if( pEdits[ i ].iOp == ISO8583_EDIT_REMOVE )
+        {
+            ISO8583_BITMAP_CLEAR( ulBitmap, iFieldNum );
+            ISO8583_BITMAP_CLEAR( ulEdited, iFieldNum );
+            continue;
+        }
+
+        if( pEdits[ i ].iOp == ISO8583_EDIT_REPLACE && !ISO8583_BITMAP_TEST( pulPresent, iFieldNum ) )
+            continue;
+
+        if( pEdits[ i ].iLength <= 0 )
+            return ISOENGINE_INVALID_FIELD_LENGTH;
+
+        ISO8583_BITMAP_SET( ulBitmap, iFieldNum );
+        ISO8583_BITMAP_SET( ulEdited, iFieldNum );
+        pEdit[ iFieldNum ] = &pEdits[ i ];
+    }
+
+    return ISOENGINE_OK;
+}
+
+//Encode the fields indexed by pView over pSrc with pEdits applied: untouched
+//fields are copied from pSrc, runs of them that are contiguous in pSrc with
+//one memcpy, edited fields are encoded. See ISO8583Engine_Transform.
+static int SpliceFields( const ISO8583_Spec * pSpec, const byte * pSrc, const ISO8583_View * pView,
+                         const ISO8583_Edit * pEdits, int iEdits, byte * pRetBuf, int iSizeRetBuf )
+{
+    const ISO8583_Edit * pEdit[ ISO8583_MAXFIELD ];       // valid where ulEdited is set
+    unsigned long long ulBitmap[ ISO8583_MAXFIELD / 64 ], ulEdited[ ISO8583_MAXFIELD / 64 ];
+    const byte * pRunStart = NULL, * pRunStop = NULL, * pStart;
+    const byte * pEnd = pRetBuf + iSizeRetBuf;
+    const ISO8583_Edit * pMsgID;
+    byte cField[ 1000 + 2 ];
+    byte * cpWpt;
+    int i, iRet, iWords, iFieldNum, iLength, iPrefix, len;
+    unsigned long long ullBits;
+
+    iRet = CollectEdits( pSpec, pView->ulBitmap, pEdits, iEdits, ulBitmap, ulEdited, pEdit, &pMsgID );
+
+    if( iRet != ISOENGINE_OK )
+        return iRet;
+
+    if( pSpec->bBitMapMode == ISO8583_BITMAP128
+        || ( pSpec->bBitMapMode == ISO8583_BITMAPAUTO && ulBitmap[ 1 ] != 0 ) )
+        iWords = 2;
+    else
+        iWords = 1;
+
+    if( iSizeRetBuf < 2 + iWords * 8 )
+        return( -3 );
+
+    if( pMsgID != NULL )
+        ISO8583Utils_ASC2BCD(( unsigned char * )pMsgID->pData, pRetBuf, 4 );
+    else
+        memcpy( pRetBuf, pSrc, 2 );
+
+    cpWpt = pRetBuf + 2 + iWords * 8;
+
+    for( i = 0; i < iWords; i ++ )
+    {
+        ullBits = ulBitmap[ i ];
+
+        if( i == 0 )
+            ullBits &= ~1ULL;
+
+        ISO8583Bits_StoreWire( pRetBuf + 2 + i * 8, ullBits );
+
+        while( ullBits )
+        {
+            iFieldNum = ( i << 6 ) + ISO8583Bits_Ctz64( ullBits );
+            ullBits &= ullBits - 1;
+            iPrefix = FieldPrefixSize( pSpec, iFieldNum );
+
+            //Untouched field: extend the current run when it follows it in pSrc
+            if( !ISO8583_BITMAP_TEST( ulEdited, iFieldNum ) )
+            {
+                pStart = pSrc + pView->Field[ iFieldNum ].addr - iPrefix;
+
+                if( pStart != pRunStop )
+                {
+                    if( CopyRun( &cpWpt, pEnd, pRunStart, pRunStop ) != 0 )
+                        return( -3 );
+
+                    pRunStart = pStart;
+                }
+
+                pRunStop = pSrc + pView->Field[ iFieldNum ].addr + FieldWireSize( pSpec, iFieldNum, pView->Field[ iFieldNum ].len );
+                continue;
+            }
+
+            if( CopyRun( &cpWpt, pEnd, pRunStart, pRunStop ) != 0 )
+                return( -3 );
+
+            pRunStart = pRunStop = NULL;
+
+            len = pEdit[ iFieldNum ]->iLength;
+            iLength = StoreFieldLength( pSpec, iFieldNum, &len );
+
+            if( iLength > 999 )
+                return ISOENGINE_TOO_LONG_FILED_LENGTH;
+
+            if( iPrefix + FieldWireSize( pSpec, iFieldNum, iLength ) > pEnd - cpWpt )
+                return( -3 );
+
+            StoreFieldData( pSpec, iFieldNum, pEdit[ iFieldNum ]->pData, len, iLength, cField );
+
+            if( iPrefix )
+            {
+                ISO8583Utils_LEN2BCD( iLength, cpWpt, iPrefix );
+                cpWpt += iPrefix;
+            }
+
+            memcpy( cpWpt, cField, FieldWireSize( pSpec, iFieldNum, iLength ) );
+            cpWpt += FieldWireSize( pSpec, iFieldNum, iLength );
+        }
+    }
+
+    if( CopyRun( &cpWpt, pEnd, pRunStart, pRunStop ) != 0 )
+        return( -3 );
+
+    if( iWords == 2 )
+        pRetBuf[ 2 ] |= 0x80;
+
+    return( int )( cpWpt - pRetBuf );
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Engine_Transform
+ * DESCRIPTION:     Build a new RAW message from a RAW source message and a
+ *                  list of field edits. Runs of untouched fields that are
+ *                  contiguous in pSrc are copied with one memcpy.
+ * PARAMETERS:      pSpec: spec context
+ *                  pSrc: RAW source message
+ *                  nSrcLen: number of bytes in pSrc
+ *                  pEdits: field edits
+ *                  iEdits: number of field edits
+ *                  pRetBuf(out): RAW output message
+ *                  iSizeRetBuf: size of pRetBuf
+ * RETURN:          >0: success, length of pRetBuf used
+ *                  <0: error, see ISO8583Engine.h
+ ---------------------------------------------------------------------------- */
+int ISO8583Engine_Transform( const ISO8583_Spec * pSpec, const byte * pSrc, size_t nSrcLen,
+                             const ISO8583_Edit * pEdits, int iEdits, byte * pRetBuf, int iSizeRetBuf )
+{
+    ISO8583_View View;
+    int iRet;
+
+    if( pSpec->bFldFormatSetFlag != TRUE )
+        return ISOENGINE_NOT_SET_FIELD_FMT;
+
+    iRet = ISO8583Engine_ParseView( pSpec, &View, pSrc, nSrcLen );
+
+    if( iRet != ISOENGINE_OK )
+        return iRet;
+
+    return SpliceFields( pSpec, pSrc, &View, pEdits, iEdits, pRetBuf, iSizeRetBuf );
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Engine_InitTemplate
+ * DESCRIPTION:     Encode the static fields of a message once, as the
+ *                  transform of an empty message
+ * PARAMETERS:      pSpec: spec context
+ *                  pTemplate(out): template
+ *                  pStatic: edits of the static fields
+ *                  iStatic: number of edits
+ * RETURN:          ISOENGINE_OK or <0 error
+ ---------------------------------------------------------------------------- */
+int ISO8583Engine_InitTemplate( const ISO8583_Spec * pSpec, ISO8583_Template * pTemplate, const ISO8583_Edit * pStatic, int iStatic )
+{
+    byte cEmpty[ 2 + 8 ];
+    int iRet;
+
+    memset( cEmpty, 0, sizeof( cEmpty ) );
+    iRet = ISO8583Engine_Transform( pSpec, cEmpty, sizeof( cEmpty ), pStatic, iStatic, pTemplate->cWire, sizeof( pTemplate->cWire ) );
+
+    if( iRet < 0 )
+        return iRet;
+
+    pTemplate->iLength = iRet;
+    iRet = ISO8583Engine_ParseView( pSpec, &pTemplate->View, pTemplate->cWire, pTemplate->iLength );
+    pTemplate->View.pBuf = NULL;
+    return iRet;
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Engine_TemplateToHexbuf
+ * DESCRIPTION:     Encode one message from a template and its dynamic fields
+ * PARAMETERS:      pSpec: spec context
+ *                  pTemplate: template
+ *                  pDynamic: edits of the dynamic fields
+ *                  iDynamic: number of edits
+ *                  pRetBuf(out): RAW iso8583 message
+ *                  iSizeRetBuf: size of pRetBuf
+ * RETURN:          >0: success, length of pRetBuf used
+ *                  <0: error
+ ---------------------------------------------------------------------------- */
+int ISO8583Engine_TemplateToHexbuf( const ISO8583_Spec * pSpec, const ISO8583_Template * pTemplate,
+                                    const ISO8583_Edit * pDynamic, int iDynamic, byte * pRetBuf, int iSizeRetBuf )
+{
+    if( pSpec->bFldFormatSetFlag != TRUE )
+        return ISOENGINE_NOT_SET_FIELD_FMT;
+
+    return SpliceFields( pSpec, pTemplate->cWire, &pTemplate->View, pDynamic, iDynamic, pRetBuf, iSizeRetBuf );
+}
+
+//Add nLength bytes at pBase to the iovec list, the last entry grows instead
+//when pBase follows it in memory
+static int AppendIov( struct iovec * pIov, int * piIov, int iMaxIov, const byte * pBase, size_t nLength )
+{
+    struct iovec * pLast;
+
+    if( nLength == 0 )
+        return( 0 );
+
+    if( *piIov > 0 )
+    {
+        pLast = &pIov[ *piIov - 1 ];
+
+        if(( const byte * )pLast->iov_base + pLast->iov_len == pBase )
+        {
+            pLast->iov_len += nLength;
+            return( 0 );
+        }
+    }
+
+    if( *piIov == iMaxIov )
+        return( -3 );
+
+    pIov[ *piIov ].iov_base = ( void * )pBase;
+    pIov[ *piIov ].iov_len = nLength;
+    ( *piIov ) ++;
+    return( 0 );
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Engine_Iso8583ToIovec
+ * DESCRIPTION:     Scatter / gather encode: the message ID, bitmap, length
+ *                  prefixes and packed fields go to pArena, every other field
+ *                  is referenced where it already is, in the record or in
+ *                  caller memory
+ * PARAMETERS:      pSpec: spec context
+ *                  pIso8583Data: Iso8583 data structure, may be NULL
+ *                  pFields: field edits applied to the record
+ *                  iFields: number of edits
+ *                  pArena(out): header bytes
+ *                  iSizeArena: size of pArena
+ *                  pIov(out): iovec list
+ *                  iMaxIov: entries of pIov
+ *                  pnLength(out): bytes of the message
+ * RETURN:          >0: number of pIov entries used
+ *                  <0: error, see ISO8583Engine.h
+ ---------------------------------------------------------------------------- */
+int ISO8583Engine_Iso8583ToIovec( const ISO8583_Spec * pSpec, ISO8583_Rec * pIso8583Data, const ISO8583_Edit * pFields, int iFields,
+                                  byte * pArena, int iSizeArena, struct iovec * pIov, int iMaxIov, size_t * pnLength )
+{
+    static const unsigned long long ulNone[ ISO8583_MAXFIELD / 64 ];
+    const ISO8583_Edit * pEdit[ ISO8583_MAXFIELD ];       // valid where ulEdited is set
+    unsigned long long ulBitmap[ ISO8583_MAXFIELD / 64 ], ulEdited[ ISO8583_MAXFIELD / 64 ];
+    const ISO8583_Edit * pMsgID;
+    const byte * pEnd = pArena + iSizeArena;
+    byte * cpWpt = pArena;
+    int i, iRet, iIov = 0, iWords, iFieldNum, iLength, iWire, iPrefix, iAddr, len = 0;
+    unsigned long long ullBits;
+    size_t nLength = 0;
+
+    if( pSpec->bFldFormatSetFlag != TRUE )
+        return ISOENGINE_NOT_SET_FIELD_FMT;
+
+    iRet = CollectEdits( pSpec, pIso8583Data != NULL ? pIso8583Data->ulBitmap : ulNone, pFields, iFields, ulBitmap, ulEdited, pEdit, &pMsgID );
+
+    if( iRet != ISOENGINE_OK )
+        return iRet;
+
+    if( pMsgID == NULL && pIso8583Data == NULL )
+        return ISOENGINE_INVALID_FIELD_NO;
+
+    if( pSpec->bBitMapMode == ISO8583_BITMAP128
+        || ( pSpec->bBitMapMode == ISO8583_BITMAPAUTO && ulBitmap[ 1 ] != 0 ) )
+        iWords = 2;
+    else
+        iWords = 1;
+
+    if( iSizeArena < 2 + iWords * 8 )
+        return( -3 );
+
+    ISO8583Utils_ASC2BCD( pMsgID != NULL ? ( unsigned char * )pMsgID->pData : pIso8583Data->cMsgID, cpWpt, 4 );
+
+    for( i = 0; i < iWords; i ++ )
+        ISO8583Bits_StoreWire( cpWpt + 2 + i * 8, ulBitmap[ i ] & ( i == 0 ? ~1ULL : ~0ULL ) );
+
+    if( iWords == 2 )
+        cpWpt[ 2 ] |= 0x80;
+
+    if( AppendIov( pIov, &iIov, iMaxIov, cpWpt, 2 + iWords * 8 ) != 0 )
+        return( -3 );
+    cpWpt += 2 + iWords * 8;
+
+    for( i = 0; i < iWords; i ++ )
+    {
+        ullBits = ulBitmap[ i ];
+
+        if( i == 0 )
+            ullBits &= ~1ULL;
+
+        while( ullBits )
+        {
+            iFieldNum = ( i << 6 ) + ISO8583Bits_Ctz64( ullBits );
+            ullBits &= ullBits - 1;
+            iPrefix = FieldPrefixSize( pSpec, iFieldNum );
+
+            if( ISO8583_BITMAP_TEST( ulEdited, iFieldNum ) )
+            {
+                len = pEdit[ iFieldNum ]->iLength;
+                iLength = StoreFieldLength( pSpec, iFieldNum, &len );
+
+                if( iLength > 999 )
+                    return ISOENGINE_TOO_LONG_FILED_LENGTH;
+            }
+            else
+                iLength = pIso8583Data->Field[ iFieldNum ].len;
+
+            iWire = FieldWireSize( pSpec, iFieldNum, iLength );
+
+            if( iPrefix )
+            {
+                if( pEnd - cpWpt < iPrefix )
+                    return( -3 );
+
+                ISO8583Utils_LEN2BCD( iLength, cpWpt, iPrefix );
+                if( AppendIov( pIov, &iIov, iMaxIov, cpWpt, iPrefix ) != 0 )
+                    return( -3 );
+                cpWpt += iPrefix;
+            }
+
+            //Record field, already in wire form in cData
+            if( !ISO8583_BITMAP_TEST( ulEdited, iFieldNum ) )
+            {
+                iAddr = pIso8583Data->Field[ iFieldNum ].addr;
+
+                if( iAddr < 0 || iWire < 0 || iAddr + iWire > pIso8583Data->iCapacity )
+                    return( -4 );
+
+                if( AppendIov( pIov, &iIov, iMaxIov, &pIso8583Data->cData[ iAddr ], iWire ) != 0 )
+                    return( -3 );
+                continue;
+            }
+
+            //Caller data that is already what goes on the wire is not copied
+            if( !pSpec->Op[ iFieldNum ].bPacked && len == iLength )
+            {
+                if( AppendIov( pIov, &iIov, iMaxIov, pEdit[ iFieldNum ]->pData, iWire ) != 0 )
+                    return( -3 );
+                continue;
+            }
+
+            if( pEnd - cpWpt < StoreFieldSize( pSpec, iFieldNum, iLength ) )
+                return( -3 );
+
+            //Same store as ISO8583Engine_SetField, short fixed data gets padded
+            StoreFieldData( pSpec, iFieldNum, pEdit[ iFieldNum ]->pData, len, iLength, cpWpt );
+
+            if( AppendIov( pIov, &iIov, iMaxIov, cpWpt, iWire ) != 0 )
+                return( -3 );
+            cpWpt += iWire;
+        }
+    }
+
+    for( i = 0; i < iIov; i ++ )
+        nLength += pIov[ i ].iov_len;
+
+    *pnLength = nLength;
+    return iIov;
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Utils_BCD2LEN
+ * DESCRIPTION:     Convert BcdLen bytes BCD length to int
+ * RETURN:          None
+ ---------------------------------------------------------------------------- */
+int ISO8583Utils_BCD2LEN( unsigned char * BcdBuf, int * Len, int BcdLen )
+{
+    int i;
+    unsigned short usLen = 0;
+
+    if(BcdLen <= 0 || BcdLen > 10)
+        return -1;
+
+    for (i = 0; i < BcdLen; i++)
+    {
+        usLen = usLen * 100 + (((*(BcdBuf + i)) & 0xF0) >> 4) * 10 + ((*(BcdBuf + i)) & 0x0F);
+    }
+
+    *Len = (int)usLen;
+    return 0;
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Utils_LEN2BCD
+ * DESCRIPTION:     Convert int length to BcdLen bytes BCD
+ * PARAMETERS:      Len: length
+ *                  BcdBuf(out): BcdLen bytes
+ *                  BcdLen: 1 - 10
+ * RETURN:          0, -1: BcdLen or Len out of range
+ ---------------------------------------------------------------------------- */
+int ISO8583Utils_LEN2BCD( int Len, byte * BcdBuf, int BcdLen)
+{
+    if( BcdLen <= 0 || BcdLen > 10 || Len < 0 )
+        return -1;
+
+    return ISO8583Utils_U642BCD(( unsigned long long )Len, BcdBuf, BcdLen * 2 );
+}
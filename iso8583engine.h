@@ -1,183 +1,793 @@
-/***************************************************************************
-* FILE NAME:    ISO8583Engine.H                                            *
-* MODULE NAME:  ISO8583Engine                                              *
-* PROGRAMMER:                                                              *
-* DESCRIPTION:                                                             *
-* REVISION:                                                                *
-****************************************************************************/
-
-#ifndef _ISO8583ENGINE_H
-#define _ISO8583ENGINE_H
-
-//Return values enum
-typedef enum
-{
-    ISOENGINE_OK = 0,
-    ISOENGINE_NOT_SET_FIELD_FMT = -100,
-    ISOENGINE_INVALID_FIELD_NO,
-    ISOENGINE_TOO_LONG_FILED_LENGTH,
-    ISOENGINE_INVALID_FIELD_LENGTH,
-    ISOENGINE_OVER_MAXLENGTH,
-    ISOENGINE_INVALID_FIELD_DATA,
-    ISOENGINE_TOO_SMALL_FIELD_BUF_SIZE,
-} ISO8583_ENGINE_RetVal;
-
-//Maximum field number: default 64, determined by Application Message format standard
-#define ISO8583_MAXFIELD        64
-
-#ifndef byte
-typedef unsigned char byte;
-#endif
-
-//Maximum length of ISO8583 data
-#define ISO8583_MAXLENTH        1024
-
-#define ISO8583TYPE_FIX         0x01    // type fix length
-#define ISO8583TYPE_VAR         0x02    // type Variable length - 99/999
-#define ISO8583TYPE_BIN         0x04    // type Binary  - 'b','h'
-#define ISO8583TYPE_ASC         0x08    // type ASCII   - 'a','an','ans'
-#define ISO8583TYPE_BCD         0x10    // type BCD     - 'n','z'
-#define ISO8583TYPE_DIGIT       0x20    // type Digit   - '0'~'9'
-
-//BITMAP type 64 / 128
-typedef enum
-{
-    ISO8583_BITMAP64 = 0,
-    ISO8583_BITMAP128,
-} ISO8583_BitMode;
-
-
-//ISO8583 field format struct
-typedef struct
-{
-    unsigned char bType;         // (Fix or Var) | (BIN or ASC or BCD)
-    int iMaxLength;     // data max length
-} ISO8583_FieldFormat;
-
-typedef struct
-{
-    short bitf;
-    short len;
-    int addr;
-} ISO8583_ElementFlag;
-
-typedef struct
-{
-    int iOffset;
-    unsigned char cData[ ISO8583_MAXLENTH ];
-    unsigned char cMsgID[ 5 ];
-    ISO8583_ElementFlag Field[ ISO8583_MAXFIELD ];
-} ISO8583_Rec;
-
-
-/* -----------------------------------------------------------------------------
- * FUNCTION NAME:   ISO8583Engine_InitFieldFormat
- * DESCRIPTION:     Set ISO8583 field type and format, should be called
- *                  before the using of ISO8583 engine module
- * PARAMETERS:      bBitMode: Iso8583 bitmap mode, see enum ISO8583_BitMode in ISO8583Engine.h
- *                  pFieldFormat: poFieldFormat definitions
- * RETURN:          None
- ---------------------------------------------------------------------------- */
-int ISO8583Engine_InitFieldFormat( ISO8583_BitMode bBitMode, ISO8583_FieldFormat *pIso8583FieldFormat );
-
-/* -----------------------------------------------------------------------------
- * FUNCTION NAME:   ISO8583Engine_ClearAllFields
- * DESCRIPTION:     Clear all field data in ISO8583_Rec structure
- * PARAMETERS:      ptIso8583Data: ISO8583 data structure
- * RETURN:          None.
- ---------------------------------------------------------------------------- */
-int ISO8583Engine_ClearAllFields( ISO8583_Rec * ptIso8583Data );
-
-/* -----------------------------------------------------------------------------
- * FUNCTION NAME:   ISO8583Engine_ClearOneField
- * DESCRIPTION:     Clear one field data
- * PARAMETERS:      ptIso8583Data: pointer to ISO8583 data structure
- *                  iFieldNo: Field No
- * RETURN:          None
- ---------------------------------------------------------------------------- */
-int ISO8583Engine_ClearOneField( ISO8583_Rec * ptIso8583Data, int iFieldNo );
-
-/* -----------------------------------------------------------------------------
- * FUNCTION NAME:   ISO8583Engine_SetField
- * DESCRIPTION:     Set ISO8583 field data
-                    pFieldData must be the ASC format
- * return:          if successful, return 0; else
- *                  -1: not set iso8583 field format
- *                  -2: iFieldNo > APPISO8583_MAXFIELD or iFieldNo <= 1
- *                  -3: iDataLength > 999
- *                  -4: iso8583 string total length already > ISO8583_MAXLENTH
- ---------------------------------------------------------------------------- */
-int ISO8583Engine_SetField(ISO8583_Rec * pIsoRec, int iFieldNo, unsigned char * pFieldData, int iDataLength);
-
-/* -----------------------------------------------------------------------------
- * FUNCTION NAME:   ISO8583Engine_GetField
- * DESCRIPTION:     Get ISO8583 field data
-                    pRetFieldData must be the ASC format
- * return:          Return FieldData length has gotten
- ---------------------------------------------------------------------------- */
-int ISO8583Engine_GetField(ISO8583_Rec * cpIsoRec, int iFieldNo, unsigned char * pRetFieldData, int iSizeofRetFieldData);
-
-/* -----------------------------------------------------------------------------
- * FUNCTION NAME:   ISO8583Engine_HexbufToIso8583
- * DESCRIPTION:     Convert ISO8583 RAW hex buffer data to ISO8583_Rec struct
- * PARAMETERS:      pIso8583Data(out): Converted Iso8583 data structure
- *                  pBuf(in): RAW iso8583 hex buf data
- * RETURN:          =0: success,
- *                  -1: variable field length error
- *                  -2: iFieldNo >= ISO8583_MAXFIELD or iFieldNo < 1
- *                  -3: iso8583 string total length already > ISO8583_MAXLENTH
- *                  -4: iso8583 string total length already > ISO8583_MAXLENTH
- ---------------------------------------------------------------------------- */
-int ISO8583Engine_HexbufToIso8583( ISO8583_Rec * pIso8583Data, unsigned char * pBuf );
-
-/* -----------------------------------------------------------------------------
- * FUNCTION NAME:   ISO8583Engine_Iso8583ToHexbuf
- * DESCRIPTION:     Convert ISO8583_Rec struct to Hex buffer - RAW ISO8583 data
- * PARAMETERS:      pIso8583Data: Iso8583 data structure
- *                  pRetBuf: RAW iso8583 hex buf data
- *                  iSizeRetBuf: size of pRetBuf
- * RETURN:          >0: success,
- *                  -1: variable field length error
- *                  -2: iFieldNo >= ISO8583_MAXFIELD or iFieldNo < 1
- *                  -3: iso8583 string total length already > iSizeRetBuf
- *                  -4: iso8583 string total length already > ISO8583_MAXLENTH
- ---------------------------------------------------------------------------- */
-int ISO8583Engine_Iso8583ToHexbuf( ISO8583_Rec * pIso8583Data, unsigned char * pRetBuf, int iSizeRetBuf );
-
-/* --------------------------------------------------------------------------
-* FUNCTION NAME: ISO8583Utils_BCD2ASC
-* DESCRIPTION:   Convert BCD code to ASCII code.
-* PARAMETERS:    BcdBuf - BCD input buffer, Len - double length of Bcdbuf bytes
-*                AscBuf - converted result
-* RETURN:        0
-* NOTES:
-* ------------------------------------------------------------------------ */
-int ISO8583Utils_BCD2ASC(unsigned char * BcdBuf, unsigned char * AscBuf, int Len);
-
-/* --------------------------------------------------------------------------
-* FUNCTION NAME: ISO8583Utils_ASC2BCD
-* DESCRIPTION:   Convert ASCII code to BCD code.
-* PARAMETERS:    AscBuf - Ascii input buffer, must ended by '\0'
-*                Len - double length of BCD code, should be even.
-*                BcdBuf - converted BCD code result
-* RETURN:        0
-* NOTES:         support 'A'-'F' convertion(extend BCD code)
-* ------------------------------------------------------------------------ */
-int ISO8583Utils_ASC2BCD(unsigned char * AscBuf, unsigned char * BcdBuf, int Len);
-
-/* -----------------------------------------------------------------------------
- * FUNCTION NAME:   ISO8583Utils_BCD2LEN
- * DESCRIPTION:     Convert BcdLen bytes BCD length to int
- * RETURN:          None
- ---------------------------------------------------------------------------- */
-int ISO8583Utils_BCD2LEN( unsigned char * BcdBuf, int * Len, int BcdLen );
-
-/* -----------------------------------------------------------------------------
- * FUNCTION NAME:   ISO8583Utils_LEN2BCD
- * DESCRIPTION:     Convert BcdLen bytes BCD length to int
- * PARAMETERS:
- * RETURN:          None
- ---------------------------------------------------------------------------- */
-int ISO8583Utils_LEN2BCD( int Len, byte * BcdBuf, int BcdLen);
-
-#endif
+/***************************************************************************
+* FILE NAME:    ISO8583Engine.H                                            *
+* MODULE NAME:  ISO8583Engine                                              *
+* PROGRAMMER:                                                              *
+* DESCRIPTION:                                                             *
+* REVISION:                                                                *
+****************************************************************************/
+
+#ifndef _ISO8583ENGINE_H
+#define _ISO8583ENGINE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//Return values enum
+typedef enum
+{
+    ISOENGINE_OK = 0,
+    ISOENGINE_NOT_SET_FIELD_FMT = -100,
+    ISOENGINE_INVALID_FIELD_NO,
+    ISOENGINE_TOO_LONG_FILED_LENGTH,
+    ISOENGINE_INVALID_FIELD_LENGTH,
+    ISOENGINE_OVER_MAXLENGTH,
+    ISOENGINE_INVALID_FIELD_DATA,
+    ISOENGINE_TOO_SMALL_FIELD_BUF_SIZE,
+    ISOENGINE_TRUNCATED_MSG,
+} ISO8583_ENGINE_RetVal;
+
+//Maximum field number, 128 with a secondary bitmap. Whether a spec uses the
+//secondary bitmap is chosen at run time, see ISO8583_BitMode.
+#define ISO8583_MAXFIELD        128
+
+//Fields covered by the primary bitmap
+#define ISO8583_PRIMARYFIELD    64
+
+#ifndef byte
+typedef unsigned char byte;
+#endif
+
+//Windows headers define TRUE / FALSE, other platforms get them here
+#ifndef TRUE
+#define TRUE    1
+#endif
+
+#ifndef FALSE
+#define FALSE   0
+#endif
+
+#include <stddef.h>
+
+#if defined( _WIN32 )
+//POSIX scatter / gather element, see ISO8583Engine_Iso8583ToIovec
+struct iovec
+{
+    void * iov_base;
+    size_t iov_len;
+};
+#else
+#include <sys/uio.h>
+#endif
+
+//Maximum length of ISO8583 data held by an ISO8583_FixRec, pooled records grow
+//past it up to ISO8583_POOL_MAXDATA (see ISO8583Pool.h)
+#define ISO8583_MAXLENTH        1024
+
+//Maximum length of a RAW message indexed by ISO8583_View, field offsets are int
+#define ISO8583_MAXVIEWLEN      0x7FFFFFFF
+
+#define ISO8583TYPE_FIX         0x01    // type fix length
+#define ISO8583TYPE_VAR         0x02    // type Variable length - 99/999
+#define ISO8583TYPE_BIN         0x04    // type Binary  - 'b','h'
+#define ISO8583TYPE_ASC         0x08    // type ASCII   - 'a','an','ans'
+#define ISO8583TYPE_BCD         0x10    // type BCD     - 'n','z'
+#define ISO8583TYPE_DIGIT       0x20    // type Digit   - '0'~'9'
+
+//BCD/ASCII conversion kernel levels, see ISO8583Utils_SetSimdLevel
+typedef enum
+{
+    ISO8583_SIMD_AUTO = -1,
+    ISO8583_SIMD_SCALAR = 0,
+    ISO8583_SIMD_SSE2,
+    ISO8583_SIMD_SSSE3,
+    ISO8583_SIMD_AVX2,
+} ISO8583_SimdLevel;
+
+//BITMAP type 64 / 128
+//ISO8583_BITMAP64:     primary bitmap only, 64 entries of field format, bit 1
+//                      of a received message is ignored
+//ISO8583_BITMAP128:    128 entries of field format, the secondary bitmap is
+//                      always sent and read when bit 1 is set
+//ISO8583_BITMAPAUTO:   128 entries of field format, the secondary bitmap is
+//                      sent only when a field above 64 is set and read when
+//                      bit 1 is set
+typedef enum
+{
+    ISO8583_BITMAP64 = 0,
+    ISO8583_BITMAP128,
+    ISO8583_BITMAPAUTO,
+} ISO8583_BitMode;
+
+
+//ISO8583 field format struct
+typedef struct
+{
+    unsigned char bType;         // (Fix or Var) | (BIN or ASC or BCD)
+    int iMaxLength;     // data max length
+} ISO8583_FieldFormat;
+
+//Content a field may hold, checked by ISO8583Engine_HexbufToIso8583Strict
+typedef enum
+{
+    ISO8583_CLASS_ANY = 0,      // b, not checked
+    ISO8583_CLASS_N,            // digits
+    ISO8583_CLASS_Z,            // track data: digits and separator, nibble D
+                                // packed, 0x30 - 0x3F ASCII
+    ISO8583_CLASS_A,            // letters and space
+    ISO8583_CLASS_AN,           // letters, digits and space
+    ISO8583_CLASS_ANS,          // printable, 0x20 - 0x7E
+    ISO8583_CLASS_NS,           // printable but letters
+} ISO8583_CharClass;
+
+//Field layout compiled from ISO8583_FieldFormat by ISO8583Engine_InitFieldFormat,
+//read by the pack / unpack loops instead of the bType bits. bClass and bLuhn
+//default to N for packed fields (Z for 35 and 36), ANS for ASC fields and a
+//Luhn check on a numeric field 2; ISO8583SpecFile sets them per field.
+typedef struct
+{
+    unsigned char bPrefix;          // length prefix bytes, 0 for fixed fields
+    unsigned char bPacked;          // digits packed two per byte
+    unsigned char bClass;           // ISO8583_CharClass
+    unsigned char bLuhn;            // last digit is a Luhn check digit
+    unsigned short usLength;        // fixed fields: length as in ISO8583_ElementFlag.len
+    unsigned short usWire;          // fixed fields: bytes on the wire
+    unsigned short usMaxLength;     // variable fields: longest length
+} ISO8583_FieldOp;
+
+#if defined( __cplusplus )
+#define ISO8583_CACHELINE   alignas( 64 )
+#elif defined( _MSC_VER )
+#define ISO8583_CACHELINE   __declspec( align( 64 ) )
+#else
+#define ISO8583_CACHELINE   _Alignas( 64 )
+#endif
+
+//ISO8583 spec context: bitmap mode and field layout of one network dialect.
+//Initiated by ISO8583Engine_InitFieldFormat() and read-only afterwards, so one
+//spec may be shared by any number of threads packing/unpacking concurrently.
+//It holds no pointers, so a spec may also be copied or mapped from a file
+//written by the same build, see ISO8583SpecFile.h.
+typedef struct
+{
+    unsigned char bBitMapMode;
+    unsigned char bFldFormatSetFlag;
+    int iMaxField;      // ISO8583_PRIMARYFIELD or ISO8583_MAXFIELD, from bBitMapMode
+    ISO8583_FieldFormat FldFormat[ ISO8583_MAXFIELD ];
+    ISO8583_CACHELINE ISO8583_FieldOp Op[ ISO8583_MAXFIELD ];
+} ISO8583_Spec;
+
+typedef struct
+{
+    short bitf;
+    short len;
+    int addr;
+} ISO8583_ElementFlag;
+
+struct ISO8583_Pool;
+
+//Field presence is kept in ulBitmap: bit ( n - 1 ) % 64 of word ( n - 1 ) / 64
+//is set when field n is. Field[].bitf mirrors it for existing callers.
+//The field data area cData is either caller-owned (ISO8583Engine_InitRec,
+//ISO8583_FixRec) or comes from a pool and grows on demand (ISO8583Pool_Acquire).
+//Field points at PrimaryField until a field above 64 is set, pooled records
+//then move to a pool block of ISO8583_MAXFIELD entries. Field points into the
+//record itself, so a record must not be copied by value.
+typedef struct
+{
+    int iOffset;                    // bytes of cData in use
+    int iCapacity;                  // size of cData
+    unsigned char * cData;
+    unsigned char cMsgID[ 5 ];
+    unsigned long long ulBitmap[ ISO8583_MAXFIELD / 64 ];
+    struct ISO8583_Pool * pPool;    // owning pool, NULL for caller-owned cData
+    int iMaxField;                  // entries in Field
+    ISO8583_ElementFlag * Field;
+    ISO8583_ElementFlag PrimaryField[ ISO8583_PRIMARYFIELD ];
+} ISO8583_Rec;
+
+//Record with inline storage for all 128 fields for stack / static use, see
+//ISO8583Engine_InitFixRec
+typedef struct
+{
+    ISO8583_Rec Rec;
+    ISO8583_ElementFlag Field[ ISO8583_MAXFIELD ];
+    unsigned char cBuf[ ISO8583_MAXLENTH ];
+} ISO8583_FixRec;
+
+//Zero-copy index of a RAW iso8583 buffer, filled by ISO8583Engine_ParseView
+//or, lazily, by ISO8583Engine_OpenView. ulBitmap is the message bitmap, same
+//bit order as ISO8583_Rec.ulBitmap. Field[].addr (offset of the field data
+//inside pBuf) and Field[].len (same meaning as in ISO8583_Rec) are valid for
+//the first iResolved fields only; Field[].bitf is not used.
+typedef struct
+{
+    const byte * pBuf;
+    int iLength;
+    int iResolved;      // fields with offsets resolved
+    int iCursor;        // offset in pBuf just past the last resolved field
+    int iError;         // sticky resolution error, ISOENGINE_OK if none
+    unsigned long long ulBitmap[ ISO8583_MAXFIELD / 64 ];
+    ISO8583_ElementFlag Field[ ISO8583_MAXFIELD ];
+} ISO8583_View;
+
+//Reason of an error found by ISO8583Engine_HexbufToIso8583Strict
+typedef enum
+{
+    ISO8583_CHECK_OK = 0,
+    ISO8583_CHECK_MTI,          // message type not 4 digits
+    ISO8583_CHECK_FORMAT,       // field present with no format in the spec
+    ISO8583_CHECK_PREFIX,       // length prefix not BCD digits
+    ISO8583_CHECK_LENGTH,       // length above the maximum of the field
+    ISO8583_CHECK_TRUNCATED,    // message ends inside the field
+    ISO8583_CHECK_DIGIT,        // nibble or byte of a N / Z field not allowed
+    ISO8583_CHECK_CHARSET,      // byte outside the ISO8583_CharClass of the field
+    ISO8583_CHECK_LUHN,         // wrong check digit
+} ISO8583_CheckReason;
+
+//Where ISO8583Engine_HexbufToIso8583Strict stopped
+typedef struct
+{
+    int iFieldNo;       // field in error, 0 for the message type or none
+    int iReason;        // ISO8583_CheckReason
+    int iOffset;        // offset in the message of the first bad byte
+} ISO8583_CheckError;
+
+//Field edit applied by ISO8583Engine_Transform
+typedef enum
+{
+    ISO8583_EDIT_SET = 0,       // set the field, present or not
+    ISO8583_EDIT_REPLACE,       // set the field only when the source has it
+    ISO8583_EDIT_REMOVE,        // drop the field
+} ISO8583_EditOp;
+
+//One field edit. iFieldNo 0 sets the message ID (4 ASC digits, SET only).
+//pData / iLength are ASC data as for ISO8583Engine_SetField, unused for REMOVE.
+typedef struct
+{
+    int iFieldNo;
+    int iOp;
+    const unsigned char * pData;
+    int iLength;
+} ISO8583_Edit;
+
+//Message template: the static fields of a message encoded once, in wire form,
+//by ISO8583Engine_InitTemplate. View indexes cWire, its pBuf is not used so a
+//template may be copied by value.
+typedef struct
+{
+    int iLength;        // bytes of cWire used
+    ISO8583_View View;
+    unsigned char cWire[ ISO8583_MAXLENTH ];
+} ISO8583_Template;
+
+//Fixed point amount, llValue / 10^iScale, e.g. 1234 with iScale 2 is 12.34
+typedef struct
+{
+    long long llValue;
+    int iScale;         // decimal places, 0 - 18
+} ISO8583_Amount;
+
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Engine_InitFieldFormat
+ * DESCRIPTION:     Set ISO8583 field type and format, should be called
+ *                  before the using of ISO8583 engine module
+ * PARAMETERS:      pSpec(out): spec context to initiate
+ *                  bBitMode: Iso8583 bitmap mode, see enum ISO8583_BitMode in ISO8583Engine.h
+ *                  pFieldFormat: poFieldFormat definitions, 64 entries for
+ *                                ISO8583_BITMAP64, 128 entries otherwise
+ * RETURN:          ISOENGINE_OK
+ ---------------------------------------------------------------------------- */
+int ISO8583Engine_InitFieldFormat( ISO8583_Spec * pSpec, ISO8583_BitMode bBitMode, const ISO8583_FieldFormat *pIso8583FieldFormat );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Engine_InitRec
+ * DESCRIPTION:     Initiate an ISO8583_Rec on caller-owned field data storage,
+ *                  must be called once before any other use of the record.
+ *                  The record holds fields 1 to 64 only.
+ * PARAMETERS:      ptIso8583Data: ISO8583 data structure
+ *                  pBuf: field data area, must outlive the record
+ *                  iSize: size of pBuf
+ * RETURN:          ISOENGINE_OK
+ ---------------------------------------------------------------------------- */
+int ISO8583Engine_InitRec( ISO8583_Rec * ptIso8583Data, unsigned char * pBuf, int iSize );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Engine_InitFixRec
+ * DESCRIPTION:     Initiate an ISO8583_FixRec on its own ISO8583_MAXLENTH buffer
+ * RETURN:          The record to pass to the other ISO8583Engine functions
+ ---------------------------------------------------------------------------- */
+ISO8583_Rec * ISO8583Engine_InitFixRec( ISO8583_FixRec * ptFixRec );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Engine_Reserve
+ * DESCRIPTION:     Make sure the field data area holds at least iSize bytes.
+ *                  Pooled records move to a larger pool block, records on
+ *                  caller-owned storage cannot grow.
+ * RETURN:          ISOENGINE_OK or ISOENGINE_OVER_MAXLENGTH
+ ---------------------------------------------------------------------------- */
+int ISO8583Engine_Reserve( ISO8583_Rec * ptIso8583Data, int iSize );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Engine_ReserveFields
+ * DESCRIPTION:     Make sure Field holds at least iMaxField entries. Pooled
+ *                  records move to a pool block, other records cannot grow.
+ * RETURN:          ISOENGINE_OK or ISOENGINE_INVALID_FIELD_NO
+ ---------------------------------------------------------------------------- */
+int ISO8583Engine_ReserveFields( ISO8583_Rec * ptIso8583Data, int iMaxField );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Engine_ClearAllFields
+ * DESCRIPTION:     Clear all field data in ISO8583_Rec structure, in time
+ *                  proportional to the number of fields set. The record must
+ *                  have been initiated, see ISO8583Engine_InitRec.
+ * PARAMETERS:      ptIso8583Data: ISO8583 data structure
+ * RETURN:          None.
+ ---------------------------------------------------------------------------- */
+int ISO8583Engine_ClearAllFields( ISO8583_Rec * ptIso8583Data );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Engine_ClearOneField
+ * DESCRIPTION:     Clear one field data
+ * PARAMETERS:      ptIso8583Data: pointer to ISO8583 data structure
+ *                  iFieldNo: Field No
+ * RETURN:          None
+ ---------------------------------------------------------------------------- */
+int ISO8583Engine_ClearOneField( ISO8583_Rec * ptIso8583Data, int iFieldNo );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Engine_SetField
+ * DESCRIPTION:     Set ISO8583 field data
+                    pFieldData must be the ASC format, only iDataLength bytes
+                    of it are read. Short data of a fixed length field is
+                    padded, ASC with spaces and binary with zeros.
+ * return:          if successful, return 0; else
+ *                  -1: not set iso8583 field format
+ *                  -2: iFieldNo > APPISO8583_MAXFIELD or iFieldNo <= 1
+ *                  -3: iDataLength > 999
+ *                  -4: iso8583 string total length already > capacity of the record
+ ---------------------------------------------------------------------------- */
+int ISO8583Engine_SetField(const ISO8583_Spec * pSpec, ISO8583_Rec * pIsoRec, int iFieldNo, unsigned char * pFieldData, int iDataLength);
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Engine_GetField
+ * DESCRIPTION:     Get ISO8583 field data
+                    pRetFieldData must be the ASC format
+ * return:          Return FieldData length has gotten
+ ---------------------------------------------------------------------------- */
+int ISO8583Engine_GetField(const ISO8583_Spec * pSpec, ISO8583_Rec * cpIsoRec, int iFieldNo, unsigned char * pRetFieldData, int iSizeofRetFieldData);
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Engine_GetFieldU64
+ * DESCRIPTION:     Get a numeric field as an integer. Packed BCD fields are
+ *                  converted straight from the record, ASC fields from their
+ *                  digits, with no ASC copy in between.
+ * PARAMETERS:      pSpec: spec context
+ *                  pIsoRec: ISO8583 data struct
+ *                  iFieldNo: Field No
+ *                  pullValue(out): field value, 0 when not present
+ * RETURN:          >0: success, digits of the field
+ *                  0: field not present
+ *                  ISOENGINE_INVALID_FIELD_NO: iFieldNo beyond the spec or iFieldNo <= 1
+ *                  ISOENGINE_INVALID_FIELD_DATA: BIN field, empty or not all digits
+ *                  ISOENGINE_OVER_MAXLENGTH: value does not fit 64 bits
+ ---------------------------------------------------------------------------- */
+int ISO8583Engine_GetFieldU64( const ISO8583_Spec * pSpec, ISO8583_Rec * pIsoRec, int iFieldNo, unsigned long long * pullValue );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Engine_GetFieldU32
+ * DESCRIPTION:     ISO8583Engine_GetFieldU64 of a field such as the STAN
+ * PARAMETERS:      puiValue(out): field value, 0 when not present
+ * RETURN:          As for ISO8583Engine_GetFieldU64, ISOENGINE_OVER_MAXLENGTH
+ *                  when the value does not fit 32 bits
+ ---------------------------------------------------------------------------- */
+int ISO8583Engine_GetFieldU32( const ISO8583_Spec * pSpec, ISO8583_Rec * pIsoRec, int iFieldNo, unsigned int * puiValue );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Engine_SetFieldU64
+ * DESCRIPTION:     Set a numeric field from an integer. Fixed fields are
+ *                  filled with leading zeros, variable fields get the digits
+ *                  of the value. Packed BCD fields are written straight to
+ *                  the record with no ASC copy in between.
+ * PARAMETERS:      pSpec: spec context
+ *                  pIsoRec: ISO8583 data struct
+ *                  iFieldNo: Field No
+ *                  ullValue: field value, any unsigned type
+ * RETURN:          ISOENGINE_OK
+ *                  ISOENGINE_INVALID_FIELD_DATA: BIN field
+ *                  ISOENGINE_TOO_LONG_FILED_LENGTH: more digits than the field
+ *                  other <0: as for ISO8583Engine_SetField
+ ---------------------------------------------------------------------------- */
+int ISO8583Engine_SetFieldU64( const ISO8583_Spec * pSpec, ISO8583_Rec * pIsoRec, int iFieldNo, unsigned long long ullValue );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Engine_GetFieldAmount
+ * DESCRIPTION:     Get an amount field, e.g. field 4, as a fixed point amount
+ * PARAMETERS:      iScale: decimal places of the field, the exponent of the
+ *                          currency in field 49
+ *                  pAmount(out): amount, 0 when not present
+ * RETURN:          As for ISO8583Engine_GetFieldU64
+ ---------------------------------------------------------------------------- */
+int ISO8583Engine_GetFieldAmount( const ISO8583_Spec * pSpec, ISO8583_Rec * pIsoRec, int iFieldNo, int iScale, ISO8583_Amount * pAmount );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Engine_SetFieldAmount
+ * DESCRIPTION:     Set an amount field from a fixed point amount, rescaled to
+ *                  the decimal places of the field
+ * PARAMETERS:      iScale: decimal places of the field
+ *                  pAmount: amount, llValue >= 0
+ * RETURN:          As for ISO8583Engine_SetFieldU64,
+ *                  ISOENGINE_INVALID_FIELD_DATA: negative amount, scale out of
+ *                  range or more decimal places than iScale keeps
+ ---------------------------------------------------------------------------- */
+int ISO8583Engine_SetFieldAmount( const ISO8583_Spec * pSpec, ISO8583_Rec * pIsoRec, int iFieldNo, int iScale, const ISO8583_Amount * pAmount );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Engine_ReserveField
+ * DESCRIPTION:     Make room for the data of a field and mark it set, so it
+ *                  can be written in place, e.g. by an ISO8583_TlvBuilder,
+ *                  and finished with ISO8583Engine_CommitField. Only for
+ *                  fields kept as they are on the wire, not packed BCD. No
+ *                  other field of the record may be set or cleared before
+ *                  the commit.
+ * PARAMETERS:      pSpec: spec context
+ *                  pIsoRec: ISO8583 data struct
+ *                  iFieldNo: Field No
+ *                  iSize: bytes to reserve, at most the maximum length of a
+ *                         variable field, fixed fields get their length
+ *                  ppData(out): where the field data goes
+ * RETURN:          >0: bytes reserved at *ppData
+ *                  ISOENGINE_INVALID_FIELD_DATA: packed BCD field
+ *                  ISOENGINE_INVALID_FIELD_LENGTH: iSize out of range
+ *                  other <0: as for ISO8583Engine_SetField
+ ---------------------------------------------------------------------------- */
+int ISO8583Engine_ReserveField( const ISO8583_Spec * pSpec, ISO8583_Rec * pIsoRec, int iFieldNo, int iSize, byte ** ppData );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Engine_CommitField
+ * DESCRIPTION:     Set the length of a field written in place after
+ *                  ISO8583Engine_ReserveField, unused reserved bytes are
+ *                  given back when the field is the last one stored
+ * PARAMETERS:      pSpec: spec context
+ *                  pIsoRec: ISO8583 data struct
+ *                  iFieldNo: Field No
+ *                  iLength: bytes written, 1 - the bytes reserved, a fixed
+ *                           field must be filled
+ * RETURN:          ISOENGINE_OK
+ *                  ISOENGINE_INVALID_FIELD_NO: field not reserved
+ *                  ISOENGINE_INVALID_FIELD_LENGTH: iLength out of range
+ ---------------------------------------------------------------------------- */
+int ISO8583Engine_CommitField( const ISO8583_Spec * pSpec, ISO8583_Rec * pIsoRec, int iFieldNo, int iLength );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Engine_HexbufToIso8583
+ * DESCRIPTION:     Convert ISO8583 RAW hex buffer data to ISO8583_Rec struct
+ * PARAMETERS:      pSpec: spec context
+ *                  pIso8583Data(out): Converted Iso8583 data structure
+ *                  pBuf(in): RAW iso8583 hex buf data
+ * RETURN:          =0: success,
+ *                  -1: variable field length error
+ *                  -2: iFieldNo >= ISO8583_MAXFIELD or iFieldNo < 1
+ *                  -3: iso8583 string total length already > capacity of the record
+ ---------------------------------------------------------------------------- */
+int ISO8583Engine_HexbufToIso8583( const ISO8583_Spec * pSpec, ISO8583_Rec * pIso8583Data, unsigned char * pBuf );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Engine_HexbufToIso8583Len
+ * DESCRIPTION:     ISO8583Engine_HexbufToIso8583 on a buffer of known length,
+ *                  e.g. a frame from ISO8583Framer_Next. Reads never go past
+ *                  pBuf + nLength.
+ * RETURN:          =0: success,
+ *                  ISOENGINE_TRUNCATED_MSG: message ends before a field does
+ *                  -1: variable field length error
+ *                  -3: iso8583 string total length already > capacity of the record
+ ---------------------------------------------------------------------------- */
+int ISO8583Engine_HexbufToIso8583Len( const ISO8583_Spec * pSpec, ISO8583_Rec * pIso8583Data, const byte * pBuf, size_t nLength );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Engine_HexbufToIso8583Strict
+ * DESCRIPTION:     ISO8583Engine_HexbufToIso8583Len that also checks every
+ *                  field against its spec as it is copied: length prefix
+ *                  digits, maximum length, ISO8583_FieldOp.bClass content and
+ *                  the Luhn check digit where bLuhn is set. Decoding stops at
+ *                  the first error.
+ * PARAMETERS:      pSpec: spec context
+ *                  pIso8583Data(out): Converted Iso8583 data structure
+ *                  pBuf(in): RAW iso8583 hex buf data
+ *                  nLength: number of bytes in pBuf
+ *                  pError(out): field, ISO8583_CheckReason and offset of the
+ *                               error, iReason ISO8583_CHECK_OK if none
+ * RETURN:          =0: success,
+ *                  ISOENGINE_INVALID_FIELD_DATA: content error
+ *                  ISOENGINE_INVALID_FIELD_LENGTH: field longer than its maximum
+ *                  ISOENGINE_TRUNCATED_MSG: message ends before a field does
+ *                  -3: iso8583 string total length already > capacity of the record
+ ---------------------------------------------------------------------------- */
+int ISO8583Engine_HexbufToIso8583Strict( const ISO8583_Spec * pSpec, ISO8583_Rec * pIso8583Data, const byte * pBuf, size_t nLength, ISO8583_CheckError * pError );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Engine_Iso8583ToHexbuf
+ * DESCRIPTION:     Convert ISO8583_Rec struct to Hex buffer - RAW ISO8583 data
+ * PARAMETERS:      pSpec: spec context
+ *                  pIso8583Data: Iso8583 data structure
+ *                  pRetBuf: RAW iso8583 hex buf data
+ *                  iSizeRetBuf: size of pRetBuf
+ * RETURN:          >0: success,
+ *                  -1: variable field length error
+ *                  -2: iFieldNo >= ISO8583_MAXFIELD or iFieldNo < 1
+ *                  -3: iso8583 string total length already > iSizeRetBuf
+ *                  -4: field data outside of ISO8583_Rec.cData
+ ---------------------------------------------------------------------------- */
+int ISO8583Engine_Iso8583ToHexbuf( const ISO8583_Spec * pSpec, ISO8583_Rec * pIso8583Data, unsigned char * pRetBuf, int iSizeRetBuf );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Engine_Iso8583ToIovec
+ * DESCRIPTION:     Encode a message as an iovec list for writev / sendmsg
+ *                  instead of one buffer. The message ID, bitmap, length
+ *                  prefixes and packed BCD fields are written to pArena;
+ *                  record fields point into ISO8583_Rec.cData and pFields
+ *                  ASC / binary fields point at the caller's data, neither is
+ *                  copied. Entries that follow each other in memory are
+ *                  merged. The list is valid as long as pArena, the record
+ *                  and the pFields data are not changed.
+ * PARAMETERS:      pSpec: spec context
+ *                  pIso8583Data: Iso8583 data structure, NULL to encode
+ *                                pFields alone (field 0 then required)
+ *                  pFields: field edits as for ISO8583Engine_Transform, with
+ *                           the record as the source; pData of SET fields
+ *                           is ASC data as for ISO8583Engine_SetField
+ *                  iFields: number of edits
+ *                  pArena(out): header bytes, 2 + 16 + 2 per variable field
+ *                               plus the packed fields is always enough
+ *                  iSizeArena: size of pArena
+ *                  pIov(out): iovec list
+ *                  iMaxIov: entries of pIov, 2 per field + 1 is always enough
+ *                  pnLength(out): bytes of the message, sum of the entries
+ * RETURN:          >0: number of pIov entries used
+ *                  ISOENGINE_INVALID_FIELD_NO: bad field number, or no record
+ *                                              and no field 0
+ *                  ISOENGINE_INVALID_FIELD_LENGTH: empty field edit
+ *                  -3: pArena or pIov too small
+ *                  -4: field data outside of ISO8583_Rec.cData
+ ---------------------------------------------------------------------------- */
+int ISO8583Engine_Iso8583ToIovec( const ISO8583_Spec * pSpec, ISO8583_Rec * pIso8583Data, const ISO8583_Edit * pFields, int iFields,
+                                  unsigned char * pArena, int iSizeArena, struct iovec * pIov, int iMaxIov, size_t * pnLength );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Engine_OpenView
+ * DESCRIPTION:     Lazy zero-copy decode: check the message ID and bitmap of a
+ *                  RAW iso8583 buffer and note which fields are present. Field
+ *                  offsets are resolved by ISO8583Engine_ViewGetField /
+ *                  ISO8583Engine_ViewFieldPtr only as far as the highest
+ *                  field asked for, and cached in the view.
+ * PARAMETERS:      pSpec: spec context
+ *                  pView(out): field index into pBuf
+ *                  pBuf(in): RAW iso8583 hex buf data, must outlive pView
+ *                  nLength: number of bytes in pBuf
+ * RETURN:          ISOENGINE_OK: success
+ *                  ISOENGINE_TRUNCATED_MSG: message shorter than its bitmap
+ *                  ISOENGINE_INVALID_FIELD_NO: field bit set beyond the spec
+ ---------------------------------------------------------------------------- */
+int ISO8583Engine_OpenView( const ISO8583_Spec * pSpec, ISO8583_View * pView, const byte * pBuf, size_t nLength );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Engine_ParseView
+ * DESCRIPTION:     Index a RAW iso8583 buffer in place: record the offset and
+ *                  length of every field present, copy nothing. Reads never
+ *                  go past pBuf + nLength.
+ * PARAMETERS:      pSpec: spec context
+ *                  pView(out): field index into pBuf
+ *                  pBuf(in): RAW iso8583 hex buf data, must outlive pView
+ *                  nLength: number of bytes in pBuf
+ * RETURN:          ISOENGINE_OK: success
+ *                  ISOENGINE_TRUNCATED_MSG: message ends before a field does
+ *                  ISOENGINE_INVALID_FIELD_NO: field bit set beyond the spec
+ *                  -1: variable field length error
+ ---------------------------------------------------------------------------- */
+int ISO8583Engine_ParseView( const ISO8583_Spec * pSpec, ISO8583_View * pView, const byte * pBuf, size_t nLength );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Engine_ViewGetField
+ * DESCRIPTION:     ISO8583Engine_GetField on a view, the data is read straight
+ *                  from the viewed buffer
+ * return:          Return FieldData length has gotten, 0 if not present
+ ---------------------------------------------------------------------------- */
+int ISO8583Engine_ViewGetField( const ISO8583_Spec * pSpec, ISO8583_View * pView, int iFieldNo, unsigned char * pRetFieldData, int iSizeofRetFieldData );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Engine_ViewGetFieldU64
+ * DESCRIPTION:     ISO8583Engine_GetFieldU64 on a view, the value is converted
+ *                  straight from the viewed buffer
+ * return:          >0: digits of the field, 0 if not present, <0 error
+ ---------------------------------------------------------------------------- */
+int ISO8583Engine_ViewGetFieldU64( const ISO8583_Spec * pSpec, ISO8583_View * pView, int iFieldNo, unsigned long long * pullValue );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Engine_ViewFieldPtr
+ * DESCRIPTION:     Locate the RAW field data inside the viewed buffer, packed
+ *                  BCD fields are returned packed
+ * return:          >0: field length, in digits for BCD fields, bytes otherwise
+ *                  0: field not present
+ ---------------------------------------------------------------------------- */
+int ISO8583Engine_ViewFieldPtr( const ISO8583_Spec * pSpec, ISO8583_View * pView, int iFieldNo, const byte ** ppData );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Engine_Transform
+ * DESCRIPTION:     Build a new RAW message from a RAW source message and a
+ *                  list of field edits, e.g. a response from its request.
+ *                  Fields the edits do not touch are block-copied from pSrc,
+ *                  only edited fields are encoded. The output is the same as
+ *                  HexbufToIso8583, SetField / ClearOneField per edit and
+ *                  Iso8583ToHexbuf. When a field is edited more than once
+ *                  the last edit wins.
+ * PARAMETERS:      pSpec: spec context
+ *                  pSrc: RAW source message, nSrcLen bytes
+ *                  pEdits: iEdits field edits, any order
+ *                  pRetBuf(out): RAW output message, must not overlap pSrc
+ *                  iSizeRetBuf: size of pRetBuf
+ * RETURN:          >0: success, length of pRetBuf used
+ *                  -3: output longer than iSizeRetBuf
+ *                  ISOENGINE_INVALID_FIELD_NO: edit of a field beyond the spec
+ *                  ISOENGINE_INVALID_FIELD_LENGTH: edit with no data
+ *                  ISOENGINE_TOO_LONG_FILED_LENGTH: edit longer than 999
+ *                  other <0: source message error, see ISO8583Engine_ParseView
+ ---------------------------------------------------------------------------- */
+int ISO8583Engine_Transform( const ISO8583_Spec * pSpec, const byte * pSrc, size_t nSrcLen,
+                             const ISO8583_Edit * pEdits, int iEdits, byte * pRetBuf, int iSizeRetBuf );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Engine_InitTemplate
+ * DESCRIPTION:     Encode the static fields of a message once
+ * PARAMETERS:      pSpec: spec context, the template is only valid with it
+ *                  pTemplate(out): template
+ *                  pStatic: iStatic ISO8583_EDIT_SET edits of the static
+ *                           fields, field 0 for the message ID ("0000" if none)
+ * RETURN:          ISOENGINE_OK or an error as for ISO8583Engine_Transform
+ ---------------------------------------------------------------------------- */
+int ISO8583Engine_InitTemplate( const ISO8583_Spec * pSpec, ISO8583_Template * pTemplate, const ISO8583_Edit * pStatic, int iStatic );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Engine_TemplateToHexbuf
+ * DESCRIPTION:     Encode one message from a template and its dynamic fields.
+ *                  The pre-encoded static fields are spliced in bitmap order
+ *                  with the dynamic ones, which are the only fields encoded.
+ *                  A dynamic edit of a static field overrides it, as in
+ *                  ISO8583Engine_Transform with the template as the source.
+ * PARAMETERS:      pSpec: spec context of ISO8583Engine_InitTemplate
+ *                  pTemplate: template
+ *                  pDynamic: iDynamic edits, message ID and dynamic fields
+ *                  pRetBuf(out): RAW iso8583 message
+ *                  iSizeRetBuf: size of pRetBuf
+ * RETURN:          >0: success, length of pRetBuf used
+ *                  <0: error as for ISO8583Engine_Transform
+ ---------------------------------------------------------------------------- */
+int ISO8583Engine_TemplateToHexbuf( const ISO8583_Spec * pSpec, const ISO8583_Template * pTemplate,
+                                    const ISO8583_Edit * pDynamic, int iDynamic, byte * pRetBuf, int iSizeRetBuf );
+
+/* --------------------------------------------------------------------------
+* FUNCTION NAME: ISO8583Utils_BCD2ASC
+* DESCRIPTION:   Convert BCD code to ASCII code.
+* PARAMETERS:    BcdBuf - BCD input buffer, Len - double length of Bcdbuf bytes
+*                AscBuf - converted result
+* RETURN:        0
+* NOTES:
+* ------------------------------------------------------------------------ */
+int ISO8583Utils_BCD2ASC(unsigned char * BcdBuf, unsigned char * AscBuf, int Len);
+
+/* --------------------------------------------------------------------------
+* FUNCTION NAME: ISO8583Utils_ASC2BCD
+* DESCRIPTION:   Convert ASCII code to BCD code.
+* PARAMETERS:    AscBuf - Ascii input buffer, must ended by '\0'
+*                Len - double length of BCD code, should be even.
+*                BcdBuf - converted BCD code result
+* RETURN:        0
+* NOTES:         support 'A'-'F' convertion(extend BCD code)
+* ------------------------------------------------------------------------ */
+int ISO8583Utils_ASC2BCD(unsigned char * AscBuf, unsigned char * BcdBuf, int Len);
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Utils_BCD2U64
+ * DESCRIPTION:     Convert Len packed BCD digits to an integer
+ * PARAMETERS:      BcdBuf: BCD input, left aligned, the pad nibble of an odd
+ *                          Len is ignored
+ *                  Len: number of digits, 1 - 20
+ *                  pValue(out): converted value
+ * RETURN:          0, -1: a nibble is not a digit, -2: Len out of range or
+ *                  the value does not fit 64 bits
+ ---------------------------------------------------------------------------- */
+int ISO8583Utils_BCD2U64( const unsigned char * BcdBuf, int Len, unsigned long long * pValue );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Utils_ASC2U64
+ * DESCRIPTION:     Convert Len ASCII digits to an integer
+ * PARAMETERS:      AscBuf: ASCII input
+ *                  Len: number of digits, 1 - 20
+ *                  pValue(out): converted value
+ * RETURN:          0, -1: a char is not a digit, -2: Len out of range or the
+ *                  value does not fit 64 bits
+ ---------------------------------------------------------------------------- */
+int ISO8583Utils_ASC2U64( const unsigned char * AscBuf, int Len, unsigned long long * pValue );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Utils_U642BCD
+ * DESCRIPTION:     Convert an integer to Len packed BCD digits
+ * PARAMETERS:      Value: value to convert
+ *                  BcdBuf(out): ( Len + 1 ) / 2 bytes, left aligned with
+ *                               leading zeros, an odd Len gets a 0 pad nibble
+ *                  Len: number of digits, > 0
+ * RETURN:          0, -1: Value has more than Len digits
+ ---------------------------------------------------------------------------- */
+int ISO8583Utils_U642BCD( unsigned long long Value, unsigned char * BcdBuf, int Len );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Utils_CheckBCD
+ * DESCRIPTION:     Check that Len packed BCD digits are 0 - 9, 16 digits at
+ *                  a time
+ * PARAMETERS:      BcdBuf: BCD input, left aligned, the pad nibble of an odd
+ *                          Len is not checked
+ *                  Len: number of digits
+ *                  bTrack: nibble D, the track data separator, is allowed
+ * RETURN:          -1: all digits are good, else the first bad digit
+ ---------------------------------------------------------------------------- */
+int ISO8583Utils_CheckBCD( const unsigned char * BcdBuf, int Len, int bTrack );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Utils_CheckChars
+ * DESCRIPTION:     Check that Len bytes belong to a character class, 8 bytes
+ *                  at a time
+ * PARAMETERS:      Buf: input
+ *                  Len: number of bytes
+ *                  iClass: ISO8583_CharClass
+ * RETURN:          -1: all bytes are good, else the offset of the first bad one
+ ---------------------------------------------------------------------------- */
+int ISO8583Utils_CheckChars( const unsigned char * Buf, int Len, int iClass );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Utils_Luhn
+ * DESCRIPTION:     Check the Luhn (mod 10) check digit of a number such as a PAN
+ * PARAMETERS:      Buf: digits, packed BCD left aligned or ASCII
+ *                  Len: number of digits, the last one is the check digit
+ *                  bPacked: Buf is packed BCD
+ * RETURN:          0: good, -1: wrong check digit or not all digits
+ ---------------------------------------------------------------------------- */
+int ISO8583Utils_Luhn( const unsigned char * Buf, int Len, int bPacked );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Utils_SetSimdLevel
+ * DESCRIPTION:     Select the BCD/ASCII conversion kernels. By default the best
+ *                  level the CPU supports is detected once, on first use.
+ * PARAMETERS:      iLevel: ISO8583_SIMD_AUTO or one of ISO8583_SimdLevel,
+ *                  levels the CPU lacks are lowered to the best supported one
+ * RETURN:          The level in effect afterwards
+ ---------------------------------------------------------------------------- */
+int ISO8583Utils_SetSimdLevel( int iLevel );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Utils_GetSimdLevel
+ * DESCRIPTION:     Return the BCD/ASCII conversion kernel level in use
+ ---------------------------------------------------------------------------- */
+int ISO8583Utils_GetSimdLevel( void );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Utils_BCD2LEN
+ * DESCRIPTION:     Convert BcdLen bytes BCD length to int
+ * RETURN:          None
+ ---------------------------------------------------------------------------- */
+int ISO8583Utils_BCD2LEN( unsigned char * BcdBuf, int * Len, int BcdLen );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Utils_LEN2BCD
+ * DESCRIPTION:     Convert int length to BcdLen bytes BCD
+ * PARAMETERS:      Len: length, 0 - 10^( 2 * BcdLen ) - 1
+ *                  BcdBuf(out): BcdLen bytes
+ *                  BcdLen: 1 - 10
+ * RETURN:          0, -1: BcdLen or Len out of range
+ ---------------------------------------------------------------------------- */
+int ISO8583Utils_LEN2BCD( int Len, byte * BcdBuf, int BcdLen);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,334 @@
+/***************************************************************************
+* FILE NAME:    ISO8583Framer.C                                            *
+* MODULE NAME:  ISO8583Engine                                              *
+* PROGRAMMER:                                                              *
+* DESCRIPTION:  Incremental stream framer, see ISO8583Framer.h             *
+* REVISION:                                                                *
+****************************************************************************/
+
+#include <string.h>
+
+#include "ISO8583Engine.h"
+#include "ISO8583Framer.h"
+
+/*-----------------------------------------------------------------------------
+ * Internal functions
+ *-----------------------------------------------------------------------------*/
+
+//Largest value a length prefix of the configured format can carry
+static long long PrefixLimit( const ISO8583_FramerCfg * pCfg )
+{
+    long long llLimit = 1;
+    int i;
+
+    for( i = 0; i < pCfg->iLenBytes; i ++ )
+        llLimit *= pCfg->iLenFormat == ISO8583_LEN_BINARY ? 256 : pCfg->iLenFormat == ISO8583_LEN_BCD ? 100 : 10;
+
+    return llLimit - 1;
+}
+
+//Bytes of one frame holding the largest message
+static int MaxFrameSize( const ISO8583_FramerCfg * pCfg )
+{
+    return pCfg->iLenBytes + pCfg->iHeaderLength + pCfg->iMaxMessage;
+}
+
+//Value of the length prefix at pRpt, -1 for a non digit or a value past int
+static int DecodePrefix( const ISO8583_FramerCfg * pCfg, const byte * pRpt )
+{
+    unsigned int uiLength = 0;
+    int i;
+
+    for( i = 0; i < pCfg->iLenBytes; i ++ )
+    {
+        if( pCfg->iLenFormat == ISO8583_LEN_BINARY )
+            uiLength = ( uiLength << 8 ) | pRpt[ i ];
+        else if( pCfg->iLenFormat == ISO8583_LEN_BCD )
+        {
+            if(( pRpt[ i ] >> 4 ) > 9 || ( pRpt[ i ] & 0x0F ) > 9 )
+                return -1;
+
+            uiLength = uiLength * 100 + ( pRpt[ i ] >> 4 ) * 10 + ( pRpt[ i ] & 0x0F );
+        }
+        else
+        {
+            if( pRpt[ i ] < '0' || pRpt[ i ] > '9' )
+                return -1;
+
+            uiLength = uiLength * 10 + pRpt[ i ] - '0';
+        }
+    }
+
+    return uiLength > 0x7FFFFFFF ? -1 : ( int )uiLength;
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Framer_CheckCfg
+ * DESCRIPTION:     Check a frame layout
+ * PARAMETERS:      pCfg: frame layout
+ * RETURN:          ISOENGINE_OK
+ *                  ISOENGINE_INVALID_FIELD_LENGTH: bad prefix format or size
+ ---------------------------------------------------------------------------- */
+int ISO8583Framer_CheckCfg( const ISO8583_FramerCfg * pCfg )
+{
+    int iMaxBytes;
+
+    switch( pCfg->iLenFormat )
+    {
+    case ISO8583_LEN_BINARY:
+    case ISO8583_LEN_BCD:
+        iMaxBytes = 4;
+        break;
+    case ISO8583_LEN_ASCII:
+        iMaxBytes = 9;
+        break;
+    default:
+        return ISOENGINE_INVALID_FIELD_LENGTH;
+    }
+
+    if( pCfg->iLenBytes < 1 || pCfg->iLenBytes > iMaxBytes || pCfg->iHeaderLength < 0 || pCfg->iMaxMessage < 1 )
+        return ISOENGINE_INVALID_FIELD_LENGTH;
+
+    //Frame offsets are int
+    if(( long long )pCfg->iMaxMessage + pCfg->iHeaderLength + pCfg->iLenBytes > 0x7FFFFFFF )
+        return ISOENGINE_INVALID_FIELD_LENGTH;
+
+    return ISOENGINE_OK;
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Framer_Init
+ * DESCRIPTION:     Set up a framer on a caller owned buffer
+ * PARAMETERS:      pFramer: framer
+ *                  pCfg: frame layout, copied
+ *                  pBuf: receive buffer
+ *                  iSize: size of pBuf
+ * RETURN:          ISOENGINE_OK
+ *                  ISOENGINE_INVALID_FIELD_LENGTH: bad prefix format or size
+ *                  ISOENGINE_TOO_SMALL_FIELD_BUF_SIZE: iSize below one frame
+ ---------------------------------------------------------------------------- */
+int ISO8583Framer_Init( ISO8583_Framer * pFramer, const ISO8583_FramerCfg * pCfg, byte * pBuf, int iSize )
+{
+    int iRet = ISO8583Framer_CheckCfg( pCfg );
+
+    if( iRet != ISOENGINE_OK )
+        return iRet;
+
+    if( iSize < MaxFrameSize( pCfg ) )
+        return ISOENGINE_TOO_SMALL_FIELD_BUF_SIZE;
+
+    memset( pFramer, 0, sizeof( ISO8583_Framer ) );
+    pFramer->Cfg = *pCfg;
+    pFramer->pBuf = pBuf;
+    pFramer->iSize = iSize;
+    return ISOENGINE_OK;
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Framer_Reset
+ * DESCRIPTION:     Drop all buffered data and a sticky error
+ * PARAMETERS:      pFramer: framer
+ * RETURN:          None.
+ ---------------------------------------------------------------------------- */
+void ISO8583Framer_Reset( ISO8583_Framer * pFramer )
+{
+    pFramer->iHead = 0;
+    pFramer->iTail = 0;
+    pFramer->iError = 0;
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Framer_WritePtr
+ * DESCRIPTION:     Where the next read() goes, frames returned before are
+ *                  invalid afterwards
+ * PARAMETERS:      pFramer: framer
+ *                  piRoom(out): bytes free at the returned pointer
+ * RETURN:          Write pointer into the framer buffer
+ ---------------------------------------------------------------------------- */
+byte * ISO8583Framer_WritePtr( ISO8583_Framer * pFramer, int * piRoom )
+{
+    //Everything consumed, start over at the front for free
+    if( pFramer->iHead == pFramer->iTail )
+    {
+        pFramer->iHead = 0;
+        pFramer->iTail = 0;
+    }
+    //Only move the partial frame when a full frame could no longer follow it,
+    //so the copy is rare and always shorter than one frame
+    else if( pFramer->iHead > 0 && pFramer->iSize - pFramer->iHead < MaxFrameSize( &pFramer->Cfg ) )
+    {
+        memmove( pFramer->pBuf, pFramer->pBuf + pFramer->iHead, pFramer->iTail - pFramer->iHead );
+        pFramer->iTail -= pFramer->iHead;
+        pFramer->iHead = 0;
+    }
+
+    *piRoom = pFramer->iSize - pFramer->iTail;
+    return pFramer->pBuf + pFramer->iTail;
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Framer_Commit
+ * DESCRIPTION:     Account for iLength bytes written at ISO8583Framer_WritePtr
+ * PARAMETERS:      pFramer: framer
+ *                  iLength: bytes received
+ * RETURN:          ISOENGINE_OK
+ *                  ISOENGINE_OVER_MAXLENGTH: iLength larger than the room
+ ---------------------------------------------------------------------------- */
+int ISO8583Framer_Commit( ISO8583_Framer * pFramer, int iLength )
+{
+    if( iLength < 0 || iLength > pFramer->iSize - pFramer->iTail )
+        return ISOENGINE_OVER_MAXLENGTH;
+
+    pFramer->iTail += iLength;
+    return ISOENGINE_OK;
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Framer_Next
+ * DESCRIPTION:     Take the next complete frame out of the buffer
+ * PARAMETERS:      pFramer: framer
+ *                  pFrame(out): the frame
+ * RETURN:          1: a frame was returned
+ *                  0: more data needed
+ *                  <0: sticky stream error
+ ---------------------------------------------------------------------------- */
+int ISO8583Framer_Next( ISO8583_Framer * pFramer, ISO8583_Frame * pFrame )
+{
+    size_t nUsed;
+    int iRet;
+
+    if( pFramer->iError )
+        return pFramer->iError;
+
+    iRet = ISO8583Framer_Parse( &pFramer->Cfg, pFramer->pBuf + pFramer->iHead, pFramer->iTail - pFramer->iHead, pFrame, &nUsed );
+
+    if( iRet < 0 )
+        pFramer->iError = iRet;
+    else if( iRet > 0 )
+        pFramer->iHead += ( int )nUsed;
+
+    return iRet;
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Framer_Parse
+ * DESCRIPTION:     Take the first frame out of a buffer held by the caller
+ * PARAMETERS:      pCfg: frame layout
+ *                  pBuf: stream data
+ *                  nLength: bytes in pBuf
+ *                  pFrame(out): the frame
+ *                  pnUsed(out): bytes of the frame
+ * RETURN:          1: a frame was returned
+ *                  0: pBuf ends inside the frame
+ *                  <0: stream error
+ ---------------------------------------------------------------------------- */
+int ISO8583Framer_Parse( const ISO8583_FramerCfg * pCfg, const byte * pBuf, size_t nLength, ISO8583_Frame * pFrame, size_t * pnUsed )
+{
+    int iBody;
+
+    if( nLength < ( size_t )pCfg->iLenBytes )
+        return 0;
+
+    iBody = DecodePrefix( pCfg, pBuf );
+
+    if( iBody >= 0 && pCfg->bLenInclusive )
+        iBody -= pCfg->iLenBytes;
+
+    //A zero length frame is a keepalive, anything else carries the header
+    if( iBody < 0 || ( iBody > 0 && iBody < pCfg->iHeaderLength ) )
+        return ISOENGINE_INVALID_FIELD_DATA;
+
+    if( iBody - pCfg->iHeaderLength > pCfg->iMaxMessage )
+        return ISOENGINE_OVER_MAXLENGTH;
+
+    if( nLength - pCfg->iLenBytes < ( size_t )iBody )
+        return 0;
+
+    pBuf += pCfg->iLenBytes;
+
+    if( iBody == 0 )
+    {
+        pFrame->pHeader = pBuf;
+        pFrame->iHeaderLength = 0;
+        pFrame->pMsg = pBuf;
+        pFrame->iMsgLength = 0;
+    }
+    else
+    {
+        pFrame->pHeader = pBuf;
+        pFrame->iHeaderLength = pCfg->iHeaderLength;
+        pFrame->pMsg = pBuf + pCfg->iHeaderLength;
+        pFrame->iMsgLength = iBody - pCfg->iHeaderLength;
+    }
+
+    *pnUsed = pCfg->iLenBytes + iBody;
+    return 1;
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Framer_EncodePrefix
+ * DESCRIPTION:     Write the length prefix and header of an outgoing message
+ * PARAMETERS:      pCfg: frame layout
+ *                  pOut: at least iLenBytes + iHeaderLength bytes
+ *                  pHeader: iHeaderLength bytes of header, NULL for zeros
+ *                  iMsgLength: bytes of RAW message
+ * RETURN:          >0: bytes written to pOut
+ *                  ISOENGINE_OVER_MAXLENGTH: length does not fit the prefix
+ ---------------------------------------------------------------------------- */
+int ISO8583Framer_EncodePrefix( const ISO8583_FramerCfg * pCfg, byte * pOut, const byte * pHeader, int iMsgLength )
+{
+    long long llValue = ( long long )pCfg->iHeaderLength + iMsgLength;
+    int i;
+
+    if( pCfg->bLenInclusive )
+        llValue += pCfg->iLenBytes;
+
+    if( iMsgLength < 0 || llValue > PrefixLimit( pCfg ) )
+        return ISOENGINE_OVER_MAXLENGTH;
+
+    for( i = pCfg->iLenBytes - 1; i >= 0; i -- )
+    {
+        if( pCfg->iLenFormat == ISO8583_LEN_BINARY )
+        {
+            pOut[ i ] = ( byte )llValue;
+            llValue >>= 8;
+        }
+        else if( pCfg->iLenFormat == ISO8583_LEN_BCD )
+        {
+            pOut[ i ] = ( byte )((( llValue / 10 % 10 ) << 4 ) | ( llValue % 10 ));
+            llValue /= 100;
+        }
+        else
+        {
+            pOut[ i ] = ( byte )( '0' + llValue % 10 );
+            llValue /= 10;
+        }
+    }
+
+    if( pHeader != NULL )
+        memcpy( pOut + pCfg->iLenBytes, pHeader, pCfg->iHeaderLength );
+    else
+        memset( pOut + pCfg->iLenBytes, 0, pCfg->iHeaderLength );
+
+    return pCfg->iLenBytes + pCfg->iHeaderLength;
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Framer_ReplyTpdu
+ * DESCRIPTION:     TPDU of a response, addresses swapped
+ * PARAMETERS:      pTpdu(in): request TPDU
+ *                  pReply(out): response TPDU, may be pTpdu
+ * RETURN:          None.
+ ---------------------------------------------------------------------------- */
+void ISO8583Framer_ReplyTpdu( const byte * pTpdu, byte * pReply )
+{
+    byte cDest[ 2 ];
+
+    cDest[ 0 ] = pTpdu[ 1 ];
+    cDest[ 1 ] = pTpdu[ 2 ];
+    pReply[ 0 ] = pTpdu[ 0 ];
+    pReply[ 1 ] = pTpdu[ 3 ];
+    pReply[ 2 ] = pTpdu[ 4 ];
+    pReply[ 3 ] = cDest[ 0 ];
+    pReply[ 4 ] = cDest[ 1 ];
+}
@@ -0,0 +1,183 @@
+/***************************************************************************
+* FILE NAME:    ISO8583Framer.H                                            *
+* MODULE NAME:  ISO8583Engine                                              *
+* PROGRAMMER:                                                              *
+* DESCRIPTION:  Incremental framer for ISO8583 over a byte stream (TCP).   *
+*               Each message is sent as a length prefix, an optional       *
+*               fixed header (e.g. the 5 byte TPDU) and the RAW message.   *
+*               The caller reads straight into the framer buffer           *
+*               (ISO8583Framer_WritePtr / ISO8583Framer_Commit), then      *
+*               takes every complete message out of it with                *
+*               ISO8583Framer_Next. Frames point into the framer buffer,   *
+*               nothing is copied per message, and one read() may hold     *
+*               any number of messages.                                    *
+* REVISION:                                                                *
+****************************************************************************/
+
+#ifndef _ISO8583FRAMER_H
+#define _ISO8583FRAMER_H
+
+#include "ISO8583Engine.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//Size of a TPDU header: id 0x60, 2 bytes destination, 2 bytes source address
+#define ISO8583_TPDU_LENGTH     5
+
+//Encoding of the length prefix
+//ISO8583_LEN_BINARY:   unsigned big endian, iLenBytes 1 - 4
+//ISO8583_LEN_BCD:      packed BCD, 2 digits per byte, iLenBytes 1 - 4
+//ISO8583_LEN_ASCII:    ASCII digits, iLenBytes 1 - 9
+typedef enum
+{
+    ISO8583_LEN_BINARY = 0,
+    ISO8583_LEN_BCD,
+    ISO8583_LEN_ASCII,
+} ISO8583_LenFormat;
+
+//Frame layout on the stream
+typedef struct
+{
+    int iLenFormat;         //ISO8583_LenFormat
+    int iLenBytes;          //bytes of the length prefix
+    int bLenInclusive;      //the length counts the prefix itself
+    int iHeaderLength;      //bytes of header between prefix and message, 0 for none
+    int iMaxMessage;        //largest RAW message accepted, without header
+} ISO8583_FramerCfg;
+
+//One complete message, points into the framer buffer
+typedef struct
+{
+    const byte * pHeader;   //iHeaderLength bytes of header
+    int iHeaderLength;      //0 for a keepalive (length 0) frame
+    const byte * pMsg;      //RAW message, for ISO8583Engine_HexbufToIso8583Len
+    int iMsgLength;         //0 for a keepalive frame
+} ISO8583_Frame;
+
+//Framer state, the buffer is owned by the caller
+typedef struct
+{
+    ISO8583_FramerCfg Cfg;
+    byte * pBuf;
+    int iSize;
+    int iHead;              //first byte not yet returned by ISO8583Framer_Next
+    int iTail;              //end of the received data
+    int iError;             //sticky stream error, the connection must be dropped
+} ISO8583_Framer;
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Framer_CheckCfg
+ * DESCRIPTION:     Check a frame layout, done by ISO8583Framer_Init
+ * PARAMETERS:      pCfg: frame layout
+ * RETURN:          ISOENGINE_OK
+ *                  ISOENGINE_INVALID_FIELD_LENGTH: bad prefix format or size
+ ---------------------------------------------------------------------------- */
+int ISO8583Framer_CheckCfg( const ISO8583_FramerCfg * pCfg );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Framer_Init
+ * DESCRIPTION:     Set up a framer on a caller owned buffer
+ * PARAMETERS:      pFramer: framer
+ *                  pCfg: frame layout, copied
+ *                  pBuf: receive buffer
+ *                  iSize: size of pBuf, at least one largest frame
+ *                         (prefix + header + iMaxMessage), a few frames
+ *                         more keep ISO8583Framer_WritePtr from moving data
+ * RETURN:          ISOENGINE_OK
+ *                  ISOENGINE_INVALID_FIELD_LENGTH: bad prefix format or size
+ *                  ISOENGINE_TOO_SMALL_FIELD_BUF_SIZE: iSize below one frame
+ ---------------------------------------------------------------------------- */
+int ISO8583Framer_Init( ISO8583_Framer * pFramer, const ISO8583_FramerCfg * pCfg, byte * pBuf, int iSize );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Framer_Reset
+ * DESCRIPTION:     Drop all buffered data and a sticky error, e.g. when the
+ *                  connection is reopened
+ * PARAMETERS:      pFramer: framer
+ * RETURN:          None.
+ ---------------------------------------------------------------------------- */
+void ISO8583Framer_Reset( ISO8583_Framer * pFramer );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Framer_WritePtr
+ * DESCRIPTION:     Where the next read() goes. The unread part of a partial
+ *                  frame may be moved to the start of the buffer to make room,
+ *                  so frames returned by ISO8583Framer_Next are only valid up
+ *                  to the next call of this function.
+ * PARAMETERS:      pFramer: framer
+ *                  piRoom(out): bytes free at the returned pointer
+ * RETURN:          Write pointer into the framer buffer
+ ---------------------------------------------------------------------------- */
+byte * ISO8583Framer_WritePtr( ISO8583_Framer * pFramer, int * piRoom );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Framer_Commit
+ * DESCRIPTION:     Account for iLength bytes written at ISO8583Framer_WritePtr
+ * PARAMETERS:      pFramer: framer
+ *                  iLength: bytes received, at most the room given
+ * RETURN:          ISOENGINE_OK
+ *                  ISOENGINE_OVER_MAXLENGTH: iLength larger than the room
+ ---------------------------------------------------------------------------- */
+int ISO8583Framer_Commit( ISO8583_Framer * pFramer, int iLength );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Framer_Next
+ * DESCRIPTION:     Take the next complete frame out of the buffer. Call until
+ *                  it returns 0 after every ISO8583Framer_Commit.
+ * PARAMETERS:      pFramer: framer
+ *                  pFrame(out): the frame, points into the framer buffer
+ * RETURN:          1: a frame was returned
+ *                  0: more data needed
+ *                  ISOENGINE_OVER_MAXLENGTH: frame larger than iMaxMessage
+ *                  ISOENGINE_INVALID_FIELD_DATA: bad length prefix or
+ *                  frame shorter than its header
+ *                  Errors are sticky until ISO8583Framer_Reset.
+ ---------------------------------------------------------------------------- */
+int ISO8583Framer_Next( ISO8583_Framer * pFramer, ISO8583_Frame * pFrame );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Framer_Parse
+ * DESCRIPTION:     ISO8583Framer_Next on a buffer held by the caller, e.g. a
+ *                  mapped capture file: take the first frame out of pBuf
+ * PARAMETERS:      pCfg: frame layout, checked by ISO8583Framer_CheckCfg
+ *                  pBuf: stream data
+ *                  nLength: bytes in pBuf
+ *                  pFrame(out): the frame, points into pBuf
+ *                  pnUsed(out): bytes of the frame, the next one starts
+ *                               at pBuf + *pnUsed
+ * RETURN:          1: a frame was returned
+ *                  0: pBuf ends inside the frame
+ *                  <0: stream error as for ISO8583Framer_Next
+ ---------------------------------------------------------------------------- */
+int ISO8583Framer_Parse( const ISO8583_FramerCfg * pCfg, const byte * pBuf, size_t nLength, ISO8583_Frame * pFrame, size_t * pnUsed );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Framer_EncodePrefix
+ * DESCRIPTION:     Write the length prefix and header of an outgoing message
+ *                  of iMsgLength bytes, the message itself follows them
+ * PARAMETERS:      pCfg: frame layout
+ *                  pOut: at least iLenBytes + iHeaderLength bytes
+ *                  pHeader: iHeaderLength bytes of header, NULL for zeros
+ *                  iMsgLength: bytes of RAW message
+ * RETURN:          >0: bytes written to pOut
+ *                  ISOENGINE_OVER_MAXLENGTH: length does not fit the prefix
+ ---------------------------------------------------------------------------- */
+int ISO8583Framer_EncodePrefix( const ISO8583_FramerCfg * pCfg, byte * pOut, const byte * pHeader, int iMsgLength );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Framer_ReplyTpdu
+ * DESCRIPTION:     TPDU of a response: the request TPDU with destination and
+ *                  source address swapped
+ * PARAMETERS:      pTpdu(in): ISO8583_TPDU_LENGTH bytes of request TPDU
+ *                  pReply(out): ISO8583_TPDU_LENGTH bytes, may be pTpdu
+ * RETURN:          None.
+ ---------------------------------------------------------------------------- */
+void ISO8583Framer_ReplyTpdu( const byte * pTpdu, byte * pReply );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
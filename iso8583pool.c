@@ -0,0 +1,305 @@
+/***************************************************************************
+* FILE NAME:    ISO8583Pool.C                                              *
+* MODULE NAME:  ISO8583Engine                                              *
+* PROGRAMMER:                                                              *
+* DESCRIPTION:  Slab pool of ISO8583_Rec, see ISO8583Pool.h                *
+* REVISION:                                                                *
+****************************************************************************/
+
+#include <string.h>
+#include <stdlib.h>
+
+#include "ISO8583Engine.h"
+#include "ISO8583Pool.h"
+
+#define ISO8583_POOL_CLASSES    ( ISO8583_POOL_MAXSHIFT - ISO8583_POOL_MINSHIFT + 1 )
+#define ISO8583_POOL_ALIGN      64
+
+//Carve unit of a record header, keeps every block cache line aligned
+#define ISO8583_POOL_RECSIZE    (( sizeof( ISO8583_Rec ) + ISO8583_POOL_ALIGN - 1 ) & ~( size_t )( ISO8583_POOL_ALIGN - 1 ))
+
+//Free blocks and free records are linked through their first bytes
+typedef struct ISO8583_PoolLink
+{
+    struct ISO8583_PoolLink * pNext;
+} ISO8583_PoolLink;
+
+//Slab header, the slab data follows at the next cache line
+typedef struct ISO8583_PoolSlab
+{
+    struct ISO8583_PoolSlab * pNext;
+    void * pMem;
+} ISO8583_PoolSlab;
+
+struct ISO8583_Pool
+{
+    ISO8583_PoolLink * pFreeData[ ISO8583_POOL_CLASSES ];
+    ISO8583_PoolLink * pFreeRec;
+    ISO8583_PoolSlab * pSlabs;
+    unsigned char * pCarve;
+    size_t nCarveLeft;
+    int iDataClass;
+};
+
+/*-----------------------------------------------------------------------------
+ * Internal functions
+ *-----------------------------------------------------------------------------*/
+
+//Smallest size class holding iSize bytes, -1 when iSize is too large
+static int SizeClass( int iSize )
+{
+    int iClass = 0;
+
+    if( iSize > ISO8583_POOL_MAXDATA )
+        return -1;
+
+    while(( ISO8583_POOL_MINDATA << iClass ) < iSize )
+        iClass ++;
+
+    return iClass;
+}
+
+//Cut nSize bytes from the current slab, starting a new slab when it is used up.
+//The unused tail of the old slab is left alone.
+static void * Carve( ISO8583_Pool * pPool, size_t nSize )
+{
+    ISO8583_PoolSlab * pSlab;
+    unsigned char * pMem;
+    void * pRet;
+
+    if( nSize > pPool->nCarveLeft )
+    {
+        pMem = ( unsigned char * )malloc( ISO8583_POOL_SLABSIZE + 2 * ISO8583_POOL_ALIGN );
+
+        if( pMem == NULL )
+            return NULL;
+
+        pSlab = ( ISO8583_PoolSlab * )pMem;
+        pSlab->pMem = pMem;
+        pSlab->pNext = pPool->pSlabs;
+        pPool->pSlabs = pSlab;
+
+        pMem += sizeof( ISO8583_PoolSlab ) + ISO8583_POOL_ALIGN - 1;
+        pPool->pCarve = ( unsigned char * )(( size_t )pMem & ~( size_t )( ISO8583_POOL_ALIGN - 1 ));
+        pPool->nCarveLeft = ISO8583_POOL_SLABSIZE;
+    }
+
+    pRet = pPool->pCarve;
+    pPool->pCarve += nSize;
+    pPool->nCarveLeft -= nSize;
+    return pRet;
+}
+
+static unsigned char * AllocData( ISO8583_Pool * pPool, int iClass )
+{
+    ISO8583_PoolLink * pLink = pPool->pFreeData[ iClass ];
+
+    if( pLink == NULL )
+        return ( unsigned char * )Carve( pPool, ( size_t )ISO8583_POOL_MINDATA << iClass );
+
+    pPool->pFreeData[ iClass ] = pLink->pNext;
+    return ( unsigned char * )pLink;
+}
+
+static void FreeData( ISO8583_Pool * pPool, unsigned char * pData, int iSize )
+{
+    ISO8583_PoolLink * pLink = ( ISO8583_PoolLink * )pData;
+    int iClass = SizeClass( iSize );
+
+    pLink->pNext = pPool->pFreeData[ iClass ];
+    pPool->pFreeData[ iClass ] = pLink;
+}
+
+/*-----------------------------------------------------------------------------
+ * Interface functions
+ *-----------------------------------------------------------------------------*/
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Pool_Create
+ * DESCRIPTION:     Create a pool and pre-allocate records
+ * PARAMETERS:      iRecords: records to pre-allocate
+ *                  iDataSize: initial field data size of an acquired record
+ * RETURN:          The pool or NULL
+ ---------------------------------------------------------------------------- */
+ISO8583_Pool * ISO8583Pool_Create( int iRecords, int iDataSize )
+{
+    ISO8583_Pool * pPool;
+    ISO8583_Rec ** ppRec;
+    int i;
+
+    if( SizeClass( iDataSize ) < 0 )
+        return NULL;
+
+    pPool = ( ISO8583_Pool * )calloc( 1, sizeof( ISO8583_Pool ) );
+
+    if( pPool == NULL )
+        return NULL;
+
+    pPool->iDataClass = SizeClass( iDataSize );
+
+    if( iRecords <= 0 )
+        return pPool;
+
+    ppRec = ( ISO8583_Rec ** )malloc( iRecords * sizeof( ISO8583_Rec * ) );
+
+    if( ppRec == NULL )
+    {
+        ISO8583Pool_Destroy( pPool );
+        return NULL;
+    }
+
+    for( i = 0; i < iRecords; i ++ )
+    {
+        if(( ppRec[ i ] = ISO8583Pool_Acquire( pPool ) ) == NULL )
+            break;
+    }
+
+    while( -- i >= 0 )
+        ISO8583Pool_Release( ppRec[ i ] );
+
+    free( ppRec );
+    return pPool;
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Pool_Destroy
+ * DESCRIPTION:     Free all memory of the pool
+ * PARAMETERS:      pPool: pool
+ * RETURN:          None.
+ ---------------------------------------------------------------------------- */
+void ISO8583Pool_Destroy( ISO8583_Pool * pPool )
+{
+    ISO8583_PoolSlab * pSlab;
+
+    if( pPool == NULL )
+        return;
+
+    while(( pSlab = pPool->pSlabs ) != NULL )
+    {
+        pPool->pSlabs = pSlab->pNext;
+        free( pSlab->pMem );
+    }
+
+    free( pPool );
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Pool_Acquire
+ * DESCRIPTION:     Take an empty record from the pool
+ * PARAMETERS:      pPool: pool
+ * RETURN:          The record or NULL
+ ---------------------------------------------------------------------------- */
+ISO8583_Rec * ISO8583Pool_Acquire( ISO8583_Pool * pPool )
+{
+    ISO8583_Rec * pIso8583Data;
+    unsigned char * pData;
+
+    pData = AllocData( pPool, pPool->iDataClass );
+
+    if( pData == NULL )
+        return NULL;
+
+    if( pPool->pFreeRec != NULL )
+    {
+        pIso8583Data = ( ISO8583_Rec * )pPool->pFreeRec;
+        pPool->pFreeRec = pPool->pFreeRec->pNext;
+    }
+    else if(( pIso8583Data = ( ISO8583_Rec * )Carve( pPool, ISO8583_POOL_RECSIZE ) ) == NULL )
+    {
+        FreeData( pPool, pData, ISO8583_POOL_MINDATA << pPool->iDataClass );
+        return NULL;
+    }
+
+    ISO8583Engine_InitRec( pIso8583Data, pData, ISO8583_POOL_MINDATA << pPool->iDataClass );
+    pIso8583Data->pPool = pPool;
+    return pIso8583Data;
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Pool_Release
+ * DESCRIPTION:     Give a record back to its pool
+ * PARAMETERS:      pIso8583Data: record from ISO8583Pool_Acquire
+ * RETURN:          None.
+ ---------------------------------------------------------------------------- */
+void ISO8583Pool_Release( ISO8583_Rec * pIso8583Data )
+{
+    ISO8583_Pool * pPool;
+    ISO8583_PoolLink * pLink;
+
+    if( pIso8583Data == NULL || pIso8583Data->pPool == NULL )
+        return;
+
+    pPool = pIso8583Data->pPool;
+    FreeData( pPool, pIso8583Data->cData, pIso8583Data->iCapacity );
+
+    if( pIso8583Data->Field != pIso8583Data->PrimaryField )
+        FreeData( pPool, ( unsigned char * )pIso8583Data->Field, pIso8583Data->iMaxField * ( int )sizeof( ISO8583_ElementFlag ) );
+
+    pLink = ( ISO8583_PoolLink * )pIso8583Data;
+    pLink->pNext = pPool->pFreeRec;
+    pPool->pFreeRec = pLink;
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Pool_Grow
+ * DESCRIPTION:     Move the field data of a pooled record to a larger block
+ * PARAMETERS:      pIso8583Data: record from ISO8583Pool_Acquire
+ *                  iSize: bytes needed
+ * RETURN:          ISOENGINE_OK or ISOENGINE_OVER_MAXLENGTH
+ ---------------------------------------------------------------------------- */
+int ISO8583Pool_Grow( ISO8583_Rec * pIso8583Data, int iSize )
+{
+    ISO8583_Pool * pPool = pIso8583Data->pPool;
+    unsigned char * pData;
+    int iClass;
+
+    if( iSize <= pIso8583Data->iCapacity )
+        return ISOENGINE_OK;
+
+    if( pPool == NULL || ( iClass = SizeClass( iSize ) ) < 0 )
+        return ISOENGINE_OVER_MAXLENGTH;
+
+    if(( pData = AllocData( pPool, iClass ) ) == NULL )
+        return ISOENGINE_OVER_MAXLENGTH;
+
+    memcpy( pData, pIso8583Data->cData, pIso8583Data->iOffset );
+    FreeData( pPool, pIso8583Data->cData, pIso8583Data->iCapacity );
+    pIso8583Data->cData = pData;
+    pIso8583Data->iCapacity = ISO8583_POOL_MINDATA << iClass;
+    return ISOENGINE_OK;
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Pool_GrowFields
+ * DESCRIPTION:     Move the field flags of a pooled record to a larger block
+ * PARAMETERS:      pIso8583Data: record from ISO8583Pool_Acquire
+ *                  iMaxField: entries needed
+ * RETURN:          ISOENGINE_OK or ISOENGINE_INVALID_FIELD_NO
+ ---------------------------------------------------------------------------- */
+int ISO8583Pool_GrowFields( ISO8583_Rec * pIso8583Data, int iMaxField )
+{
+    ISO8583_Pool * pPool = pIso8583Data->pPool;
+    ISO8583_ElementFlag * pField;
+    int iClass, iSize;
+
+    if( iMaxField <= pIso8583Data->iMaxField )
+        return ISOENGINE_OK;
+
+    iSize = iMaxField * ( int )sizeof( ISO8583_ElementFlag );
+
+    if( pPool == NULL || ( iClass = SizeClass( iSize ) ) < 0 )
+        return ISOENGINE_INVALID_FIELD_NO;
+
+    if(( pField = ( ISO8583_ElementFlag * )AllocData( pPool, iClass ) ) == NULL )
+        return ISOENGINE_INVALID_FIELD_NO;
+
+    memset( pField, 0, iMaxField * sizeof( ISO8583_ElementFlag ) );
+    memcpy( pField, pIso8583Data->Field, pIso8583Data->iMaxField * sizeof( ISO8583_ElementFlag ) );
+
+    if( pIso8583Data->Field != pIso8583Data->PrimaryField )
+        FreeData( pPool, ( unsigned char * )pIso8583Data->Field, pIso8583Data->iMaxField * ( int )sizeof( ISO8583_ElementFlag ) );
+
+    pIso8583Data->Field = pField;
+    pIso8583Data->iMaxField = iMaxField;
+    return ISOENGINE_OK;
+}
@@ -0,0 +1,94 @@
+/***************************************************************************
+* FILE NAME:    ISO8583Pool.H                                              *
+* MODULE NAME:  ISO8583Engine                                              *
+* PROGRAMMER:                                                              *
+* DESCRIPTION:  Slab pool of ISO8583_Rec with growable field data areas.   *
+*               Data areas come in power of two size classes from          *
+*               ISO8583_POOL_MINDATA to ISO8583_POOL_MAXDATA, kept on one  *
+*               free list per class. Memory is taken from the system in    *
+*               ISO8583_POOL_SLABSIZE slabs and only given back by         *
+*               ISO8583Pool_Destroy, so a warm pool never calls malloc.    *
+*               A pool is not thread safe, use one pool per thread.        *
+* REVISION:                                                                *
+****************************************************************************/
+
+#ifndef _ISO8583POOL_H
+#define _ISO8583POOL_H
+
+#include "ISO8583Engine.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ISO8583_POOL_MINSHIFT   8
+#define ISO8583_POOL_MAXSHIFT   16
+#define ISO8583_POOL_MINDATA    ( 1 << ISO8583_POOL_MINSHIFT )
+#define ISO8583_POOL_MAXDATA    ( 1 << ISO8583_POOL_MAXSHIFT )
+#define ISO8583_POOL_SLABSIZE   ( 1 << 16 )
+
+typedef struct ISO8583_Pool ISO8583_Pool;
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Pool_Create
+ * DESCRIPTION:     Create a pool and pre-allocate records
+ * PARAMETERS:      iRecords: records to pre-allocate, may be 0
+ *                  iDataSize: initial field data size of an acquired record,
+ *                             rounded up to a size class
+ * RETURN:          The pool, NULL when out of memory or iDataSize > ISO8583_POOL_MAXDATA
+ ---------------------------------------------------------------------------- */
+ISO8583_Pool * ISO8583Pool_Create( int iRecords, int iDataSize );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Pool_Destroy
+ * DESCRIPTION:     Free all memory of the pool, records acquired from it
+ *                  become invalid
+ * PARAMETERS:      pPool: pool, may be NULL
+ * RETURN:          None.
+ ---------------------------------------------------------------------------- */
+void ISO8583Pool_Destroy( ISO8583_Pool * pPool );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Pool_Acquire
+ * DESCRIPTION:     Take an empty record from the pool, it needs no
+ *                  ISO8583Engine_InitRec
+ * PARAMETERS:      pPool: pool
+ * RETURN:          The record, NULL when out of memory
+ ---------------------------------------------------------------------------- */
+ISO8583_Rec * ISO8583Pool_Acquire( ISO8583_Pool * pPool );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Pool_Release
+ * DESCRIPTION:     Give a record and its field data area back to its pool
+ * PARAMETERS:      pIso8583Data: record from ISO8583Pool_Acquire, may be NULL
+ * RETURN:          None.
+ ---------------------------------------------------------------------------- */
+void ISO8583Pool_Release( ISO8583_Rec * pIso8583Data );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Pool_Grow
+ * DESCRIPTION:     Move the field data of a pooled record to a block of at
+ *                  least iSize bytes. Called by ISO8583Engine_Reserve.
+ * PARAMETERS:      pIso8583Data: record from ISO8583Pool_Acquire
+ *                  iSize: bytes needed
+ * RETURN:          ISOENGINE_OK
+ *                  ISOENGINE_OVER_MAXLENGTH: iSize > ISO8583_POOL_MAXDATA or out of memory
+ ---------------------------------------------------------------------------- */
+int ISO8583Pool_Grow( ISO8583_Rec * pIso8583Data, int iSize );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Pool_GrowFields
+ * DESCRIPTION:     Move the field flags of a pooled record to a pool block of
+ *                  at least iMaxField entries. Called by ISO8583Engine_ReserveFields.
+ * PARAMETERS:      pIso8583Data: record from ISO8583Pool_Acquire
+ *                  iMaxField: entries needed
+ * RETURN:          ISOENGINE_OK
+ *                  ISOENGINE_INVALID_FIELD_NO: out of memory
+ ---------------------------------------------------------------------------- */
+int ISO8583Pool_GrowFields( ISO8583_Rec * pIso8583Data, int iMaxField );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
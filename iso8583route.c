@@ -0,0 +1,712 @@
+/***************************************************************************
+* FILE NAME:    ISO8583Route.C                                             *
+* MODULE NAME:  ISO8583Engine                                              *
+* PROGRAMMER:                                                              *
+* DESCRIPTION:  BIN range routing index, see ISO8583Route.h                *
+* REVISION:                                                                *
+****************************************************************************/
+
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <sched.h>
+#include <stdatomic.h>
+
+#include "ISO8583Engine.h"
+#include "ISO8583Bits.h"
+#include "ISO8583Route.h"
+
+#define ROUTE_SPAN          100000000000ULL     // 10 ^ ISO8583_ROUTE_DIGITS
+#define ROUTE_BUCKET        100000ULL           // PAN values per index entry
+#define ROUTE_BUCKETS       1000000             // 10 ^ ISO8583_ROUTE_INDEX
+#define ROUTE_ANYMTI        0xFFFF
+
+//One rule of an interval, ordered most specific first
+typedef struct
+{
+    unsigned int uiProcLow;         // field 3 range of the processing code prefix
+    unsigned int uiProcHigh;
+    unsigned short usMti;           // ROUTE_ANYMTI for any
+    int iRoute;
+} RouteCand;
+
+//Disjoint intervals [ ullStart[ i ], ullStart[ i + 1 ] ) covering all 11
+//digit PAN prefixes, the rules of interval i are Cand[ uiList[ i ] ] up to
+//Cand[ uiList[ i + 1 ] ]. uiIndex[ p ] is the interval holding p * 10 ^ 5.
+struct ISO8583_RouteTable
+{
+    int iIntervals;
+    int iCands;
+    unsigned long long * ullStart;
+    unsigned int * uiList;
+    RouteCand * Cand;
+    unsigned int uiIndex[ ROUTE_BUCKETS + 1 ];
+};
+
+//Reader slot: epoch of the lookup running on it, 0 when idle
+typedef struct
+{
+    ISO8583_CACHELINE atomic_ullong ullEpoch;
+    atomic_int bTaken;                              // held by a thread
+} RouteReader;
+
+struct ISO8583_Router
+{
+    _Atomic( ISO8583_RouteTable * ) pTable;
+    ISO8583_CACHELINE atomic_ullong ullEpoch;       // bumped by every publish
+    atomic_int iReaders;                            // slots ever handed out, highest + 1
+    RouteReader Reader[ ISO8583_ROUTE_READERS ];
+};
+
+//A rule normalized to 11 digit PAN values, for the build only
+typedef struct
+{
+    unsigned long long ullLow;
+    unsigned long long ullHigh;     // inclusive
+    RouteCand Cand;
+    int iProcDigits;
+    int iOrder;                     // position in the rule array
+} RouteSpan;
+
+//Sweep event: rule iSpan enters at ullAt, or leaves at ullAt when bEnd
+typedef struct
+{
+    unsigned long long ullAt;
+    int iSpan;
+    int bEnd;
+} RouteEvent;
+
+static const unsigned long long Pow10[ ISO8583_ROUTE_DIGITS + 1 ] =
+{
+    1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL,
+    100000000ULL, 1000000000ULL, 10000000000ULL, 100000000000ULL
+};
+
+/*-----------------------------------------------------------------------------
+ * Internal functions
+ *-----------------------------------------------------------------------------*/
+
+//Digits of a rule string, -1 when not all digits or longer than iMax
+static int DigitString( const char * pStr, int iMax, unsigned long long * pValue )
+{
+    int iLength = 0;
+
+    *pValue = 0;
+
+    for( ; pStr[ iLength ]; iLength ++ )
+    {
+        if( iLength >= iMax || !isdigit(( unsigned char )pStr[ iLength ] ) )
+            return -1;
+
+        *pValue = *pValue * 10 + ( pStr[ iLength ] - '0' );
+    }
+
+    return iLength;
+}
+
+//Normalize a rule, -1 when it is not valid
+static int MakeSpan( const ISO8583_RouteRule * pRule, int iOrder, RouteSpan * pSpan )
+{
+    unsigned long long ullLow, ullHigh, ullValue;
+    int iLow, iHigh, iDigits;
+
+    iLow = DigitString( pRule->cLow, ISO8583_ROUTE_DIGITS, &ullLow );
+    iHigh = pRule->cHigh[ 0 ] ? DigitString( pRule->cHigh, ISO8583_ROUTE_DIGITS, &ullHigh ) : iLow;
+
+    if( iLow < ISO8583_ROUTE_INDEX || iHigh < ISO8583_ROUTE_INDEX || pRule->iRoute < 0 )
+        return -1;
+
+    if( pRule->cHigh[ 0 ] == 0 )
+        ullHigh = ullLow;
+
+    //low pads with 0, high with 9: 411111-4111199 covers 41111100000 - 41111999999
+    pSpan->ullLow = ullLow * Pow10[ ISO8583_ROUTE_DIGITS - iLow ];
+    pSpan->ullHigh = ( ullHigh + 1 ) * Pow10[ ISO8583_ROUTE_DIGITS - iHigh ] - 1;
+
+    if( pSpan->ullLow > pSpan->ullHigh )
+        return -1;
+
+    if( pRule->cMti[ 0 ] == 0 )
+        pSpan->Cand.usMti = ROUTE_ANYMTI;
+    else if( DigitString( pRule->cMti, 4, &ullValue ) == 4 )
+        pSpan->Cand.usMti = ( unsigned short )ullValue;
+    else
+        return -1;
+
+    if(( iDigits = DigitString( pRule->cProc, 6, &ullValue ) ) < 0 )
+        return -1;
+
+    pSpan->Cand.uiProcLow = ( unsigned int )( ullValue * Pow10[ 6 - iDigits ] );
+    pSpan->Cand.uiProcHigh = ( unsigned int )(( ullValue + 1 ) * Pow10[ 6 - iDigits ] - 1 );
+    pSpan->Cand.iRoute = pRule->iRoute;
+    pSpan->iProcDigits = iDigits;
+    pSpan->iOrder = iOrder;
+    return 0;
+}
+
+//Specificity order: narrower BIN range, then an MTI, then a longer
+//processing code, then the rule given first
+static int CompareSpan( const void * a, const void * b )
+{
+    const RouteSpan * pA = ( const RouteSpan * )a;
+    const RouteSpan * pB = ( const RouteSpan * )b;
+    unsigned long long ullWidthA = pA->ullHigh - pA->ullLow, ullWidthB = pB->ullHigh - pB->ullLow;
+
+    if( ullWidthA != ullWidthB )
+        return ullWidthA < ullWidthB ? -1 : 1;
+
+    if(( pA->Cand.usMti == ROUTE_ANYMTI ) != ( pB->Cand.usMti == ROUTE_ANYMTI ))
+        return pA->Cand.usMti == ROUTE_ANYMTI ? 1 : -1;
+
+    if( pA->iProcDigits != pB->iProcDigits )
+        return pA->iProcDigits > pB->iProcDigits ? -1 : 1;
+
+    return pA->iOrder - pB->iOrder;
+}
+
+static int CompareEvent( const void * a, const void * b )
+{
+    const RouteEvent * pA = ( const RouteEvent * )a;
+    const RouteEvent * pB = ( const RouteEvent * )b;
+
+    if( pA->ullAt != pB->ullAt )
+        return pA->ullAt < pB->ullAt ? -1 : 1;
+
+    return pA->iSpan - pB->iSpan;
+}
+
+//Position of iSpan in the sorted active set, or where it goes
+static int ActiveFind( const int * piActive, int iActive, int iSpan )
+{
+    int iLow = 0, iHigh = iActive;
+
+    while( iLow < iHigh )
+    {
+        int iMid = ( iLow + iHigh ) >> 1;
+
+        if( piActive[ iMid ] < iSpan )
+            iLow = iMid + 1;
+        else
+            iHigh = iMid;
+    }
+
+    return iLow;
+}
+
+//Rules of the active set that can ever match: a rule for any MTI and any
+//processing code hides every less specific one
+static int ActiveCands( const RouteSpan * pSpans, const int * piActive, int iActive )
+{
+    int i;
+
+    for( i = 0; i < iActive; i ++ )
+    {
+        const RouteSpan * pSpan = &pSpans[ piActive[ i ] ];
+
+        if( pSpan->Cand.usMti == ROUTE_ANYMTI && pSpan->iProcDigits == 0 )
+            return i + 1;
+    }
+
+    return iActive;
+}
+
+//Does interval iLast have the same rules as the active set
+static int SameCands( const ISO8583_RouteTable * pTable, int iLast, const RouteSpan * pSpans, const int * piActive, int iCands )
+{
+    const RouteCand * pA, * pB;
+    int i;
+
+    if( iLast < 0 || ( int )( pTable->uiList[ iLast + 1 ] - pTable->uiList[ iLast ] ) != iCands )
+        return 0;
+
+    for( i = 0; i < iCands; i ++ )
+    {
+        pA = &pTable->Cand[ pTable->uiList[ iLast ] + i ];
+        pB = &pSpans[ piActive[ i ] ].Cand;
+
+        if( pA->usMti != pB->usMti || pA->uiProcLow != pB->uiProcLow || pA->uiProcHigh != pB->uiProcHigh
+            || pA->iRoute != pB->iRoute )
+            return 0;
+    }
+
+    return 1;
+}
+
+//Route of the first rule of an interval matching MTI and processing code
+static int MatchCands( const ISO8583_RouteTable * pTable, unsigned long long ullBin, int iMti, int iProc )
+{
+    const RouteCand * pCand, * pEnd;
+    unsigned int uiLow, uiHigh;
+
+    if( ullBin >= ROUTE_SPAN )
+        return ISO8583_ROUTE_NONE;
+
+    //the interval is the last one in the bucket range starting at or below ullBin
+    uiLow = pTable->uiIndex[ ullBin / ROUTE_BUCKET ];
+    uiHigh = pTable->uiIndex[ ullBin / ROUTE_BUCKET + 1 ];
+
+    while( uiLow < uiHigh )
+    {
+        unsigned int uiMid = ( uiLow + uiHigh + 1 ) >> 1;
+
+        if( pTable->ullStart[ uiMid ] <= ullBin )
+            uiLow = uiMid;
+        else
+            uiHigh = uiMid - 1;
+    }
+
+    pCand = &pTable->Cand[ pTable->uiList[ uiLow ] ];
+    pEnd = &pTable->Cand[ pTable->uiList[ uiLow + 1 ] ];
+
+    for( ; pCand < pEnd; pCand ++ )
+    {
+        if(( pCand->usMti == ROUTE_ANYMTI || pCand->usMti == iMti )
+            && ( unsigned int )iProc >= pCand->uiProcLow && ( unsigned int )iProc <= pCand->uiProcHigh )
+            return pCand->iRoute;
+    }
+
+    return ISO8583_ROUTE_NONE;
+}
+
+//Numeric value of the first iDigits digits of a field in wire form
+static int FieldDigits( const ISO8583_Spec * pSpec, const ISO8583_Rec * pIso8583Data, int iFieldNum, int iDigits, unsigned long long * pValue )
+{
+    const ISO8583_FieldOp * pOp = &pSpec->Op[ iFieldNum ];
+    int iAddr = pIso8583Data->Field[ iFieldNum ].addr;
+    const byte * pData;
+
+    if( iAddr < 0 || iAddr + ( pOp->bPacked ? ( iDigits + 1 ) / 2 : iDigits ) > pIso8583Data->iOffset )
+        return ISOENGINE_INVALID_FIELD_DATA;
+
+    pData = &pIso8583Data->cData[ iAddr ];
+
+    if( pOp->bPacked )
+        return ISO8583Utils_BCD2U64( pData, iDigits, pValue );
+
+    return ISO8583Utils_ASC2U64( pData, iDigits, pValue );
+}
+
+/*-----------------------------------------------------------------------------
+ * External functions
+ *-----------------------------------------------------------------------------*/
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Route_Build
+ * DESCRIPTION:     Compile rules into a table
+ * PARAMETERS:      pRules: rules
+ *                  iRules: number of rules
+ *                  ppTable(out): the table
+ *                  piBad(out): index of a bad rule, may be NULL
+ * RETURN:          ISOENGINE_OK, ISOENGINE_INVALID_FIELD_DATA,
+ *                  ISOENGINE_OVER_MAXLENGTH
+ ---------------------------------------------------------------------------- */
+int ISO8583Route_Build( const ISO8583_RouteRule * pRules, int iRules, ISO8583_RouteTable ** ppTable, int * piBad )
+{
+    ISO8583_RouteTable * pTable = NULL;
+    RouteSpan * pSpans = NULL;
+    RouteEvent * pEvents = NULL;
+    int * piActive = NULL;
+    int i, j, iActive = 0, iCands, iCandMax, iIntervalMax, iRet = ISOENGINE_OVER_MAXLENGTH;
+    unsigned long long ullAt;
+    unsigned int p;
+
+    *ppTable = NULL;
+
+    if( iRules < 0 )
+        iRules = 0;
+
+    pSpans = ( RouteSpan * )malloc(( iRules + 1 ) * sizeof( RouteSpan ));
+    pEvents = ( RouteEvent * )malloc(( 2 * iRules + 1 ) * sizeof( RouteEvent ));
+    piActive = ( int * )malloc(( iRules + 1 ) * sizeof( int ));
+    pTable = ( ISO8583_RouteTable * )calloc( 1, sizeof( ISO8583_RouteTable ));
+
+    if( pSpans == NULL || pEvents == NULL || piActive == NULL || pTable == NULL )
+        goto Done;
+
+    for( i = 0; i < iRules; i ++ )
+    {
+        if( MakeSpan( &pRules[ i ], i, &pSpans[ i ] ) < 0 )
+        {
+            if( piBad )
+                *piBad = i;
+
+            iRet = ISOENGINE_INVALID_FIELD_DATA;
+            goto Done;
+        }
+    }
+
+    //with the spans in specificity order, the active set kept sorted by span
+    //index is sorted by specificity as well
+    qsort( pSpans, iRules, sizeof( RouteSpan ), CompareSpan );
+
+    for( i = 0; i < iRules; i ++ )
+    {
+        pEvents[ 2 * i ].ullAt = pSpans[ i ].ullLow;
+        pEvents[ 2 * i ].iSpan = i;
+        pEvents[ 2 * i ].bEnd = 0;
+        pEvents[ 2 * i + 1 ].ullAt = pSpans[ i ].ullHigh + 1;
+        pEvents[ 2 * i + 1 ].iSpan = i;
+        pEvents[ 2 * i + 1 ].bEnd = 1;
+    }
+
+    qsort( pEvents, 2 * iRules, sizeof( RouteEvent ), CompareEvent );
+
+    //every boundary may open an interval; candidates grow as needed
+    iIntervalMax = 2 * iRules + 1;
+    iCandMax = iRules + 16;
+    pTable->ullStart = ( unsigned long long * )malloc( iIntervalMax * sizeof( unsigned long long ));
+    pTable->uiList = ( unsigned int * )malloc(( iIntervalMax + 1 ) * sizeof( unsigned int ));
+    pTable->Cand = ( RouteCand * )malloc( iCandMax * sizeof( RouteCand ));
+
+    if( pTable->ullStart == NULL || pTable->uiList == NULL || pTable->Cand == NULL )
+        goto Done;
+
+    pTable->uiList[ 0 ] = 0;
+
+    for( i = 0, ullAt = 0; ullAt < ROUTE_SPAN; )
+    {
+        //apply every event at this boundary
+        for( ; i < 2 * iRules && pEvents[ i ].ullAt == ullAt; i ++ )
+        {
+            int iPos = ActiveFind( piActive, iActive, pEvents[ i ].iSpan );
+
+            if( pEvents[ i ].bEnd )
+            {
+                memmove( &piActive[ iPos ], &piActive[ iPos + 1 ], ( iActive - iPos - 1 ) * sizeof( int ));
+                iActive --;
+            }
+            else
+            {
+                memmove( &piActive[ iPos + 1 ], &piActive[ iPos ], ( iActive - iPos ) * sizeof( int ));
+                piActive[ iPos ] = pEvents[ i ].iSpan;
+                iActive ++;
+            }
+        }
+
+        iCands = ActiveCands( pSpans, piActive, iActive );
+
+        if( !SameCands( pTable, pTable->iIntervals - 1, pSpans, piActive, iCands ))
+        {
+            if( pTable->iCands + iCands > iCandMax )
+            {
+                RouteCand * pGrown;
+
+                iCandMax = ( pTable->iCands + iCands ) * 2;
+
+                if(( pGrown = ( RouteCand * )realloc( pTable->Cand, iCandMax * sizeof( RouteCand ))) == NULL )
+                    goto Done;
+
+                pTable->Cand = pGrown;
+            }
+
+            for( j = 0; j < iCands; j ++ )
+                pTable->Cand[ pTable->iCands ++ ] = pSpans[ piActive[ j ] ].Cand;
+
+            pTable->ullStart[ pTable->iIntervals ++ ] = ullAt;
+            pTable->uiList[ pTable->iIntervals ] = pTable->iCands;
+        }
+
+        ullAt = i < 2 * iRules ? pEvents[ i ].ullAt : ROUTE_SPAN;
+    }
+
+    //direct index: interval of the first PAN value of every 6 digit prefix,
+    //the last entry bounds the search of the last prefix
+    for( p = 0, j = 0; p < ROUTE_BUCKETS; p ++ )
+    {
+        while( j + 1 < pTable->iIntervals && pTable->ullStart[ j + 1 ] <= p * ROUTE_BUCKET )
+            j ++;
+
+        pTable->uiIndex[ p ] = j;
+    }
+
+    pTable->uiIndex[ ROUTE_BUCKETS ] = pTable->iIntervals - 1;
+
+    *ppTable = pTable;
+    pTable = NULL;
+    iRet = ISOENGINE_OK;
+
+Done:
+    ISO8583Route_FreeTable( pTable );
+    free( pSpans );
+    free( pEvents );
+    free( piActive );
+    return iRet;
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Route_Load
+ * DESCRIPTION:     Build a table from a rule file
+ * PARAMETERS:      fp: rule file
+ *                  ppTable(out): the table
+ *                  piLine(out): line of an error, may be NULL
+ * RETURN:          ISOENGINE_OK, an error of ISO8583Route_Build
+ ---------------------------------------------------------------------------- */
+int ISO8583Route_Load( FILE * fp, ISO8583_RouteTable ** ppTable, int * piLine )
+{
+    ISO8583_RouteRule * pRules = NULL, * pGrown;
+    char cLine[ 256 ], cBin[ 32 ], cMti[ 8 ], cProc[ 8 ], * pDash;
+    int iRules = 0, iMax = 0, iLine = 0, iBad = -1, iRet, iScan, iRoute;
+    int * piLines = NULL, * piGrown;
+
+    *ppTable = NULL;
+
+    while( fgets( cLine, sizeof( cLine ), fp ))
+    {
+        iLine ++;
+
+        if(( pDash = strchr( cLine, '#' )) != NULL )
+            *pDash = 0;
+
+        if(( iScan = sscanf( cLine, "%31s %7s %7s %d", cBin, cMti, cProc, &iRoute )) <= 0 )
+            continue;
+
+        if( iRules == iMax )
+        {
+            iMax = iMax ? iMax * 2 : 1024;
+            pGrown = ( ISO8583_RouteRule * )realloc( pRules, iMax * sizeof( ISO8583_RouteRule ));
+            piGrown = ( int * )realloc( piLines, iMax * sizeof( int ));
+
+            if( pGrown )
+                pRules = pGrown;
+
+            if( piGrown )
+                piLines = piGrown;
+
+            if( pGrown == NULL || piGrown == NULL )
+            {
+                iRet = ISOENGINE_OVER_MAXLENGTH;
+                goto Done;
+            }
+        }
+
+        memset( &pRules[ iRules ], 0, sizeof( ISO8583_RouteRule ));
+        piLines[ iRules ] = iLine;
+
+        if(( pDash = strchr( cBin, '-' )) != NULL )
+            *pDash ++ = 0;
+
+        //a short line or a string too long for the rule is an error of its own
+        if( iScan != 4 || strlen( cBin ) > ISO8583_ROUTE_DIGITS || ( pDash && strlen( pDash ) > ISO8583_ROUTE_DIGITS )
+            || strlen( cMti ) > 4 || strlen( cProc ) > 6 )
+        {
+            if( piLine )
+                *piLine = iLine;
+
+            iRet = ISOENGINE_INVALID_FIELD_DATA;
+            goto Done;
+        }
+
+        strcpy( pRules[ iRules ].cLow, cBin );
+        strcpy( pRules[ iRules ].cHigh, pDash ? pDash : "" );
+        strcpy( pRules[ iRules ].cMti, strcmp( cMti, "*" ) ? cMti : "" );
+        strcpy( pRules[ iRules ].cProc, strcmp( cProc, "*" ) ? cProc : "" );
+        pRules[ iRules ].iRoute = iRoute;
+        iRules ++;
+    }
+
+    if(( iRet = ISO8583Route_Build( pRules, iRules, ppTable, &iBad )) != ISOENGINE_OK && iBad >= 0 && piLine )
+        *piLine = piLines[ iBad ];
+
+Done:
+    free( pRules );
+    free( piLines );
+    return iRet;
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Route_FreeTable
+ * DESCRIPTION:     Free a table that was not published
+ * PARAMETERS:      pTable: table, may be NULL
+ * RETURN:          None.
+ ---------------------------------------------------------------------------- */
+void ISO8583Route_FreeTable( ISO8583_RouteTable * pTable )
+{
+    if( pTable == NULL )
+        return;
+
+    free( pTable->ullStart );
+    free( pTable->uiList );
+    free( pTable->Cand );
+    free( pTable );
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Route_Create
+ * DESCRIPTION:     Create a router
+ * PARAMETERS:      pTable: first table, may be NULL
+ * RETURN:          The router, NULL when out of memory
+ ---------------------------------------------------------------------------- */
+ISO8583_Router * ISO8583Route_Create( ISO8583_RouteTable * pTable )
+{
+    ISO8583_Router * pRouter;
+
+    if(( pRouter = ( ISO8583_Router * )calloc( 1, sizeof( ISO8583_Router ))) == NULL )
+        return NULL;
+
+    //epoch 0 marks an idle reader slot
+    atomic_init( &pRouter->pTable, pTable );
+    atomic_init( &pRouter->ullEpoch, 1 );
+    return pRouter;
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Route_Destroy
+ * DESCRIPTION:     Free a router and its table
+ * PARAMETERS:      pRouter: router, may be NULL
+ * RETURN:          None.
+ ---------------------------------------------------------------------------- */
+void ISO8583Route_Destroy( ISO8583_Router * pRouter )
+{
+    if( pRouter == NULL )
+        return;
+
+    ISO8583Route_FreeTable( atomic_load( &pRouter->pTable ));
+    free( pRouter );
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Route_Register
+ * DESCRIPTION:     Reader slot of a thread that looks up the router
+ * PARAMETERS:      pRouter: router
+ * RETURN:          >= 0: reader slot, ISOENGINE_OVER_MAXLENGTH
+ ---------------------------------------------------------------------------- */
+int ISO8583Route_Register( ISO8583_Router * pRouter )
+{
+    int iReader, iSeen, bFree;
+
+    for( iReader = 0; iReader < ISO8583_ROUTE_READERS; iReader ++ )
+    {
+        bFree = 0;
+        if( atomic_compare_exchange_strong( &pRouter->Reader[ iReader ].bTaken, &bFree, 1 ))
+            break;
+    }
+
+    if( iReader == ISO8583_ROUTE_READERS )
+        return ISOENGINE_OVER_MAXLENGTH;
+
+    //publishers scan the slots below iReaders
+    iSeen = atomic_load( &pRouter->iReaders );
+    while( iSeen <= iReader && !atomic_compare_exchange_weak( &pRouter->iReaders, &iSeen, iReader + 1 ))
+        ;
+
+    return iReader;
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Route_Unregister
+ * DESCRIPTION:     Give back a reader slot
+ * PARAMETERS:      pRouter: router
+ *                  iReader: slot of ISO8583Route_Register
+ * RETURN:          None.
+ ---------------------------------------------------------------------------- */
+void ISO8583Route_Unregister( ISO8583_Router * pRouter, int iReader )
+{
+    if( iReader < 0 || iReader >= ISO8583_ROUTE_READERS )
+        return;
+
+    atomic_store( &pRouter->Reader[ iReader ].ullEpoch, 0 );
+    atomic_store( &pRouter->Reader[ iReader ].bTaken, 0 );
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Route_Publish
+ * DESCRIPTION:     Replace the table, free the old one once no lookup reads it
+ * PARAMETERS:      pRouter: router
+ *                  pTable: new table
+ * RETURN:          None.
+ ---------------------------------------------------------------------------- */
+void ISO8583Route_Publish( ISO8583_Router * pRouter, ISO8583_RouteTable * pTable )
+{
+    ISO8583_RouteTable * pOld = atomic_exchange( &pRouter->pTable, pTable );
+    unsigned long long ullEpoch = atomic_fetch_add( &pRouter->ullEpoch, 1 ) + 1;
+    int i, iReaders = atomic_load( &pRouter->iReaders );
+
+    //a lookup still on an older epoch may hold pOld; one that sees this epoch
+    //or stores its epoch after the slot is read here loads the new table
+    for( i = 0; i < iReaders && i < ISO8583_ROUTE_READERS; i ++ )
+    {
+        for( ;; )
+        {
+            unsigned long long ullSeen = atomic_load( &pRouter->Reader[ i ].ullEpoch );
+
+            if( ullSeen == 0 || ullSeen >= ullEpoch )
+                break;
+
+            sched_yield();
+        }
+    }
+
+    ISO8583Route_FreeTable( pOld );
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Route_Lookup
+ * DESCRIPTION:     Route of a BIN, MTI and processing code
+ * PARAMETERS:      pRouter: router
+ *                  iReader: slot of the calling thread
+ *                  ullBin: first ISO8583_ROUTE_DIGITS PAN digits
+ *                  iMti: MTI
+ *                  iProc: field 3
+ * RETURN:          Route of the rule, ISO8583_ROUTE_NONE
+ ---------------------------------------------------------------------------- */
+int ISO8583Route_Lookup( ISO8583_Router * pRouter, int iReader, unsigned long long ullBin, int iMti, int iProc )
+{
+    atomic_ullong * pSlot = &pRouter->Reader[ iReader ].ullEpoch;
+    ISO8583_RouteTable * pTable;
+    int iRoute = ISO8583_ROUTE_NONE;
+
+    //the epoch store must be ordered before the table load, hence seq_cst
+    atomic_store( pSlot, atomic_load_explicit( &pRouter->ullEpoch, memory_order_relaxed ));
+
+    if(( pTable = atomic_load( &pRouter->pTable )) != NULL )
+        iRoute = MatchCands( pTable, ullBin, iMti, iProc );
+
+    atomic_store_explicit( pSlot, 0, memory_order_release );
+    return iRoute;
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Route_LookupRec
+ * DESCRIPTION:     ISO8583Route_Lookup on a record
+ * PARAMETERS:      pRouter: router
+ *                  iReader: slot of the calling thread
+ *                  pSpec: spec context
+ *                  pIso8583Data: Iso8583 data structure
+ * RETURN:          Route of the rule, ISO8583_ROUTE_NONE,
+ *                  ISOENGINE_INVALID_FIELD_DATA
+ ---------------------------------------------------------------------------- */
+int ISO8583Route_LookupRec( ISO8583_Router * pRouter, int iReader, const ISO8583_Spec * pSpec, const ISO8583_Rec * pIso8583Data )
+{
+    unsigned long long ullBin, ullMti, ullProc = 0;
+    int iDigits;
+
+    //field 2, the PAN, routes the message
+    if( !ISO8583_BITMAP_TEST( pIso8583Data->ulBitmap, 1 ) )
+        return ISOENGINE_INVALID_FIELD_DATA;
+
+    if( ISO8583Utils_ASC2U64( pIso8583Data->cMsgID, 4, &ullMti ) != 0 )
+        return ISOENGINE_INVALID_FIELD_DATA;
+
+    //field 3 as a number of 6 digits, absent means 000000
+    if( ISO8583_BITMAP_TEST( pIso8583Data->ulBitmap, 2 ) )
+    {
+        iDigits = pIso8583Data->Field[ 2 ].len;
+
+        if( iDigits < 1 || iDigits > 6 || FieldDigits( pSpec, pIso8583Data, 2, iDigits, &ullProc ) != 0 )
+            return ISOENGINE_INVALID_FIELD_DATA;
+
+        ullProc *= Pow10[ 6 - iDigits ];
+    }
+
+    //the leading PAN digits, scaled up when the PAN is shorter; a PAN needs
+    //at least the 6 digits of a BIN
+    iDigits = pIso8583Data->Field[ 1 ].len;
+
+    if( iDigits > ISO8583_ROUTE_DIGITS )
+        iDigits = ISO8583_ROUTE_DIGITS;
+
+    if( iDigits < ISO8583_ROUTE_INDEX || FieldDigits( pSpec, pIso8583Data, 1, iDigits, &ullBin ) != 0 )
+        return ISOENGINE_INVALID_FIELD_DATA;
+
+    return ISO8583Route_Lookup( pRouter, iReader, ullBin * Pow10[ ISO8583_ROUTE_DIGITS - iDigits ], ( int )ullMti, ( int )ullProc );
+}
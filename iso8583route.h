@@ -0,0 +1,174 @@
+/***************************************************************************
+* FILE NAME:    ISO8583Route.H                                             *
+* MODULE NAME:  ISO8583Engine                                              *
+* PROGRAMMER:                                                              *
+* DESCRIPTION:  BIN range routing index over field 2 (PAN).                *
+*               Ranges of 6 to 11 digit BIN prefixes, each with an        *
+*               optional MTI and processing code (field 3) prefix, are     *
+*               compiled into a table of disjoint intervals over the first *
+*               11 PAN digits, indexed directly by the first 6. A lookup   *
+*               takes the digits straight from the packed BCD of field 2,  *
+*               finds the interval in two or three cache lines and returns *
+*               the route of its most specific rule matching MTI and       *
+*               processing code.                                           *
+*               A router holds the current table. A new table is           *
+*               published with one atomic swap; lookups never wait, the    *
+*               publisher waits for the lookups still reading the old      *
+*               table (epochs) before freeing it.                          *
+* REVISION:                                                                *
+****************************************************************************/
+
+#ifndef _ISO8583ROUTE_H
+#define _ISO8583ROUTE_H
+
+#include <stdio.h>
+
+#include "ISO8583Engine.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//PAN digits routed on, and digits of the direct index
+#define ISO8583_ROUTE_DIGITS    11
+#define ISO8583_ROUTE_INDEX     6
+
+//Threads that may look up one router at the same time
+#define ISO8583_ROUTE_READERS   128
+
+//Lookup result when no rule matches
+#define ISO8583_ROUTE_NONE      ( -1 )
+
+//One routing rule. When rules overlap the narrowest BIN range wins, then a
+//rule with an MTI, then the longer processing code prefix, then the first
+//given.
+typedef struct
+{
+    char cLow[ ISO8583_ROUTE_DIGITS + 1 ];  // first BIN, 6 - 11 digits
+    char cHigh[ ISO8583_ROUTE_DIGITS + 1 ]; // last BIN, 6 - 11 digits, "" for cLow
+    char cMti[ 5 ];                         // 4 digits, "" for any
+    char cProc[ 7 ];                        // 0 - 6 leading digits of field 3
+    int iRoute;                             // >= 0
+} ISO8583_RouteRule;
+
+typedef struct ISO8583_RouteTable ISO8583_RouteTable;
+typedef struct ISO8583_Router ISO8583_Router;
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Route_Build
+ * DESCRIPTION:     Compile rules into a table
+ * PARAMETERS:      pRules: iRules rules, any order
+ *                  iRules: number of rules
+ *                  ppTable(out): the table
+ *                  piBad(out): index of a bad rule, may be NULL
+ * RETURN:          ISOENGINE_OK
+ *                  ISOENGINE_INVALID_FIELD_DATA: bad rule *piBad
+ *                  ISOENGINE_OVER_MAXLENGTH: out of memory
+ ---------------------------------------------------------------------------- */
+int ISO8583Route_Build( const ISO8583_RouteRule * pRules, int iRules, ISO8583_RouteTable ** ppTable, int * piBad );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Route_Load
+ * DESCRIPTION:     Build a table from a rule file, one rule per line:
+ *                  low[-high] mti|* proc|* route
+ *                  e.g. "411111-411199 0200 00 3". '#' starts a comment.
+ * PARAMETERS:      fp: rule file
+ *                  ppTable(out): the table
+ *                  piLine(out): line of an error, may be NULL
+ * RETURN:          ISOENGINE_OK, an error of ISO8583Route_Build
+ ---------------------------------------------------------------------------- */
+int ISO8583Route_Load( FILE * fp, ISO8583_RouteTable ** ppTable, int * piLine );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Route_FreeTable
+ * DESCRIPTION:     Free a table that was not published
+ * PARAMETERS:      pTable: table, may be NULL
+ * RETURN:          None.
+ ---------------------------------------------------------------------------- */
+void ISO8583Route_FreeTable( ISO8583_RouteTable * pTable );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Route_Create
+ * DESCRIPTION:     Create a router
+ * PARAMETERS:      pTable: first table, owned by the router from now on,
+ *                          may be NULL (nothing routes)
+ * RETURN:          The router, NULL when out of memory
+ ---------------------------------------------------------------------------- */
+ISO8583_Router * ISO8583Route_Create( ISO8583_RouteTable * pTable );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Route_Destroy
+ * DESCRIPTION:     Free a router and its table, no lookup may be running
+ * PARAMETERS:      pRouter: router, may be NULL
+ * RETURN:          None.
+ ---------------------------------------------------------------------------- */
+void ISO8583Route_Destroy( ISO8583_Router * pRouter );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Route_Register
+ * DESCRIPTION:     Reader slot of a thread that looks up the router, taken
+ *                  once per thread and given back with
+ *                  ISO8583Route_Unregister
+ * PARAMETERS:      pRouter: router
+ * RETURN:          >= 0: reader slot, ISOENGINE_OVER_MAXLENGTH: all
+ *                  ISO8583_ROUTE_READERS slots taken
+ ---------------------------------------------------------------------------- */
+int ISO8583Route_Register( ISO8583_Router * pRouter );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Route_Unregister
+ * DESCRIPTION:     Give back the reader slot of a thread, e.g. when it exits.
+ *                  The thread must not look up with the slot any more, the
+ *                  next ISO8583Route_Register may hand it out again.
+ * PARAMETERS:      pRouter: router
+ *                  iReader: slot of ISO8583Route_Register
+ * RETURN:          None.
+ ---------------------------------------------------------------------------- */
+void ISO8583Route_Unregister( ISO8583_Router * pRouter, int iReader );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Route_Publish
+ * DESCRIPTION:     Replace the table. Lookups started after the swap see the
+ *                  new table; the call returns when no lookup reads the old
+ *                  one any more, and frees it. One publisher at a time.
+ * PARAMETERS:      pRouter: router
+ *                  pTable: new table, owned by the router from now on
+ * RETURN:          None.
+ ---------------------------------------------------------------------------- */
+void ISO8583Route_Publish( ISO8583_Router * pRouter, ISO8583_RouteTable * pTable );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Route_Lookup
+ * DESCRIPTION:     Route of a BIN, MTI and processing code
+ * PARAMETERS:      pRouter: router
+ *                  iReader: slot of the calling thread, see ISO8583Route_Register
+ *                  ullBin: first ISO8583_ROUTE_DIGITS PAN digits, a shorter
+ *                          PAN padded with zeros
+ *                  iMti: MTI 0 - 9999
+ *                  iProc: field 3, 0 - 999999
+ * RETURN:          Route of the rule, ISO8583_ROUTE_NONE
+ ---------------------------------------------------------------------------- */
+int ISO8583Route_Lookup( ISO8583_Router * pRouter, int iReader, unsigned long long ullBin, int iMti, int iProc );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Route_LookupRec
+ * DESCRIPTION:     ISO8583Route_Lookup on a record: the MTI, field 3 and the
+ *                  first PAN digits are converted from their wire form in
+ *                  cData, packed BCD is not unpacked to ASCII
+ * PARAMETERS:      pRouter: router
+ *                  iReader: slot of the calling thread
+ *                  pSpec: spec context
+ *                  pIso8583Data: Iso8583 data structure
+ * RETURN:          Route of the rule, ISO8583_ROUTE_NONE
+ *                  ISOENGINE_INVALID_FIELD_DATA: no field 2, a PAN of less
+ *                                                than ISO8583_ROUTE_INDEX
+ *                                                digits or a field that is
+ *                                                not numeric
+ ---------------------------------------------------------------------------- */
+int ISO8583Route_LookupRec( ISO8583_Router * pRouter, int iReader, const ISO8583_Spec * pSpec, const ISO8583_Rec * pIso8583Data );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
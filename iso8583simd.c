@@ -0,0 +1,843 @@
+/***************************************************************************
+* FILE NAME:    ISO8583Simd.C                                              *
+* MODULE NAME:  ISO8583Engine                                              *
+* PROGRAMMER:                                                              *
+* DESCRIPTION:  BCD <-> ASCII conversion utilities. SSE2 / SSSE3 / AVX2    *
+*               kernels convert 16 or 32 bytes per step and are selected   *
+*               once by CPU feature detection; every kernel produces the   *
+*               same bytes as the scalar version.                          *
+* REVISION:                                                                *
+****************************************************************************/
+
+#include <string.h>
+
+#include "ISO8583Engine.h"
+
+#if defined( __GNUC__ ) && ( defined( __x86_64__ ) || defined( __i386__ ) )
+#define ISO8583_SIMD_X86    1
+#include <immintrin.h>
+#endif
+
+typedef void ( *BCD2ASC_Fn )( const unsigned char * BcdBuf, unsigned char * AscBuf, int Len );
+typedef void ( *ASC2BCD_Fn )( const unsigned char * AscBuf, unsigned char * BcdBuf, int Len );
+
+static const unsigned char HexDigits[ 16 ] =
+{
+    '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'A', 'B', 'C', 'D', 'E', 'F'
+};
+
+static void BCD2ASC_Scalar( const unsigned char * BcdBuf, unsigned char * AscBuf, int Len );
+static void ASC2BCD_Scalar( const unsigned char * AscBuf, unsigned char * BcdBuf, int Len );
+
+//Selected kernels, start out scalar so a thread racing the first detection is still correct
+static int SimdLevel = -1;
+static BCD2ASC_Fn pfnBCD2ASC = BCD2ASC_Scalar;
+static ASC2BCD_Fn pfnASC2BCD = ASC2BCD_Scalar;
+
+/*-----------------------------------------------------------------------------
+ * Scalar kernels, also used for the tails of the vector kernels
+ *-----------------------------------------------------------------------------*/
+static void BCD2ASC_Scalar( const unsigned char * BcdBuf, unsigned char * AscBuf, int Len )
+{
+    int i;
+
+    for( i = 0; i + 1 < Len; i += 2, BcdBuf ++ )
+    {
+        AscBuf[ i ] = HexDigits[ *BcdBuf >> 4 ];
+        AscBuf[ i + 1 ] = HexDigits[ *BcdBuf & 0x0F ];
+    }
+
+    if( i < Len )
+        AscBuf[ i ] = HexDigits[ *BcdBuf >> 4 ];
+}
+
+//Nibble value of one ASCII char: 'a'-'f' / 'A'-'F' give 10-15, other chars keep
+//their low 4 bits when bKeep is set and give 0 otherwise
+static unsigned char AscNibble( unsigned char c, int bKeep )
+{
+    if(( unsigned char )(( c | 0x20 ) - 'a' ) < 6 )
+        return ( unsigned char )(( c & 0x0F ) + 9 );
+
+    return bKeep ? ( unsigned char )( c & 0x0F ) : 0;
+}
+
+//The low nibble of every pair is kept or zeroed on AscBuf[ 1 ] >= '0', not on
+//its own char; this has always been the behaviour and the wire depends on it
+static void ASC2BCD_Scalar( const unsigned char * AscBuf, unsigned char * BcdBuf, int Len )
+{
+    int i, bKeepLow;
+
+    if( Len <= 0 )
+        return;
+
+    bKeepLow = AscBuf[ 1 ] >= '0';
+
+    for( i = 0; i < Len; i += 2 )
+        BcdBuf[ i / 2 ] = ( unsigned char )(( AscNibble( AscBuf[ i ], AscBuf[ i ] >= '0' ) << 4 ) | AscNibble( AscBuf[ i + 1 ], bKeepLow ));
+}
+
+#ifdef ISO8583_SIMD_X86
+
+/*-----------------------------------------------------------------------------
+ * SSE2 kernels: 16 BCD bytes / 32 ASCII chars per step
+ *-----------------------------------------------------------------------------*/
+__attribute__(( target( "sse2" ) ))
+static __m128i NibbleToHex_SSE2( __m128i n )
+{
+    __m128i letter = _mm_and_si128( _mm_cmpgt_epi8( n, _mm_set1_epi8( 9 ) ), _mm_set1_epi8( 'A' - '0' - 10 ) );
+
+    return _mm_add_epi8( _mm_add_epi8( n, _mm_set1_epi8( '0' ) ), letter );
+}
+
+__attribute__(( target( "sse2" ) ))
+static void BCD2ASC_SSE2( const unsigned char * BcdBuf, unsigned char * AscBuf, int Len )
+{
+    const __m128i mask = _mm_set1_epi8( 0x0F );
+    __m128i v, hi, lo;
+
+    for( ; Len >= 32; Len -= 32, BcdBuf += 16, AscBuf += 32 )
+    {
+        v = _mm_loadu_si128(( const __m128i * )BcdBuf );
+        hi = _mm_and_si128( _mm_srli_epi16( v, 4 ), mask );
+        lo = _mm_and_si128( v, mask );
+        _mm_storeu_si128(( __m128i * )AscBuf, NibbleToHex_SSE2( _mm_unpacklo_epi8( hi, lo ) ) );
+        _mm_storeu_si128(( __m128i * )( AscBuf + 16 ), NibbleToHex_SSE2( _mm_unpackhi_epi8( hi, lo ) ) );
+    }
+
+    BCD2ASC_Scalar( BcdBuf, AscBuf, Len );
+}
+
+//Per-char nibble values of 16 ASCII chars, see AscNibble(); keep is a mask of
+//the non-letter chars allowed to keep their low 4 bits
+__attribute__(( target( "sse2" ) ))
+static __m128i AscNibble_SSE2( __m128i c, __m128i keep )
+{
+    __m128i low = _mm_and_si128( c, _mm_set1_epi8( 0x0F ) );
+    __m128i idx = _mm_sub_epi8( _mm_or_si128( c, _mm_set1_epi8( 0x20 ) ), _mm_set1_epi8( 'a' ) );
+    __m128i letter = _mm_cmpeq_epi8( _mm_min_epu8( idx, _mm_set1_epi8( 5 ) ), idx );
+
+    keep = _mm_or_si128( keep, letter );
+    return _mm_and_si128( _mm_add_epi8( low, _mm_and_si128( letter, _mm_set1_epi8( 9 ) ) ), keep );
+}
+
+//Chars at even offsets keep their low bits when >= '0', odd offsets when AscBuf[ 1 ] >= '0'
+__attribute__(( target( "sse2" ) ))
+static __m128i AscKeepMask_SSE2( __m128i c, __m128i oddKeep )
+{
+    __m128i ge0 = _mm_cmpeq_epi8( _mm_max_epu8( c, _mm_set1_epi8( '0' ) ), c );
+
+    return _mm_or_si128( _mm_and_si128( ge0, _mm_set1_epi16( 0x00FF ) ), oddKeep );
+}
+
+__attribute__(( target( "sse2" ) ))
+static void ASC2BCD_SSE2( const unsigned char * AscBuf, unsigned char * BcdBuf, int Len )
+{
+    __m128i oddKeep, c0, c1, v0, v1;
+    int bKeepLow;
+
+    if( Len < 32 )
+    {
+        ASC2BCD_Scalar( AscBuf, BcdBuf, Len );
+        return;
+    }
+
+    bKeepLow = AscBuf[ 1 ] >= '0';
+    oddKeep = bKeepLow ? _mm_set1_epi16(( short )0xFF00 ) : _mm_setzero_si128();
+
+    for( ; Len >= 32; Len -= 32, AscBuf += 32, BcdBuf += 16 )
+    {
+        c0 = _mm_loadu_si128(( const __m128i * )AscBuf );
+        c1 = _mm_loadu_si128(( const __m128i * )( AscBuf + 16 ) );
+        v0 = AscNibble_SSE2( c0, AscKeepMask_SSE2( c0, oddKeep ) );
+        v1 = AscNibble_SSE2( c1, AscKeepMask_SSE2( c1, oddKeep ) );
+
+        // 16 bit lanes hold ( odd << 8 ) | even, turn into ( even << 4 ) | odd
+        v0 = _mm_or_si128( _mm_slli_epi16( _mm_and_si128( v0, _mm_set1_epi16( 0x00FF ) ), 4 ), _mm_srli_epi16( v0, 8 ) );
+        v1 = _mm_or_si128( _mm_slli_epi16( _mm_and_si128( v1, _mm_set1_epi16( 0x00FF ) ), 4 ), _mm_srli_epi16( v1, 8 ) );
+        _mm_storeu_si128(( __m128i * )BcdBuf, _mm_packus_epi16( v0, v1 ) );
+    }
+
+    //tail chars are still judged on the original AscBuf[ 1 ]
+    for( ; Len > 0; Len -= 2, AscBuf += 2, BcdBuf ++ )
+        *BcdBuf = ( unsigned char )(( AscNibble( AscBuf[ 0 ], AscBuf[ 0 ] >= '0' ) << 4 ) | AscNibble( AscBuf[ 1 ], bKeepLow ));
+}
+
+/*-----------------------------------------------------------------------------
+ * SSSE3 kernels: pshufb hex table lookup, pmaddubsw nibble pairing
+ *-----------------------------------------------------------------------------*/
+__attribute__(( target( "ssse3" ) ))
+static void BCD2ASC_SSSE3( const unsigned char * BcdBuf, unsigned char * AscBuf, int Len )
+{
+    const __m128i mask = _mm_set1_epi8( 0x0F );
+    const __m128i table = _mm_loadu_si128(( const __m128i * )HexDigits );
+    __m128i v, hi, lo;
+
+    for( ; Len >= 32; Len -= 32, BcdBuf += 16, AscBuf += 32 )
+    {
+        v = _mm_loadu_si128(( const __m128i * )BcdBuf );
+        hi = _mm_and_si128( _mm_srli_epi16( v, 4 ), mask );
+        lo = _mm_and_si128( v, mask );
+        _mm_storeu_si128(( __m128i * )AscBuf, _mm_shuffle_epi8( table, _mm_unpacklo_epi8( hi, lo ) ) );
+        _mm_storeu_si128(( __m128i * )( AscBuf + 16 ), _mm_shuffle_epi8( table, _mm_unpackhi_epi8( hi, lo ) ) );
+    }
+
+    BCD2ASC_Scalar( BcdBuf, AscBuf, Len );
+}
+
+__attribute__(( target( "ssse3" ) ))
+static void ASC2BCD_SSSE3( const unsigned char * AscBuf, unsigned char * BcdBuf, int Len )
+{
+    const __m128i weight = _mm_set1_epi16( 0x0110 );
+    __m128i oddKeep, c0, c1, v0, v1;
+    int bKeepLow;
+
+    if( Len < 32 )
+    {
+        ASC2BCD_Scalar( AscBuf, BcdBuf, Len );
+        return;
+    }
+
+    bKeepLow = AscBuf[ 1 ] >= '0';
+    oddKeep = bKeepLow ? _mm_set1_epi16(( short )0xFF00 ) : _mm_setzero_si128();
+
+    for( ; Len >= 32; Len -= 32, AscBuf += 32, BcdBuf += 16 )
+    {
+        c0 = _mm_loadu_si128(( const __m128i * )AscBuf );
+        c1 = _mm_loadu_si128(( const __m128i * )( AscBuf + 16 ) );
+        v0 = _mm_maddubs_epi16( AscNibble_SSE2( c0, AscKeepMask_SSE2( c0, oddKeep ) ), weight );
+        v1 = _mm_maddubs_epi16( AscNibble_SSE2( c1, AscKeepMask_SSE2( c1, oddKeep ) ), weight );
+        _mm_storeu_si128(( __m128i * )BcdBuf, _mm_packus_epi16( v0, v1 ) );
+    }
+
+    for( ; Len > 0; Len -= 2, AscBuf += 2, BcdBuf ++ )
+        *BcdBuf = ( unsigned char )(( AscNibble( AscBuf[ 0 ], AscBuf[ 0 ] >= '0' ) << 4 ) | AscNibble( AscBuf[ 1 ], bKeepLow ));
+}
+
+/*-----------------------------------------------------------------------------
+ * AVX2 kernels: 32 BCD bytes / 64 ASCII chars per step
+ *-----------------------------------------------------------------------------*/
+__attribute__(( target( "avx2" ) ))
+static void BCD2ASC_AVX2( const unsigned char * BcdBuf, unsigned char * AscBuf, int Len )
+{
+    const __m256i mask = _mm256_set1_epi8( 0x0F );
+    const __m256i table = _mm256_broadcastsi128_si256( _mm_loadu_si128(( const __m128i * )HexDigits ) );
+    __m256i v, hi, lo, a, b;
+
+    for( ; Len >= 64; Len -= 64, BcdBuf += 32, AscBuf += 64 )
+    {
+        v = _mm256_loadu_si256(( const __m256i * )BcdBuf );
+        hi = _mm256_and_si256( _mm256_srli_epi16( v, 4 ), mask );
+        lo = _mm256_and_si256( v, mask );
+        a = _mm256_shuffle_epi8( table, _mm256_unpacklo_epi8( hi, lo ) );
+        b = _mm256_shuffle_epi8( table, _mm256_unpackhi_epi8( hi, lo ) );
+        _mm256_storeu_si256(( __m256i * )AscBuf, _mm256_permute2x128_si256( a, b, 0x20 ) );
+        _mm256_storeu_si256(( __m256i * )( AscBuf + 32 ), _mm256_permute2x128_si256( a, b, 0x31 ) );
+    }
+
+    BCD2ASC_SSSE3( BcdBuf, AscBuf, Len );
+}
+
+__attribute__(( target( "avx2" ) ))
+static __m256i AscPairs_AVX2( __m256i c, __m256i oddKeep )
+{
+    __m256i low = _mm256_and_si256( c, _mm256_set1_epi8( 0x0F ) );
+    __m256i idx = _mm256_sub_epi8( _mm256_or_si256( c, _mm256_set1_epi8( 0x20 ) ), _mm256_set1_epi8( 'a' ) );
+    __m256i letter = _mm256_cmpeq_epi8( _mm256_min_epu8( idx, _mm256_set1_epi8( 5 ) ), idx );
+    __m256i ge0 = _mm256_cmpeq_epi8( _mm256_max_epu8( c, _mm256_set1_epi8( '0' ) ), c );
+    __m256i keep = _mm256_or_si256( _mm256_or_si256( _mm256_and_si256( ge0, _mm256_set1_epi16( 0x00FF ) ), oddKeep ), letter );
+    __m256i v = _mm256_and_si256( _mm256_add_epi8( low, _mm256_and_si256( letter, _mm256_set1_epi8( 9 ) ) ), keep );
+
+    return _mm256_maddubs_epi16( v, _mm256_set1_epi16( 0x0110 ) );
+}
+
+__attribute__(( target( "avx2" ) ))
+static void ASC2BCD_AVX2( const unsigned char * AscBuf, unsigned char * BcdBuf, int Len )
+{
+    __m256i oddKeep, v0, v1;
+    int bKeepLow;
+
+    if( Len < 64 )
+    {
+        ASC2BCD_SSSE3( AscBuf, BcdBuf, Len );
+        return;
+    }
+
+    bKeepLow = AscBuf[ 1 ] >= '0';
+    oddKeep = bKeepLow ? _mm256_set1_epi16(( short )0xFF00 ) : _mm256_setzero_si256();
+
+    for( ; Len >= 64; Len -= 64, AscBuf += 64, BcdBuf += 32 )
+    {
+        v0 = AscPairs_AVX2( _mm256_loadu_si256(( const __m256i * )AscBuf ), oddKeep );
+        v1 = AscPairs_AVX2( _mm256_loadu_si256(( const __m256i * )( AscBuf + 32 ) ), oddKeep );
+        _mm256_storeu_si256(( __m256i * )BcdBuf, _mm256_permute4x64_epi64( _mm256_packus_epi16( v0, v1 ), 0xD8 ) );
+    }
+
+    for( ; Len > 0; Len -= 2, AscBuf += 2, BcdBuf ++ )
+        *BcdBuf = ( unsigned char )(( AscNibble( AscBuf[ 0 ], AscBuf[ 0 ] >= '0' ) << 4 ) | AscNibble( AscBuf[ 1 ], bKeepLow ));
+}
+
+#endif
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Utils_SetSimdLevel
+ * DESCRIPTION:     Select the BCD/ASCII conversion kernels. Levels the CPU
+ *                  does not support are lowered to the best supported one.
+ * PARAMETERS:      iLevel: ISO8583_SIMD_AUTO or one of ISO8583_SimdLevel
+ * RETURN:          The level in effect afterwards
+ ---------------------------------------------------------------------------- */
+int ISO8583Utils_SetSimdLevel( int iLevel )
+{
+    int iMax = ISO8583_SIMD_SCALAR;
+
+#ifdef ISO8583_SIMD_X86
+    __builtin_cpu_init();
+
+    if( __builtin_cpu_supports( "avx2" ) )
+        iMax = ISO8583_SIMD_AVX2;
+    else if( __builtin_cpu_supports( "ssse3" ) )
+        iMax = ISO8583_SIMD_SSSE3;
+    else if( __builtin_cpu_supports( "sse2" ) )
+        iMax = ISO8583_SIMD_SSE2;
+#endif
+
+    if( iLevel == ISO8583_SIMD_AUTO || iLevel > iMax )
+        iLevel = iMax;
+
+    switch( iLevel )
+    {
+#ifdef ISO8583_SIMD_X86
+    case ISO8583_SIMD_AVX2:
+        pfnBCD2ASC = BCD2ASC_AVX2;
+        pfnASC2BCD = ASC2BCD_AVX2;
+        break;
+
+    case ISO8583_SIMD_SSSE3:
+        pfnBCD2ASC = BCD2ASC_SSSE3;
+        pfnASC2BCD = ASC2BCD_SSSE3;
+        break;
+
+    case ISO8583_SIMD_SSE2:
+        pfnBCD2ASC = BCD2ASC_SSE2;
+        pfnASC2BCD = ASC2BCD_SSE2;
+        break;
+#endif
+
+    default:
+        iLevel = ISO8583_SIMD_SCALAR;
+        pfnBCD2ASC = BCD2ASC_Scalar;
+        pfnASC2BCD = ASC2BCD_Scalar;
+        break;
+    }
+
+    SimdLevel = iLevel;
+    return iLevel;
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Utils_GetSimdLevel
+ * DESCRIPTION:     Return the BCD/ASCII kernel level in use, detecting the
+ *                  CPU features on first call
+ ---------------------------------------------------------------------------- */
+int ISO8583Utils_GetSimdLevel( void )
+{
+    if( SimdLevel < 0 )
+        ISO8583Utils_SetSimdLevel( ISO8583_SIMD_AUTO );
+
+    return SimdLevel;
+}
+
+/* --------------------------------------------------------------------------
+* FUNCTION NAME: ISO8583Utils_BCD2ASC
+* DESCRIPTION:   Convert BCD code to ASCII code.
+* PARAMETERS:    BcdBuf - BCD input buffer, Len - double length of Bcdbuf bytes
+*                AscBuf - converted result
+* RETURN:        0
+* NOTES:
+* ------------------------------------------------------------------------ */
+int ISO8583Utils_BCD2ASC(unsigned char * BcdBuf, unsigned char * AscBuf, int Len)
+{
+    if( Len < 32 )
+        BCD2ASC_Scalar( BcdBuf, AscBuf, Len );
+    else
+    {
+        if( SimdLevel < 0 )
+            ISO8583Utils_SetSimdLevel( ISO8583_SIMD_AUTO );
+
+        pfnBCD2ASC( BcdBuf, AscBuf, Len );
+    }
+
+    return 0;
+}
+
+
+/* --------------------------------------------------------------------------
+* FUNCTION NAME: ISO8583Utils_ASC2BCD
+* DESCRIPTION:   Convert ASCII code to BCD code.
+* PARAMETERS:    AscBuf - Ascii input buffer, must ended by '\0'
+*                Len - double length of BCD code, should be even.
+*                BcdBuf - converted BCD code result
+* RETURN:        0
+* NOTES:         support 'A'-'F' convertion(extend BCD code)
+* ------------------------------------------------------------------------ */
+int ISO8583Utils_ASC2BCD(unsigned char * AscBuf, unsigned char * BcdBuf, int Len)
+{
+    if( Len < 32 )
+        ASC2BCD_Scalar( AscBuf, BcdBuf, Len );
+    else
+    {
+        if( SimdLevel < 0 )
+            ISO8583Utils_SetSimdLevel( ISO8583_SIMD_AUTO );
+
+        pfnASC2BCD( AscBuf, BcdBuf, Len );
+    }
+
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------
+ * Number conversion. Up to 16 packed digits or 8 ASCII digits are combined in
+ * one 64 bit word: pairs of digits first, then pairs of pairs, and so on.
+ *-----------------------------------------------------------------------------*/
+
+#define BCD_ROW( t )    t##0, t##1, t##2, t##3, t##4, t##5, t##6, t##7, t##8, t##9
+
+//Packed BCD byte of 0 - 99
+static const unsigned char BcdPair[ 100 ] =
+{
+    BCD_ROW( 0x0 ), BCD_ROW( 0x1 ), BCD_ROW( 0x2 ), BCD_ROW( 0x3 ), BCD_ROW( 0x4 ),
+    BCD_ROW( 0x5 ), BCD_ROW( 0x6 ), BCD_ROW( 0x7 ), BCD_ROW( 0x8 ), BCD_ROW( 0x9 )
+};
+
+static const unsigned long long Pow10[ 20 ] =
+{
+    1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL,
+    100000000ULL, 1000000000ULL, 10000000000ULL, 100000000000ULL, 1000000000000ULL,
+    10000000000000ULL, 100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
+    100000000000000000ULL, 1000000000000000000ULL, 10000000000000000000ULL
+};
+
+//Nonzero when a nibble of x is above 9, that is bit 3 set with bit 2 or bit 1
+static unsigned long long SwarBadNibbles( unsigned long long x )
+{
+    return x & (( x << 1 ) | ( x << 2 )) & 0x8888888888888888ULL;
+}
+
+//Value of 16 packed BCD digits, most significant digit in the top nibble
+static unsigned long long SwarBcdValue( unsigned long long x )
+{
+    x = ( x & 0x0F0F0F0F0F0F0F0FULL ) + (( x >> 4 ) & 0x0F0F0F0F0F0F0F0FULL ) * 10;
+    x = ( x & 0x00FF00FF00FF00FFULL ) + (( x >> 8 ) & 0x00FF00FF00FF00FFULL ) * 100;
+    x = ( x & 0x0000FFFF0000FFFFULL ) + (( x >> 16 ) & 0x0000FFFF0000FFFFULL ) * 10000;
+    return ( x & 0xFFFFFFFFULL ) + ( x >> 32 ) * 100000000ULL;
+}
+
+//Value of 8 ASCII digits, most significant digit in the low byte
+static unsigned long long SwarAscValue( unsigned long long x )
+{
+    x -= 0x3030303030303030ULL;
+    x = ( x * 10 + ( x >> 8 ) ) & 0x00FF00FF00FF00FFULL;
+    x = ( x * 100 + ( x >> 16 ) ) & 0x0000FFFF0000FFFFULL;
+    return ( x * 10000 + ( x >> 32 ) ) & 0xFFFFFFFFULL;
+}
+
+//8 packed BCD digits of uiValue < 10^8, the reverse of SwarBcdValue: the two
+//halves are split in 32 bit lanes, then in 16 and 8 bit lanes by multiplying
+//with the reciprocals of 100 and 10, and the digit bytes squeezed to nibbles
+static unsigned int SwarBcdDigits( unsigned int uiValue )
+{
+    unsigned long long x, q;
+
+    x = (( unsigned long long )( uiValue / 10000 ) << 32 ) | ( uiValue % 10000 );
+    q = (( x * 10486 ) >> 20 ) & 0x0000007F0000007FULL;
+    x = ( q << 16 ) | ( x - q * 100 );
+    q = (( x * 103 ) >> 10 ) & 0x000F000F000F000FULL;
+    x = ( q << 8 ) | ( x - q * 10 );
+    x = ( x | ( x >> 4 ) ) & 0x00FF00FF00FF00FFULL;
+    x = ( x | ( x >> 8 ) ) & 0x0000FFFF0000FFFFULL;
+    return ( unsigned int )( x | ( x >> 16 ) );
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Utils_BCD2U64
+ * DESCRIPTION:     Convert Len packed BCD digits to an integer, 16 digits at
+ *                  a time
+ * PARAMETERS:      BcdBuf: BCD input, left aligned, the pad nibble of an odd
+ *                          Len is ignored
+ *                  Len: number of digits, 1 - 20
+ *                  pValue(out): converted value
+ * RETURN:          0, -1: a nibble is not a digit, -2: Len out of range or
+ *                  the value does not fit 64 bits
+ ---------------------------------------------------------------------------- */
+int ISO8583Utils_BCD2U64( const unsigned char * BcdBuf, int Len, unsigned long long * pValue )
+{
+    unsigned long long ullHead = 0, x = 0;
+    int i, iHead, iRest;
+
+    if( Len <= 0 || Len > 20 )
+        return -2;
+
+    //Digits in front of the last 16, always a whole number of bytes
+    iHead = Len > 16 ? ( Len - 15 ) & ~1 : 0;
+    iRest = Len - iHead;
+
+    for( i = 0; i < iHead / 2; i ++ )
+    {
+        if( SwarBadNibbles( BcdBuf[ i ] ) )
+            return -1;
+
+        ullHead = ullHead * 100 + ( BcdBuf[ i ] >> 4 ) * 10 + ( BcdBuf[ i ] & 0x0F );
+    }
+
+    for( BcdBuf += iHead / 2, i = 0; i < ( iRest + 1 ) / 2; i ++ )
+        x = ( x << 8 ) | BcdBuf[ i ];
+
+    if( iRest & 1 )
+        x >>= 4;
+
+    if( SwarBadNibbles( x ) )
+        return -1;
+
+    x = SwarBcdValue( x );
+
+    if( ullHead > ( ~0ULL - x ) / Pow10[ iRest ] )
+        return -2;
+
+    *pValue = ullHead * Pow10[ iRest ] + x;
+    return 0;
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Utils_ASC2U64
+ * DESCRIPTION:     Convert Len ASCII digits to an integer, 8 digits at a time
+ * PARAMETERS:      AscBuf: ASCII input
+ *                  Len: number of digits, 1 - 20
+ *                  pValue(out): converted value
+ * RETURN:          0, -1: a char is not a digit, -2: Len out of range or the
+ *                  value does not fit 64 bits
+ ---------------------------------------------------------------------------- */
+int ISO8583Utils_ASC2U64( const unsigned char * AscBuf, int Len, unsigned long long * pValue )
+{
+    unsigned long long ullValue = 0, x;
+    int i, n;
+
+    if( Len <= 0 || Len > 20 )
+        return -2;
+
+    //The first chunk takes Len % 8 digits behind leading '0's, the others 8
+    for( n = ( Len - 1 ) % 8 + 1; Len > 0; Len -= n, AscBuf += n, n = 8 )
+    {
+        x = n < 8 ? 0x3030303030303030ULL >> ( 8 * n ) : 0;
+
+        for( i = 0; i < n; i ++ )
+            x |= ( unsigned long long )AscBuf[ i ] << ( 8 * ( 8 - n + i ) );
+
+        if(( x & 0xF0F0F0F0F0F0F0F0ULL ) != 0x3030303030303030ULL
+            || (( x + 0x0606060606060606ULL ) & 0xF0F0F0F0F0F0F0F0ULL ) != 0x3030303030303030ULL )
+            return -1;
+
+        x = SwarAscValue( x );
+
+        if( ullValue > ( ~0ULL - x ) / Pow10[ n ] )
+            return -2;
+
+        ullValue = ullValue * Pow10[ n ] + x;
+    }
+
+    *pValue = ullValue;
+    return 0;
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Utils_U642BCD
+ * DESCRIPTION:     Convert an integer to Len packed BCD digits, 8 digits at a
+ *                  time, values below 10000 by table
+ * PARAMETERS:      Value: value to convert
+ *                  BcdBuf(out): ( Len + 1 ) / 2 bytes, left aligned with
+ *                               leading zeros, an odd Len gets a 0 pad nibble
+ *                  Len: number of digits, > 0
+ * RETURN:          0, -1: Value has more than Len digits
+ ---------------------------------------------------------------------------- */
+int ISO8583Utils_U642BCD( unsigned long long Value, unsigned char * BcdBuf, int Len )
+{
+    unsigned char cDigits[ 13 ];
+    unsigned int uiWord;
+    int i, j, iBytes;
+
+    if( Len <= 0 || ( Len < 20 && Value >= Pow10[ Len ] ) )
+        return -1;
+
+    //Value right aligned in 24 digits, cDigits[ 12 ] is the pad of an odd Len
+    memset( cDigits, 0, sizeof( cDigits ) );
+
+    if( Value < 10000 )
+    {
+        cDigits[ 10 ] = BcdPair[ Value / 100 ];
+        cDigits[ 11 ] = BcdPair[ Value % 100 ];
+    }
+    else
+    {
+        for( i = 2; i >= 0 && Value != 0; i --, Value /= 100000000 )
+        {
+            uiWord = SwarBcdDigits(( unsigned int )( Value % 100000000 ));
+
+            for( j = 3; j >= 0; j --, uiWord >>= 8 )
+                cDigits[ i * 4 + j ] = ( unsigned char )uiWord;
+        }
+    }
+
+    iBytes = ( Len + 1 ) / 2;
+
+    for( i = 0, j = 12 - iBytes; i < iBytes; i ++, j ++ )
+    {
+        if( j < 0 )
+            BcdBuf[ i ] = 0;
+        else if( Len & 1 )
+            BcdBuf[ i ] = ( unsigned char )(( cDigits[ j ] << 4 ) | ( cDigits[ j + 1 ] >> 4 ));
+        else
+            BcdBuf[ i ] = cDigits[ j ];
+    }
+
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------
+ * Content checks, 8 bytes per step in a 64 bit word, the last short word too.
+ * A word with a bad byte is looked at again byte by byte.
+ *-----------------------------------------------------------------------------*/
+
+#define SWAR_ONES       0x0101010101010101ULL
+#define SWAR_HIGH       0x8080808080808080ULL
+
+//Byte ranges of each ISO8583_CharClass as the SWAR_ONES multiples added by
+//SwarNotInClass, the byte ranges themselves and the number of ranges
+typedef struct
+{
+    unsigned long long ullLo[ 4 ];
+    unsigned long long ullHi[ 4 ];
+    unsigned char cRange[ 4 ][ 2 ];
+    int iRanges;
+} CharClassRanges;
+
+#define CLASS_RANGE_LO( lo )    (( 0x80 - ( lo )) * SWAR_ONES )
+#define CLASS_RANGE_HI( hi )    (( 0x7F - ( hi )) * SWAR_ONES )
+#define CLASS_RANGE1( a, b ) \
+    { { CLASS_RANGE_LO( a ) }, { CLASS_RANGE_HI( b ) }, { { a, b } }, 1 }
+#define CLASS_RANGE3( a, b, c, d, e, f ) \
+    { { CLASS_RANGE_LO( a ), CLASS_RANGE_LO( c ), CLASS_RANGE_LO( e ) }, \
+      { CLASS_RANGE_HI( b ), CLASS_RANGE_HI( d ), CLASS_RANGE_HI( f ) }, { { a, b }, { c, d }, { e, f } }, 3 }
+#define CLASS_RANGE4( a, b, c, d, e, f, g, h ) \
+    { { CLASS_RANGE_LO( a ), CLASS_RANGE_LO( c ), CLASS_RANGE_LO( e ), CLASS_RANGE_LO( g ) }, \
+      { CLASS_RANGE_HI( b ), CLASS_RANGE_HI( d ), CLASS_RANGE_HI( f ), CLASS_RANGE_HI( h ) }, { { a, b }, { c, d }, { e, f }, { g, h } }, 4 }
+
+static const CharClassRanges ClassRanges[ ISO8583_CLASS_NS + 1 ] =
+{
+    CLASS_RANGE1( 0x00, 0x7F ),                                     // ANY, not checked
+    CLASS_RANGE1( '0', '9' ),                                       // N
+    CLASS_RANGE1( 0x30, 0x3F ),                                     // Z
+    CLASS_RANGE3( 'A', 'Z', 'a', 'z', ' ', ' ' ),                   // A
+    CLASS_RANGE4( '0', '9', 'A', 'Z', 'a', 'z', ' ', ' ' ),         // AN
+    CLASS_RANGE1( 0x20, 0x7E ),                                     // ANS
+    CLASS_RANGE3( 0x20, 0x40, 0x5B, 0x60, 0x7B, 0x7E ),             // NS
+};
+
+//Up to 8 bytes at p as one word without reading past p + iBytes. 4 - 7 bytes
+//are two overlapping 4 byte loads, fewer are repeated from the last byte: a
+//check sees some bytes twice but no byte that is not in the buffer.
+static unsigned long long SwarLoadShort( const unsigned char * p, int iBytes )
+{
+    unsigned int uiLow, uiHigh;
+
+    if( iBytes >= 4 )
+    {
+        memcpy( &uiLow, p, 4 );
+        memcpy( &uiHigh, p + iBytes - 4, 4 );
+    }
+    else
+    {
+        uiLow = p[ 0 ] | ( p[ iBytes >> 1 ] << 8 ) | ( p[ iBytes - 1 ] << 16 ) | (( unsigned int )p[ iBytes - 1 ] << 24 );
+        uiHigh = uiLow;
+    }
+
+    return uiLow | (( unsigned long long )uiHigh << 32 );
+}
+
+//Nonzero when a nibble of x is D
+static unsigned long long SwarNibblesD( unsigned long long x )
+{
+    x ^= 0xDDDDDDDDDDDDDDDDULL;
+    return ~((( x & 0x7777777777777777ULL ) + 0x7777777777777777ULL ) | x ) & 0x8888888888888888ULL;
+}
+
+//Nonzero when a byte of x is outside the class. A byte b below 0x80 is at
+//least lo when b + 0x80 - lo has the high bit set and above hi when
+//b + 0x7F - hi has, neither sum carries into the next byte.
+static unsigned long long SwarNotInClass( unsigned long long x, const CharClassRanges * pClass )
+{
+    unsigned long long ullIn;
+    int i;
+
+    ullIn = ( x + pClass->ullLo[ 0 ] ) & ~( x + pClass->ullHi[ 0 ] );
+
+    for( i = 1; i < pClass->iRanges; i ++ )
+        ullIn |= ( x + pClass->ullLo[ i ] ) & ~( x + pClass->ullHi[ i ] );
+
+    return ( x | ~ullIn ) & SWAR_HIGH;
+}
+
+//Offset of the first byte of Buf outside the class, -1 if none
+static int FirstNotInClass( const unsigned char * Buf, int Len, const CharClassRanges * pClass )
+{
+    int i, j;
+
+    for( i = 0; i < Len; i ++ )
+    {
+        for( j = 0; j < pClass->iRanges; j ++ )
+        {
+            if( Buf[ i ] >= pClass->cRange[ j ][ 0 ] && Buf[ i ] <= pClass->cRange[ j ][ 1 ] )
+                break;
+        }
+
+        if( j == pClass->iRanges )
+            return i;
+    }
+
+    return -1;
+}
+
+//Nonzero when digit nibble n is not allowed
+static int BadNibble( unsigned char n, int bTrack )
+{
+    return n > 9 && !( bTrack && n == 0x0D );
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Utils_CheckBCD
+ * DESCRIPTION:     Check that Len packed BCD digits are 0 - 9, 16 digits at
+ *                  a time
+ * PARAMETERS:      BcdBuf: BCD input, left aligned
+ *                  Len: number of digits
+ *                  bTrack: nibble D is allowed
+ * RETURN:          -1: all digits are good, else the first bad digit
+ ---------------------------------------------------------------------------- */
+int ISO8583Utils_CheckBCD( const unsigned char * BcdBuf, int Len, int bTrack )
+{
+    unsigned long long x, ullBad;
+    int i, iBytes = Len / 2;
+
+    for( i = 0; i < iBytes; i += 8 )
+    {
+        if( iBytes - i >= 8 )
+            memcpy( &x, BcdBuf + i, 8 );
+        else
+            x = SwarLoadShort( BcdBuf + i, iBytes - i );
+
+        ullBad = SwarBadNibbles( x );
+        if( bTrack )
+            ullBad &= ~SwarNibblesD( x );
+
+        if( ullBad != 0 )
+            break;
+    }
+
+    for( ; i < iBytes; i ++ )
+    {
+        if( BadNibble( BcdBuf[ i ] >> 4, bTrack ) )
+            return i * 2;
+
+        if( BadNibble( BcdBuf[ i ] & 0x0F, bTrack ) )
+            return i * 2 + 1;
+    }
+
+    if(( Len & 1 ) && BadNibble( BcdBuf[ iBytes ] >> 4, bTrack ) )
+        return Len - 1;
+
+    return -1;
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Utils_CheckChars
+ * DESCRIPTION:     Check that Len bytes belong to a character class, 8 bytes
+ *                  at a time
+ * PARAMETERS:      Buf: input
+ *                  Len: number of bytes
+ *                  iClass: ISO8583_CharClass
+ * RETURN:          -1: all bytes are good, else the offset of the first bad one
+ ---------------------------------------------------------------------------- */
+int ISO8583Utils_CheckChars( const unsigned char * Buf, int Len, int iClass )
+{
+    const CharClassRanges * pClass;
+    unsigned long long x;
+    int i;
+
+    if( iClass <= ISO8583_CLASS_ANY || iClass > ISO8583_CLASS_NS )
+        return -1;
+
+    pClass = &ClassRanges[ iClass ];
+
+    for( i = 0; i < Len; i += 8 )
+    {
+        if( Len - i >= 8 )
+            memcpy( &x, Buf + i, 8 );
+        else
+            x = SwarLoadShort( Buf + i, Len - i );
+
+        if( SwarNotInClass( x, pClass ) )
+            return i + FirstNotInClass( Buf + i, Len - i < 8 ? Len - i : 8, pClass );
+    }
+
+    return -1;
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Utils_Luhn
+ * DESCRIPTION:     Check the Luhn (mod 10) check digit of a number
+ * PARAMETERS:      Buf: digits, packed BCD left aligned or ASCII
+ *                  Len: number of digits, the last one is the check digit
+ *                  bPacked: Buf is packed BCD
+ * RETURN:          0: good, -1: wrong check digit or not all digits
+ ---------------------------------------------------------------------------- */
+int ISO8583Utils_Luhn( const unsigned char * Buf, int Len, int bPacked )
+{
+    //Digit doubled with the digits of the product summed
+    static const unsigned char Doubled[ 16 ] = { 0, 2, 4, 6, 8, 1, 3, 5, 7, 9 };
+    unsigned int uiFirst, uiSecond, uiBad = 0;
+    int i, iSum = 0;
+
+    if( Len <= 0 )
+        return -1;
+
+    //Every second digit from the right, the check digit itself, is doubled.
+    //Two digits a step: the first of a pair is doubled when Len is even.
+    for( i = 0; i + 2 <= Len; i += 2 )
+    {
+        if( bPacked )
+        {
+            uiFirst = Buf[ i >> 1 ] >> 4;
+            uiSecond = Buf[ i >> 1 ] & 0x0F;
+        }
+        else
+        {
+            uiFirst = ( unsigned int )( Buf[ i ] - '0' ) & 0xFF;
+            uiSecond = ( unsigned int )( Buf[ i + 1 ] - '0' ) & 0xFF;
+        }
+
+        uiBad |= ( uiFirst > 9 ) | ( uiSecond > 9 );
+        if( Len & 1 )
+            iSum += uiFirst + Doubled[ uiSecond & 0x0F ];
+        else
+            iSum += Doubled[ uiFirst & 0x0F ] + uiSecond;
+    }
+
+    //Odd Len: the check digit is left
+    if( i < Len )
+    {
+        uiFirst = bPacked ? Buf[ i >> 1 ] >> 4 : ( unsigned int )( Buf[ i ] - '0' ) & 0xFF;
+        uiBad |= uiFirst > 9;
+        iSum += uiFirst;
+    }
+
+    if( uiBad )
+        return -1;
+
+    return iSum % 10 == 0 ? 0 : -1;
+}
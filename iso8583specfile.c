@@ -0,0 +1,613 @@
+/***************************************************************************
+* FILE NAME:    ISO8583SpecFile.C                                          *
+* MODULE NAME:  ISO8583Engine                                              *
+* PROGRAMMER:                                                              *
+* DESCRIPTION:  Spec definition files and the spec cache, see              *
+*               ISO8583SpecFile.h                                          *
+* REVISION:                                                                *
+****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "ISO8583Engine.h"
+#include "ISO8583SpecFile.h"
+
+#define SPECFILE_MAGIC          "ISO8583S"
+#define SPECFILE_VERSION        2
+#define SPECFILE_BYTEORDER      0x01020304U
+#define SPECFILE_MAXLINE        256
+#define SPECFILE_MAXTOKENS      8
+
+#define ALIGN64( n )            ((( n ) + 63 ) & ~( size_t )63 )
+
+#if defined( __APPLE__ )
+#define STAT_MTIME_NS( st )     (( st ).st_mtimespec.tv_nsec )
+#else
+#define STAT_MTIME_NS( st )     (( st ).st_mtim.tv_nsec )
+#endif
+
+//Cache file header
+typedef struct
+{
+    char cMagic[ 8 ];
+    unsigned int uiVersion;
+    unsigned int uiSpecSize;        //sizeof( ISO8583_Spec ) of the writer
+    unsigned int uiByteOrder;       //SPECFILE_BYTEORDER as the writer stores it
+    unsigned int uiCount;
+    unsigned long long ullSize;     //bytes of the cache file
+} SpecCacheHeader;
+
+//One definition file in the cache
+typedef struct
+{
+    char cPath[ ISO8583_SPECFILE_MAXPATH ];
+    long long llFileSize;
+    long long llMtime;
+    long long llMtimeNs;
+    unsigned long long ullOffset;   //of the ISO8583_Spec image
+} SpecCacheEntry;
+
+//Field types and their ISO8583_CharClass
+static const struct
+{
+    const char * pName;
+    int iClass;
+} FieldTypes[] =
+{
+    { "n",   ISO8583_CLASS_N },
+    { "z",   ISO8583_CLASS_Z },
+    { "a",   ISO8583_CLASS_A },
+    { "an",  ISO8583_CLASS_AN },
+    { "ans", ISO8583_CLASS_ANS },
+    { "ns",  ISO8583_CLASS_NS },
+    { "b",   ISO8583_CLASS_ANY },
+};
+
+/*-----------------------------------------------------------------------------
+ * Internal functions
+ *-----------------------------------------------------------------------------*/
+
+//Split a line at blanks, returns the number of tokens or -1 for too many
+static int SplitLine( char * pLine, char ** ppTokens )
+{
+    int iTokens = 0;
+
+    for( ;; )
+    {
+        while( *pLine == ' ' || *pLine == '\t' || *pLine == '\r' )
+            pLine ++;
+
+        if( *pLine == 0 )
+            return iTokens;
+
+        if( iTokens == SPECFILE_MAXTOKENS )
+            return -1;
+
+        ppTokens[ iTokens ++ ] = pLine;
+
+        while( *pLine != 0 && *pLine != ' ' && *pLine != '\t' && *pLine != '\r' )
+            pLine ++;
+
+        if( *pLine != 0 )
+            *pLine ++ = 0;
+    }
+}
+
+//Decimal number of a whole token, -1 if it is not one
+static int TokenNumber( const char * pToken )
+{
+    int iValue = 0;
+
+    if( *pToken == 0 )
+        return -1;
+
+    for( ; *pToken != 0; pToken ++ )
+    {
+        if( *pToken < '0' || *pToken > '9' || iValue > 99999 )
+            return -1;
+
+        iValue = iValue * 10 + ( *pToken - '0' );
+    }
+
+    return iValue;
+}
+
+//One field definition line to its ISO8583_FieldFormat, and the bClass and
+//bLuhn of its ISO8583_FieldOp
+static int ParseField( char ** ppTokens, int iTokens, ISO8583_FieldFormat * pFmts, ISO8583_FieldOp * pOps )
+{
+    ISO8583_FieldFormat * pFmt;
+    int i, iFieldNo, iMax, iClass = -1, bDigits, bBinary, bAscii = 0, iPad = 0, iLuhn = -1;
+
+    if( iTokens < 4 )
+        return ISOENGINE_INVALID_FIELD_DATA;
+
+    iFieldNo = TokenNumber( ppTokens[ 0 ] );
+
+    if( iFieldNo < 2 || iFieldNo > ISO8583_MAXFIELD || pFmts[ iFieldNo - 1 ].bType != 0 )
+        return ISOENGINE_INVALID_FIELD_NO;
+
+    pFmt = &pFmts[ iFieldNo - 1 ];
+
+    for( i = 0; i < ( int )( sizeof( FieldTypes ) / sizeof( FieldTypes[ 0 ] ) ); i ++ )
+    {
+        if( strcmp( ppTokens[ 1 ], FieldTypes[ i ].pName ) == 0 )
+            iClass = FieldTypes[ i ].iClass;
+    }
+
+    if( iClass < 0 )
+        return ISOENGINE_INVALID_FIELD_DATA;
+
+    bDigits = iClass == ISO8583_CLASS_N || iClass == ISO8583_CLASS_Z;
+    bBinary = iClass == ISO8583_CLASS_ANY;
+
+    for( i = 4; i < iTokens; i ++ )
+    {
+        if( strcmp( ppTokens[ i ], "ascii" ) == 0 && bDigits )
+            bAscii = 1;
+        else if( strcmp( ppTokens[ i ], "pad=zero" ) == 0 )
+            iPad = 1;
+        else if( strcmp( ppTokens[ i ], "pad=space" ) == 0 )
+            iPad = 2;
+        else if( strcmp( ppTokens[ i ], "luhn" ) == 0 && bDigits )
+            iLuhn = 1;
+        else if( strcmp( ppTokens[ i ], "noluhn" ) == 0 )
+            iLuhn = 0;
+        else
+            return ISOENGINE_INVALID_FIELD_DATA;
+    }
+
+    if(( iMax = TokenNumber( ppTokens[ 3 ] ) ) <= 0 )
+        return ISOENGINE_INVALID_FIELD_LENGTH;
+
+    //The engine takes a 1 byte prefix up to 99 and 2 bytes above
+    if( strcmp( ppTokens[ 2 ], "LL" ) == 0 )
+    {
+        if( iMax > 99 )
+            return ISOENGINE_INVALID_FIELD_LENGTH;
+
+        pFmt->bType = ISO8583TYPE_VAR;
+    }
+    else if( strcmp( ppTokens[ 2 ], "LLL" ) == 0 )
+    {
+        if( iMax < 100 || iMax > 999 )
+            return ISOENGINE_INVALID_FIELD_LENGTH;
+
+        pFmt->bType = ISO8583TYPE_VAR;
+    }
+    else if( strcmp( ppTokens[ 2 ], "fixed" ) == 0 )
+    {
+        if( iMax > 999 || ( bBinary && iMax % 8 != 0 ) )
+            return ISOENGINE_INVALID_FIELD_LENGTH;
+
+        pFmt->bType = ISO8583TYPE_FIX;
+    }
+    else
+        return ISOENGINE_INVALID_FIELD_DATA;
+
+    //Padding only applies to fixed packed digits
+    if( iPad != 0 && ( !bDigits || bAscii || pFmt->bType != ISO8583TYPE_FIX ) )
+        return ISOENGINE_INVALID_FIELD_DATA;
+
+    //Fixed binary is BIN alone, as in SampleFldFmt: the engine takes the
+    //length of a BIN field in bits. Variable binary data is kept as it is,
+    //like ASC
+    if( bBinary && pFmt->bType == ISO8583TYPE_FIX )
+        pFmt->bType = ISO8583TYPE_BIN;
+    else if( bDigits && !bAscii )
+        pFmt->bType |= ISO8583TYPE_BCD | ( iPad == 1 ? ISO8583TYPE_DIGIT : 0 );
+    else
+        pFmt->bType |= ISO8583TYPE_ASC;
+
+    pFmt->iMaxLength = iMax;
+
+    //The PAN of a n field 2 is checked unless told otherwise
+    pOps[ iFieldNo - 1 ].bClass = ( unsigned char )iClass;
+    pOps[ iFieldNo - 1 ].bLuhn = ( unsigned char )( iLuhn < 0 ? iFieldNo == 2 && bDigits : iLuhn );
+    return ISOENGINE_OK;
+}
+
+//Identity of a definition file, changed by any write or replacement
+static int FileStamp( const char * pPath, SpecCacheEntry * pEntry )
+{
+    struct stat st;
+
+    if( stat( pPath, &st ) != 0 )
+        return -1;
+
+    pEntry->llFileSize = ( long long )st.st_size;
+    pEntry->llMtime = ( long long )st.st_mtime;
+    pEntry->llMtimeNs = ( long long )STAT_MTIME_NS( st );
+    return 0;
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583SpecFile_Parse
+ * DESCRIPTION:     Compile a spec from the text of a definition file
+ * PARAMETERS:      pText: definition text
+ *                  nLength: bytes of pText
+ *                  pSpec(out): spec context
+ *                  piLine(out): line of the error
+ * RETURN:          ISOENGINE_OK or <0 error
+ ---------------------------------------------------------------------------- */
+int ISO8583SpecFile_Parse( const char * pText, size_t nLength, ISO8583_Spec * pSpec, int * piLine )
+{
+    ISO8583_FieldFormat Fmts[ ISO8583_MAXFIELD ];
+    ISO8583_FieldOp Ops[ ISO8583_MAXFIELD ];
+    char cLine[ SPECFILE_MAXLINE ];
+    char * pTokens[ SPECFILE_MAXTOKENS ];
+    const char * pEnd = pText + nLength;
+    const char * pNext;
+    char * pComment;
+    int i, iTokens, iRet, iLine = 0, iHighLine = 0, iBitMode = ISO8583_BITMAP64;
+
+    memset( Fmts, 0, sizeof( Fmts ) );
+    memset( Ops, 0, sizeof( Ops ) );
+    Fmts[ 0 ].bType = ISO8583TYPE_BIN;
+    Fmts[ 0 ].iMaxLength = 64;
+    *piLine = 0;
+
+    for( ; pText < pEnd; pText = pNext )
+    {
+        iLine ++;
+
+        if(( pNext = ( const char * )memchr( pText, '\n', pEnd - pText ) ) == NULL )
+            pNext = pEnd;
+
+        if( pNext - pText >= SPECFILE_MAXLINE )
+        {
+            *piLine = iLine;
+            return ISOENGINE_INVALID_FIELD_DATA;
+        }
+
+        memcpy( cLine, pText, pNext - pText );
+        cLine[ pNext - pText ] = 0;
+
+        if( pNext < pEnd )
+            pNext ++;
+
+        if(( pComment = strchr( cLine, '#' ) ) != NULL )
+            *pComment = 0;
+
+        if(( iTokens = SplitLine( cLine, pTokens ) ) == 0 )
+            continue;
+
+        if( iTokens > 0 && strcmp( pTokens[ 0 ], "bitmap" ) == 0 )
+        {
+            if( iTokens == 2 && strcmp( pTokens[ 1 ], "64" ) == 0 )
+                iBitMode = ISO8583_BITMAP64;
+            else if( iTokens == 2 && strcmp( pTokens[ 1 ], "128" ) == 0 )
+                iBitMode = ISO8583_BITMAP128;
+            else if( iTokens == 2 && strcmp( pTokens[ 1 ], "auto" ) == 0 )
+                iBitMode = ISO8583_BITMAPAUTO;
+            else
+            {
+                *piLine = iLine;
+                return ISOENGINE_INVALID_FIELD_DATA;
+            }
+
+            continue;
+        }
+
+        iRet = iTokens < 0 ? ISOENGINE_INVALID_FIELD_DATA : ParseField( pTokens, iTokens, Fmts, Ops );
+
+        if( iRet != ISOENGINE_OK )
+        {
+            *piLine = iLine;
+            return iRet;
+        }
+
+        if( TokenNumber( pTokens[ 0 ] ) > ISO8583_PRIMARYFIELD && iHighLine == 0 )
+            iHighLine = iLine;
+    }
+
+    if( iBitMode == ISO8583_BITMAP64 && iHighLine != 0 )
+    {
+        *piLine = iHighLine;
+        return ISOENGINE_INVALID_FIELD_NO;
+    }
+
+    ISO8583Engine_InitFieldFormat( pSpec, ( ISO8583_BitMode )iBitMode, Fmts );
+
+    //Field 1, the secondary bitmap, has no line and stays binary
+    for( i = 1; i < pSpec->iMaxField; i ++ )
+    {
+        pSpec->Op[ i ].bClass = Ops[ i ].bClass;
+        pSpec->Op[ i ].bLuhn = Ops[ i ].bLuhn;
+    }
+
+    return ISOENGINE_OK;
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583SpecFile_Load
+ * DESCRIPTION:     ISO8583SpecFile_Parse of a definition file
+ * PARAMETERS:      pPath: definition file
+ *                  pSpec(out): spec context
+ *                  piLine(out): line of the error
+ * RETURN:          ISOENGINE_OK or <0 error
+ ---------------------------------------------------------------------------- */
+int ISO8583SpecFile_Load( const char * pPath, ISO8583_Spec * pSpec, int * piLine )
+{
+    char * pText;
+    long lSize;
+    FILE * fp;
+    int iRet = -1;
+
+    *piLine = 0;
+
+    if(( fp = fopen( pPath, "rb" ) ) == NULL )
+        return -1;
+
+    if( fseek( fp, 0, SEEK_END ) == 0 && ( lSize = ftell( fp ) ) >= 0 && fseek( fp, 0, SEEK_SET ) == 0
+        && ( pText = ( char * )malloc( lSize + 1 ) ) != NULL )
+    {
+        if( fread( pText, 1, lSize, fp ) == ( size_t )lSize )
+            iRet = ISO8583SpecFile_Parse( pText, lSize, pSpec, piLine );
+
+        free( pText );
+    }
+
+    fclose( fp );
+    return iRet;
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583SpecFile_WriteCache
+ * DESCRIPTION:     Write the compiled specs of iCount definition files to a
+ *                  cache file
+ * PARAMETERS:      pCachePath: cache file
+ *                  ppPaths: iCount definition files
+ *                  ppSpecs: iCount specs compiled from them
+ *                  iCount: number of specs
+ * RETURN:          ISOENGINE_OK, -1: a file could not be read or written
+ ---------------------------------------------------------------------------- */
+int ISO8583SpecFile_WriteCache( const char * pCachePath, const char * const * ppPaths, const ISO8583_Spec * const * ppSpecs, int iCount )
+{
+    static const byte cZero[ 64 ];
+    SpecCacheHeader Header;
+    SpecCacheEntry Entry;
+    char cTmpPath[ ISO8583_SPECFILE_MAXPATH + 16 ];
+    size_t nSpecOffset, nSpecSize = ALIGN64( sizeof( ISO8583_Spec ) );
+    FILE * fp;
+    int i, bOk;
+
+    if( iCount < 0 || strlen( pCachePath ) >= ISO8583_SPECFILE_MAXPATH )
+        return -1;
+
+    nSpecOffset = ALIGN64( sizeof( Header ) + iCount * sizeof( Entry ) );
+
+    memset( &Header, 0, sizeof( Header ) );
+    memcpy( Header.cMagic, SPECFILE_MAGIC, sizeof( Header.cMagic ) );
+    Header.uiVersion = SPECFILE_VERSION;
+    Header.uiSpecSize = sizeof( ISO8583_Spec );
+    Header.uiByteOrder = SPECFILE_BYTEORDER;
+    Header.uiCount = iCount;
+    Header.ullSize = nSpecOffset + iCount * nSpecSize;
+
+    sprintf( cTmpPath, "%s.%ld", pCachePath, ( long )getpid() );
+
+    if(( fp = fopen( cTmpPath, "wb" ) ) == NULL )
+        return -1;
+
+    bOk = fwrite( &Header, sizeof( Header ), 1, fp ) == 1;
+
+    for( i = 0; bOk && i < iCount; i ++ )
+    {
+        memset( &Entry, 0, sizeof( Entry ) );
+        bOk = strlen( ppPaths[ i ] ) < sizeof( Entry.cPath ) && FileStamp( ppPaths[ i ], &Entry ) == 0;
+        strncpy( Entry.cPath, ppPaths[ i ], sizeof( Entry.cPath ) - 1 );
+        Entry.ullOffset = nSpecOffset + i * nSpecSize;
+        bOk = bOk && fwrite( &Entry, sizeof( Entry ), 1, fp ) == 1;
+    }
+
+    if( bOk )
+        bOk = fwrite( cZero, 1, nSpecOffset - sizeof( Header ) - iCount * sizeof( Entry ), fp ) == nSpecOffset - sizeof( Header ) - iCount * sizeof( Entry );
+
+    for( i = 0; bOk && i < iCount; i ++ )
+    {
+        bOk = fwrite( ppSpecs[ i ], sizeof( ISO8583_Spec ), 1, fp ) == 1
+              && fwrite( cZero, 1, nSpecSize - sizeof( ISO8583_Spec ), fp ) == nSpecSize - sizeof( ISO8583_Spec );
+    }
+
+    if( fclose( fp ) != 0 || !bOk || rename( cTmpPath, pCachePath ) != 0 )
+    {
+        remove( cTmpPath );
+        return -1;
+    }
+
+    return ISOENGINE_OK;
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583SpecFile_OpenCache
+ * DESCRIPTION:     Map a cache file
+ * PARAMETERS:      pCache(out): mapped cache
+ *                  pCachePath: cache file
+ * RETURN:          ISOENGINE_OK, -1: no cache or not usable by this build
+ ---------------------------------------------------------------------------- */
+int ISO8583SpecFile_OpenCache( ISO8583_SpecCache * pCache, const char * pCachePath )
+{
+    const SpecCacheHeader * pHeader;
+    const SpecCacheEntry * pEntries;
+    struct stat st;
+    void * pMap;
+    size_t nSpecSize = ALIGN64( sizeof( ISO8583_Spec ) );
+    unsigned int i;
+    int fd;
+
+    memset( pCache, 0, sizeof( *pCache ) );
+
+    if(( fd = open( pCachePath, O_RDONLY ) ) < 0 )
+        return -1;
+
+    if( fstat( fd, &st ) != 0 || ( size_t )st.st_size < sizeof( SpecCacheHeader ) )
+    {
+        close( fd );
+        return -1;
+    }
+
+    pMap = mmap( NULL, ( size_t )st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    close( fd );
+
+    if( pMap == MAP_FAILED )
+        return -1;
+
+    pHeader = ( const SpecCacheHeader * )pMap;
+    pEntries = ( const SpecCacheEntry * )( pHeader + 1 );
+
+    if( memcmp( pHeader->cMagic, SPECFILE_MAGIC, sizeof( pHeader->cMagic ) ) != 0 || pHeader->uiVersion != SPECFILE_VERSION
+        || pHeader->uiSpecSize != sizeof( ISO8583_Spec ) || pHeader->uiByteOrder != SPECFILE_BYTEORDER
+        || pHeader->ullSize != ( unsigned long long )st.st_size
+        || pHeader->uiCount > ( st.st_size - sizeof( SpecCacheHeader ) ) / sizeof( SpecCacheEntry ) )
+    {
+        munmap( pMap, ( size_t )st.st_size );
+        return -1;
+    }
+
+    for( i = 0; i < pHeader->uiCount; i ++ )
+    {
+        if( pEntries[ i ].ullOffset % 64 != 0 || pEntries[ i ].ullOffset > pHeader->ullSize - nSpecSize
+            || pHeader->ullSize < nSpecSize || memchr( pEntries[ i ].cPath, 0, sizeof( pEntries[ i ].cPath ) ) == NULL )
+        {
+            munmap( pMap, ( size_t )st.st_size );
+            return -1;
+        }
+    }
+
+    pCache->pMap = ( const byte * )pMap;
+    pCache->nSize = ( size_t )st.st_size;
+    pCache->iCount = ( int )pHeader->uiCount;
+    return ISOENGINE_OK;
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583SpecFile_CacheLookup
+ * DESCRIPTION:     Find the compiled spec of a definition file in a cache
+ * PARAMETERS:      pCache: mapped cache
+ *                  pPath: definition file
+ * RETURN:          The spec, NULL when not in the cache or changed since
+ ---------------------------------------------------------------------------- */
+const ISO8583_Spec * ISO8583SpecFile_CacheLookup( const ISO8583_SpecCache * pCache, const char * pPath )
+{
+    const SpecCacheEntry * pEntries;
+    SpecCacheEntry Stamp;
+    int i;
+
+    if( pCache->pMap == NULL || FileStamp( pPath, &Stamp ) != 0 )
+        return NULL;
+
+    pEntries = ( const SpecCacheEntry * )( pCache->pMap + sizeof( SpecCacheHeader ) );
+
+    for( i = 0; i < pCache->iCount; i ++ )
+    {
+        if( strcmp( pEntries[ i ].cPath, pPath ) == 0 )
+        {
+            if( pEntries[ i ].llFileSize != Stamp.llFileSize || pEntries[ i ].llMtime != Stamp.llMtime
+                || pEntries[ i ].llMtimeNs != Stamp.llMtimeNs )
+                return NULL;
+
+            return ( const ISO8583_Spec * )( pCache->pMap + pEntries[ i ].ullOffset );
+        }
+    }
+
+    return NULL;
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583SpecFile_CloseCache
+ * DESCRIPTION:     Unmap a cache
+ * PARAMETERS:      pCache: mapped cache
+ * RETURN:          None.
+ ---------------------------------------------------------------------------- */
+void ISO8583SpecFile_CloseCache( ISO8583_SpecCache * pCache )
+{
+    if( pCache->pMap != NULL )
+        munmap(( void * )pCache->pMap, pCache->nSize );
+
+    free( pCache->pParsed );
+    memset( pCache, 0, sizeof( *pCache ) );
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583SpecFile_LoadAll
+ * DESCRIPTION:     Load iCount definition files through the cache
+ * PARAMETERS:      pCache(out): mapped cache
+ *                  pCachePath: cache file
+ *                  ppPaths: iCount definition files
+ *                  iCount: number of files
+ *                  ppSpecs(out): iCount specs
+ *                  piFailed(out): index of the file in error
+ *                  piLine(out): line of a parse error
+ * RETURN:          ISOENGINE_OK, ISO8583_SPECFILE_NOCACHE or <0 error
+ ---------------------------------------------------------------------------- */
+int ISO8583SpecFile_LoadAll( ISO8583_SpecCache * pCache, const char * pCachePath, const char * const * ppPaths, int iCount,
+                             const ISO8583_Spec ** ppSpecs, int * piFailed, int * piLine )
+{
+    ISO8583_Spec * pParsed;
+    int i, iRet = ISOENGINE_OK;
+
+    *piFailed = -1;
+    *piLine = 0;
+
+    if( ISO8583SpecFile_OpenCache( pCache, pCachePath ) == ISOENGINE_OK )
+    {
+        for( i = 0; i < iCount && ( ppSpecs[ i ] = ISO8583SpecFile_CacheLookup( pCache, ppPaths[ i ] ) ) != NULL; i ++ )
+            ;
+
+        if( i == iCount )
+            return ISOENGINE_OK;
+
+        ISO8583SpecFile_CloseCache( pCache );
+    }
+
+    //Some file is new or changed: parse them all and write the cache again
+    if(( pParsed = ( ISO8583_Spec * )calloc( iCount > 0 ? iCount : 1, sizeof( ISO8583_Spec ) ) ) == NULL )
+        return -1;
+
+    for( i = 0; i < iCount && iRet == ISOENGINE_OK; i ++ )
+    {
+        ppSpecs[ i ] = &pParsed[ i ];
+
+        if(( iRet = ISO8583SpecFile_Load( ppPaths[ i ], &pParsed[ i ], piLine ) ) != ISOENGINE_OK )
+            *piFailed = i;
+    }
+
+    if( iRet != ISOENGINE_OK )
+    {
+        free( pParsed );
+
+        for( i = 0; i < iCount; i ++ )
+            ppSpecs[ i ] = NULL;
+
+        return iRet;
+    }
+
+    if( ISO8583SpecFile_WriteCache( pCachePath, ppPaths, ppSpecs, iCount ) == ISOENGINE_OK
+        && ISO8583SpecFile_OpenCache( pCache, pCachePath ) == ISOENGINE_OK )
+    {
+        for( i = 0; i < iCount && ( ppSpecs[ i ] = ISO8583SpecFile_CacheLookup( pCache, ppPaths[ i ] ) ) != NULL; i ++ )
+            ;
+
+        if( i == iCount )
+        {
+            free( pParsed );
+            return ISOENGINE_OK;
+        }
+
+        ISO8583SpecFile_CloseCache( pCache );
+    }
+
+    //No usable cache, e.g. a read-only directory: serve the parsed specs
+    for( i = 0; i < iCount; i ++ )
+        ppSpecs[ i ] = &pParsed[ i ];
+
+    pCache->pParsed = pParsed;
+    return ISO8583_SPECFILE_NOCACHE;
+}
@@ -0,0 +1,172 @@
+/***************************************************************************
+* FILE NAME:    ISO8583SpecFile.H                                          *
+* MODULE NAME:  ISO8583Engine                                              *
+* PROGRAMMER:                                                              *
+* DESCRIPTION:  Specs loaded at run time from text definition files, and a *
+*               binary cache of the compiled ISO8583_Spec images that is   *
+*               mapped at start up instead of parsing every file again.    *
+*               Needs POSIX mmap / stat.                                   *
+*                                                                          *
+*               TEXT FORMAT, one definition per line, '#' starts a comment *
+*                 bitmap 64|128|auto  ISO8583_BitMode of the spec, 64 by   *
+*                                     default                              *
+*                 <field> <type> <length> <max> [options]                  *
+*               field:    2 - 128, field 1 is the secondary bitmap and     *
+*                         needs no line                                    *
+*               type:     n, z        digits, packed BCD                   *
+*                         a, an, ans, ns  characters, as they are          *
+*                         b           binary: fixed fields have <max> in   *
+*                                     bits, LL / LLL fields in bytes       *
+*               length:   fixed, LL (max 1 - 99) or LLL (max 100 - 999),   *
+*                         the prefix is BCD, its size follows from <max>   *
+*               options:  ascii       n / z digits one per byte, not       *
+*                                     packed                               *
+*                         pad=zero    fixed packed n: short values get     *
+*                                     leading zeros                        *
+*                         pad=space   fixed packed n: short values are     *
+*                                     padded on the right (default)        *
+*                         luhn        n / z: the last digit is a Luhn      *
+*                                     check digit, default for n field 2   *
+*                         noluhn      no Luhn check                        *
+*               The type is also the ISO8583_CharClass that                *
+*               ISO8583Engine_HexbufToIso8583Strict checks the field       *
+*               content against.                                           *
+*               Fields with no line have no format (0 bytes). Example:     *
+*                 bitmap 64                                                *
+*                 2   n   LL    19                                         *
+*                 4   n   fixed 12  pad=zero                               *
+*                 41  ans fixed 8                                          *
+*                 52  b   fixed 64                                         *
+*                 55  b   LLL   255                                        *
+*                                                                          *
+*               CACHE FORMAT, native byte order, only read by the build    *
+*               that wrote it: a header, one entry per spec file with its  *
+*               path, size and modification time, then the ISO8583_Spec    *
+*               images on 64 byte boundaries. A changed spec file, another *
+*               build or a damaged cache is detected and not used.         *
+* REVISION:                                                                *
+****************************************************************************/
+
+#ifndef _ISO8583SPECFILE_H
+#define _ISO8583SPECFILE_H
+
+#include <stddef.h>
+
+#include "ISO8583Engine.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ISO8583_SPECFILE_MAXPATH    256
+
+//Warning of ISO8583SpecFile_LoadAll: every spec parsed, the cache could not
+//be written or mapped and the specs are served from memory
+#define ISO8583_SPECFILE_NOCACHE    1
+
+//Mapped spec cache, see ISO8583SpecFile_OpenCache
+typedef struct
+{
+    const byte * pMap;
+    size_t nSize;
+    int iCount;             //specs in the cache
+    ISO8583_Spec * pParsed; //specs of ISO8583SpecFile_LoadAll when not cached
+} ISO8583_SpecCache;
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583SpecFile_Parse
+ * DESCRIPTION:     Compile a spec from the text of a definition file
+ * PARAMETERS:      pText: definition text, need not end with 0
+ *                  nLength: bytes of pText
+ *                  pSpec(out): spec context, see ISO8583Engine_InitFieldFormat
+ *                  piLine(out): line of the error, 0 when there is none
+ * RETURN:          ISOENGINE_OK
+ *                  ISOENGINE_INVALID_FIELD_NO: field number out of range or
+ *                                              defined twice
+ *                  ISOENGINE_INVALID_FIELD_LENGTH: bad length or maximum
+ *                  ISOENGINE_INVALID_FIELD_DATA: any other syntax error
+ ---------------------------------------------------------------------------- */
+int ISO8583SpecFile_Parse( const char * pText, size_t nLength, ISO8583_Spec * pSpec, int * piLine );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583SpecFile_Load
+ * DESCRIPTION:     ISO8583SpecFile_Parse of a definition file
+ * PARAMETERS:      pPath: definition file
+ *                  pSpec(out): spec context
+ *                  piLine(out): line of the error, 0 when there is none
+ * RETURN:          As for ISO8583SpecFile_Parse, -1: file not readable
+ ---------------------------------------------------------------------------- */
+int ISO8583SpecFile_Load( const char * pPath, ISO8583_Spec * pSpec, int * piLine );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583SpecFile_WriteCache
+ * DESCRIPTION:     Write the compiled specs of iCount definition files to a
+ *                  cache file. The file is written aside and renamed, so a
+ *                  process mapping the old cache keeps a consistent copy.
+ * PARAMETERS:      pCachePath: cache file
+ *                  ppPaths: iCount definition files, as passed to
+ *                           ISO8583SpecFile_CacheLookup later
+ *                  ppSpecs: iCount specs compiled from them
+ *                  iCount: number of specs
+ * RETURN:          ISOENGINE_OK, -1: a file could not be read or written
+ ---------------------------------------------------------------------------- */
+int ISO8583SpecFile_WriteCache( const char * pCachePath, const char * const * ppPaths, const ISO8583_Spec * const * ppSpecs, int iCount );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583SpecFile_OpenCache
+ * DESCRIPTION:     Map a cache file written by ISO8583SpecFile_WriteCache
+ * PARAMETERS:      pCache(out): mapped cache, ISO8583SpecFile_CloseCache
+ *                               when done
+ *                  pCachePath: cache file
+ * RETURN:          ISOENGINE_OK, -1: no cache or not usable by this build
+ ---------------------------------------------------------------------------- */
+int ISO8583SpecFile_OpenCache( ISO8583_SpecCache * pCache, const char * pCachePath );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583SpecFile_CacheLookup
+ * DESCRIPTION:     Find the compiled spec of a definition file in a cache
+ * PARAMETERS:      pCache: mapped cache
+ *                  pPath: definition file
+ * RETURN:          The spec, read-only and valid until the cache is closed,
+ *                  NULL when not in the cache or the file changed since
+ ---------------------------------------------------------------------------- */
+const ISO8583_Spec * ISO8583SpecFile_CacheLookup( const ISO8583_SpecCache * pCache, const char * pPath );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583SpecFile_CloseCache
+ * DESCRIPTION:     Unmap a cache, specs found in it are no longer valid
+ * PARAMETERS:      pCache: mapped cache
+ * RETURN:          None.
+ ---------------------------------------------------------------------------- */
+void ISO8583SpecFile_CloseCache( ISO8583_SpecCache * pCache );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583SpecFile_LoadAll
+ * DESCRIPTION:     Start up loading of iCount definition files: all specs
+ *                  come from the cache when it is current, otherwise every
+ *                  file is parsed and the cache written again and mapped.
+ *                  When the cache cannot be written, e.g. its directory is
+ *                  read-only, the parsed specs are kept in pCache instead.
+ * PARAMETERS:      pCache(out): mapped cache, ISO8583SpecFile_CloseCache
+ *                               when done
+ *                  pCachePath: cache file
+ *                  ppPaths: iCount definition files
+ *                  iCount: number of files
+ *                  ppSpecs(out): iCount specs, valid until the cache is
+ *                                closed, also with
+ *                                ISO8583_SPECFILE_NOCACHE
+ *                  piFailed(out): index of the file in error, -1 if none
+ *                  piLine(out): line of a parse error, 0 if none
+ * RETURN:          ISOENGINE_OK
+ *                  ISO8583_SPECFILE_NOCACHE: specs loaded, cache not written
+ *                  -1: file not readable or out of memory
+ *                  other <0: parse error, see ISO8583SpecFile_Parse
+ ---------------------------------------------------------------------------- */
+int ISO8583SpecFile_LoadAll( ISO8583_SpecCache * pCache, const char * pCachePath, const char * const * ppPaths, int iCount,
+                             const ISO8583_Spec ** ppSpecs, int * piFailed, int * piLine );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
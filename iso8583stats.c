@@ -0,0 +1,397 @@
+/***************************************************************************
+* FILE NAME:    ISO8583Stats.C                                             *
+* MODULE NAME:  ISO8583Engine                                              *
+* PROGRAMMER:                                                              *
+* DESCRIPTION:  Engine instrumentation, see ISO8583Stats.h                 *
+* REVISION:                                                                *
+****************************************************************************/
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ISO8583Engine.h"
+#include "ISO8583Stats.h"
+#include "ISO8583Bits.h"
+
+static const char * const OpNames[ ISO8583_STATS_OPS ] = { "setfield", "getfield", "pack", "unpack" };
+
+//Counters at the last ISO8583Stats_Reset
+static ISO8583_Stats StatsBase;
+
+#if defined( ISO8583_STATS )
+
+ISO8583_STATS_TLS ISO8583_StatsBlock * g_pIso8583Stats;
+
+//Blocks of all threads, pushed on first use and never removed
+static _Atomic( ISO8583_StatsBlock * ) pStatsBlocks;
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Stats_Attach
+ * DESCRIPTION:     Give the calling thread its counter block
+ * PARAMETERS:      None.
+ * RETURN:          The block. Out of memory the thread shares a block that
+ *                  is never summed, so counting goes on without effect.
+ ---------------------------------------------------------------------------- */
+ISO8583_StatsBlock * ISO8583Stats_Attach( void )
+{
+    static ISO8583_StatsBlock Discard;
+    ISO8583_StatsBlock * pBlock = ( ISO8583_StatsBlock * )calloc( 1, sizeof( ISO8583_StatsBlock ) );
+
+    if( pBlock == NULL )
+        return g_pIso8583Stats = &Discard;
+
+    pBlock->pNext = atomic_load( &pStatsBlocks );
+    while( !atomic_compare_exchange_weak( &pStatsBlocks, &pBlock->pNext, pBlock ) )
+        ;
+
+    return g_pIso8583Stats = pBlock;
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Stats_Now
+ * DESCRIPTION:     Monotonic clock for the latency histograms
+ * PARAMETERS:      None.
+ * RETURN:          ns, never 0
+ ---------------------------------------------------------------------------- */
+unsigned long long ISO8583Stats_Now( void )
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ( unsigned long long )ts.tv_sec * 1000000000ULL + ts.tv_nsec + 1;
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Stats_Time
+ * DESCRIPTION:     Add a sampled call to the histogram of iOp
+ * PARAMETERS:      pBlock: block of the calling thread
+ *                  iOp: ISO8583_StatsOp
+ *                  ullStart: ISO8583Stats_Begin time
+ * RETURN:          None.
+ ---------------------------------------------------------------------------- */
+void ISO8583Stats_Time( ISO8583_StatsBlock * pBlock, int iOp, unsigned long long ullStart )
+{
+    unsigned long long ullNs = ISO8583Stats_Now() - ullStart;
+    int iBucket = 0;
+
+    for( ; ullNs != 0 && iBucket < ISO8583_STATS_BUCKETS - 1; ullNs >>= 1 )
+        iBucket ++;
+
+    ISO8583Stats_Add( &pBlock->ullHistogram[ iOp ][ iBucket ], 1 );
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Stats_Message
+ * DESCRIPTION:     Count a packed or unpacked message
+ * PARAMETERS:      bPacked: 1 packed, 0 unpacked
+ *                  pMsgID: 4 ASC digits of the MTI
+ *                  nBytes: bytes of the RAW message
+ *                  pulBitmap: ISO8583_MAXFIELD / 64 bitmap words, fields are
+ *                             counted for unpacked messages only
+ * RETURN:          None.
+ ---------------------------------------------------------------------------- */
+void ISO8583Stats_Message( int bPacked, const unsigned char * pMsgID, size_t nBytes, const unsigned long long * pulBitmap )
+{
+    ISO8583_StatsBlock * pBlock = ISO8583Stats_Block();
+    unsigned long long ullBits;
+    unsigned int uiMti = 0, uiDigit;
+    int i;
+
+    //All 4 digits, 0200 and 1200 are counted apart; not an MTI goes to 0000
+    for( i = 0; i < 4; i ++ )
+    {
+        if(( uiDigit = pMsgID[ i ] - ( unsigned int )'0' ) > 9 )
+        {
+            uiMti = 0;
+            break;
+        }
+        uiMti = uiMti * 10 + uiDigit;
+    }
+
+    if( bPacked )
+    {
+        ISO8583Stats_Add( &pBlock->ullPacked[ uiMti ], 1 );
+        ISO8583Stats_Add( &pBlock->ullPackedBytes, nBytes );
+        return;
+    }
+
+    ISO8583Stats_Add( &pBlock->ullUnpacked[ uiMti ], 1 );
+    ISO8583Stats_Add( &pBlock->ullUnpackedBytes, nBytes );
+
+    for( i = 0; i < ISO8583_MAXFIELD / 64; i ++ )
+    {
+        for( ullBits = pulBitmap[ i ]; ullBits; ullBits &= ullBits - 1 )
+            ISO8583Stats_Add( &pBlock->ullFieldSeen[ ( i << 6 ) + ISO8583Bits_Ctz64( ullBits ) ], 1 );
+    }
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Stats_Error
+ * DESCRIPTION:     Count an error return
+ * PARAMETERS:      iRet: return code <0
+ *                  iFieldNo: field in error, 0 if none
+ * RETURN:          None.
+ ---------------------------------------------------------------------------- */
+void ISO8583Stats_Error( int iRet, int iFieldNo )
+{
+    ISO8583_StatsBlock * pBlock = ISO8583Stats_Block();
+
+    if( iFieldNo < 0 || iFieldNo > ISO8583_MAXFIELD )
+        iFieldNo = 0;
+
+    ISO8583Stats_Add( &pBlock->ullErrors[ ISO8583Stats_ErrorIndex( iRet ) ], 1 );
+    ISO8583Stats_Add( &pBlock->ullFieldErrors[ iFieldNo ], 1 );
+    atomic_store_explicit( &pBlock->ullLastError, (( unsigned long long )( unsigned int )iRet << 32 ) | ( unsigned int )iFieldNo, memory_order_relaxed );
+}
+
+//Sum n counters of a block into pSum
+static void SumCounters( unsigned long long * pSum, const atomic_ullong * pCounter, int n )
+{
+    int i;
+
+    for( i = 0; i < n; i ++ )
+        pSum[ i ] += atomic_load_explicit( &pCounter[ i ], memory_order_relaxed );
+}
+
+#endif
+
+//Sum of all thread blocks, not less the reset base
+static void SumBlocks( ISO8583_Stats * pStats )
+{
+#if defined( ISO8583_STATS )
+    ISO8583_StatsBlock * pBlock;
+    unsigned long long ullLast;
+#endif
+
+    memset( pStats, 0, sizeof( *pStats ) );
+
+#if defined( ISO8583_STATS )
+    for( pBlock = atomic_load( &pStatsBlocks ); pBlock != NULL; pBlock = pBlock->pNext )
+    {
+        SumCounters( pStats->ullPacked, pBlock->ullPacked, ISO8583_STATS_MTIS );
+        SumCounters( pStats->ullUnpacked, pBlock->ullUnpacked, ISO8583_STATS_MTIS );
+        SumCounters( &pStats->ullPackedBytes, &pBlock->ullPackedBytes, 1 );
+        SumCounters( &pStats->ullUnpackedBytes, &pBlock->ullUnpackedBytes, 1 );
+        SumCounters( pStats->ullFieldSeen, pBlock->ullFieldSeen, ISO8583_MAXFIELD );
+        SumCounters( pStats->ullErrors, pBlock->ullErrors, ISO8583_STATS_ERRORS );
+        SumCounters( pStats->ullFieldErrors, pBlock->ullFieldErrors, ISO8583_MAXFIELD + 1 );
+        SumCounters( pStats->ullCalls, pBlock->ullCalls, ISO8583_STATS_OPS );
+        SumCounters( pStats->ullHistogram[ 0 ], pBlock->ullHistogram[ 0 ], ISO8583_STATS_OPS * ISO8583_STATS_BUCKETS );
+
+        //Last error of any thread, threads are not ordered among themselves
+        ullLast = atomic_load_explicit( &pBlock->ullLastError, memory_order_relaxed );
+        if( ullLast != 0 && pStats->iLastError == 0 )
+        {
+            pStats->iLastError = ( int )( unsigned int )( ullLast >> 32 );
+            pStats->iLastErrorField = ( int )( unsigned int )ullLast;
+        }
+    }
+#endif
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Stats_Enabled
+ * DESCRIPTION:     Whether the library was built with ISO8583_STATS
+ * PARAMETERS:      None.
+ * RETURN:          1 or 0
+ ---------------------------------------------------------------------------- */
+int ISO8583Stats_Enabled( void )
+{
+#if defined( ISO8583_STATS )
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Stats_Snapshot
+ * DESCRIPTION:     Sum the counters of all threads less the reset base
+ * PARAMETERS:      pStats(out): counters
+ * RETURN:          None.
+ ---------------------------------------------------------------------------- */
+void ISO8583Stats_Snapshot( ISO8583_Stats * pStats )
+{
+    unsigned long long * pSum = ( unsigned long long * )pStats;
+    const unsigned long long * pBase = ( const unsigned long long * )&StatsBase;
+    size_t i;
+
+    SumBlocks( pStats );
+
+    //Every counter is an unsigned long long up to iLastError
+    for( i = 0; i < offsetof( ISO8583_Stats, iLastError ) / sizeof( unsigned long long ); i ++ )
+        pSum[ i ] -= pBase[ i ];
+
+    if( pStats->iLastError == StatsBase.iLastError && pStats->iLastErrorField == StatsBase.iLastErrorField
+        && StatsBase.iLastError != 0 )
+        pStats->iLastError = pStats->iLastErrorField = 0;
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Stats_Reset
+ * DESCRIPTION:     Keep the current sums as the base of later snapshots
+ * PARAMETERS:      None.
+ * RETURN:          None.
+ ---------------------------------------------------------------------------- */
+void ISO8583Stats_Reset( void )
+{
+    SumBlocks( &StatsBase );
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Stats_ErrorIndex
+ * DESCRIPTION:     Index of ISO8583_Stats.ullErrors for a return code
+ * PARAMETERS:      iRet: return code <0
+ * RETURN:          0 - 7: ISOENGINE_* from -100, 8 - 11: -1 to -4, 12: other
+ ---------------------------------------------------------------------------- */
+int ISO8583Stats_ErrorIndex( int iRet )
+{
+    if( iRet >= ISOENGINE_NOT_SET_FIELD_FMT && iRet <= ISOENGINE_TRUNCATED_MSG )
+        return iRet - ISOENGINE_NOT_SET_FIELD_FMT;
+
+    if( iRet >= -4 && iRet <= -1 )
+        return 7 - iRet;
+
+    return ISO8583_STATS_ERRORS - 1;
+}
+
+//Return code of an ISO8583_Stats.ullErrors index, 0 for "other"
+static int ErrorCode( int iIndex )
+{
+    if( iIndex <= ISOENGINE_TRUNCATED_MSG - ISOENGINE_NOT_SET_FIELD_FMT )
+        return ISOENGINE_NOT_SET_FIELD_FMT + iIndex;
+
+    if( iIndex < ISO8583_STATS_ERRORS - 1 )
+        return 7 - iIndex;
+
+    return 0;
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Stats_Percentile
+ * DESCRIPTION:     Latency of an operation at a percentile of the timed calls
+ * PARAMETERS:      pStats: counters
+ *                  iOp: ISO8583_StatsOp
+ *                  dPercent: 0 - 100
+ * RETURN:          Upper bound in ns of the bucket, 0 if nothing was timed
+ ---------------------------------------------------------------------------- */
+unsigned long long ISO8583Stats_Percentile( const ISO8583_Stats * pStats, int iOp, double dPercent )
+{
+    unsigned long long ullTotal = 0, ullSeen = 0;
+    int i;
+
+    for( i = 0; i < ISO8583_STATS_BUCKETS; i ++ )
+        ullTotal += pStats->ullHistogram[ iOp ][ i ];
+
+    if( ullTotal == 0 )
+        return 0;
+
+    for( i = 0; i < ISO8583_STATS_BUCKETS - 1; i ++ )
+    {
+        ullSeen += pStats->ullHistogram[ iOp ][ i ];
+        if( ullSeen * 100.0 >= dPercent * ullTotal )
+            break;
+    }
+
+    return ( 1ULL << i ) - 1;
+}
+
+//printf to the export buffer, *piLength stays past the end once it is full
+static void Append( char * pBuf, int iSize, int * piLength, const char * pFormat, ... )
+{
+    va_list Args;
+    int n;
+
+    if( *piLength >= iSize )
+        return;
+
+    va_start( Args, pFormat );
+    n = vsnprintf( pBuf + *piLength, iSize - *piLength, pFormat, Args );
+    va_end( Args );
+
+    *piLength += n < 0 ? iSize : n;
+}
+
+//"name":{"key":n,...} of the nonzero counters, keys from the index
+static void AppendCounters( char * pBuf, int iSize, int * piLength, const char * pName, const unsigned long long * pCounter,
+                            int n, const char * pKeyFormat, int iKeyBase )
+{
+    const char * pSep = "";
+    int i;
+
+    Append( pBuf, iSize, piLength, "\"%s\":{", pName );
+    for( i = 0; i < n; i ++ )
+    {
+        if( pCounter[ i ] == 0 )
+            continue;
+
+        Append( pBuf, iSize, piLength, pSep );
+        Append( pBuf, iSize, piLength, pKeyFormat, i + iKeyBase );
+        Append( pBuf, iSize, piLength, ":%llu", pCounter[ i ] );
+        pSep = ",";
+    }
+    Append( pBuf, iSize, piLength, "}," );
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Stats_Export
+ * DESCRIPTION:     Write counters as one JSON object
+ * PARAMETERS:      pStats: counters
+ *                  pBuf(out): text
+ *                  iSize: size of pBuf
+ * RETURN:          Length of the text
+ *                  ISOENGINE_TOO_SMALL_FIELD_BUF_SIZE: pBuf too small
+ ---------------------------------------------------------------------------- */
+int ISO8583Stats_Export( const ISO8583_Stats * pStats, char * pBuf, int iSize )
+{
+    const char * pSep = "";
+    int i, iOp, iLength = 0;
+
+    Append( pBuf, iSize, &iLength, "{" );
+    AppendCounters( pBuf, iSize, &iLength, "packed", pStats->ullPacked, ISO8583_STATS_MTIS, "\"%04d\"", 0 );
+    AppendCounters( pBuf, iSize, &iLength, "unpacked", pStats->ullUnpacked, ISO8583_STATS_MTIS, "\"%04d\"", 0 );
+    Append( pBuf, iSize, &iLength, "\"bytes\":{\"packed\":%llu,\"unpacked\":%llu},", pStats->ullPackedBytes, pStats->ullUnpackedBytes );
+    AppendCounters( pBuf, iSize, &iLength, "fields", pStats->ullFieldSeen, ISO8583_MAXFIELD, "\"%d\"", 1 );
+
+    Append( pBuf, iSize, &iLength, "\"errors\":{" );
+    for( i = 0; i < ISO8583_STATS_ERRORS; i ++ )
+    {
+        if( pStats->ullErrors[ i ] == 0 )
+            continue;
+
+        if( ErrorCode( i ) != 0 )
+            Append( pBuf, iSize, &iLength, "%s\"%d\":%llu", pSep, ErrorCode( i ), pStats->ullErrors[ i ] );
+        else
+            Append( pBuf, iSize, &iLength, "%s\"other\":%llu", pSep, pStats->ullErrors[ i ] );
+        pSep = ",";
+    }
+    Append( pBuf, iSize, &iLength, "}," );
+
+    AppendCounters( pBuf, iSize, &iLength, "errorfields", pStats->ullFieldErrors, ISO8583_MAXFIELD + 1, "\"%d\"", 0 );
+    Append( pBuf, iSize, &iLength, "\"lasterror\":{\"code\":%d,\"field\":%d},\"latency\":{", pStats->iLastError, pStats->iLastErrorField );
+
+    for( iOp = 0; iOp < ISO8583_STATS_OPS; iOp ++ )
+    {
+        Append( pBuf, iSize, &iLength, "%s\"%s\":{\"calls\":%llu,\"p50\":%llu,\"p99\":%llu,", iOp ? "," : "", OpNames[ iOp ],
+                pStats->ullCalls[ iOp ], ISO8583Stats_Percentile( pStats, iOp, 50 ), ISO8583Stats_Percentile( pStats, iOp, 99 ) );
+
+        //Buckets are keyed by their upper bound in ns
+        Append( pBuf, iSize, &iLength, "\"hist\":{" );
+        for( i = 0, pSep = ""; i < ISO8583_STATS_BUCKETS; i ++ )
+        {
+            if( pStats->ullHistogram[ iOp ][ i ] == 0 )
+                continue;
+
+            Append( pBuf, iSize, &iLength, "%s\"%llu\":%llu", pSep, ( 1ULL << i ) - 1, pStats->ullHistogram[ iOp ][ i ] );
+            pSep = ",";
+        }
+        Append( pBuf, iSize, &iLength, "}}" );
+    }
+
+    Append( pBuf, iSize, &iLength, "}}" );
+
+    return iLength < iSize ? iLength : ISOENGINE_TOO_SMALL_FIELD_BUF_SIZE;
+}
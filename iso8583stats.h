@@ -0,0 +1,218 @@
+/***************************************************************************
+* FILE NAME:    ISO8583Stats.H                                             *
+* MODULE NAME:  ISO8583Engine                                              *
+* PROGRAMMER:                                                              *
+* DESCRIPTION:  Optional instrumentation of the engine, built in when     *
+*               ISO8583_STATS is defined for the library build and         *
+*               compiled to nothing otherwise.                             *
+*               Every thread counts into its own block, no lock and no     *
+*               atomic read-modify-write on the hot path: messages packed  *
+*               and unpacked per MTI, bytes, field presence, errors per    *
+*               return code and per field. One call in                     *
+*               ISO8583_STATS_SAMPLE of SetField, GetField, pack and       *
+*               unpack is timed into a log2 latency histogram.             *
+*               ISO8583Stats_Snapshot sums the blocks of all threads that  *
+*               ever counted, a thread's block outlives the thread.        *
+*               Without ISO8583_STATS the snapshot API is still there and  *
+*               returns zeros.                                             *
+* REVISION:                                                                *
+****************************************************************************/
+
+#ifndef _ISO8583STATS_H
+#define _ISO8583STATS_H
+
+#include "ISO8583Engine.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//MTI counters are kept per 4 digit MTI, version digit included: index MTI
+#define ISO8583_STATS_MTIS      10000
+
+//Return codes with a counter: ISOENGINE_* from -100 up, then -1 to -4, then
+//any other negative code
+#define ISO8583_STATS_ERRORS    13
+
+//Latency histogram buckets, bucket b holds times of 2^(b-1) to 2^b - 1 ns
+#define ISO8583_STATS_BUCKETS   32
+
+//One call in ISO8583_STATS_SAMPLE is timed, a power of two
+#ifndef ISO8583_STATS_SAMPLE
+#define ISO8583_STATS_SAMPLE    64
+#endif
+
+//Timed operations
+typedef enum
+{
+    ISO8583_STATS_OP_SETFIELD = 0,
+    ISO8583_STATS_OP_GETFIELD,
+    ISO8583_STATS_OP_PACK,
+    ISO8583_STATS_OP_UNPACK,
+    ISO8583_STATS_OPS
+} ISO8583_StatsOp;
+
+//Counters summed over all threads, see ISO8583Stats_Snapshot
+typedef struct
+{
+    unsigned long long ullPacked[ ISO8583_STATS_MTIS ];       // messages per MTI
+    unsigned long long ullUnpacked[ ISO8583_STATS_MTIS ];
+    unsigned long long ullPackedBytes;
+    unsigned long long ullUnpackedBytes;
+    unsigned long long ullFieldSeen[ ISO8583_MAXFIELD ];      // unpacked messages with field i + 1
+    unsigned long long ullErrors[ ISO8583_STATS_ERRORS ];     // per ISO8583Stats_ErrorIndex
+    unsigned long long ullFieldErrors[ ISO8583_MAXFIELD + 1 ];// errors per field, 0: message ID / bitmap / none
+    unsigned long long ullCalls[ ISO8583_STATS_OPS ];         // all calls, timed or not
+    unsigned long long ullHistogram[ ISO8583_STATS_OPS ][ ISO8583_STATS_BUCKETS ];
+    int iLastError;                                         // return code of the last error counted, 0 if none
+    int iLastErrorField;                                    // its field
+} ISO8583_Stats;
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Stats_Enabled
+ * DESCRIPTION:     Whether the library was built with ISO8583_STATS
+ * PARAMETERS:      None.
+ * RETURN:          1: counting, 0: the snapshot is always zero
+ ---------------------------------------------------------------------------- */
+int ISO8583Stats_Enabled( void );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Stats_Snapshot
+ * DESCRIPTION:     Sum the counters of all threads since start up or the last
+ *                  ISO8583Stats_Reset. Threads keep counting meanwhile, so
+ *                  counters taken at the same time may differ by the calls
+ *                  in flight.
+ * PARAMETERS:      pStats(out): counters
+ * RETURN:          None.
+ ---------------------------------------------------------------------------- */
+void ISO8583Stats_Snapshot( ISO8583_Stats * pStats );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Stats_Reset
+ * DESCRIPTION:     Start counting from zero. The counters of the threads are
+ *                  not written, a snapshot taken now is kept and subtracted
+ *                  by later snapshots. Not to be called concurrently with
+ *                  ISO8583Stats_Snapshot.
+ * PARAMETERS:      None.
+ * RETURN:          None.
+ ---------------------------------------------------------------------------- */
+void ISO8583Stats_Reset( void );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Stats_ErrorIndex
+ * DESCRIPTION:     Index of ISO8583_Stats.ullErrors for a return code
+ * PARAMETERS:      iRet: return code <0
+ * RETURN:          0 - ISO8583_STATS_ERRORS - 1
+ ---------------------------------------------------------------------------- */
+int ISO8583Stats_ErrorIndex( int iRet );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Stats_Percentile
+ * DESCRIPTION:     Latency of an operation at a percentile of the timed calls
+ * PARAMETERS:      pStats: counters
+ *                  iOp: ISO8583_StatsOp
+ *                  dPercent: 0 - 100
+ * RETURN:          Upper bound in ns of the histogram bucket, 0 if no call
+ *                  was timed
+ ---------------------------------------------------------------------------- */
+unsigned long long ISO8583Stats_Percentile( const ISO8583_Stats * pStats, int iOp, double dPercent );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Stats_Export
+ * DESCRIPTION:     Write counters as one JSON object, counters that are zero
+ *                  are left out: {"packed":{"0200":n,...},"unpacked":{...},
+ *                  "bytes":{"packed":n,"unpacked":n},"fields":{"2":n,...},
+ *                  "errors":{"-93":n,...},"errorfields":{"35":n,...},
+ *                  "lasterror":{"code":n,"field":n},"latency":{"setfield":
+ *                  {"calls":n,"p50":ns,"p99":ns,"hist":{"64":n,...}},...}}
+ * PARAMETERS:      pStats: counters
+ *                  pBuf(out): text, ends with 0
+ *                  iSize: size of pBuf
+ * RETURN:          Length of the text
+ *                  ISOENGINE_TOO_SMALL_FIELD_BUF_SIZE: pBuf too small
+ ---------------------------------------------------------------------------- */
+int ISO8583Stats_Export( const ISO8583_Stats * pStats, char * pBuf, int iSize );
+
+/*-----------------------------------------------------------------------------
+ * Hooks used by the engine, not part of the API
+ *-----------------------------------------------------------------------------*/
+#if defined( ISO8583_STATS ) && !defined( __cplusplus )
+
+#include <stdatomic.h>
+
+#if defined( _MSC_VER )
+#define ISO8583_STATS_TLS       __declspec( thread )
+#else
+#define ISO8583_STATS_TLS       _Thread_local
+#endif
+
+//Counters of one thread. Only the owning thread writes them, with a relaxed
+//load and store that compile to plain instructions; snapshots read them
+//with relaxed loads.
+typedef struct ISO8583_StatsBlock
+{
+    atomic_ullong ullPacked[ ISO8583_STATS_MTIS ];
+    atomic_ullong ullUnpacked[ ISO8583_STATS_MTIS ];
+    atomic_ullong ullPackedBytes;
+    atomic_ullong ullUnpackedBytes;
+    atomic_ullong ullFieldSeen[ ISO8583_MAXFIELD ];
+    atomic_ullong ullErrors[ ISO8583_STATS_ERRORS ];
+    atomic_ullong ullFieldErrors[ ISO8583_MAXFIELD + 1 ];
+    atomic_ullong ullCalls[ ISO8583_STATS_OPS ];
+    atomic_ullong ullHistogram[ ISO8583_STATS_OPS ][ ISO8583_STATS_BUCKETS ];
+    atomic_ullong ullLastError;                             // code << 32 | field
+    struct ISO8583_StatsBlock * pNext;
+} ISO8583_StatsBlock;
+
+extern ISO8583_STATS_TLS ISO8583_StatsBlock * g_pIso8583Stats;
+
+ISO8583_StatsBlock * ISO8583Stats_Attach( void );
+unsigned long long ISO8583Stats_Now( void );
+void ISO8583Stats_Time( ISO8583_StatsBlock * pBlock, int iOp, unsigned long long ullStart );
+void ISO8583Stats_Message( int bPacked, const unsigned char * pMsgID, size_t nBytes, const unsigned long long * pulBitmap );
+void ISO8583Stats_Error( int iRet, int iFieldNo );
+
+//Single writer counter increment
+static inline void ISO8583Stats_Add( atomic_ullong * pCounter, unsigned long long n )
+{
+    atomic_store_explicit( pCounter, atomic_load_explicit( pCounter, memory_order_relaxed ) + n, memory_order_relaxed );
+}
+
+static inline ISO8583_StatsBlock * ISO8583Stats_Block( void )
+{
+    ISO8583_StatsBlock * pBlock = g_pIso8583Stats;
+
+    return pBlock != NULL ? pBlock : ISO8583Stats_Attach();
+}
+
+//Count a call of iOp, the start time when this one is sampled, else 0
+static inline unsigned long long ISO8583Stats_Begin( int iOp )
+{
+    ISO8583_StatsBlock * pBlock = ISO8583Stats_Block();
+    unsigned long long ullCalls = atomic_load_explicit( &pBlock->ullCalls[ iOp ], memory_order_relaxed );
+
+    atomic_store_explicit( &pBlock->ullCalls[ iOp ], ullCalls + 1, memory_order_relaxed );
+    return ( ullCalls & ( ISO8583_STATS_SAMPLE - 1 ) ) == 0 ? ISO8583Stats_Now() : 0;
+}
+
+#define ISO8583_STATS_BEGIN( iOp )      unsigned long long ullStatsStart = ISO8583Stats_Begin( iOp )
+#define ISO8583_STATS_END( iOp )        (( void )( ullStatsStart != 0 ? ISO8583Stats_Time( g_pIso8583Stats, iOp, ullStatsStart ), 0 : 0 ))
+#define ISO8583_STATS_PACKED( pMsgID, nBytes, pulBitmap )   ISO8583Stats_Message( 1, pMsgID, nBytes, pulBitmap )
+#define ISO8583_STATS_UNPACKED( pMsgID, nBytes, pulBitmap ) ISO8583Stats_Message( 0, pMsgID, nBytes, pulBitmap )
+#define ISO8583_STATS_ERROR( iRet, iFieldNo )               ISO8583Stats_Error( iRet, iFieldNo )
+
+#else
+
+#define ISO8583_STATS_BEGIN( iOp )
+#define ISO8583_STATS_END( iOp )                            (( void )0 )
+#define ISO8583_STATS_PACKED( pMsgID, nBytes, pulBitmap )   (( void )0 )
+#define ISO8583_STATS_UNPACKED( pMsgID, nBytes, pulBitmap ) (( void )0 )
+#define ISO8583_STATS_ERROR( iRet, iFieldNo )               (( void )0 )
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
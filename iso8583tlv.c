@@ -0,0 +1,546 @@
+/***************************************************************************
+* FILE NAME:    ISO8583Tlv.C                                               *
+* MODULE NAME:  ISO8583Engine                                              *
+* PROGRAMMER:                                                              *
+* DESCRIPTION:  BER-TLV index and builder, see ISO8583Tlv.h                *
+* REVISION:                                                                *
+****************************************************************************/
+
+#include <string.h>
+
+#include "ISO8583Engine.h"
+#include "ISO8583Bits.h"
+#include "ISO8583Tlv.h"
+
+//First tag byte: the value holds data objects
+#define TLV_CONSTRUCTED     0x20
+
+//First tag byte: more tag bytes follow, each but the last with bit 8 set
+#define TLV_TAGMORE         0x1F
+
+/*-----------------------------------------------------------------------------
+ * Internal functions
+ *-----------------------------------------------------------------------------*/
+
+//Read the tag at pRpt, at most iLength bytes, bytes of the tag or <0
+static int ReadTag( const byte * pRpt, int iLength, unsigned int * puiTag )
+{
+    unsigned int uiTag = pRpt[ 0 ];
+    int i = 1;
+
+    if(( uiTag & TLV_TAGMORE ) == TLV_TAGMORE )
+    {
+        do
+        {
+            if( i >= iLength )
+                return ISOENGINE_TRUNCATED_MSG;
+
+            if( i == 4 )
+                return ISOENGINE_INVALID_FIELD_DATA;
+
+            uiTag = ( uiTag << 8 ) | pRpt[ i ];
+        } while( pRpt[ i ++ ] & 0x80 );
+    }
+
+    *puiTag = uiTag;
+    return i;
+}
+
+//Read the length at pRpt, at most iLength bytes, bytes of the length or <0
+static int ReadLength( const byte * pRpt, int iLength, int * piValue )
+{
+    int i, iBytes;
+
+    if( iLength < 1 )
+        return ISOENGINE_TRUNCATED_MSG;
+
+    if( pRpt[ 0 ] < 0x80 )
+    {
+        *piValue = pRpt[ 0 ];
+        return 1;
+    }
+
+    //0x80 is the indefinite form, not used in EMV data
+    iBytes = pRpt[ 0 ] & 0x7F;
+
+    if( iBytes == 0 || iBytes > 3 )
+        return ISOENGINE_INVALID_FIELD_DATA;
+
+    if( iBytes >= iLength )
+        return ISOENGINE_TRUNCATED_MSG;
+
+    for( *piValue = 0, i = 1; i <= iBytes; i ++ )
+        *piValue = ( *piValue << 8 ) | pRpt[ i ];
+
+    return iBytes + 1;
+}
+
+//Bytes of the tag uiTag
+static int TagSize( unsigned int uiTag )
+{
+    return uiTag > 0xFFFFFF ? 4 : uiTag > 0xFFFF ? 3 : uiTag > 0xFF ? 2 : 1;
+}
+
+//Bytes of a value length iLength
+static int LengthSize( int iLength )
+{
+    return iLength < 0x80 ? 1 : iLength <= 0xFF ? 2 : iLength <= 0xFFFF ? 3 : 4;
+}
+
+//Write the length iLength in iSize bytes at pWpt
+static void WriteLength( byte * pWpt, int iLength, int iSize )
+{
+    int i;
+
+    if( iSize == 1 )
+    {
+        pWpt[ 0 ] = ( byte )iLength;
+        return;
+    }
+
+    pWpt[ 0 ] = ( byte )( 0x80 | ( iSize - 1 ) );
+
+    for( i = iSize - 1; i > 0; i --, iLength >>= 8 )
+        pWpt[ i ] = ( byte )iLength;
+}
+
+//Write the tag uiTag and the length iLength, iReserve bytes are left for the
+//value. Where the value goes or NULL.
+static byte * PutHeader( ISO8583_TlvBuilder * pBuilder, unsigned int uiTag, int iLength, int iReserve )
+{
+    int i, iTagSize, iLengthSize;
+    byte * pWpt;
+
+    if( pBuilder->iError != ISOENGINE_OK )
+        return NULL;
+
+    if( uiTag == 0 || iLength < 0 || iLength > 0xFFFFFF )
+    {
+        pBuilder->iError = ISOENGINE_INVALID_FIELD_DATA;
+        return NULL;
+    }
+
+    iTagSize = TagSize( uiTag );
+    iLengthSize = LengthSize( iLength );
+
+    if( pBuilder->iCapacity - pBuilder->iLength < iTagSize + iLengthSize + iReserve )
+    {
+        pBuilder->iError = ISOENGINE_OVER_MAXLENGTH;
+        return NULL;
+    }
+
+    pWpt = pBuilder->pBuf + pBuilder->iLength;
+
+    for( i = iTagSize - 1; i >= 0; i --, uiTag >>= 8 )
+        pWpt[ i ] = ( byte )uiTag;
+
+    WriteLength( pWpt + iTagSize, iLength, iLengthSize );
+    pBuilder->iLength += iTagSize + iLengthSize + iReserve;
+
+    return pWpt + iTagSize + iLengthSize;
+}
+
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Tlv_Parse
+ * DESCRIPTION:     Index the data objects of a buffer in place. A constructed
+ *                  object below ISO8583_TLV_MAXDEPTH levels is indexed as a
+ *                  primitive one. On error the index is left empty.
+ * PARAMETERS:      pIndex(out): index, refers to pBuf
+ *                  pBuf: BER-TLV data
+ *                  iLength: bytes of pBuf
+ * RETURN:          >=0: number of items
+ *                  ISOENGINE_INVALID_FIELD_DATA: bad tag or length
+ *                  ISOENGINE_TRUNCATED_MSG: a data object runs past its end
+ *                  ISOENGINE_TOO_SMALL_FIELD_BUF_SIZE: too many items
+ ---------------------------------------------------------------------------- */
+int ISO8583Tlv_Parse( ISO8583_TlvIndex * pIndex, const byte * pBuf, int iLength )
+{
+    int iEnd[ ISO8583_TLV_MAXDEPTH + 1 ], iParent[ ISO8583_TLV_MAXDEPTH + 1 ];
+    int iDepth = 0, iPos = 0, iCount = 0, iRet, iValue, bTwo;
+    ISO8583_TlvItem * pItem;
+    unsigned int uiTag;
+    byte bFirst, bNext;
+
+    pIndex->pBuf = pBuf;
+    pIndex->iLength = iLength;
+    pIndex->iCount = 0;
+
+    iEnd[ 0 ] = iLength;
+    iParent[ 0 ] = -1;
+
+    for( ;; )
+    {
+        while( iDepth > 0 && iPos >= iEnd[ iDepth ] )
+            iDepth --;
+
+        if( iPos >= iLength )
+            break;
+
+        bFirst = pBuf[ iPos ];
+
+        //Padding between data objects
+        if( bFirst == 0x00 )
+        {
+            iPos ++;
+            continue;
+        }
+
+        //Tags of 1 or 2 bytes with a short length are read from the next 3
+        //bytes, loaded together and picked without branches: the tag size
+        //varies from one object to the next in EMV data. A 2 byte tag ends
+        //when bit 8 of its second byte is clear.
+        bTwo = ( bFirst & TLV_TAGMORE ) == TLV_TAGMORE;
+
+        if( iEnd[ iDepth ] - iPos >= 3 )
+        {
+            bNext = pBuf[ iPos + 1 ];
+            iValue = bTwo ? pBuf[ iPos + 2 ] : bNext;
+        }
+        else
+            bNext = iValue = 0x80;
+
+        if( iValue < 0x80 && !( bTwo && ( bNext & 0x80 ) ) )
+        {
+            uiTag = bTwo ? ( unsigned int )bFirst << 8 | bNext : bFirst;
+            iPos += 2 + bTwo;
+        }
+        else
+        {
+            iRet = ReadTag( pBuf + iPos, iEnd[ iDepth ] - iPos, &uiTag );
+
+            if( iRet < 0 )
+                return iRet;
+
+            iPos += iRet;
+            iRet = ReadLength( pBuf + iPos, iEnd[ iDepth ] - iPos, &iValue );
+
+            if( iRet < 0 )
+                return iRet;
+
+            iPos += iRet;
+        }
+
+        if( iValue > iEnd[ iDepth ] - iPos )
+            return ISOENGINE_TRUNCATED_MSG;
+
+        if( iCount == ISO8583_TLV_MAXITEMS )
+            return ISOENGINE_TOO_SMALL_FIELD_BUF_SIZE;
+
+        pItem = &pIndex->Item[ iCount ];
+        pItem->uiTag = uiTag;
+        pItem->iOffset = iPos;
+        pItem->iLength = iValue;
+        pItem->iParent = ( short )iParent[ iDepth ];
+        pItem->bConstructed = 0;
+
+        if(( bFirst & TLV_CONSTRUCTED ) && iDepth < ISO8583_TLV_MAXDEPTH )
+        {
+            pItem->bConstructed = 1;
+            iDepth ++;
+            iEnd[ iDepth ] = iPos + iValue;
+            iParent[ iDepth ] = iCount;
+        }
+        else
+            iPos += iValue;
+
+        iCount ++;
+    }
+
+    pIndex->iCount = iCount;
+    return iCount;
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Tlv_ParseView
+ * DESCRIPTION:     ISO8583Tlv_Parse of a field inside a viewed message
+ * PARAMETERS:      pIndex(out): index, refers to the viewed buffer
+ *                  pSpec: spec context
+ *                  pView: opened or parsed view
+ *                  iFieldNo: Field No
+ * RETURN:          As for ISO8583Tlv_Parse, 0 when the field is not present
+ *                  ISOENGINE_INVALID_FIELD_DATA: packed BCD field
+ *                  other <0: see ISO8583Engine_ViewFieldPtr
+ ---------------------------------------------------------------------------- */
+int ISO8583Tlv_ParseView( ISO8583_TlvIndex * pIndex, const ISO8583_Spec * pSpec, ISO8583_View * pView, int iFieldNo )
+{
+    const byte * pData = NULL;
+    int iLength;
+
+    iLength = ISO8583Engine_ViewFieldPtr( pSpec, pView, iFieldNo, &pData );
+
+    if( iLength < 0 )
+        return iLength;
+
+    if( iLength > 0 && pSpec->Op[ iFieldNo - 1 ].bPacked )
+        return ISOENGINE_INVALID_FIELD_DATA;
+
+    return ISO8583Tlv_Parse( pIndex, pData, iLength );
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Tlv_ParseRec
+ * DESCRIPTION:     ISO8583Tlv_Parse of a field of a record
+ * PARAMETERS:      pIndex(out): index, refers to the record data
+ *                  pSpec: spec context
+ *                  pIso8583Data: ISO8583 data struct
+ *                  iFieldNo: Field No
+ * RETURN:          As for ISO8583Tlv_ParseView
+ ---------------------------------------------------------------------------- */
+int ISO8583Tlv_ParseRec( ISO8583_TlvIndex * pIndex, const ISO8583_Spec * pSpec, const ISO8583_Rec * pIso8583Data, int iFieldNo )
+{
+    const ISO8583_ElementFlag * pField;
+
+    if( iFieldNo <= 1 || iFieldNo > pSpec->iMaxField )
+        return ISOENGINE_INVALID_FIELD_NO;
+
+    if( !ISO8583_BITMAP_TEST( pIso8583Data->ulBitmap, iFieldNo - 1 ) )
+        return ISO8583Tlv_Parse( pIndex, NULL, 0 );
+
+    if( pSpec->Op[ iFieldNo - 1 ].bPacked )
+        return ISOENGINE_INVALID_FIELD_DATA;
+
+    pField = &pIso8583Data->Field[ iFieldNo - 1 ];
+
+    if( pField->addr < 0 || pField->len < 0 || pField->addr + pField->len > pIso8583Data->iCapacity )
+        return ISOENGINE_OVER_MAXLENGTH;
+
+    return ISO8583Tlv_Parse( pIndex, pIso8583Data->cData + pField->addr, pField->len );
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Tlv_Find
+ * DESCRIPTION:     Find a tag at any level, from item iFrom on
+ * PARAMETERS:      pIndex: index
+ *                  uiTag: tag
+ *                  iFrom: first item to look at
+ * RETURN:          >=0: item of the tag, -1 if not found
+ ---------------------------------------------------------------------------- */
+int ISO8583Tlv_Find( const ISO8583_TlvIndex * pIndex, unsigned int uiTag, int iFrom )
+{
+    int i;
+
+    for( i = iFrom < 0 ? 0 : iFrom; i < pIndex->iCount; i ++ )
+    {
+        if( pIndex->Item[ i ].uiTag == uiTag )
+            return i;
+    }
+
+    return -1;
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Tlv_Value
+ * DESCRIPTION:     Locate the value of the first data object with a tag
+ * PARAMETERS:      pIndex: index
+ *                  uiTag: tag
+ *                  ppValue(out): value inside the indexed buffer
+ * RETURN:          >=0: value bytes, -1 if not found
+ ---------------------------------------------------------------------------- */
+int ISO8583Tlv_Value( const ISO8583_TlvIndex * pIndex, unsigned int uiTag, const byte ** ppValue )
+{
+    int i = ISO8583Tlv_Find( pIndex, uiTag, 0 );
+
+    if( i < 0 )
+        return -1;
+
+    *ppValue = pIndex->pBuf + pIndex->Item[ i ].iOffset;
+    return pIndex->Item[ i ].iLength;
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Tlv_InitBuilder
+ * DESCRIPTION:     Start writing data objects to a buffer
+ * PARAMETERS:      pBuilder(out): builder
+ *                  pBuf: output buffer
+ *                  iCapacity: bytes of pBuf
+ * RETURN:          None.
+ ---------------------------------------------------------------------------- */
+void ISO8583Tlv_InitBuilder( ISO8583_TlvBuilder * pBuilder, byte * pBuf, int iCapacity )
+{
+    pBuilder->pBuf = pBuf;
+    pBuilder->iCapacity = iCapacity;
+    pBuilder->iLength = 0;
+    pBuilder->iError = ISOENGINE_OK;
+    pBuilder->iDepth = 0;
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Tlv_Place
+ * DESCRIPTION:     Write the tag and length of a primitive data object and
+ *                  leave its value to the caller
+ * PARAMETERS:      pBuilder: builder
+ *                  uiTag: tag
+ *                  iLength: value bytes
+ * RETURN:          Where the value goes, NULL on error
+ ---------------------------------------------------------------------------- */
+byte * ISO8583Tlv_Place( ISO8583_TlvBuilder * pBuilder, unsigned int uiTag, int iLength )
+{
+    return PutHeader( pBuilder, uiTag, iLength, iLength );
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Tlv_Put
+ * DESCRIPTION:     Write a primitive data object
+ * PARAMETERS:      pBuilder: builder
+ *                  uiTag: tag
+ *                  pValue: value
+ *                  iLength: value bytes
+ * RETURN:          ISOENGINE_OK or the sticky error
+ ---------------------------------------------------------------------------- */
+int ISO8583Tlv_Put( ISO8583_TlvBuilder * pBuilder, unsigned int uiTag, const byte * pValue, int iLength )
+{
+    byte * pWpt = PutHeader( pBuilder, uiTag, iLength, iLength );
+
+    if( pWpt != NULL )
+        memcpy( pWpt, pValue, iLength );
+
+    return pBuilder->iError;
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Tlv_PutBcd
+ * DESCRIPTION:     Write a numeric data object as packed BCD
+ * PARAMETERS:      pBuilder: builder
+ *                  uiTag: tag
+ *                  ullValue: value
+ *                  iLength: value bytes, 1 - 10
+ * RETURN:          ISOENGINE_OK or the sticky error
+ ---------------------------------------------------------------------------- */
+int ISO8583Tlv_PutBcd( ISO8583_TlvBuilder * pBuilder, unsigned int uiTag, unsigned long long ullValue, int iLength )
+{
+    byte * pWpt;
+
+    if( pBuilder->iError == ISOENGINE_OK && ( iLength < 1 || iLength > 10 ) )
+        pBuilder->iError = ISOENGINE_INVALID_FIELD_LENGTH;
+
+    pWpt = PutHeader( pBuilder, uiTag, iLength, iLength );
+
+    if( pWpt != NULL && ISO8583Utils_U642BCD( ullValue, pWpt, iLength * 2 ) != 0 )
+        pBuilder->iError = ISOENGINE_TOO_LONG_FILED_LENGTH;
+
+    return pBuilder->iError;
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Tlv_Open
+ * DESCRIPTION:     Start a constructed data object. Its length is written
+ *                  in short form for now and widened by ISO8583Tlv_Close.
+ * PARAMETERS:      pBuilder: builder
+ *                  uiTag: tag, constructed
+ * RETURN:          ISOENGINE_OK or the sticky error
+ ---------------------------------------------------------------------------- */
+int ISO8583Tlv_Open( ISO8583_TlvBuilder * pBuilder, unsigned int uiTag )
+{
+    byte * pWpt;
+
+    if( pBuilder->iError == ISOENGINE_OK
+        && ( pBuilder->iDepth == ISO8583_TLV_MAXDEPTH || !( uiTag >> ( 8 * ( TagSize( uiTag ) - 1 ) ) & TLV_CONSTRUCTED ) ) )
+        pBuilder->iError = ISOENGINE_INVALID_FIELD_DATA;
+
+    pWpt = PutHeader( pBuilder, uiTag, 0, 0 );
+
+    if( pWpt != NULL )
+        pBuilder->iOpen[ pBuilder->iDepth ++ ] = ( int )( pWpt - pBuilder->pBuf );
+
+    return pBuilder->iError;
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Tlv_Close
+ * DESCRIPTION:     End the constructed data object opened last, its value
+ *                  moves up when the length needs the long form
+ * PARAMETERS:      pBuilder: builder
+ * RETURN:          ISOENGINE_OK or the sticky error
+ ---------------------------------------------------------------------------- */
+int ISO8583Tlv_Close( ISO8583_TlvBuilder * pBuilder )
+{
+    int iValue, iLength, iExtra;
+
+    if( pBuilder->iError != ISOENGINE_OK )
+        return pBuilder->iError;
+
+    if( pBuilder->iDepth == 0 )
+        return pBuilder->iError = ISOENGINE_INVALID_FIELD_DATA;
+
+    iValue = pBuilder->iOpen[ -- pBuilder->iDepth ];
+    iLength = pBuilder->iLength - iValue;
+    iExtra = LengthSize( iLength ) - 1;
+
+    if( iExtra > 0 )
+    {
+        if( pBuilder->iCapacity - pBuilder->iLength < iExtra )
+            return pBuilder->iError = ISOENGINE_OVER_MAXLENGTH;
+
+        memmove( pBuilder->pBuf + iValue + iExtra, pBuilder->pBuf + iValue, iLength );
+        pBuilder->iLength += iExtra;
+    }
+
+    WriteLength( pBuilder->pBuf + iValue - 1, iLength, iExtra + 1 );
+    return ISOENGINE_OK;
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Tlv_Finish
+ * DESCRIPTION:     End writing
+ * PARAMETERS:      pBuilder: builder
+ * RETURN:          >=0: bytes written, <0: the sticky error
+ ---------------------------------------------------------------------------- */
+int ISO8583Tlv_Finish( ISO8583_TlvBuilder * pBuilder )
+{
+    if( pBuilder->iError == ISOENGINE_OK && pBuilder->iDepth != 0 )
+        pBuilder->iError = ISOENGINE_INVALID_FIELD_DATA;
+
+    if( pBuilder->iError != ISOENGINE_OK )
+        return pBuilder->iError;
+
+    return pBuilder->iLength;
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Tlv_BuildField
+ * DESCRIPTION:     Start writing data objects straight into a record field
+ * PARAMETERS:      pBuilder(out): builder
+ *                  pSpec: spec context
+ *                  pIso8583Data: ISO8583 data struct
+ *                  iFieldNo: Field No
+ *                  iCapacity: bytes to reserve for the field
+ * RETURN:          ISOENGINE_OK or <0 as for ISO8583Engine_ReserveField
+ ---------------------------------------------------------------------------- */
+int ISO8583Tlv_BuildField( ISO8583_TlvBuilder * pBuilder, const ISO8583_Spec * pSpec, ISO8583_Rec * pIso8583Data, int iFieldNo, int iCapacity )
+{
+    byte * pData = NULL;
+    int iRet;
+
+    iRet = ISO8583Engine_ReserveField( pSpec, pIso8583Data, iFieldNo, iCapacity, &pData );
+    ISO8583Tlv_InitBuilder( pBuilder, pData, iRet > 0 ? iRet : 0 );
+
+    if( iRet < 0 )
+        return pBuilder->iError = iRet;
+
+    return ISOENGINE_OK;
+}
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Tlv_CommitField
+ * DESCRIPTION:     ISO8583Tlv_Finish of a builder on a record field and set
+ *                  the field length, the field is cleared when empty or on
+ *                  error
+ * PARAMETERS:      pBuilder: builder from ISO8583Tlv_BuildField
+ *                  pSpec: spec context
+ *                  pIso8583Data: ISO8583 data struct
+ *                  iFieldNo: Field No
+ * RETURN:          >=0: field bytes, <0 error
+ ---------------------------------------------------------------------------- */
+int ISO8583Tlv_CommitField( ISO8583_TlvBuilder * pBuilder, const ISO8583_Spec * pSpec, ISO8583_Rec * pIso8583Data, int iFieldNo )
+{
+    int iLength = ISO8583Tlv_Finish( pBuilder );
+
+    if( iLength > 0 )
+        iLength = ISO8583Engine_CommitField( pSpec, pIso8583Data, iFieldNo, iLength ) == ISOENGINE_OK ? iLength : ISOENGINE_INVALID_FIELD_LENGTH;
+
+    if( iLength <= 0 )
+        ISO8583Engine_ClearOneField( pIso8583Data, iFieldNo );
+
+    return iLength;
+}
@@ -0,0 +1,246 @@
+/***************************************************************************
+* FILE NAME:    ISO8583Tlv.H                                               *
+* MODULE NAME:  ISO8583Engine                                              *
+* PROGRAMMER:                                                              *
+* DESCRIPTION:  BER-TLV subfields of composite fields such as field 55     *
+*               (ICC data, EMV tags) or private fields 48 / 60 - 63.       *
+*               ISO8583_TlvIndex indexes the data objects of a field in    *
+*               place, nothing is copied, constructed objects are indexed  *
+*               down to ISO8583_TLV_MAXDEPTH levels. ISO8583_TlvBuilder    *
+*               writes data objects straight into a buffer, e.g. the data  *
+*               of a record field reserved with ISO8583Engine_ReserveField.*
+*               Tags are kept as their bytes read big endian: 9F26 is      *
+*               0x9F26, 95 is 0x95. Tags of up to 4 bytes and lengths in   *
+*               short form or long form of up to 3 bytes are handled.      *
+*               00 bytes between data objects are skipped as padding.      *
+* REVISION:                                                                *
+****************************************************************************/
+
+#ifndef _ISO8583TLV_H
+#define _ISO8583TLV_H
+
+#include "ISO8583Engine.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//Most data objects of an ISO8583_TlvIndex
+#define ISO8583_TLV_MAXITEMS    64
+
+//Most levels of constructed data objects indexed or built
+#define ISO8583_TLV_MAXDEPTH    4
+
+//EMV tags commonly looked up in field 55
+#define ISO8583_TAG_AC          0x9F26  // Application Cryptogram
+#define ISO8583_TAG_CID         0x9F27  // Cryptogram Information Data
+#define ISO8583_TAG_IAD         0x9F10  // Issuer Application Data
+#define ISO8583_TAG_UN          0x9F37  // Unpredictable Number
+#define ISO8583_TAG_ATC         0x9F36  // Application Transaction Counter
+#define ISO8583_TAG_TVR         0x95    // Terminal Verification Results
+#define ISO8583_TAG_TXNDATE     0x9A    // Transaction Date
+#define ISO8583_TAG_TXNTYPE     0x9C    // Transaction Type
+#define ISO8583_TAG_AMOUNT      0x9F02  // Amount, Authorised
+#define ISO8583_TAG_AIP         0x82    // Application Interchange Profile
+
+//One data object of an ISO8583_TlvIndex
+typedef struct
+{
+    unsigned int uiTag;
+    int iOffset;            // value offset in the indexed buffer
+    int iLength;            // value bytes
+    short iParent;          // item of the enclosing constructed object, -1 if none
+    short bConstructed;     // the value holds data objects, indexed after this item
+} ISO8583_TlvItem;
+
+//Data objects of a buffer in the order they appear, see ISO8583Tlv_Parse
+typedef struct
+{
+    const byte * pBuf;
+    int iLength;
+    int iCount;             // items indexed
+    ISO8583_TlvItem Item[ ISO8583_TLV_MAXITEMS ];
+} ISO8583_TlvIndex;
+
+//Data objects written to a buffer, see ISO8583Tlv_InitBuilder. An error is
+//kept in iError and every later call does nothing, so a run of puts can be
+//checked once at ISO8583Tlv_Finish.
+typedef struct
+{
+    byte * pBuf;
+    int iCapacity;
+    int iLength;            // bytes written
+    int iError;             // sticky error, ISOENGINE_OK if none
+    int iDepth;             // constructed objects open
+    int iOpen[ ISO8583_TLV_MAXDEPTH ];  // value offset of each open object
+} ISO8583_TlvBuilder;
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Tlv_Parse
+ * DESCRIPTION:     Index the data objects of a buffer in place
+ * PARAMETERS:      pIndex(out): index, refers to pBuf
+ *                  pBuf: BER-TLV data
+ *                  iLength: bytes of pBuf
+ * RETURN:          >=0: number of items
+ *                  ISOENGINE_INVALID_FIELD_DATA: bad tag or length
+ *                  ISOENGINE_TRUNCATED_MSG: a data object runs past its end
+ *                  ISOENGINE_TOO_SMALL_FIELD_BUF_SIZE: more than
+ *                                                      ISO8583_TLV_MAXITEMS
+ ---------------------------------------------------------------------------- */
+int ISO8583Tlv_Parse( ISO8583_TlvIndex * pIndex, const byte * pBuf, int iLength );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Tlv_ParseView
+ * DESCRIPTION:     ISO8583Tlv_Parse of a field inside a viewed message
+ * PARAMETERS:      pIndex(out): index, refers to the viewed buffer
+ *                  pSpec: spec context
+ *                  pView: opened or parsed view
+ *                  iFieldNo: Field No
+ * RETURN:          As for ISO8583Tlv_Parse, 0 when the field is not present
+ *                  ISOENGINE_INVALID_FIELD_DATA: packed BCD field
+ *                  other <0: see ISO8583Engine_ViewFieldPtr
+ ---------------------------------------------------------------------------- */
+int ISO8583Tlv_ParseView( ISO8583_TlvIndex * pIndex, const ISO8583_Spec * pSpec, ISO8583_View * pView, int iFieldNo );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Tlv_ParseRec
+ * DESCRIPTION:     ISO8583Tlv_Parse of a field of a record
+ * PARAMETERS:      pIndex(out): index, refers to the record data until the
+ *                               record is changed
+ *                  pSpec: spec context
+ *                  pIsoRec: ISO8583 data struct
+ *                  iFieldNo: Field No
+ * RETURN:          As for ISO8583Tlv_ParseView
+ ---------------------------------------------------------------------------- */
+int ISO8583Tlv_ParseRec( ISO8583_TlvIndex * pIndex, const ISO8583_Spec * pSpec, const ISO8583_Rec * pIsoRec, int iFieldNo );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Tlv_Find
+ * DESCRIPTION:     Find a tag at any level, from item iFrom on
+ * PARAMETERS:      pIndex: index
+ *                  uiTag: tag
+ *                  iFrom: first item to look at, 0 or the last item found + 1
+ * RETURN:          >=0: item of the tag, -1 if not found
+ ---------------------------------------------------------------------------- */
+int ISO8583Tlv_Find( const ISO8583_TlvIndex * pIndex, unsigned int uiTag, int iFrom );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Tlv_Value
+ * DESCRIPTION:     Locate the value of the first data object with a tag
+ * PARAMETERS:      pIndex: index
+ *                  uiTag: tag
+ *                  ppValue(out): value inside the indexed buffer
+ * RETURN:          >=0: value bytes, -1 if not found
+ ---------------------------------------------------------------------------- */
+int ISO8583Tlv_Value( const ISO8583_TlvIndex * pIndex, unsigned int uiTag, const byte ** ppValue );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Tlv_InitBuilder
+ * DESCRIPTION:     Start writing data objects to a buffer
+ * PARAMETERS:      pBuilder(out): builder
+ *                  pBuf: output buffer
+ *                  iCapacity: bytes of pBuf
+ * RETURN:          None.
+ ---------------------------------------------------------------------------- */
+void ISO8583Tlv_InitBuilder( ISO8583_TlvBuilder * pBuilder, byte * pBuf, int iCapacity );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Tlv_Place
+ * DESCRIPTION:     Write the tag and length of a primitive data object and
+ *                  leave its value to the caller
+ * PARAMETERS:      pBuilder: builder
+ *                  uiTag: tag
+ *                  iLength: value bytes
+ * RETURN:          Where the value goes, NULL on error, see iError
+ ---------------------------------------------------------------------------- */
+byte * ISO8583Tlv_Place( ISO8583_TlvBuilder * pBuilder, unsigned int uiTag, int iLength );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Tlv_Put
+ * DESCRIPTION:     Write a primitive data object
+ * PARAMETERS:      pBuilder: builder
+ *                  uiTag: tag
+ *                  pValue: value
+ *                  iLength: value bytes
+ * RETURN:          ISOENGINE_OK or the sticky error, see ISO8583Tlv_Finish
+ ---------------------------------------------------------------------------- */
+int ISO8583Tlv_Put( ISO8583_TlvBuilder * pBuilder, unsigned int uiTag, const byte * pValue, int iLength );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Tlv_PutBcd
+ * DESCRIPTION:     Write a numeric (n) data object, e.g. 9F02 or 9A, as
+ *                  iLength bytes of packed BCD with leading zeros
+ * PARAMETERS:      pBuilder: builder
+ *                  uiTag: tag
+ *                  ullValue: value
+ *                  iLength: value bytes, 1 - 10
+ * RETURN:          ISOENGINE_OK or the sticky error,
+ *                  ISOENGINE_TOO_LONG_FILED_LENGTH: more digits than iLength
+ ---------------------------------------------------------------------------- */
+int ISO8583Tlv_PutBcd( ISO8583_TlvBuilder * pBuilder, unsigned int uiTag, unsigned long long ullValue, int iLength );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Tlv_Open
+ * DESCRIPTION:     Start a constructed data object, e.g. 71 or 72, the data
+ *                  objects written until ISO8583Tlv_Close make its value
+ * PARAMETERS:      pBuilder: builder
+ *                  uiTag: tag, constructed
+ * RETURN:          ISOENGINE_OK or the sticky error,
+ *                  ISOENGINE_INVALID_FIELD_DATA: tag not constructed or more
+ *                  than ISO8583_TLV_MAXDEPTH open
+ ---------------------------------------------------------------------------- */
+int ISO8583Tlv_Open( ISO8583_TlvBuilder * pBuilder, unsigned int uiTag );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Tlv_Close
+ * DESCRIPTION:     End the constructed data object opened last and write its
+ *                  length
+ * PARAMETERS:      pBuilder: builder
+ * RETURN:          ISOENGINE_OK or the sticky error
+ ---------------------------------------------------------------------------- */
+int ISO8583Tlv_Close( ISO8583_TlvBuilder * pBuilder );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Tlv_Finish
+ * DESCRIPTION:     End writing
+ * PARAMETERS:      pBuilder: builder
+ * RETURN:          >=0: bytes written
+ *                  ISOENGINE_OVER_MAXLENGTH: the buffer was too small
+ *                  ISOENGINE_INVALID_FIELD_DATA: bad tag or length, or a
+ *                  constructed data object not closed
+ ---------------------------------------------------------------------------- */
+int ISO8583Tlv_Finish( ISO8583_TlvBuilder * pBuilder );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Tlv_BuildField
+ * DESCRIPTION:     Start writing data objects straight into a record field,
+ *                  see ISO8583Engine_ReserveField. No other field of the
+ *                  record may be set or cleared until ISO8583Tlv_CommitField.
+ * PARAMETERS:      pBuilder(out): builder
+ *                  pSpec: spec context
+ *                  pIsoRec: ISO8583 data struct
+ *                  iFieldNo: Field No
+ *                  iCapacity: bytes to reserve for the field
+ * RETURN:          ISOENGINE_OK or <0 as for ISO8583Engine_ReserveField
+ ---------------------------------------------------------------------------- */
+int ISO8583Tlv_BuildField( ISO8583_TlvBuilder * pBuilder, const ISO8583_Spec * pSpec, ISO8583_Rec * pIsoRec, int iFieldNo, int iCapacity );
+
+/* -----------------------------------------------------------------------------
+ * FUNCTION NAME:   ISO8583Tlv_CommitField
+ * DESCRIPTION:     ISO8583Tlv_Finish of a builder on a record field and set
+ *                  the field length. The field is cleared when nothing was
+ *                  written or on error.
+ * PARAMETERS:      pBuilder: builder from ISO8583Tlv_BuildField
+ *                  pSpec: spec context
+ *                  pIsoRec: ISO8583 data struct
+ *                  iFieldNo: Field No
+ * RETURN:          >=0: field bytes
+ *                  <0: as for ISO8583Tlv_Finish or ISO8583Engine_CommitField
+ ---------------------------------------------------------------------------- */
+int ISO8583Tlv_CommitField( ISO8583_TlvBuilder * pBuilder, const ISO8583_Spec * pSpec, ISO8583_Rec * pIsoRec, int iFieldNo );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,71 @@
+/***************************************************************************
+* FILE NAME:    ColumnTest.C                                               *
+* MODULE NAME:  ISO8583Engine tests                                        *
+* PROGRAMMER:                                                              *
+* DESCRIPTION:  ISO8583Column_AddMessage of truncated messages adds no     *
+*               row, also when the highest column field is absent and the  *
+*               damage is in a lower one; a whole message still adds one.  *
+* REVISION:                                                                *
+****************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "ISO8583Engine.h"
+#include "ISO8583Column.h"
+#include "SampleFmt.h"
+
+static int iFailed = 0;
+
+static void Check( int bOk, const char * pWhat )
+{
+    if( !bOk )
+    {
+        printf( "FAILED: %s\n", pWhat );
+        iFailed ++;
+    }
+}
+
+//Message 0200 with field 2 and, when bAmount, field 4
+static int BuildMessage( const ISO8583_Spec * pSpec, int bAmount, unsigned char * pBuf, int iSize )
+{
+    ISO8583_FixRec Rec;
+    ISO8583_Rec * pRec = ISO8583Engine_InitFixRec( &Rec );
+
+    ISO8583Engine_SetField( pSpec, pRec, 0, ( unsigned char * )"0200", 4 );
+    ISO8583Engine_SetField( pSpec, pRec, 2, ( unsigned char * )"4111111111111111", 16 );
+
+    if( bAmount )
+        ISO8583Engine_SetField( pSpec, pRec, 4, ( unsigned char * )"000000001000", 12 );
+
+    return ISO8583Engine_Iso8583ToHexbuf( pSpec, pRec, pBuf, iSize );
+}
+
+int main( void )
+{
+    static ISO8583_Spec Spec;
+    static ISO8583_ColumnSet Set;
+    ISO8583_ColumnDef Defs[ 2 ];
+    unsigned char cBuf[ 256 ];
+    int iLength;
+
+    ISO8583Engine_InitFieldFormat( &Spec, ISO8583_BITMAP64, SampleFldFmt );
+    ISO8583Column_DefaultDef( &Spec, 2, &Defs[ 0 ] );
+    ISO8583Column_DefaultDef( &Spec, 4, &Defs[ 1 ] );
+    Check( ISO8583Column_Init( &Set, &Spec, Defs, 2, 16 ) == ISOENGINE_OK, "init" );
+
+    //field 4, the highest column field, is absent and field 2 is cut
+    iLength = BuildMessage( &Spec, 0, cBuf, sizeof( cBuf ) );
+    Check( ISO8583Column_AddMessage( &Set, cBuf, iLength - 3 ) < 0, "cut field 2, no field 4: error" );
+    Check( Set.iRows == 0, "cut field 2, no field 4: no row" );
+
+    //field 4 itself is cut
+    iLength = BuildMessage( &Spec, 1, cBuf, sizeof( cBuf ) );
+    Check( ISO8583Column_AddMessage( &Set, cBuf, iLength - 3 ) < 0, "cut field 4: error" );
+    Check( Set.iRows == 0, "cut field 4: no row" );
+
+    Check( ISO8583Column_AddMessage( &Set, cBuf, iLength ) == 1, "whole message: one row" );
+
+    ISO8583Column_Free( &Set );
+    return iFailed != 0;
+}
@@ -0,0 +1,68 @@
+/***************************************************************************
+* FILE NAME:    SpecFileTest.C                                             *
+* MODULE NAME:  ISO8583Engine tests                                        *
+* PROGRAMMER:                                                              *
+* DESCRIPTION:  A spec with a fixed binary field, parsed by                *
+*               ISO8583SpecFile_Parse, must encode and decode a message    *
+*               to the same fields: the binary field takes its length in   *
+*               bits and the fields behind it are read where they were     *
+*               written.                                                   *
+* REVISION:                                                                *
+****************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "ISO8583Engine.h"
+#include "ISO8583SpecFile.h"
+
+static const char SpecText[] =
+    "bitmap 64\n"
+    "2   n   LL    19\n"
+    "4   n   fixed 12  pad=zero\n"
+    "41  ans fixed 8\n"
+    "52  b   fixed 64\n"
+    "55  b   LLL   255\n";
+
+static int iFailed = 0;
+
+static void Check( int bOk, const char * pWhat )
+{
+    if( !bOk )
+    {
+        printf( "FAILED: %s\n", pWhat );
+        iFailed ++;
+    }
+}
+
+int main( void )
+{
+    static const unsigned char cPin[ 8 ] = { 0x12, 0x34, 0x56, 0x78, 0x9A, 0xBC, 0xDE, 0xF0 };
+    static const unsigned char cChip[ 5 ] = { 0x9F, 0x26, 0x02, 0xAB, 0xCD };
+    static ISO8583_Spec Spec;
+    ISO8583_FixRec Out, In;
+    ISO8583_Rec * pOut = ISO8583Engine_InitFixRec( &Out ), * pIn = ISO8583Engine_InitFixRec( &In );
+    unsigned char cBuf[ 512 ], cField[ 300 ];
+    int iLine, iLength;
+
+    Check( ISO8583SpecFile_Parse( SpecText, sizeof( SpecText ) - 1, &Spec, &iLine ) == ISOENGINE_OK, "parse" );
+    Check( Spec.FldFormat[ 51 ].bType == ISO8583TYPE_BIN && Spec.FldFormat[ 51 ].iMaxLength == 64, "field 52 is BIN of 64 bits" );
+
+    ISO8583Engine_SetField( &Spec, pOut, 0, ( unsigned char * )"0200", 4 );
+    ISO8583Engine_SetField( &Spec, pOut, 2, ( unsigned char * )"4111111111111111", 16 );
+    ISO8583Engine_SetField( &Spec, pOut, 4, ( unsigned char * )"000000001000", 12 );
+    ISO8583Engine_SetField( &Spec, pOut, 41, ( unsigned char * )"TERM0001", 8 );
+    ISO8583Engine_SetField( &Spec, pOut, 52, ( unsigned char * )cPin, sizeof( cPin ) );
+    ISO8583Engine_SetField( &Spec, pOut, 55, ( unsigned char * )cChip, sizeof( cChip ) );
+
+    //2 MTI + 8 bitmap + 1 + 8 PAN + 6 amount + 8 TID + 8 PIN + 2 + 5 chip
+    iLength = ISO8583Engine_Iso8583ToHexbuf( &Spec, pOut, cBuf, sizeof( cBuf ) );
+    Check( iLength == 48, "encoded length" );
+
+    Check( ISO8583Engine_HexbufToIso8583Len( &Spec, pIn, cBuf, iLength ) == ISOENGINE_OK, "decode" );
+    Check( ISO8583Engine_GetField( &Spec, pIn, 52, cField, sizeof( cField ) ) == 8 && memcmp( cField, cPin, 8 ) == 0, "field 52" );
+    Check( ISO8583Engine_GetField( &Spec, pIn, 55, cField, sizeof( cField ) ) == 5 && memcmp( cField, cChip, 5 ) == 0, "field 55" );
+    Check( ISO8583Engine_GetField( &Spec, pIn, 41, cField, sizeof( cField ) ) == 8 && memcmp( cField, "TERM0001", 8 ) == 0, "field 41" );
+
+    return iFailed != 0;
+}
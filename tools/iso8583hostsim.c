@@ -0,0 +1,934 @@
+/***************************************************************************
+* FILE NAME:    ISO8583HostSim.C                                           *
+* MODULE NAME:  ISO8583Engine tools                                        *
+* PROGRAMMER:                                                              *
+* DESCRIPTION:  Acquirer / issuer host simulator for load tests (Linux).   *
+*               One worker thread per core, each with its own listening    *
+*               socket on the same port (SO_REUSEPORT, the kernel spreads  *
+*               the connections), its own edge triggered epoll loop and    *
+*               its own copy of the spec, record pool, connections and     *
+*               delay queue: workers share nothing but their counters,     *
+*               which only the main thread reads.                          *
+*               Every request is framed with ISO8583Framer, decoded with   *
+*               ISO8583Engine_HexbufToIso8583Len and matched against the   *
+*               response rules, the response is built from the request    *
+*               with ISO8583Engine_Transform: MTI function digit + 1,      *
+*               field 39 set, field 38 set on approvals, fields 35, 36,    *
+*               45 and 52 removed. Responses of one read are written       *
+*               together.                                                  *
+* USAGE:        iso8583hostsim [options]                                   *
+*               -p 5000             port, default 5000                     *
+*               -w 4                worker threads, default one per core   *
+*               -m 0200,0800        request MTIs answered, default         *
+*                                   0200,0800; others are counted only     *
+*               -c 00               field 39 when no rule matches          *
+*               -r rule             response rule, repeatable, the first   *
+*                                   matching rule is used:                 *
+*                                   match:action[,action]                  *
+*                                   match: * or MTI, then ,N=value for     *
+*                                   field N, value* matches a prefix       *
+*                                   action: rc=05 (field 39),              *
+*                                   delay=ms or delay=min-max (uniform),   *
+*                                   drop=percent (no response),            *
+*                                   close (close the connection)           *
+*                                   e.g. -r '0200,3=31*:rc=00,delay=5-50'  *
+*                                        -r '0200,41=TERM0009:drop=10'     *
+*               -i 5                print counters every 5 seconds         *
+*               -L bin|bcd|asc      length prefix format, default bin      *
+*               -n 2                length prefix bytes, default 2         *
+*               -I                  length counts the prefix itself        *
+*               -H 5                header bytes after the prefix, a 5     *
+*                                   byte header is answered as a TPDU      *
+*               -s dialect.spec     field formats from a definition file   *
+*                                   (ISO8583SpecFile.H), default the       *
+*                                   sample formats                         *
+*               SIGINT / SIGTERM stop the simulator and print the totals.  *
+* REVISION:                                                                *
+****************************************************************************/
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include "ISO8583Engine.h"
+#include "ISO8583Framer.h"
+#include "ISO8583Pool.h"
+#include "ISO8583SpecFile.h"
+#include "SampleFmt.h"
+
+//Largest request accepted, without prefix and header
+#define SIM_MAXMESSAGE          4096
+
+//Receive buffer of a connection, room for a few pipelined requests
+#define SIM_INBUF               ( 4 * SIM_MAXMESSAGE )
+
+//Responses waiting for the socket, a connection that lets more pile up is
+//closed as a slow reader
+#define SIM_OUTBUF              ( 16 * SIM_MAXMESSAGE )
+
+//Prefix (at most 9 ASCII digits) and header of a response
+#define SIM_MAXFRAMING          64
+
+#define SIM_MAXRULES            64
+#define SIM_MAXMATCH            8
+#define SIM_MAXVALUE            64
+#define SIM_MAXMTIS             16
+#define SIM_EVENTS              256
+#define SIM_BACKLOG             4096
+
+enum
+{
+    SIM_REQUESTS = 0,       // requests decoded
+    SIM_RESPONSES,          // responses sent or queued
+    SIM_DELAYED,            // responses held by a delay rule
+    SIM_DROPPED,            // requests dropped by a rule
+    SIM_IGNORED,            // requests with an MTI not answered
+    SIM_BAD,                // frames the engine could not decode
+    SIM_ACCEPTED,           // connections accepted
+    SIM_CLOSED,             // connections closed
+    SIM_COUNTERS,
+};
+
+static const char * const CounterNames[ SIM_COUNTERS ] =
+    { "requests", "responses", "delayed", "dropped", "ignored", "bad", "accepted", "closed" };
+
+typedef struct
+{
+    int iFieldNo;
+    int iLength;
+    int bPrefix;                    // value* matches a prefix
+    unsigned char cValue[ SIM_MAXVALUE ];
+} SimMatch;
+
+typedef struct
+{
+    char cMti[ 5 ];                 // "" matches any MTI
+    SimMatch Match[ SIM_MAXMATCH ];
+    int iMatches;
+    char cRc[ 3 ];                  // "" keeps the default
+    unsigned int uiDelayMin;        // us
+    unsigned int uiDelayMax;
+    unsigned int uiDrop;            // per 10000 requests
+    int bClose;
+} SimRule;
+
+typedef struct
+{
+    ISO8583_FramerCfg Cfg;
+    ISO8583_Spec Spec;
+    int iPort;
+    char cMtis[ SIM_MAXMTIS ][ 5 ];
+    int iMtis;
+    char cDefaultRc[ 3 ];
+    SimRule Rules[ SIM_MAXRULES ];
+    int iRules;
+} SimOpt;
+
+//One terminal connection, owned by one worker
+typedef struct SimConn
+{
+    int fd;
+    unsigned int uiGen;             // bumped on close, delayed responses check it
+    ISO8583_Framer Framer;
+    byte * pIn;
+    byte * pOut;
+    int iOutHead;
+    int iOutTail;
+    struct SimConn * pNextFree;
+} SimConn;
+
+//Response held back by a delay rule
+typedef struct
+{
+    unsigned long long ullDue;      // ns
+    SimConn * pConn;
+    unsigned int uiGen;
+    int iLength;
+    byte * pData;
+} SimPending;
+
+//Worker state, private to the worker thread but for the counters
+typedef struct
+{
+    _Alignas( 64 ) atomic_ulong ulCounters[ SIM_COUNTERS ];
+    _Alignas( 64 ) int iId;
+    pthread_t Thread;
+    const SimOpt * pOpt;
+    ISO8583_Spec Spec;
+    ISO8583_Pool * pPool;
+    ISO8583_Rec * pRec;
+    int iEpoll;
+    int iListen;
+    unsigned long long ullRandom;
+    unsigned long ulAuth;
+    SimConn * pFree;
+    SimPending * pHeap;             // min-heap on ullDue
+    int iPending;
+    int iMaxPending;
+    byte cReply[ SIM_MAXFRAMING + SIM_MAXMESSAGE ];
+} SimWorker;
+
+static volatile sig_atomic_t g_bStop;
+
+static void Usage( void )
+{
+    fprintf( stderr, "usage: iso8583hostsim [-p port] [-w workers] [-m mtis] [-c rc] [-r rule]... [-i seconds]\n"
+                     "                      [-L bin|bcd|asc] [-n prefix bytes] [-I] [-H header bytes] [-s spec-file]\n"
+                     "rule:  match:action[,action]   match: *|MTI[,N=value[*]]...\n"
+                     "       action: rc=XX | delay=ms[-ms] | drop=percent | close\n" );
+    exit( 2 );
+}
+
+static void OnSignal( int iSig )
+{
+    ( void )iSig;
+    g_bStop = 1;
+}
+
+static unsigned long long NowNs( void )
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ( unsigned long long )ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+//Counter of one worker, written by that worker only
+static void Count( SimWorker * pWorker, int iCounter )
+{
+    atomic_store_explicit( &pWorker->ulCounters[ iCounter ],
+                           atomic_load_explicit( &pWorker->ulCounters[ iCounter ], memory_order_relaxed ) + 1, memory_order_relaxed );
+}
+
+//xorshift64*, per worker
+static unsigned int Random( SimWorker * pWorker )
+{
+    pWorker->ullRandom ^= pWorker->ullRandom >> 12;
+    pWorker->ullRandom ^= pWorker->ullRandom << 25;
+    pWorker->ullRandom ^= pWorker->ullRandom >> 27;
+    return ( unsigned int )(( pWorker->ullRandom * 0x2545F4914F6CDD1DULL ) >> 32 );
+}
+
+//Milliseconds given as text, to us, -1 if not a number
+static long ParseMs( const char * pText, char ** ppEnd )
+{
+    double d = strtod( pText, ppEnd );
+
+    return *ppEnd == pText || d < 0 ? -1 : ( long )( d * 1000 );
+}
+
+//Parse match:action[,action]
+static int ParseRule( const char * pText, SimRule * pRule )
+{
+    char cText[ 256 ], * pAction, * pToken, * pSave, * pEnd, * pValue;
+    SimMatch * pMatch;
+    long lMin, lMax;
+    double d;
+
+    if( strlen( pText ) >= sizeof( cText ) )
+        return -1;
+
+    strcpy( cText, pText );
+    memset( pRule, 0, sizeof( SimRule ) );
+
+    if(( pAction = strchr( cText, ':' ) ) == NULL )
+        return -1;
+
+    *pAction ++ = 0;
+
+    for( pToken = strtok_r( cText, ",", &pSave ); pToken; pToken = strtok_r( NULL, ",", &pSave ) )
+    {
+        if(( pValue = strchr( pToken, '=' ) ) == NULL )
+        {
+            if( strcmp( pToken, "*" ) == 0 )
+                continue;
+            if( strlen( pToken ) != 4 || strspn( pToken, "0123456789" ) != 4 )
+                return -1;
+            strcpy( pRule->cMti, pToken );
+            continue;
+        }
+
+        if( pRule->iMatches == SIM_MAXMATCH )
+            return -1;
+
+        pMatch = &pRule->Match[ pRule->iMatches ++ ];
+        *pValue ++ = 0;
+        pMatch->iFieldNo = atoi( pToken );
+        pMatch->iLength = ( int )strlen( pValue );
+
+        if( pMatch->iFieldNo < 2 || pMatch->iFieldNo > ISO8583_MAXFIELD || pMatch->iLength >= SIM_MAXVALUE )
+            return -1;
+
+        if( pMatch->iLength > 0 && pValue[ pMatch->iLength - 1 ] == '*' )
+        {
+            pMatch->bPrefix = 1;
+            pMatch->iLength --;
+        }
+
+        memcpy( pMatch->cValue, pValue, pMatch->iLength );
+    }
+
+    for( pToken = strtok_r( pAction, ",", &pSave ); pToken; pToken = strtok_r( NULL, ",", &pSave ) )
+    {
+        if( strncmp( pToken, "rc=", 3 ) == 0 && strlen( pToken + 3 ) == 2 )
+            strcpy( pRule->cRc, pToken + 3 );
+        else if( strncmp( pToken, "delay=", 6 ) == 0 )
+        {
+            lMin = ParseMs( pToken + 6, &pEnd );
+            lMax = *pEnd == '-' ? ParseMs( pEnd + 1, &pEnd ) : lMin;
+
+            if( lMin < 0 || lMax < lMin || *pEnd )
+                return -1;
+
+            pRule->uiDelayMin = ( unsigned int )lMin;
+            pRule->uiDelayMax = ( unsigned int )lMax;
+        }
+        else if( strncmp( pToken, "drop=", 5 ) == 0 )
+        {
+            d = strtod( pToken + 5, &pEnd );
+
+            if( pEnd == pToken + 5 || *pEnd || d < 0 || d > 100 )
+                return -1;
+
+            pRule->uiDrop = ( unsigned int )( d * 100 + 0.5 );
+        }
+        else if( strcmp( pToken, "close" ) == 0 )
+            pRule->bClose = 1;
+        else
+            return -1;
+    }
+
+    return 0;
+}
+
+//First rule matching the decoded request, NULL if none
+static const SimRule * MatchRule( SimWorker * pWorker )
+{
+    const SimOpt * pOpt = pWorker->pOpt;
+    const SimRule * pRule;
+    const SimMatch * pMatch;
+    unsigned char cValue[ 2 * ISO8583_MAXLENTH ];
+    int i, j, iLength;
+
+    for( i = 0; i < pOpt->iRules; i ++ )
+    {
+        pRule = &pOpt->Rules[ i ];
+
+        if( pRule->cMti[ 0 ] && memcmp( pRule->cMti, pWorker->pRec->cMsgID, 4 ) != 0 )
+            continue;
+
+        for( j = 0; j < pRule->iMatches; j ++ )
+        {
+            pMatch = &pRule->Match[ j ];
+            iLength = ISO8583Engine_GetField( &pWorker->Spec, pWorker->pRec, pMatch->iFieldNo, cValue, sizeof( cValue ) );
+
+            if( iLength <= 0 || ( pMatch->bPrefix ? iLength < pMatch->iLength : iLength != pMatch->iLength )
+                || memcmp( cValue, pMatch->cValue, pMatch->iLength ) != 0 )
+                break;
+        }
+
+        if( j == pRule->iMatches )
+            return pRule;
+    }
+
+    return NULL;
+}
+
+static void CloseConn( SimWorker * pWorker, SimConn * pConn )
+{
+    epoll_ctl( pWorker->iEpoll, EPOLL_CTL_DEL, pConn->fd, NULL );
+    close( pConn->fd );
+    pConn->fd = -1;
+    pConn->uiGen ++;
+    pConn->pNextFree = pWorker->pFree;
+    pWorker->pFree = pConn;
+    Count( pWorker, SIM_CLOSED );
+}
+
+//Write what the socket takes, -1 when the connection failed
+static int Flush( SimConn * pConn )
+{
+    ssize_t n;
+
+    while( pConn->iOutHead < pConn->iOutTail )
+    {
+        n = write( pConn->fd, pConn->pOut + pConn->iOutHead, pConn->iOutTail - pConn->iOutHead );
+
+        if( n < 0 )
+            return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+
+        pConn->iOutHead += ( int )n;
+    }
+
+    pConn->iOutHead = pConn->iOutTail = 0;
+    return 0;
+}
+
+//Queue a framed response, -1 for a slow reader
+static int Queue( SimConn * pConn, const byte * pData, int iLength )
+{
+    if( pConn->iOutTail + iLength > SIM_OUTBUF && pConn->iOutHead > 0 )
+    {
+        memmove( pConn->pOut, pConn->pOut + pConn->iOutHead, pConn->iOutTail - pConn->iOutHead );
+        pConn->iOutTail -= pConn->iOutHead;
+        pConn->iOutHead = 0;
+    }
+
+    if( pConn->iOutTail + iLength > SIM_OUTBUF )
+        return -1;
+
+    memcpy( pConn->pOut + pConn->iOutTail, pData, iLength );
+    pConn->iOutTail += iLength;
+    return 0;
+}
+
+//Hold a response until ullDue, -1 when out of memory
+static int Delay( SimWorker * pWorker, SimConn * pConn, const byte * pData, int iLength, unsigned long long ullDue )
+{
+    SimPending Pending, * pHeap;
+    int i;
+
+    if( pWorker->iPending == pWorker->iMaxPending )
+    {
+        i = pWorker->iMaxPending ? 2 * pWorker->iMaxPending : 1024;
+
+        if(( pHeap = ( SimPending * )realloc( pWorker->pHeap, i * sizeof( SimPending ) ) ) == NULL )
+            return -1;
+
+        pWorker->pHeap = pHeap;
+        pWorker->iMaxPending = i;
+    }
+
+    if(( Pending.pData = ( byte * )malloc( iLength ) ) == NULL )
+        return -1;
+
+    memcpy( Pending.pData, pData, iLength );
+    Pending.ullDue = ullDue;
+    Pending.pConn = pConn;
+    Pending.uiGen = pConn->uiGen;
+    Pending.iLength = iLength;
+
+    for( i = pWorker->iPending ++; i > 0 && pWorker->pHeap[ ( i - 1 ) / 2 ].ullDue > ullDue; i = ( i - 1 ) / 2 )
+        pWorker->pHeap[ i ] = pWorker->pHeap[ ( i - 1 ) / 2 ];
+
+    pWorker->pHeap[ i ] = Pending;
+    return 0;
+}
+
+//Send the delayed responses that are due, return ms to the next one, -1 if none
+static int SendDue( SimWorker * pWorker )
+{
+    SimPending Due, Last;
+    unsigned long long ullNow = NowNs();
+    int i, iChild;
+
+    while( pWorker->iPending > 0 && pWorker->pHeap[ 0 ].ullDue <= ullNow )
+    {
+        Due = pWorker->pHeap[ 0 ];
+        Last = pWorker->pHeap[ -- pWorker->iPending ];
+
+        for( i = 0; ( iChild = 2 * i + 1 ) < pWorker->iPending; i = iChild )
+        {
+            if( iChild + 1 < pWorker->iPending && pWorker->pHeap[ iChild + 1 ].ullDue < pWorker->pHeap[ iChild ].ullDue )
+                iChild ++;
+            if( pWorker->pHeap[ iChild ].ullDue >= Last.ullDue )
+                break;
+            pWorker->pHeap[ i ] = pWorker->pHeap[ iChild ];
+        }
+
+        if( pWorker->iPending > 0 )
+            pWorker->pHeap[ i ] = Last;
+
+        //The connection may have been closed, its slot reused, meanwhile
+        if( Due.pConn->uiGen == Due.uiGen )
+        {
+            if( Queue( Due.pConn, Due.pData, Due.iLength ) != 0 || Flush( Due.pConn ) != 0 )
+                CloseConn( pWorker, Due.pConn );
+            else
+                Count( pWorker, SIM_RESPONSES );
+        }
+
+        free( Due.pData );
+    }
+
+    if( pWorker->iPending == 0 )
+        return -1;
+
+    return ( int )(( pWorker->pHeap[ 0 ].ullDue - ullNow ) / 1000000 ) + 1;
+}
+
+//Answer one request frame, -1 to close the connection
+static int Answer( SimWorker * pWorker, SimConn * pConn, const ISO8583_Frame * pFrame )
+{
+    static const int RemovedFields[] = { 35, 36, 45, 52 };
+    const SimOpt * pOpt = pWorker->pOpt;
+    const ISO8583_FramerCfg * pCfg = &pOpt->Cfg;
+    const SimRule * pRule;
+    ISO8583_Edit Edits[ 8 ];
+    unsigned char cMti[ 5 ], cAuth[ 7 ];
+    byte cHeader[ SIM_MAXFRAMING ];
+    const char * pRc;
+    int i, iEdits = 0, iLength, iFraming;
+    unsigned int uiDelay;
+
+    if( ISO8583Engine_HexbufToIso8583Len( &pWorker->Spec, pWorker->pRec, pFrame->pMsg, pFrame->iMsgLength ) != 0 )
+    {
+        Count( pWorker, SIM_BAD );
+        return 0;
+    }
+
+    Count( pWorker, SIM_REQUESTS );
+
+    for( i = 0; i < pOpt->iMtis; i ++ )
+    {
+        if( memcmp( pOpt->cMtis[ i ], pWorker->pRec->cMsgID, 4 ) == 0 )
+            break;
+    }
+
+    if( i == pOpt->iMtis )
+    {
+        Count( pWorker, SIM_IGNORED );
+        return 0;
+    }
+
+    pRule = MatchRule( pWorker );
+
+    if( pRule != NULL && pRule->bClose )
+        return -1;
+
+    if( pRule != NULL && pRule->uiDrop && Random( pWorker ) % 10000 < pRule->uiDrop )
+    {
+        Count( pWorker, SIM_DROPPED );
+        return 0;
+    }
+
+    pRc = pRule != NULL && pRule->cRc[ 0 ] ? pRule->cRc : pOpt->cDefaultRc;
+
+    memcpy( cMti, pWorker->pRec->cMsgID, 4 );
+    cMti[ 2 ] ++;
+    Edits[ iEdits ].iFieldNo = 0;
+    Edits[ iEdits ].iOp = ISO8583_EDIT_SET;
+    Edits[ iEdits ].pData = cMti;
+    Edits[ iEdits ++ ].iLength = 4;
+
+    if( pWorker->Spec.FldFormat[ 38 ].bType != 0 )
+    {
+        Edits[ iEdits ].iFieldNo = 39;
+        Edits[ iEdits ].iOp = ISO8583_EDIT_SET;
+        Edits[ iEdits ].pData = ( const unsigned char * )pRc;
+        Edits[ iEdits ++ ].iLength = 2;
+    }
+
+    //Approval code on approved financial and authorization requests
+    if( strcmp( pRc, "00" ) == 0 && ( cMti[ 1 ] == '1' || cMti[ 1 ] == '2' ) && pWorker->Spec.FldFormat[ 37 ].bType != 0 )
+    {
+        sprintf(( char * )cAuth, "%06lu", ( ++ pWorker->ulAuth * 64 + pWorker->iId ) % 1000000 );
+        Edits[ iEdits ].iFieldNo = 38;
+        Edits[ iEdits ].iOp = ISO8583_EDIT_SET;
+        Edits[ iEdits ].pData = cAuth;
+        Edits[ iEdits ++ ].iLength = 6;
+    }
+
+    for( i = 0; i < ( int )( sizeof( RemovedFields ) / sizeof( RemovedFields[ 0 ] ) ); i ++ )
+    {
+        Edits[ iEdits ].iFieldNo = RemovedFields[ i ];
+        Edits[ iEdits ].iOp = ISO8583_EDIT_REMOVE;
+        Edits[ iEdits ].pData = NULL;
+        Edits[ iEdits ++ ].iLength = 0;
+    }
+
+    iFraming = pCfg->iLenBytes + pCfg->iHeaderLength;
+    iLength = ISO8583Engine_Transform( &pWorker->Spec, pFrame->pMsg, pFrame->iMsgLength, Edits, iEdits,
+                                       pWorker->cReply + iFraming, SIM_MAXMESSAGE );
+
+    if( iLength <= 0 )
+    {
+        Count( pWorker, SIM_BAD );
+        return 0;
+    }
+
+    if( pCfg->iHeaderLength == ISO8583_TPDU_LENGTH )
+        ISO8583Framer_ReplyTpdu( pFrame->pHeader, cHeader );
+    else if( pCfg->iHeaderLength > 0 )
+        memcpy( cHeader, pFrame->pHeader, pCfg->iHeaderLength );
+
+    if( ISO8583Framer_EncodePrefix( pCfg, pWorker->cReply, cHeader, iLength ) != iFraming )
+        return -1;
+
+    iLength += iFraming;
+    uiDelay = pRule == NULL ? 0 : pRule->uiDelayMin;
+
+    if( pRule != NULL && pRule->uiDelayMax > pRule->uiDelayMin )
+        uiDelay += Random( pWorker ) % ( pRule->uiDelayMax - pRule->uiDelayMin + 1 );
+
+    if( uiDelay > 0 )
+    {
+        Count( pWorker, SIM_DELAYED );
+        return Delay( pWorker, pConn, pWorker->cReply, iLength, NowNs() + uiDelay * 1000ULL );
+    }
+
+    Count( pWorker, SIM_RESPONSES );
+    return Queue( pConn, pWorker->cReply, iLength );
+}
+
+//Edge triggered: read until the socket is drained, answer every frame, then
+//write the responses of all of them at once
+static void OnReadable( SimWorker * pWorker, SimConn * pConn )
+{
+    ISO8583_Frame Frame;
+    byte * pRoom;
+    int iRoom, iRet;
+    ssize_t n;
+
+    for( ;; )
+    {
+        pRoom = ISO8583Framer_WritePtr( &pConn->Framer, &iRoom );
+        n = read( pConn->fd, pRoom, iRoom );
+
+        if( n < 0 && ( errno == EAGAIN || errno == EWOULDBLOCK ) )
+            break;
+
+        if( n <= 0 )
+        {
+            CloseConn( pWorker, pConn );
+            return;
+        }
+
+        ISO8583Framer_Commit( &pConn->Framer, ( int )n );
+
+        while(( iRet = ISO8583Framer_Next( &pConn->Framer, &Frame ) ) == 1 )
+        {
+            if( Frame.iMsgLength > 0 && Answer( pWorker, pConn, &Frame ) != 0 )
+            {
+                CloseConn( pWorker, pConn );
+                return;
+            }
+        }
+
+        if( iRet < 0 )
+        {
+            Count( pWorker, SIM_BAD );
+            CloseConn( pWorker, pConn );
+            return;
+        }
+    }
+
+    if( Flush( pConn ) != 0 )
+        CloseConn( pWorker, pConn );
+}
+
+static void OnAccept( SimWorker * pWorker )
+{
+    struct epoll_event Event;
+    SimConn * pConn;
+    int fd, iOne = 1;
+
+    while(( fd = accept4( pWorker->iListen, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC ) ) >= 0 )
+    {
+        if(( pConn = pWorker->pFree ) != NULL )
+            pWorker->pFree = pConn->pNextFree;
+        else if(( pConn = ( SimConn * )calloc( 1, sizeof( SimConn ) ) ) == NULL
+                 || ( pConn->pIn = ( byte * )malloc( SIM_INBUF + SIM_OUTBUF ) ) == NULL )
+        {
+            free( pConn );
+            close( fd );
+            continue;
+        }
+
+        pConn->fd = fd;
+        pConn->pOut = pConn->pIn + SIM_INBUF;
+        pConn->iOutHead = pConn->iOutTail = 0;
+        ISO8583Framer_Init( &pConn->Framer, &pWorker->pOpt->Cfg, pConn->pIn, SIM_INBUF );
+        setsockopt( fd, IPPROTO_TCP, TCP_NODELAY, &iOne, sizeof( iOne ) );
+
+        Event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        Event.data.ptr = pConn;
+
+        if( epoll_ctl( pWorker->iEpoll, EPOLL_CTL_ADD, fd, &Event ) != 0 )
+        {
+            close( fd );
+            pConn->pNextFree = pWorker->pFree;
+            pWorker->pFree = pConn;
+            continue;
+        }
+
+        Count( pWorker, SIM_ACCEPTED );
+    }
+}
+
+//Listening socket of one worker, all workers bind the same port
+static int Listen( int iPort )
+{
+    struct sockaddr_in Addr;
+    int fd, iOne = 1;
+
+    if(( fd = socket( AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0 ) ) < 0 )
+        return -1;
+
+    memset( &Addr, 0, sizeof( Addr ) );
+    Addr.sin_family = AF_INET;
+    Addr.sin_addr.s_addr = htonl( INADDR_ANY );
+    Addr.sin_port = htons(( unsigned short )iPort );
+
+    if( setsockopt( fd, SOL_SOCKET, SO_REUSEADDR, &iOne, sizeof( iOne ) ) != 0
+        || setsockopt( fd, SOL_SOCKET, SO_REUSEPORT, &iOne, sizeof( iOne ) ) != 0
+        || bind( fd, ( struct sockaddr * )&Addr, sizeof( Addr ) ) != 0
+        || listen( fd, SIM_BACKLOG ) != 0 )
+    {
+        close( fd );
+        return -1;
+    }
+
+    return fd;
+}
+
+static void * WorkerMain( void * pArg )
+{
+    SimWorker * pWorker = ( SimWorker * )pArg;
+    struct epoll_event Events[ SIM_EVENTS ];
+    SimConn * pConn;
+    int i, n, iTimeout;
+
+    while( !g_bStop )
+    {
+        iTimeout = SendDue( pWorker );
+
+        if( iTimeout < 0 || iTimeout > 1000 )
+            iTimeout = 1000;
+
+        n = epoll_wait( pWorker->iEpoll, Events, SIM_EVENTS, iTimeout );
+
+        for( i = 0; i < n; i ++ )
+        {
+            if( Events[ i ].data.ptr == NULL )
+            {
+                OnAccept( pWorker );
+                continue;
+            }
+
+            pConn = ( SimConn * )Events[ i ].data.ptr;
+
+            //Closed earlier in this batch
+            if( pConn->fd < 0 )
+                continue;
+
+            if( Events[ i ].events & ( EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR ) )
+                OnReadable( pWorker, pConn );
+            else if(( Events[ i ].events & EPOLLOUT ) && Flush( pConn ) != 0 )
+                CloseConn( pWorker, pConn );
+        }
+    }
+
+    return NULL;
+}
+
+static int StartWorker( SimWorker * pWorker, const SimOpt * pOpt, int iId, int iCpus )
+{
+    struct epoll_event Event;
+    cpu_set_t Cpus;
+
+    pWorker->iId = iId;
+    pWorker->pOpt = pOpt;
+    pWorker->Spec = pOpt->Spec;
+    pWorker->ullRandom = 0x9E3779B97F4A7C15ULL * ( iId + 1 ) ^ NowNs();
+    pWorker->iListen = Listen( pOpt->iPort );
+    pWorker->iEpoll = epoll_create1( EPOLL_CLOEXEC );
+
+    if( pWorker->iListen < 0 || pWorker->iEpoll < 0 )
+        return -1;
+
+    if(( pWorker->pPool = ISO8583Pool_Create( 1, SIM_MAXMESSAGE ) ) == NULL
+        || ( pWorker->pRec = ISO8583Pool_Acquire( pWorker->pPool ) ) == NULL )
+        return -1;
+
+    Event.events = EPOLLIN | EPOLLET;
+    Event.data.ptr = NULL;
+
+    if( epoll_ctl( pWorker->iEpoll, EPOLL_CTL_ADD, pWorker->iListen, &Event ) != 0
+        || pthread_create( &pWorker->Thread, NULL, WorkerMain, pWorker ) != 0 )
+        return -1;
+
+    CPU_ZERO( &Cpus );
+    CPU_SET( iId % iCpus, &Cpus );
+    pthread_setaffinity_np( pWorker->Thread, sizeof( Cpus ), &Cpus );
+    return 0;
+}
+
+static void PrintCounters( SimWorker ** ppWorkers, int iWorkers, FILE * fp )
+{
+    unsigned long ulTotal;
+    int i, j;
+
+    for( j = 0; j < SIM_COUNTERS; j ++ )
+    {
+        for( ulTotal = 0, i = 0; i < iWorkers; i ++ )
+            ulTotal += atomic_load_explicit( &ppWorkers[ i ]->ulCounters[ j ], memory_order_relaxed );
+
+        fprintf( fp, "%s%s %lu", j ? "  " : "", CounterNames[ j ], ulTotal );
+    }
+
+    fputc( '\n', fp );
+    fflush( fp );
+}
+
+int main( int argc, char ** argv )
+{
+    static SimOpt Opt;
+    SimWorker ** ppWorkers;
+    const char * pSpecPath = NULL, * pMtis = "0200,0800", * pNext;
+    struct sigaction Action;
+    struct rlimit Limit;
+    int i, iRet, iWorkers = 0, iCpus, iInterval = 0, iTick;
+
+    Opt.iPort = 5000;
+    strcpy( Opt.cDefaultRc, "00" );
+    Opt.Cfg.iLenFormat = ISO8583_LEN_BINARY;
+    Opt.Cfg.iLenBytes = 2;
+    Opt.Cfg.iMaxMessage = SIM_MAXMESSAGE;
+
+    while(( i = getopt( argc, argv, "p:w:m:c:r:i:L:n:IH:s:" ) ) != -1 )
+    {
+        switch( i )
+        {
+        case 'p':
+            Opt.iPort = atoi( optarg );
+            break;
+        case 'w':
+            iWorkers = atoi( optarg );
+            break;
+        case 'm':
+            pMtis = optarg;
+            break;
+        case 'c':
+            if( strlen( optarg ) != 2 )
+                Usage();
+            strcpy( Opt.cDefaultRc, optarg );
+            break;
+        case 'r':
+            if( Opt.iRules == SIM_MAXRULES || ParseRule( optarg, &Opt.Rules[ Opt.iRules ++ ] ) != 0 )
+            {
+                fprintf( stderr, "bad rule: %s\n", optarg );
+                Usage();
+            }
+            break;
+        case 'i':
+            iInterval = atoi( optarg );
+            break;
+        case 'L':
+            if( strcmp( optarg, "bin" ) == 0 )
+                Opt.Cfg.iLenFormat = ISO8583_LEN_BINARY;
+            else if( strcmp( optarg, "bcd" ) == 0 )
+                Opt.Cfg.iLenFormat = ISO8583_LEN_BCD;
+            else if( strcmp( optarg, "asc" ) == 0 )
+                Opt.Cfg.iLenFormat = ISO8583_LEN_ASCII;
+            else
+                Usage();
+            break;
+        case 'n':
+            Opt.Cfg.iLenBytes = atoi( optarg );
+            break;
+        case 'I':
+            Opt.Cfg.bLenInclusive = 1;
+            break;
+        case 'H':
+            Opt.Cfg.iHeaderLength = atoi( optarg );
+            break;
+        case 's':
+            pSpecPath = optarg;
+            break;
+        default:
+            Usage();
+        }
+    }
+
+    if( optind != argc || ISO8583Framer_CheckCfg( &Opt.Cfg ) != ISOENGINE_OK
+        || Opt.Cfg.iLenBytes + Opt.Cfg.iHeaderLength > SIM_MAXFRAMING || Opt.iPort <= 0 || Opt.iPort > 65535 )
+        Usage();
+
+    for( ; pMtis != NULL && Opt.iMtis < SIM_MAXMTIS; pMtis = pNext ? pNext + 1 : NULL )
+    {
+        pNext = strchr( pMtis, ',' );
+
+        if(( pNext ? pNext - pMtis : ( long )strlen( pMtis ) ) != 4 )
+            Usage();
+
+        memcpy( Opt.cMtis[ Opt.iMtis ++ ], pMtis, 4 );
+    }
+
+    if( pSpecPath == NULL )
+        ISO8583Engine_InitFieldFormat( &Opt.Spec, ISO8583_BITMAP64, SampleFldFmt );
+    else if(( iRet = ISO8583SpecFile_Load( pSpecPath, &Opt.Spec, &i ) ) != ISOENGINE_OK )
+    {
+        if( iRet == -1 )
+            fprintf( stderr, "%s: cannot read\n", pSpecPath );
+        else
+            fprintf( stderr, "%s:%d: bad definition (%d)\n", pSpecPath, i, iRet );
+        return 1;
+    }
+
+    //Thousands of terminals need thousands of descriptors
+    if( getrlimit( RLIMIT_NOFILE, &Limit ) == 0 && Limit.rlim_cur < Limit.rlim_max )
+    {
+        Limit.rlim_cur = Limit.rlim_max;
+        setrlimit( RLIMIT_NOFILE, &Limit );
+    }
+
+    memset( &Action, 0, sizeof( Action ) );
+    Action.sa_handler = OnSignal;
+    sigaction( SIGINT, &Action, NULL );
+    sigaction( SIGTERM, &Action, NULL );
+    signal( SIGPIPE, SIG_IGN );
+
+    if(( iCpus = ( int )sysconf( _SC_NPROCESSORS_ONLN ) ) < 1 )
+        iCpus = 1;
+    if( iWorkers <= 0 )
+        iWorkers = iCpus;
+
+    if(( ppWorkers = ( SimWorker ** )calloc( iWorkers, sizeof( SimWorker * ) ) ) == NULL )
+        return 1;
+
+    for( i = 0; i < iWorkers; i ++ )
+    {
+        if(( ppWorkers[ i ] = ( SimWorker * )aligned_alloc( 64, ( sizeof( SimWorker ) + 63 ) & ~( size_t )63 ) ) == NULL )
+            return 1;
+
+        memset( ppWorkers[ i ], 0, sizeof( SimWorker ) );
+
+        if( StartWorker( ppWorkers[ i ], &Opt, i, iCpus ) != 0 )
+        {
+            perror( "worker" );
+            return 1;
+        }
+    }
+
+    fprintf( stderr, "listening on port %d, %d workers\n", Opt.iPort, iWorkers );
+
+    for( iTick = 0; !g_bStop; iTick ++ )
+    {
+        sleep( 1 );
+
+        if( iInterval > 0 && iTick % iInterval == iInterval - 1 )
+            PrintCounters( ppWorkers, iWorkers, stdout );
+    }
+
+    for( i = 0; i < iWorkers; i ++ )
+        pthread_join( ppWorkers[ i ]->Thread, NULL );
+
+    PrintCounters( ppWorkers, iWorkers, stderr );
+    return 0;
+}
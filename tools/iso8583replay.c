@@ -0,0 +1,550 @@
+/***************************************************************************
+* FILE NAME:    ISO8583Replay.C                                            *
+* MODULE NAME:  ISO8583Engine tools                                        *
+* PROGRAMMER:                                                              *
+* DESCRIPTION:  Replay a capture file of length prefixed ISO8583 messages. *
+*               The file is mapped, framed with ISO8583Framer_Parse and    *
+*               every message indexed in place with ISO8583Engine_OpenView *
+*               so nothing is copied. Pages already read are dropped from  *
+*               the mapping as the replay moves on, memory use does not    *
+*               grow with the file. Messages passing the MTI / field 3 /   *
+*               field 39 / field 41 filters are written as a dump, CSV,    *
+*               JSON lines or a column file (ISO8583Column.H). Cardholder  *
+*               data is masked as by ISO8583Dump_InitMask unless           *
+*               --unmasked is given. A failed write stops the replay with  *
+*               exit code 1.                                               *
+* USAGE:        iso8583replay [options] capture-file                       *
+*               -o dump|csv|json|col  output format, default dump          *
+*               -f 2,3,4            fields to write, default all present   *
+*                                   (dump, json), 3,4,11,37,39,41 (csv)    *
+*                                   or 4,11,12,13,39,41,42 (col)           *
+*               -m 0200,0210        MTI filter                             *
+*               -p 000000           field 3 filter                         *
+*               -r 00,05            field 39 filter                        *
+*               -t TERM0001         field 41 filter                        *
+*               -x                  add the RAW message in hex to a dump,  *
+*                                   needs --unmasked                       *
+*               -L bin|bcd|asc      length prefix format, default bin      *
+*               -n 2                length prefix bytes, default 2         *
+*               -i                  length counts the prefix itself        *
+*               -H 5                header bytes after the prefix (TPDU)   *
+*               -s dialect.spec     field formats from a definition file   *
+*                                   (ISO8583SpecFile.H), default the       *
+*                                   sample formats                         *
+*               -U, --unmasked      write PAN, track, PIN block and chip   *
+*                                   data in clear; col files of such       *
+*                                   fields need it too                     *
+*               A filter list matches any of its comma separated values.   *
+* REVISION:                                                                *
+****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "ISO8583Engine.h"
+#include "ISO8583Bits.h"
+#include "ISO8583Framer.h"
+#include "ISO8583Column.h"
+#include "ISO8583Dump.h"
+#include "ISO8583SpecFile.h"
+#include "SampleFmt.h"
+
+//Mapped bytes behind the replay position kept before they are dropped
+#define REPLAY_DROP_WINDOW      ( 16 << 20 )
+
+//Largest message accepted in a capture
+#define REPLAY_MAXMESSAGE       ( 64 << 10 )
+
+//Largest field value, BCD fields are unpacked to one digit per byte
+#define REPLAY_MAXVALUE         ( 2 * ISO8583_MAXLENTH )
+
+//Rows per block of a column file
+#define REPLAY_BLOCKROWS        65536
+
+//Written instead of a redacted field, as ISO8583Dump_Format does
+#define REPLAY_REDACTED         "<redacted>"
+
+enum
+{
+    REPLAY_DUMP = 0,
+    REPLAY_CSV,
+    REPLAY_JSON,
+    REPLAY_COL,
+};
+
+typedef struct
+{
+    ISO8583_FramerCfg Cfg;
+    int iFormat;
+    int bHex;
+    int bUnmasked;
+    unsigned char cMask[ ISO8583_MAXFIELD ];    // ISO8583_DUMP_*, index field - 1
+    int iFields[ ISO8583_MAXFIELD ];
+    int iFieldCount;
+    const char * pMti;
+    const char * pProc;
+    const char * pRc;
+    const char * pTid;
+} ReplayOpt;
+
+static void Usage( void )
+{
+    fprintf( stderr, "usage: iso8583replay [-o dump|csv|json|col] [-f fields] [-m mti] [-p field3] [-r field39] [-t field41]\n"
+                     "                     [-x] [-L bin|bcd|asc] [-n prefix bytes] [-i] [-H header bytes] [-s spec-file]\n"
+                     "                     [-U|--unmasked]\n"
+                     "                     capture-file\n" );
+    exit( 2 );
+}
+
+//Parse a comma separated list of field numbers
+static int ParseFields( const char * pList, int * piFields )
+{
+    int n = 0, iFieldNo;
+    char * pEnd;
+
+    while( *pList && n < ISO8583_MAXFIELD )
+    {
+        iFieldNo = ( int )strtol( pList, &pEnd, 10 );
+
+        if( pEnd == pList || iFieldNo < 2 || iFieldNo > ISO8583_MAXFIELD )
+            return -1;
+
+        piFields[ n ++ ] = iFieldNo;
+        pList = *pEnd == ',' ? pEnd + 1 : pEnd;
+    }
+
+    return n;
+}
+
+//pValue equals one of the comma separated entries of pList
+static int MatchList( const char * pList, const unsigned char * pValue, int iLength )
+{
+    const char * pNext;
+
+    for( ; pList != NULL; pList = pNext ? pNext + 1 : NULL )
+    {
+        pNext = strchr( pList, ',' );
+
+        if(( pNext ? ( int )( pNext - pList ) : ( int )strlen( pList ) ) == iLength && memcmp( pList, pValue, iLength ) == 0 )
+            return 1;
+    }
+
+    return 0;
+}
+
+//Field iFieldNo of the view passes the filter pList, NULL passes everything
+static int MatchField( const ISO8583_Spec * pSpec, ISO8583_View * pView, int iFieldNo, const char * pList )
+{
+    unsigned char cValue[ REPLAY_MAXVALUE ];
+    int iLength;
+
+    if( pList == NULL )
+        return 1;
+
+    iLength = ISO8583Engine_ViewGetField( pSpec, pView, iFieldNo, cValue, sizeof( cValue ) );
+    return iLength > 0 && MatchList( pList, cValue, iLength );
+}
+
+//Mask a field value in place as ISO8583Dump_Format does, 0 when the whole
+//value is to be redacted
+static int MaskValue( unsigned char cMask, int bBin, unsigned char * pValue, int iLength )
+{
+    int i;
+
+    //a PAN in binary form has no digits to keep
+    if( cMask == ISO8583_DUMP_REDACT || ( cMask == ISO8583_DUMP_PAN && bBin ) )
+        return 0;
+
+    if( cMask == ISO8583_DUMP_PAN )
+    {
+        for( i = 0; i < iLength; i ++ )
+        {
+            if( iLength < 13 || ( i >= 6 && i < iLength - 4 ) )
+                pValue[ i ] = '*';
+        }
+    }
+
+    return 1;
+}
+
+//Write a field value, BIN fields in hex, other bytes escaped for the format
+static void PutValue( FILE * fp, int iFormat, int bBin, const unsigned char * pValue, int iLength )
+{
+    static const char cHex[] = "0123456789ABCDEF";
+    int i;
+
+    if( iFormat != REPLAY_DUMP )
+        putc( '"', fp );
+
+    for( i = 0; i < iLength; i ++ )
+    {
+        if( bBin )
+        {
+            putc( cHex[ pValue[ i ] >> 4 ], fp );
+            putc( cHex[ pValue[ i ] & 0x0F ], fp );
+        }
+        else if( pValue[ i ] == '"' && iFormat == REPLAY_CSV )
+            fputs( "\"\"", fp );
+        else if(( pValue[ i ] == '"' || pValue[ i ] == '\\' ) && iFormat == REPLAY_JSON )
+        {
+            putc( '\\', fp );
+            putc( pValue[ i ], fp );
+        }
+        else if( pValue[ i ] < 0x20 || pValue[ i ] >= 0x7F )
+        {
+            if( iFormat == REPLAY_JSON )
+                fprintf( fp, "\\u%04x", pValue[ i ] );
+            else
+                fprintf( fp, "\\x%02X", pValue[ i ] );
+        }
+        else
+            putc( pValue[ i ], fp );
+    }
+
+    if( iFormat != REPLAY_DUMP )
+        putc( '"', fp );
+}
+
+//Write one message in the chosen format
+static void PutMessage( FILE * fp, const ReplayOpt * pOpt, const ISO8583_Spec * pSpec, ISO8583_View * pView, size_t nOffset )
+{
+    unsigned char cValue[ REPLAY_MAXVALUE ];
+    int iFields[ ISO8583_MAXFIELD ], iFieldCount = 0;
+    int i, iFieldNo, iLength, bBin;
+    unsigned long long ullBits;
+
+    if( pOpt->iFieldCount > 0 )
+    {
+        memcpy( iFields, pOpt->iFields, pOpt->iFieldCount * sizeof( int ) );
+        iFieldCount = pOpt->iFieldCount;
+    }
+    else
+    {
+        for( i = 0; i < ISO8583_MAXFIELD / 64; i ++ )
+        {
+            ullBits = pView->ulBitmap[ i ] & ( i ? ~0ULL : ~1ULL );
+
+            for( ; ullBits; ullBits &= ullBits - 1 )
+                iFields[ iFieldCount ++ ] = ( i << 6 ) + ISO8583Bits_Ctz64( ullBits ) + 1;
+        }
+    }
+
+    ISO8583Engine_ViewGetField( pSpec, pView, 0, cValue, sizeof( cValue ) );
+
+    if( pOpt->iFormat == REPLAY_DUMP )
+        fprintf( fp, "@%lu length %d MTI %s\n", ( unsigned long )nOffset, pView->iLength, cValue );
+    else if( pOpt->iFormat == REPLAY_CSV )
+        fprintf( fp, "%lu,%s", ( unsigned long )nOffset, cValue );
+    else
+        fprintf( fp, "{\"offset\":%lu,\"mti\":\"%s\"", ( unsigned long )nOffset, cValue );
+
+    for( i = 0; i < iFieldCount; i ++ )
+    {
+        iFieldNo = iFields[ i ];
+        iLength = ISO8583Engine_ViewGetField( pSpec, pView, iFieldNo, cValue, sizeof( cValue ) );
+        bBin = iFieldNo <= pSpec->iMaxField && ( pSpec->FldFormat[ iFieldNo - 1 ].bType & ISO8583TYPE_BIN );
+
+        if( iLength > 0 && !MaskValue( pOpt->cMask[ iFieldNo - 1 ], bBin, cValue, iLength ) )
+        {
+            bBin = 0;
+            iLength = sizeof( REPLAY_REDACTED ) - 1;
+            memcpy( cValue, REPLAY_REDACTED, iLength );
+        }
+
+        if( pOpt->iFormat == REPLAY_CSV )
+        {
+            putc( ',', fp );
+
+            if( iLength > 0 )
+                PutValue( fp, REPLAY_CSV, bBin, cValue, iLength );
+
+            continue;
+        }
+
+        if( iLength <= 0 )
+            continue;
+
+        if( pOpt->iFormat == REPLAY_DUMP )
+            fprintf( fp, "  [%3d] ", iFieldNo );
+        else
+            fprintf( fp, ",\"%d\":", iFieldNo );
+
+        PutValue( fp, pOpt->iFormat, bBin, cValue, iLength );
+
+        if( pOpt->iFormat == REPLAY_DUMP )
+            putc( '\n', fp );
+    }
+
+    if( pOpt->iFormat == REPLAY_DUMP && pOpt->bHex )
+    {
+        fputs( "  RAW   ", fp );
+        PutValue( fp, REPLAY_DUMP, 1, pView->pBuf, pView->iLength );
+        putc( '\n', fp );
+    }
+
+    fputs( pOpt->iFormat == REPLAY_JSON ? "}\n" : "\n", fp );
+}
+
+int main( int argc, char ** argv )
+{
+    static const int CsvFields[] = { 3, 4, 11, 37, 39, 41 };
+    static const int ColFields[] = { 4, 11, 12, 13, 39, 41, 42 };
+    static const struct option LongOpts[] =
+    {
+        { "unmasked", no_argument, NULL, 'U' },
+        { NULL, 0, NULL, 0 },
+    };
+    static ISO8583_Spec Spec;
+    static ISO8583_ColumnSet ColSet;
+    ISO8583_ColumnDef ColDefs[ ISO8583_MAXFIELD ];
+    static char cOutBuf[ 1 << 20 ];
+    ReplayOpt Opt;
+    ISO8583_View View;
+    ISO8583_Frame Frame;
+    unsigned char cMti[ 8 ];
+    const char * pSpecPath = NULL;
+    const byte * pMap;
+    size_t nSize, nPos = 0, nDropped = 0, nUsed, nPage;
+    unsigned long ulFrames = 0, ulMatched = 0, ulBad = 0;
+    struct stat st;
+    int i, fd, iRet, iExit = 0;
+
+    memset( &Opt, 0, sizeof( Opt ) );
+    Opt.Cfg.iLenFormat = ISO8583_LEN_BINARY;
+    Opt.Cfg.iLenBytes = 2;
+    Opt.Cfg.iMaxMessage = REPLAY_MAXMESSAGE;
+
+    while(( i = getopt_long( argc, argv, "o:f:m:p:r:t:xL:n:iH:s:U", LongOpts, NULL ) ) != -1 )
+    {
+        switch( i )
+        {
+        case 'o':
+            if( strcmp( optarg, "dump" ) == 0 )
+                Opt.iFormat = REPLAY_DUMP;
+            else if( strcmp( optarg, "csv" ) == 0 )
+                Opt.iFormat = REPLAY_CSV;
+            else if( strcmp( optarg, "json" ) == 0 )
+                Opt.iFormat = REPLAY_JSON;
+            else if( strcmp( optarg, "col" ) == 0 )
+                Opt.iFormat = REPLAY_COL;
+            else
+                Usage();
+            break;
+        case 'f':
+            if(( Opt.iFieldCount = ParseFields( optarg, Opt.iFields ) ) <= 0 )
+                Usage();
+            break;
+        case 'm':
+            Opt.pMti = optarg;
+            break;
+        case 'p':
+            Opt.pProc = optarg;
+            break;
+        case 'r':
+            Opt.pRc = optarg;
+            break;
+        case 't':
+            Opt.pTid = optarg;
+            break;
+        case 'x':
+            Opt.bHex = 1;
+            break;
+        case 'L':
+            if( strcmp( optarg, "bin" ) == 0 )
+                Opt.Cfg.iLenFormat = ISO8583_LEN_BINARY;
+            else if( strcmp( optarg, "bcd" ) == 0 )
+                Opt.Cfg.iLenFormat = ISO8583_LEN_BCD;
+            else if( strcmp( optarg, "asc" ) == 0 )
+                Opt.Cfg.iLenFormat = ISO8583_LEN_ASCII;
+            else
+                Usage();
+            break;
+        case 'n':
+            Opt.Cfg.iLenBytes = atoi( optarg );
+            break;
+        case 'i':
+            Opt.Cfg.bLenInclusive = 1;
+            break;
+        case 'H':
+            Opt.Cfg.iHeaderLength = atoi( optarg );
+            break;
+        case 's':
+            pSpecPath = optarg;
+            break;
+        case 'U':
+            Opt.bUnmasked = 1;
+            break;
+        default:
+            Usage();
+        }
+    }
+
+    if( optind != argc - 1 || ISO8583Framer_CheckCfg( &Opt.Cfg ) != ISOENGINE_OK )
+        Usage();
+
+    if( Opt.bHex && !Opt.bUnmasked )
+    {
+        fputs( "-x writes the message in clear, give --unmasked\n", stderr );
+        return 2;
+    }
+
+    if( Opt.iFormat == REPLAY_CSV && Opt.iFieldCount == 0 )
+    {
+        Opt.iFieldCount = sizeof( CsvFields ) / sizeof( CsvFields[ 0 ] );
+        memcpy( Opt.iFields, CsvFields, sizeof( CsvFields ) );
+    }
+    else if( Opt.iFormat == REPLAY_COL && Opt.iFieldCount == 0 )
+    {
+        Opt.iFieldCount = sizeof( ColFields ) / sizeof( ColFields[ 0 ] );
+        memcpy( Opt.iFields, ColFields, sizeof( ColFields ) );
+    }
+
+    if( pSpecPath == NULL )
+        ISO8583Engine_InitFieldFormat( &Spec, ISO8583_BITMAP64, SampleFldFmt );
+    else if(( iRet = ISO8583SpecFile_Load( pSpecPath, &Spec, &i ) ) != ISOENGINE_OK )
+    {
+        if( iRet == -1 )
+            fprintf( stderr, "%s: cannot read\n", pSpecPath );
+        else
+            fprintf( stderr, "%s:%d: bad definition (%d)\n", pSpecPath, i, iRet );
+        return 1;
+    }
+
+    //The masks follow the spec, a definition file may add Luhn or Z fields
+    if( !Opt.bUnmasked )
+        ISO8583Dump_InitMask( &Spec, Opt.cMask );
+
+    if( Opt.iFormat == REPLAY_COL )
+    {
+        for( i = 0; i < Opt.iFieldCount; i ++ )
+        {
+            if( Opt.iFields[ i ] < 2 || ISO8583Column_DefaultDef( &Spec, Opt.iFields[ i ], &ColDefs[ i ] ) != ISOENGINE_OK )
+                Usage();
+
+            //columns hold the values as they are, there is nothing to mask
+            if( Opt.cMask[ Opt.iFields[ i ] - 1 ] != ISO8583_DUMP_CLEAR )
+            {
+                fprintf( stderr, "field %d holds cardholder data, give --unmasked\n", Opt.iFields[ i ] );
+                return 2;
+            }
+        }
+
+        if( ISO8583Column_Init( &ColSet, &Spec, ColDefs, Opt.iFieldCount, REPLAY_BLOCKROWS ) != ISOENGINE_OK )
+        {
+            fputs( "out of memory\n", stderr );
+            return 1;
+        }
+    }
+    setvbuf( stdout, cOutBuf, _IOFBF, sizeof( cOutBuf ) );
+
+    if(( fd = open( argv[ optind ], O_RDONLY ) ) < 0 || fstat( fd, &st ) != 0 )
+    {
+        perror( argv[ optind ] );
+        return 1;
+    }
+
+    nSize = ( size_t )st.st_size;
+    nPage = ( size_t )sysconf( _SC_PAGESIZE );
+
+    if( nSize == 0 )
+        return 0;
+
+    pMap = ( const byte * )mmap( NULL, nSize, PROT_READ, MAP_PRIVATE, fd, 0 );
+    close( fd );
+
+    if( pMap == ( const byte * )MAP_FAILED )
+    {
+        perror( "mmap" );
+        return 1;
+    }
+
+    madvise(( void * )pMap, nSize, MADV_SEQUENTIAL );
+
+    if( Opt.iFormat == REPLAY_CSV )
+    {
+        fputs( "offset,mti", stdout );
+
+        for( i = 0; i < Opt.iFieldCount; i ++ )
+            printf( ",f%d", Opt.iFields[ i ] );
+
+        putchar( '\n' );
+    }
+    else if( Opt.iFormat == REPLAY_COL && ISO8583Column_WriteHeader( &ColSet, stdout ) != ISOENGINE_OK )
+        iExit = 1;
+
+    while( nPos < nSize && !iExit )
+    {
+        iRet = ISO8583Framer_Parse( &Opt.Cfg, pMap + nPos, nSize - nPos, &Frame, &nUsed );
+
+        if( iRet == 0 )
+        {
+            fprintf( stderr, "@%lu: capture ends inside a message\n", ( unsigned long )nPos );
+            iExit = 1;
+            break;
+        }
+        else if( iRet < 0 )
+        {
+            fprintf( stderr, "@%lu: bad length prefix (%d), replay stopped\n", ( unsigned long )nPos, iRet );
+            iExit = 1;
+            break;
+        }
+
+        ulFrames ++;
+
+        if( Frame.iMsgLength > 0 )
+        {
+            if( ISO8583Engine_OpenView( &Spec, &View, Frame.pMsg, Frame.iMsgLength ) != ISOENGINE_OK )
+                ulBad ++;
+            else if(( Opt.pMti == NULL || ( ISO8583Engine_ViewGetField( &Spec, &View, 0, cMti, sizeof( cMti ) ) == 4 && MatchList( Opt.pMti, cMti, 4 ) ) )
+                && MatchField( &Spec, &View, 3, Opt.pProc ) && MatchField( &Spec, &View, 39, Opt.pRc )
+                && MatchField( &Spec, &View, 41, Opt.pTid ) )
+            {
+                if( Opt.iFormat != REPLAY_COL )
+                    PutMessage( stdout, &Opt, &Spec, &View, ( size_t )( Frame.pMsg - pMap ) );
+                else if(( iRet = ISO8583Column_AddView( &ColSet, &View ) ) == REPLAY_BLOCKROWS
+                         && ISO8583Column_WriteBlock( &ColSet, stdout ) != ISOENGINE_OK )
+                    iExit = 1;
+
+                if( Opt.iFormat == REPLAY_COL && iRet < 0 )
+                    ulBad ++;
+                else
+                    ulMatched ++;
+            }
+        }
+
+        nPos += nUsed;
+
+        if( ferror( stdout ) )
+            iExit = 1;
+
+        //Give back the pages behind the replay position, they are not read again
+        if( nPos - nDropped >= REPLAY_DROP_WINDOW )
+        {
+            madvise(( void * )( pMap + nDropped ), ( nPos & ~( nPage - 1 ) ) - nDropped, MADV_DONTNEED );
+            nDropped = nPos & ~( nPage - 1 );
+        }
+    }
+
+    if( Opt.iFormat == REPLAY_COL )
+    {
+        if( !iExit && ISO8583Column_WriteBlock( &ColSet, stdout ) != ISOENGINE_OK )
+            iExit = 1;
+        ISO8583Column_Free( &ColSet );
+    }
+
+    if( fflush( stdout ) != 0 || ferror( stdout ) )
+        iExit = 1;
+
+    if( iExit && ferror( stdout ) )
+        perror( "write" );
+
+    munmap(( void * )pMap, nSize );
+    fprintf( stderr, "%lu frames, %lu matched, %lu undecodable\n", ulFrames, ulMatched, ulBad );
+    return iExit;
+}